@@ -0,0 +1,52 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "ccontrol/ChunkPlacement.h"
+
+namespace lsst {
+namespace qserv {
+namespace ccontrol {
+
+void ChunkPlacement::set(std::string const& db, int chunkId, std::string const& worker) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _workers[Key(db, chunkId)] = worker;
+}
+
+void ChunkPlacement::remove(std::string const& db, int chunkId) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _workers.erase(Key(db, chunkId));
+}
+
+std::string ChunkPlacement::get(std::string const& db, int chunkId) const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    auto iter = _workers.find(Key(db, chunkId));
+    return iter == _workers.end() ? std::string() : iter->second;
+}
+
+size_t ChunkPlacement::size() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _workers.size();
+}
+
+}}} // namespace lsst::qserv::ccontrol
@@ -0,0 +1,72 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_CCONTROL_CHUNKPLACEMENT_H
+#define LSST_QSERV_CCONTROL_CHUNKPLACEMENT_H
+
+// System headers
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace lsst {
+namespace qserv {
+namespace ccontrol {
+
+/// ChunkPlacement remembers which worker answered for each chunk, as named
+/// in the ProtoHeader.wname of its results. The czar does not otherwise know
+/// where chunks live, since xrootd routes requests by chunk resource, so
+/// this is what lets it pack chunks held by the same worker into one
+/// multi-chunk TaskMsg. Entries are only hints: a worker that turns out not
+/// to hold a chunk says so, and the entry is dropped.
+class ChunkPlacement {
+public:
+    typedef std::shared_ptr<ChunkPlacement> Ptr;
+
+    ChunkPlacement() {}
+    ChunkPlacement(ChunkPlacement const&) = delete;
+    ChunkPlacement& operator=(ChunkPlacement const&) = delete;
+
+    /// Record that worker answered for chunkId of db.
+    void set(std::string const& db, int chunkId, std::string const& worker);
+
+    /// Forget where chunkId of db is.
+    void remove(std::string const& db, int chunkId);
+
+    /// @return the worker last seen answering for chunkId of db, or an empty
+    /// string if unknown
+    std::string get(std::string const& db, int chunkId) const;
+
+    size_t size() const;
+
+private:
+    typedef std::pair<std::string, int> Key;
+
+    mutable std::mutex _mtx; ///< Protects _workers
+    std::map<Key, std::string> _workers;
+};
+
+}}} // namespace lsst::qserv::ccontrol
+
+#endif // LSST_QSERV_CCONTROL_CHUNKPLACEMENT_H
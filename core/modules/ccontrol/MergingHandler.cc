@@ -31,16 +31,20 @@
 #include "lsst/log/Log.h"
 
 // Qserv headers
+#include "ccontrol/ChunkPlacement.h"
 #include "ccontrol/msgCode.h"
 #include "global/Bug.h"
 #include "global/debugUtil.h"
 #include "global/MsgReceiver.h"
+#include "proto/ColumnBlocks.h"
 #include "proto/ProtoHeaderWrap.h"
 #include "proto/ProtoImporter.h"
 #include "proto/WorkerResponse.h"
+#include "qdisp/Executive.h"
 #include "qdisp/JobQuery.h"
 #include "rproc/InfileMerger.h"
 #include "util/common.h"
+#include "util/Compression.h"
 #include "util/StringHash.h"
 
 using lsst::qserv::proto::ProtoImporter;
@@ -50,21 +54,74 @@ using lsst::qserv::proto::WorkerResponse;
 
 namespace {
 LOG_LOGGER _log = LOG_GET("lsst.qserv.ccontrol.MergingHandler");
+
+/// Read the 'continues' flag of a serialized Result message without parsing
+/// it. It is field 1 of Result, so protobuf writes it first: a varint tag
+/// (0x08) followed by a single byte value. Compressed messages carry a copy
+/// in their header.
+/// @return false if the buffer does not start as expected
+bool peekContinues(ProtoHeader const& header, std::vector<char> const& buffer, bool& continues) {
+    if (header.compression() != ProtoHeader::NONE) {
+        continues = header.continues();
+        return header.has_continues();
+    }
+    if (buffer.size() < 2 || buffer[0] != 0x08 || (buffer[1] != 0 && buffer[1] != 1)) {
+        return false;
+    }
+    continues = buffer[1] == 1;
+    return true;
+}
+
 }
 
 
 namespace lsst {
 namespace qserv {
 namespace ccontrol {
+
+/// Verify, parse and merge one result buffer on a decode thread.
+class MergingHandler::DecodeTask : public util::WorkQueue::Callable {
+public:
+    DecodeTask(std::shared_ptr<MergingHandler> const& handler,
+               std::shared_ptr<WorkerResponse> const& response,
+               std::vector<char>&& buffer, int seq)
+        : _handler(handler), _response(response), _buffer(std::move(buffer)), _seq(seq) {}
+
+    void operator()() override {
+        // Buffers of a cancelled job are dropped without decoding them.
+        auto job = _handler->getJobQuery().lock();
+        if (job == nullptr || job->isCancelled()) {
+            _handler->_decodeDone(false);
+            return;
+        }
+        bool success = _handler->_verifyResult(*_response, _buffer)
+            && _handler->_setResult(*_response, _buffer);
+        std::vector<char>().swap(_buffer); // Release memory before loading
+        _handler->_mergeInTurn(_seq, _response, success);
+    }
+
+    void cancel() override {
+        _handler->_setError(ccontrol::MSG_RESULT_ERROR, "Result decoding cancelled");
+        _handler->_decodeDone(false);
+    }
+
+private:
+    std::shared_ptr<MergingHandler> _handler;
+    std::shared_ptr<WorkerResponse> _response;
+    std::vector<char> _buffer;
+    int _seq; ///< Position of the buffer in the stream
+};
+
 ////////////////////////////////////////////////////////////////////////
 // MergingRequester public
 ////////////////////////////////////////////////////////////////////////
 MergingHandler::MergingHandler(
     std::shared_ptr<MsgReceiver> msgReceiver,
     std::shared_ptr<rproc::InfileMerger> merger,
-    std::string const& tableName)
+    std::string const& tableName,
+    std::shared_ptr<util::WorkQueue> const& decodeQueue)
     : _msgReceiver{msgReceiver}, _infileMerger{merger}, _tableName{tableName},
-      _response{new WorkerResponse()} {
+      _response{new WorkerResponse()}, _decodeQueue{decodeQueue} {
     _initState();
 }
 
@@ -95,6 +152,14 @@ bool MergingHandler::flush(int bLen, bool& last) {
             // Worker sent corrupted data, or there is some other error.
         }
     }
+    {
+        std::lock_guard<std::mutex> lock(_decodeMutex);
+        if (_decodeFailed) {
+            // The error was set by the decode thread.
+            _state = MsgState::RESULT_ERR;
+            return false;
+        }
+    }
     switch(_state) {
     case MsgState::HEADER_SIZE_WAIT:
         _response->headerSize = static_cast<unsigned char>(_buffer[0]);
@@ -106,6 +171,9 @@ bool MergingHandler::flush(int bLen, bool& last) {
         }
         if (_wName == "~") {
             _wName = _response->protoHeader.wname();
+            if (_placement && !_wName.empty()) {
+                _placement->set(_db, _chunkId, _wName);
+            }
         }
         LOGS(_log, LOG_LVL_DEBUG, "HEADER_SIZE_WAIT: From:" << _wName
              << "Resizing buffer to " <<  _response->protoHeader.size());
@@ -114,12 +182,29 @@ bool MergingHandler::flush(int bLen, bool& last) {
         return true;
 
     case MsgState::RESULT_WAIT:
-        if (!_verifyResult()) { return false; }
-        if (!_setResult()) { return false; }
-        LOGS(_log, LOG_LVL_DEBUG, "From:" << _wName << " _buffer "
-             << util::prettyCharList(_buffer, 5));
         {
-            bool msgContinues = _response->result.continues();
+            bool msgContinues = false;
+            bool queued = false;
+            if (_decodeQueue && peekContinues(_response->protoHeader, _buffer, msgContinues)) {
+                // Hand the buffer over, so the next one can be read while
+                // this one is decoded.
+                if (!_queueDecode()) {
+                    _state = MsgState::RESULT_ERR;
+                    return false;
+                }
+                queued = true;
+            } else {
+                // Buffers queued before this one are merged first.
+                if ((_decodeQueue && !drain())
+                    || !_verifyResult(*_response, _buffer)
+                    || !_setResult(*_response, _buffer)) {
+                    _state = MsgState::RESULT_ERR;
+                    return false;
+                }
+                LOGS(_log, LOG_LVL_DEBUG, "From:" << _wName << " _buffer "
+                     << util::prettyCharList(_buffer, 5));
+                msgContinues = _response->result.continues();
+            }
             _buffer.resize(0); // Nothing further needed
             _state = MsgState::RESULT_RECV;
             if (msgContinues) {
@@ -133,7 +218,13 @@ bool MergingHandler::flush(int bLen, bool& last) {
             LOGS(_log, LOG_LVL_DEBUG, "Flushed msgContinues=" << msgContinues
                  << " last=" << last << " for tableName=" << _tableName);
 
-            auto success = _merge();
+            auto success = true;
+            if (!queued) {
+                success = _merge(_response);
+                if (!success) {
+                    _state = MsgState::RESULT_ERR;
+                }
+            }
             if (msgContinues) {
                 _response.reset(new WorkerResponse());
             }
@@ -182,7 +273,14 @@ bool MergingHandler::finished() const {
     return _flushed;
 }
 
+bool MergingHandler::drain() {
+    std::unique_lock<std::mutex> lock(_decodeMutex);
+    _decodeCv.wait(lock, [this](){ return _decodesInFlight == 0; });
+    return !_decodeFailed;
+}
+
 bool MergingHandler::reset() {
+    drain(); // Buffers of the previous attempt must not be decoded concurrently.
     // If we've pushed any bits to the merger successfully, we have to undo them
     // to reset to a fresh state. For now, we will just fail if we've already
     // begun merging. If we implement the ability to retract a partial result
@@ -194,6 +292,13 @@ bool MergingHandler::reset() {
     return true;
 }
 
+void MergingHandler::setChunkPlacement(std::shared_ptr<ChunkPlacement> const& placement,
+                                       std::string const& db, int chunkId) {
+    _placement = placement;
+    _db = db;
+    _chunkId = chunkId;
+}
+
 std::ostream& MergingHandler::print(std::ostream& os) const {
     return os << "MergingRequester(" << _tableName << ", flushed="
               << (_flushed ? "true)" : "false)") ;
@@ -206,9 +311,57 @@ void MergingHandler::_initState() {
     _buffer.resize(proto::ProtoHeaderWrap::PROTO_HEADER_SIZE);
     _state = MsgState::HEADER_SIZE_WAIT;
     _setError(0, "");
+    std::lock_guard<std::mutex> lock(_decodeMutex);
+    _decodeFailed = false;
+    _decodesQueued = 0;
+    _mergeTurn = 0;
+}
+
+/// Queue the filled _buffer for decoding, waiting while too many buffers of
+/// this stream are queued already.
+/// @return false if an earlier buffer failed
+bool MergingHandler::_queueDecode() {
+    int seq;
+    {
+        std::unique_lock<std::mutex> lock(_decodeMutex);
+        _decodeCv.wait(lock, [this](){
+                return _decodesInFlight < MAX_DECODES_IN_FLIGHT || _decodeFailed; });
+        if (_decodeFailed) {
+            return false;
+        }
+        ++_decodesInFlight;
+        seq = _decodesQueued++;
+    }
+    auto task = std::make_shared<DecodeTask>(shared_from_this(), _response, std::move(_buffer), seq);
+    _buffer = std::vector<char>();
+    _response = std::make_shared<WorkerResponse>();
+    _decodeQueue->add(task);
+    return true;
+}
+
+/// Merge the response decoded from the seq-th queued buffer of the stream once
+/// the buffers queued before it are merged, so that rows are merged in the
+/// order they were sent even with several decode threads.
+void MergingHandler::_mergeInTurn(int seq, std::shared_ptr<WorkerResponse>& response, bool decoded) {
+    {
+        std::unique_lock<std::mutex> lock(_decodeMutex);
+        _decodeCv.wait(lock, [this, seq](){ return _mergeTurn == seq || _decodeFailed; });
+        decoded = decoded && !_decodeFailed;
+    }
+    _decodeDone(decoded && _merge(response));
 }
 
-bool MergingHandler::_merge() {
+void MergingHandler::_decodeDone(bool success) {
+    std::lock_guard<std::mutex> lock(_decodeMutex);
+    --_decodesInFlight;
+    ++_mergeTurn;
+    if (!success) {
+        _decodeFailed = true;
+    }
+    _decodeCv.notify_all();
+}
+
+bool MergingHandler::_merge(std::shared_ptr<WorkerResponse>& response) {
     if (auto job = getJobQuery().lock()) {
         if (job->isCancelled()) {
             LOGS(_log, LOG_LVL_WARN, "MergingRequester::_merge(), but already cancelled");
@@ -217,31 +370,63 @@ bool MergingHandler::_merge() {
         if (_flushed) {
             throw Bug("MergingRequester::_merge : already flushed");
         }
-        bool success = _infileMerger->merge(_response);
-        if (!success) {
-            LOGS(_log, LOG_LVL_WARN, "_merge() failed");
-            rproc::InfileMergerError const& err = _infileMerger->getError();
-            _setError(ccontrol::MSG_RESULT_ERROR, err.getMsg());
-            _state = MsgState::RESULT_ERR;
+        int rowCount = proto::getRowCount(response->result);
+        bool success = _infileMerge(response);
+        if (success && job->getExecutive() != nullptr) {
+            job->getExecutive()->addResultRows(rowCount);
         }
-        _response.reset();
+        response.reset();
         return success;
     }
     LOGS(_log, LOG_LVL_ERROR, "MergingHandler::_merge() failed, jobQuery was NULL");
     return false;
 }
 
+bool MergingHandler::_infileMerge(std::shared_ptr<WorkerResponse> const& response) {
+    bool success = _infileMerger->merge(response);
+    if (!success) {
+        LOGS(_log, LOG_LVL_WARN, "_merge() failed");
+        rproc::InfileMergerError const& err = _infileMerger->getError();
+        _setError(ccontrol::MSG_RESULT_ERROR, err.getMsg());
+    }
+    return success;
+}
+
 void MergingHandler::_setError(int code, std::string const& msg) {
     LOGS(_log, LOG_LVL_DEBUG, "setError: code: " << code << ", message: " << msg);
     std::lock_guard<std::mutex> lock(_errorMutex);
     _error = Error(code, msg);
 }
 
-bool MergingHandler::_setResult() {
+bool MergingHandler::_setResult(WorkerResponse& response, std::vector<char> const& buffer) {
     auto start = std::chrono::system_clock::now();
-    if (!ProtoImporter<proto::Result>::setMsgFrom(_response->result, &_buffer[0], _buffer.size())) {
+    char const* msg = buffer.data();
+    size_t msgSize = buffer.size();
+    std::string uncompressed;
+    ProtoHeader const& ph = response.protoHeader;
+    switch (ph.compression()) {
+    case ProtoHeader::NONE:
+        break;
+    case ProtoHeader::ZLIB:
+        if (ph.uncompressedsize() < 0
+            || static_cast<size_t>(ph.uncompressedsize()) > proto::ProtoHeaderWrap::PROTOBUFFER_HARD_LIMIT
+            || !util::Compression::decompress(msg, msgSize, ph.uncompressedsize(), uncompressed)) {
+            _setError(ccontrol::MSG_RESULT_DECODE, "Error decompressing result msg");
+            return false;
+        }
+        msg = uncompressed.data();
+        msgSize = uncompressed.size();
+        break;
+    default:
+        _setError(ccontrol::MSG_RESULT_DECODE, "Result msg has unknown compression");
+        return false;
+    }
+    if (!ProtoImporter<proto::Result>::setMsgFrom(response.result, msg, msgSize)) {
         _setError(ccontrol::MSG_RESULT_DECODE, "Error decoding result msg");
-        _state = MsgState::RESULT_ERR;
+        return false;
+    }
+    if (!proto::ColumnBlockReader::isValid(response.result)) {
+        _setError(ccontrol::MSG_RESULT_DECODE, "Inconsistent column blocks in result msg");
         return false;
     }
     auto protoEnd = std::chrono::system_clock::now();
@@ -249,13 +434,27 @@ bool MergingHandler::_setResult() {
     LOGS(_log, LOG_LVL_DEBUG, "protoDur=" << protoDur.count());
     return true;
 }
-bool MergingHandler::_verifyResult() {
-    if (_response->protoHeader.md5() != util::StringHash::getMd5(_buffer.data(), _buffer.size())) {
-        _setError(ccontrol::MSG_RESULT_MD5, "Result message MD5 mismatch");
-        _state = MsgState::RESULT_ERR;
+bool MergingHandler::_verifyResult(WorkerResponse const& response,
+                                   std::vector<char> const& buffer) {
+    proto::ProtoHeader const& ph = response.protoHeader;
+    // Workers that predate ProtoHeader.checksumtype only send MD5.
+    switch (ph.has_checksumtype() ? ph.checksumtype() : proto::ProtoHeader::MD5) {
+    case proto::ProtoHeader::MD5:
+        if (ph.md5() != util::StringHash::getMd5(buffer.data(), buffer.size())) {
+            _setError(ccontrol::MSG_RESULT_MD5, "Result message MD5 mismatch");
+            return false;
+        }
+        return true;
+    case proto::ProtoHeader::CRC32C:
+        if (ph.checksum() != util::StringHash::getCrc32c(buffer.data(), buffer.size())) {
+            _setError(ccontrol::MSG_RESULT_MD5, "Result message CRC32C mismatch");
+            return false;
+        }
+        return true;
+    default:
+        _setError(ccontrol::MSG_RESULT_MD5, "Result message has unknown checksum type");
         return false;
     }
-    return true;
 }
 
 }}} // lsst::qserv::ccontrol
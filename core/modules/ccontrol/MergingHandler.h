@@ -24,16 +24,22 @@
 #define LSST_QSERV_CCONTROL_MERGINGHANDLER_H
 
 // System headers
+#include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 // Qserv headers
 #include "qdisp/ResponseHandler.h"
+#include "util/WorkQueue.h"
 
 // Forward decl
 namespace lsst {
 namespace qserv {
   class MsgReceiver;
+namespace ccontrol {
+  class ChunkPlacement;
+}
 namespace proto {
   struct WorkerResponse;
 }
@@ -51,7 +57,16 @@ namespace ccontrol {
 /// fragment instead of performing buffer size and offset
 /// management. Fully-constructed protocol messages are then passed towards an
 /// InfileMerger.
-class MergingHandler : public qdisp::ResponseHandler {
+///
+/// When given a decode queue, a filled result buffer is handed to that queue
+/// for checksum verification, parsing and merging, and the next buffer is
+/// requested right away, so that receiving, decoding and loading the
+/// messages of a stream overlap. The buffers of a stream are still merged in
+/// the order received. At most MAX_DECODES_IN_FLIGHT buffers of a stream wait
+/// in the queue; flush() blocks beyond that, which holds back further reads
+/// from the worker. Buffers of a cancelled job are dropped undecoded.
+class MergingHandler : public qdisp::ResponseHandler,
+                       public std::enable_shared_from_this<MergingHandler> {
 public:
     /// Possible MergingHandler message state
     enum class MsgState { INVALID, HEADER_SIZE_WAIT,
@@ -66,9 +81,15 @@ public:
     /// @param msgReceiver Message code receiver
     /// @param merger downstream merge acceptor
     /// @param tableName target table for incoming data
+    /// @param decodeQueue threads decoding and merging result messages. If
+    ///        null, messages are decoded and merged within flush().
     MergingHandler(std::shared_ptr<MsgReceiver> msgReceiver,
                      std::shared_ptr<rproc::InfileMerger> merger,
-                     std::string const& tableName);
+                     std::string const& tableName,
+                     std::shared_ptr<util::WorkQueue> const& decodeQueue=nullptr);
+
+    /// Result buffers of a stream that may wait for decoding at once
+    static int const MAX_DECODES_IN_FLIGHT = 2;
 
     /// @return a char vector to receive the next message. The vector
     /// should be sized to the request size. The buffer will be filled
@@ -87,6 +108,10 @@ public:
     /// @return true if the receiver has completed its duties.
     virtual bool finished() const;
 
+    /// Block until all buffers passed to flush() have been decoded and merged.
+    /// @return true if they were all merged successfully
+    virtual bool drain();
+
     virtual bool reset(); ///< Reset the state that a request can be retried.
 
     /// Print a string representation of the receiver to an ostream
@@ -98,12 +123,30 @@ public:
         return _error;
     }
 
+    /// Wait for decoding in progress, since the job is being cancelled.
+    virtual void processCancel() { drain(); }
+
+    /// Record the worker sending the results of chunkId of db in placement.
+    void setChunkPlacement(std::shared_ptr<ChunkPlacement> const& placement,
+                           std::string const& db, int chunkId);
+
+protected:
+    /// Hand a decoded response to the InfileMerger, overridden in tests.
+    /// @return true on success, otherwise false with the error set
+    virtual bool _infileMerge(std::shared_ptr<proto::WorkerResponse> const& response);
+
+    void _setError(int code, std::string const& msg);
+
 private:
+    class DecodeTask;
+
     void _initState();
-    bool _merge();
-    void _setError(int code, std::string const& msg);
-    bool _setResult();
-    bool _verifyResult();
+    bool _merge(std::shared_ptr<proto::WorkerResponse>& response);
+    bool _setResult(proto::WorkerResponse& response, std::vector<char> const& buffer);
+    bool _verifyResult(proto::WorkerResponse const& response, std::vector<char> const& buffer);
+    bool _queueDecode();
+    void _mergeInTurn(int seq, std::shared_ptr<proto::WorkerResponse>& response, bool decoded);
+    void _decodeDone(bool success);
 
     std::shared_ptr<MsgReceiver> _msgReceiver; ///< Message code receiver
     std::shared_ptr<rproc::InfileMerger> _infileMerger; ///< Merging delegate
@@ -115,6 +158,17 @@ private:
     std::shared_ptr<proto::WorkerResponse> _response; ///< protobufs msg buf
     bool _flushed {false}; ///< flushed to InfileMerger?
     std::string _wName {"~"}; /// worker name
+    std::shared_ptr<ChunkPlacement> _placement; ///< Learns where chunks are, may be null
+    std::string _db; ///< Database of the chunk, for _placement
+    int _chunkId {0}; ///< Chunk of the results, for _placement
+
+    std::shared_ptr<util::WorkQueue> _decodeQueue; ///< Decodes buffers, if not null
+    std::mutex _decodeMutex; ///< Protects the members below
+    std::condition_variable _decodeCv; ///< Signals decode completion
+    int _decodesInFlight {0}; ///< Buffers queued or being decoded
+    bool _decodeFailed {false}; ///< A queued buffer failed to decode or merge
+    int _decodesQueued {0}; ///< Buffers queued since _initState()
+    int _mergeTurn {0}; ///< Position of the next queued buffer to merge
 };
 
 }}} // namespace lsst::qserv::qdisp
@@ -0,0 +1,223 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "ccontrol/MultiChunkHandler.h"
+
+// System headers
+#include <algorithm>
+
+// LSST headers
+#include "lsst/log/Log.h"
+
+// Qserv headers
+#include "ccontrol/msgCode.h"
+#include "global/MsgReceiver.h"
+#include "proto/ProtoHeaderWrap.h"
+#include "proto/WorkerResponse.h"
+
+namespace {
+LOG_LOGGER _log = LOG_GET("lsst.qserv.ccontrol.MultiChunkHandler");
+}
+
+namespace lsst {
+namespace qserv {
+namespace ccontrol {
+
+MultiChunkHandler::MultiChunkHandler(std::vector<Chunk> const& chunks,
+                                     UnownedFunc const& unownedFunc)
+    : _unownedFunc(unownedFunc),
+      _header(proto::ProtoHeaderWrap::PROTO_HEADER_SIZE),
+      _chunksLeft(chunks.size()) {
+    for (auto const& c : chunks) {
+        _chunks.emplace_back(c);
+    }
+}
+
+void MultiChunkHandler::setJobQuery(std::shared_ptr<qdisp::JobQuery> const& jobQuery) {
+    ResponseHandler::setJobQuery(jobQuery);
+    for (auto& chunk : _chunks) {
+        chunk.handler->setJobQuery(jobQuery);
+    }
+}
+
+std::vector<char>& MultiChunkHandler::nextBuffer() {
+    return _current ? _current->handler->nextBuffer() : _header;
+}
+
+bool MultiChunkHandler::flush(int bLen, bool& last) {
+    bool streamEnds = last;
+    last = false;
+    bool ok;
+    if (!_current) {
+        ok = _flushHeader(bLen, last);
+    } else {
+        // The Result of _current
+        ChunkState& chunk = *_current;
+        _current = nullptr;
+        bool chunkLast = false;
+        if (!chunk.handler->flush(bLen, chunkLast)) {
+            return _chunkFailed(chunk);
+        }
+        ok = !chunkLast || _chunkEnded(chunk, last);
+    }
+    if (ok && streamEnds && !last) {
+        _setError(ccontrol::MSG_RESULT_ERROR, "Multi-chunk result ended with "
+                  + std::to_string(_chunksLeft) + " chunks missing");
+        return false;
+    }
+    return ok;
+}
+
+/// Read the ProtoHeader in _header, and pass it on to its chunk's handler.
+bool MultiChunkHandler::_flushHeader(int bLen, bool& last) {
+    auto response = std::make_shared<proto::WorkerResponse>();
+    if (bLen != static_cast<int>(_header.size())
+        || !proto::ProtoHeaderWrap::unwrap(response, _header)) {
+        _setError(ccontrol::MSG_RESULT_DECODE, "Error decoding multi-chunk proto header");
+        return false;
+    }
+    proto::ProtoHeader const& ph = response->protoHeader;
+    auto iter = std::find_if(_chunks.begin(), _chunks.end(),
+        [&ph](ChunkState const& c) { return c.chunkId == ph.chunkid(); });
+    if (!ph.has_chunkid() || iter == _chunks.end() || iter->ended) {
+        _setError(ccontrol::MSG_RESULT_ERROR, "Unexpected chunk "
+                  + std::to_string(ph.chunkid()) + " in multi-chunk result");
+        return false;
+    }
+    ChunkState& chunk = *iter;
+    if (ph.unowned()) {
+        LOGS(_log, LOG_LVL_DEBUG, "Chunk " << chunk.chunkId << " not held by " << ph.wname());
+        if (chunk.started) {
+            _setError(ccontrol::MSG_RESULT_ERROR, "Chunk " + std::to_string(chunk.chunkId)
+                      + " reported unowned after sending results");
+            return false;
+        }
+        if (_unownedFunc) {
+            _unownedFunc(chunk.chunkId);
+        }
+        return _chunkEnded(chunk, last);
+    }
+    // The chunk handler expects a header now, and sizes its buffer for the
+    // Result from it.
+    std::vector<char>& buffer = chunk.handler->nextBuffer();
+    if (buffer.size() != _header.size()) {
+        _setError(ccontrol::MSG_RESULT_ERROR, "Chunk " + std::to_string(chunk.chunkId)
+                  + " not expecting a header");
+        return false;
+    }
+    std::copy(_header.begin(), _header.end(), buffer.begin());
+    chunk.started = true;
+    bool chunkLast = false;
+    if (!chunk.handler->flush(bLen, chunkLast)) {
+        return _chunkFailed(chunk);
+    }
+    _current = &chunk;
+    return true;
+}
+
+bool MultiChunkHandler::_chunkEnded(ChunkState& chunk, bool& last) {
+    chunk.ended = true;
+    if (--_chunksLeft == 0) {
+        last = true;
+        _header.resize(0); // Nothing further expected
+    }
+    return true;
+}
+
+/// Take on the error of chunk, naming the chunk.
+bool MultiChunkHandler::_chunkFailed(ChunkState& chunk) {
+    Error err = chunk.handler->getError();
+    std::string msg = "Chunk " + std::to_string(chunk.chunkId) + ": " + err.getMsg();
+    if (chunk.msgReceiver) {
+        (*chunk.msgReceiver)(err.getCode(), msg);
+    }
+    _setError(err.getCode(), msg);
+    return false;
+}
+
+void MultiChunkHandler::errorFlush(std::string const& msg, int code) {
+    _setError(code, msg);
+    LOGS(_log, LOG_LVL_ERROR, "Error receiving multi-chunk result.");
+}
+
+bool MultiChunkHandler::drain() {
+    bool ok = true;
+    for (auto& chunk : _chunks) {
+        if (!chunk.handler->drain()) {
+            if (ok && getError().getCode() == 0) {
+                _chunkFailed(chunk);
+            }
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool MultiChunkHandler::finished() const {
+    for (auto const& chunk : _chunks) {
+        if (!chunk.handler->finished()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MultiChunkHandler::reset() {
+    drain();
+    for (auto& chunk : _chunks) {
+        // Chunks sent elsewhere, or partly merged, cannot be retried here.
+        if (chunk.started || chunk.ended || !chunk.handler->reset()) {
+            return false;
+        }
+    }
+    _current = nullptr;
+    _header.resize(proto::ProtoHeaderWrap::PROTO_HEADER_SIZE);
+    _chunksLeft = _chunks.size();
+    _setError(0, "");
+    return true;
+}
+
+std::ostream& MultiChunkHandler::print(std::ostream& os) const {
+    return os << "MultiChunkHandler(chunks=" << _chunks.size()
+              << ", left=" << _chunksLeft << ")";
+}
+
+MultiChunkHandler::Error MultiChunkHandler::getError() const {
+    std::lock_guard<std::mutex> lock(_errorMutex);
+    return _error;
+}
+
+void MultiChunkHandler::processCancel() {
+    for (auto& chunk : _chunks) {
+        chunk.handler->processCancel();
+    }
+}
+
+void MultiChunkHandler::_setError(int code, std::string const& msg) {
+    LOGS(_log, LOG_LVL_DEBUG, "setError: code: " << code << ", message: " << msg);
+    std::lock_guard<std::mutex> lock(_errorMutex);
+    _error = Error(code, msg);
+}
+
+}}} // namespace lsst::qserv::ccontrol
@@ -0,0 +1,111 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_CCONTROL_MULTICHUNKHANDLER_H
+#define LSST_QSERV_CCONTROL_MULTICHUNKHANDLER_H
+
+// System headers
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Qserv headers
+#include "qdisp/ResponseHandler.h"
+
+// Forward decl
+namespace lsst {
+namespace qserv {
+  class MsgReceiver;
+}}
+
+namespace lsst {
+namespace qserv {
+namespace ccontrol {
+
+/// MultiChunkHandler is a ResponseHandler for the result stream of a
+/// multi-chunk TaskMsg (see TaskMsg.chunkblock in proto/worker.proto).
+///
+/// It reads each ProtoHeader itself, and hands it and the Result that
+/// follows to the handler of the chunk named by ProtoHeader.chunkid, so that
+/// every chunk is merged by its own handler, e.g. a MergingHandler, as if it
+/// had been sent alone. Errors are reported with the chunk they came from.
+/// The stream ends once every chunk has sent its last message, or was
+/// reported as not held by the worker.
+class MultiChunkHandler : public qdisp::ResponseHandler {
+public:
+    typedef std::shared_ptr<MultiChunkHandler> Ptr;
+
+    /// Called with a chunk the worker does not hold, so that it can be sent
+    /// elsewhere. Nothing was merged for the chunk.
+    typedef std::function<void(int chunkId)> UnownedFunc;
+
+    struct Chunk {
+        int chunkId;
+        std::shared_ptr<MsgReceiver> msgReceiver; ///< Receives the chunk's errors, may be null
+        qdisp::ResponseHandler::Ptr handler; ///< Handles the chunk's messages
+    };
+
+    /// @param chunks the chunks of the TaskMsg
+    MultiChunkHandler(std::vector<Chunk> const& chunks, UnownedFunc const& unownedFunc);
+
+    void setJobQuery(std::shared_ptr<qdisp::JobQuery> const& jobQuery) override;
+
+    /// @return the buffer of the next ProtoHeader, or that of the chunk
+    /// handler whose Result comes next.
+    std::vector<char>& nextBuffer() override;
+
+    bool flush(int bLen, bool& last) override;
+    void errorFlush(std::string const& msg, int code) override;
+    bool drain() override;
+    bool finished() const override;
+    bool reset() override;
+    std::ostream& print(std::ostream& os) const override;
+    Error getError() const override;
+    void processCancel() override;
+
+private:
+    struct ChunkState : Chunk {
+        explicit ChunkState(Chunk const& c) : Chunk(c) {}
+        bool started{false}; ///< A message of the chunk was handed over
+        bool ended{false}; ///< The chunk sent its last message
+    };
+
+    bool _flushHeader(int bLen, bool& last);
+    bool _chunkEnded(ChunkState& chunk, bool& last);
+    bool _chunkFailed(ChunkState& chunk);
+    void _setError(int code, std::string const& msg);
+
+    std::vector<ChunkState> _chunks;
+    UnownedFunc _unownedFunc;
+    std::vector<char> _header; ///< Receives each ProtoHeader
+    ChunkState* _current{nullptr}; ///< Chunk whose Result comes next, if any
+    int _chunksLeft; ///< Chunks that have not sent their last message
+
+    Error _error; ///< Error description
+    mutable std::mutex _errorMutex; ///< Protects _error
+};
+
+}}} // namespace lsst::qserv::ccontrol
+
+#endif // LSST_QSERV_CCONTROL_MULTICHUNKHANDLER_H
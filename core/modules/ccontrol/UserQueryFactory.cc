@@ -35,6 +35,7 @@
 #include "lsst/log/Log.h"
 
 // Qserv headers
+#include "ccontrol/ChunkPlacement.h"
 #include "ccontrol/ConfigError.h"
 #include "ccontrol/ConfigMap.h"
 #include "ccontrol/UserQueryDrop.h"
@@ -52,6 +53,7 @@
 #include "qproc/SecondaryIndex.h"
 #include "rproc/InfileMerger.h"
 #include "sql/SqlConnection.h"
+#include "util/WorkQueue.h"
 
 namespace {
 LOG_LOGGER _log = LOG_GET("lsst.qserv.ccontrol.UserQueryFactory");
@@ -76,6 +78,9 @@ public:
     std::shared_ptr<qmeta::QMeta> queryMetadata;
     std::unique_ptr<sql::SqlConnection> resultDbConn;
     qmeta::CzarId qMetaCzarId = {0};   ///< Czar ID in QMeta database
+    std::shared_ptr<util::WorkQueue> decodeQueue; ///< Decodes result messages
+    int chunksPerMsg = 1; ///< Max chunks sent to a worker in one TaskMsg
+    std::shared_ptr<ChunkPlacement> chunkPlacement; ///< Workers seen answering for chunks
 };
 
 ////////////////////////////////////////////////////////////////////////
@@ -122,7 +127,9 @@ UserQueryFactory::newUserQuery(std::string const& query,
         }
         auto uq = std::make_shared<UserQuerySelect>(qs, messageStore, executive, infileMergerConfig,
                                                     _impl->secondaryIndex, _impl->queryMetadata,
-                                                    _impl->qMetaCzarId, errorExtra);
+                                                    _impl->qMetaCzarId, errorExtra,
+                                                    _impl->decodeQueue, _impl->chunksPerMsg,
+                                                    _impl->chunkPlacement);
         if (sessionValid) {
             uq->setupChunking();
         }
@@ -166,6 +173,13 @@ UserQueryFactory::Impl::Impl(StringMap const& m) {
         "WARNING! No xrootd spec. Using localhost:1094",
         "localhost:1094");
     executiveConfig = std::make_shared<qdisp::Executive::Config>(serviceUrl);
+    chunksPerMsg = cm.getTyped<int>(
+        "frontend.chunks_per_msg",
+        "frontend.chunks_per_msg not found. Using 1.",
+        1);
+    if (chunksPerMsg > 1) {
+        chunkPlacement = std::make_shared<ChunkPlacement>();
+    }
     // This should be overriden by the installer properly.
     infileMergerConfigTemplate.socket = cm.get(
         "resultdb.unix_socket",
@@ -179,6 +193,29 @@ UserQueryFactory::Impl::Impl(StringMap const& m) {
         "resultdb.db",
         "Error, resultdb.db not found. Using qservResult.",
         "qservResult");
+    infileMergerConfigTemplate.loadConnections = cm.getTyped<int>(
+        "resultdb.load_connections",
+        "resultdb.load_connections not found. Using 1.",
+        1);
+    int decodeThreads = cm.getTyped<int>(
+        "resultdb.decode_threads",
+        "resultdb.decode_threads not found. Using 4.",
+        4);
+    if (decodeThreads > 0) {
+        decodeQueue = std::make_shared<util::WorkQueue>(decodeThreads);
+    }
+    infileMergerConfigTemplate.aggregateMaxGroups = cm.getTyped<int>(
+        "resultdb.aggregate_max_groups",
+        "resultdb.aggregate_max_groups not found. Using 1000000.",
+        1000000);
+    infileMergerConfigTemplate.resultProtocol = cm.getTyped<int>(
+        "resultdb.result_protocol",
+        "resultdb.result_protocol not found. Using 2.",
+        2);
+    infileMergerConfigTemplate.compressionLevel = cm.getTyped<int>(
+        "resultdb.compression_level",
+        "resultdb.compression_level not found. Using 0.",
+        0);
     mysql::MySqlConfig mc;
     mc.username = infileMergerConfigTemplate.user;
     mc.dbName = infileMergerConfigTemplate.targetDb; // any valid db is ok.
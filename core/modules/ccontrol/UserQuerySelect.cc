@@ -71,7 +71,9 @@
 #include "lsst/log/Log.h"
 
 // Qserv headers
+#include "ccontrol/ChunkPlacement.h"
 #include "ccontrol/MergingHandler.h"
+#include "ccontrol/MultiChunkHandler.h"
 #include "ccontrol/TmpTableName.h"
 #include "ccontrol/UserQueryError.h"
 #include "global/constants.h"
@@ -142,10 +144,15 @@ UserQuerySelect::UserQuerySelect(std::shared_ptr<qproc::QuerySession> const& qs,
                                  std::shared_ptr<qproc::SecondaryIndex> const& secondaryIndex,
                                  std::shared_ptr<qmeta::QMeta> const& queryMetadata,
                                  qmeta::CzarId czarId,
-                                 std::string const& errorExtra)
+                                 std::string const& errorExtra,
+                                 std::shared_ptr<util::WorkQueue> const& decodeQueue,
+                                 int chunksPerMsg,
+                                 std::shared_ptr<ChunkPlacement> const& chunkPlacement)
     :  _qSession(qs), _messageStore(messageStore), _executive(executive),
        _infileMergerConfig(infileMergerConfig), _secondaryIndex(secondaryIndex),
-       _queryMetadata(queryMetadata), _qMetaCzarId(czarId), _qMetaQueryId(0),
+       _queryMetadata(queryMetadata), _decodeQueue(decodeQueue),
+       _chunksPerMsg(chunksPerMsg), _chunkPlacement(chunkPlacement),
+       _qMetaCzarId(czarId), _qMetaQueryId(0),
        _killed(false), _submitted(false), _sequence(0), _errorExtra(errorExtra) {
 }
 
@@ -199,37 +206,49 @@ void UserQuerySelect::submit() {
 
     _setupMerger();
 
+    // Without ORDER BY, any rows will do for a LIMIT: stop once there are enough.
+    int mergeRowLimit = _qSession->getMergeRowLimit();
+    auto mergeStmt = _qSession->getMergeStmt();
+    if (mergeRowLimit > 0 && mergeStmt && !mergeStmt->hasOrderBy()) {
+        _executive->setRowLimit(mergeRowLimit);
+    }
+
     // Using the QuerySession, generate query specs (text, db, chunkId) and then
     // create query messages and send them to the async query manager.
-    qproc::TaskMsgFactory taskMsgFactory(_qMetaQueryId);
+    qproc::TaskMsgFactory taskMsgFactory(_qMetaQueryId, _infileMergerConfig->resultProtocol,
+                                         _infileMergerConfig->compressionLevel);
     TmpTableName ttn(_qMetaQueryId, _qSession->getOriginal());
-    proto::ProtoImporter<proto::TaskMsg> pi;
-    int msgCount = 0;
     LOGS(_log, LOG_LVL_DEBUG, "UserQuerySelect beginning submission");
     assert(_infileMerger);
     std::vector<int> chunks;
+    // Chunks last seen on the same worker are sent together, up to
+    // _chunksPerMsg at a time. Other chunks are sent alone.
+    std::map<std::string, std::vector<qproc::ChunkQuerySpec>> workerChunks;
     // Writing query for each chunk
     for(auto i = _qSession->cQueryBegin(), e = _qSession->cQueryEnd(); i != e; ++i) {
         qproc::ChunkQuerySpec& cs = *i;
         chunks.push_back(cs.chunkId);
-        std::string chunkResultName = ttn.make(cs.chunkId);
-        ++msgCount;
-        std::ostringstream ss;
-        taskMsgFactory.serializeMsg(cs, chunkResultName, _executive->getId(), _sequence, ss);
-        std::string msg = ss.str();
-
-        pi(msg.data(), msg.size());
-        if (pi.getNumAccepted() != msgCount) {
-            throw UserQueryBug("Error serializing TaskMsg.");
+        std::string worker;
+        if (_chunksPerMsg > 1 && _chunkPlacement) {
+            worker = _chunkPlacement->get(cs.db, cs.chunkId);
+        }
+        if (worker.empty()) {
+            _addChunkJob(taskMsgFactory, ttn, cs);
+            continue;
+        }
+        auto& group = workerChunks[worker];
+        group.push_back(cs); // The iterator reuses cs.
+        if (static_cast<int>(group.size()) >= _chunksPerMsg) {
+            _addMultiChunkJob(taskMsgFactory, ttn, group);
+            group.clear();
+        }
+    }
+    for (auto const& entry : workerChunks) {
+        if (entry.second.size() == 1) {
+            _addChunkJob(taskMsgFactory, ttn, entry.second.front());
+        } else if (entry.second.size() > 1) {
+            _addMultiChunkJob(taskMsgFactory, ttn, entry.second);
         }
-
-        std::shared_ptr<ChunkMsgReceiver> cmr = ChunkMsgReceiver::newInstance(cs.chunkId, _messageStore);
-        ResourceUnit ru;
-        ru.setAsDbChunk(cs.db, cs.chunkId);
-        qdisp::JobDescription jobDesc(_sequence, ru, ss.str(),
-            std::make_shared<MergingHandler>(cmr, _infileMerger, chunkResultName));
-        _executive->add(jobDesc);
-        ++_sequence;
     }
 
     _submitted = true;
@@ -242,10 +261,113 @@ void UserQuerySelect::submit() {
     }
 }
 
+/// @return a MergingHandler for the results of chunkId
+std::shared_ptr<MergingHandler>
+UserQuerySelect::_newMergingHandler(std::string const& db, int chunkId,
+                                    std::string const& chunkResultName) {
+    std::shared_ptr<ChunkMsgReceiver> cmr = ChunkMsgReceiver::newInstance(chunkId, _messageStore);
+    auto handler = std::make_shared<MergingHandler>(cmr, _infileMerger, chunkResultName,
+                                                    _decodeQueue);
+    if (_chunkPlacement) {
+        handler->setChunkPlacement(_chunkPlacement, db, chunkId);
+    }
+    return handler;
+}
+
+/// Send the query of one chunk in its own TaskMsg.
+void UserQuerySelect::_addChunkJob(qproc::TaskMsgFactory& taskMsgFactory, TmpTableName& ttn,
+                                   qproc::ChunkQuerySpec const& cs) {
+    std::string chunkResultName = ttn.make(cs.chunkId);
+    std::ostringstream ss;
+    taskMsgFactory.serializeMsg(cs, chunkResultName, _executive->getId(), _sequence, ss);
+    std::string msg = ss.str();
+
+    proto::ProtoImporter<proto::TaskMsg> pi;
+    pi(msg.data(), msg.size());
+    if (pi.getNumAccepted() != 1) {
+        throw UserQueryBug("Error serializing TaskMsg.");
+    }
+
+    ResourceUnit ru;
+    ru.setAsDbChunk(cs.db, cs.chunkId);
+    qdisp::JobDescription jobDesc(_sequence, ru, msg,
+        _newMergingHandler(cs.db, cs.chunkId, chunkResultName));
+    _executive->add(jobDesc);
+    ++_sequence;
+}
+
+/// Send the queries of several chunks held by one worker in one TaskMsg,
+/// addressed to the first chunk. Each chunk is merged by its own
+/// MergingHandler, fed by a MultiChunkHandler.
+void UserQuerySelect::_addMultiChunkJob(qproc::TaskMsgFactory& taskMsgFactory,
+                                        TmpTableName& ttn,
+                                        std::vector<qproc::ChunkQuerySpec> const& specs) {
+    std::vector<qproc::ChunkQuerySpec const*> specPtrs;
+    std::vector<std::string> chunkResultNames;
+    std::vector<MultiChunkHandler::Chunk> chunks;
+    for (auto const& cs : specs) {
+        specPtrs.push_back(&cs);
+        chunkResultNames.push_back(ttn.make(cs.chunkId));
+        std::shared_ptr<ChunkMsgReceiver> cmr = ChunkMsgReceiver::newInstance(cs.chunkId, _messageStore);
+        chunks.push_back({cs.chunkId, cmr,
+                          _newMergingHandler(cs.db, cs.chunkId, chunkResultNames.back())});
+        _multiChunkSpecs.insert(std::make_pair(cs.chunkId, cs));
+    }
+    std::ostringstream ss;
+    taskMsgFactory.serializeMsg(specPtrs, chunkResultNames, _executive->getId(), _sequence, ss);
+    std::string msg = ss.str();
+
+    proto::ProtoImporter<proto::TaskMsg> pi;
+    pi(msg.data(), msg.size());
+    if (pi.getNumAccepted() != 1) {
+        throw UserQueryBug("Error serializing multi-chunk TaskMsg.");
+    }
+
+    std::string db = specs.front().db;
+    auto unownedFunc = [this, db](int chunkId) {
+        // The worker no longer holds the chunk, if it ever did.
+        _chunkPlacement->remove(db, chunkId);
+        std::lock_guard<std::mutex> lock(_unownedMutex);
+        _unownedChunks.push_back(chunkId);
+    };
+    ResourceUnit ru;
+    ru.setAsDbChunk(db, specs.front().chunkId);
+    LOGS(_log, LOG_LVL_DEBUG, "Sending " << specs.size() << " chunks in job " << _sequence);
+    qdisp::JobDescription jobDesc(_sequence, ru, msg,
+        std::make_shared<MultiChunkHandler>(chunks, unownedFunc));
+    _executive->add(jobDesc);
+    ++_sequence;
+}
+
+/// Send the chunks of multi-chunk TaskMsgs that their worker did not hold
+/// alone, and wait for them.
+/// @return true if there were none, or they all succeeded
+bool UserQuerySelect::_joinUnowned() {
+    std::vector<int> unownedChunks;
+    {
+        std::lock_guard<std::mutex> lock(_unownedMutex);
+        unownedChunks.swap(_unownedChunks);
+    }
+    if (unownedChunks.empty() || _executive->getLimitSquashed()) {
+        return true;
+    }
+    LOGS(_log, LOG_LVL_DEBUG, "Sending " << unownedChunks.size() << " unowned chunks again");
+    qproc::TaskMsgFactory taskMsgFactory(_qMetaQueryId, _infileMergerConfig->resultProtocol,
+                                         _infileMergerConfig->compressionLevel);
+    TmpTableName ttn(_qMetaQueryId, _qSession->getOriginal());
+    for (int chunkId : unownedChunks) {
+        _addChunkJob(taskMsgFactory, ttn, _multiChunkSpecs.at(chunkId));
+    }
+    return _executive->join();
+}
+
 /// Block until a submit()'ed query completes.
 /// @return the QueryState indicating success or failure
 QueryState UserQuerySelect::join() {
     bool successful = _executive->join(); // Wait for all data
+    if (successful) {
+        successful = _joinUnowned();
+    }
     _infileMerger->finalize(); // Wait for all data to get merged
     _discardMerger();
     if (not _submitted) {
@@ -301,6 +423,7 @@ void UserQuerySelect::_setupMerger() {
     LOGS(_log, LOG_LVL_TRACE, "Setup merger");
     _infileMergerConfig->targetTable = _resultTable;
     _infileMergerConfig->mergeStmt = _qSession->getMergeStmt();
+    _infileMergerConfig->limitRows = _qSession->getMergeRowLimit() != NOTSET;
     _infileMerger = std::make_shared<rproc::InfileMerger>(*_infileMergerConfig);
 }
 
@@ -33,8 +33,10 @@
 
 // System headers
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 // Third-party headers
 
@@ -43,12 +45,18 @@
 #include "css/StripingParams.h"
 #include "qmeta/QInfo.h"
 #include "qmeta/types.h"
+#include "qproc/ChunkQuerySpec.h"
 #include "qproc/ChunkSpec.h"
 #include "query/Constraint.h"
 
 // Forward decl
 namespace lsst {
 namespace qserv {
+namespace ccontrol {
+class ChunkPlacement;
+class MergingHandler;
+class TmpTableName;
+}
 namespace qdisp {
 class Executive;
 class MessageStore;
@@ -59,10 +67,14 @@ class QMeta;
 namespace qproc {
 class QuerySession;
 class SecondaryIndex;
+class TaskMsgFactory;
 }
 namespace rproc {
 class InfileMerger;
 class InfileMergerConfig;
+}
+namespace util {
+class WorkQueue;
 }}}
 
 namespace lsst {
@@ -80,7 +92,10 @@ public:
                     std::shared_ptr<qproc::SecondaryIndex> const& secondaryIndex,
                     std::shared_ptr<qmeta::QMeta> const& queryMetadata,
                     qmeta::CzarId czarId,
-                    std::string const& errorExtra);
+                    std::string const& errorExtra,
+                    std::shared_ptr<util::WorkQueue> const& decodeQueue=nullptr,
+                    int chunksPerMsg=1,
+                    std::shared_ptr<ChunkPlacement> const& chunkPlacement=nullptr);
 
     UserQuerySelect(UserQuerySelect const&) = delete;
     UserQuerySelect& operator=(UserQuerySelect const&) = delete;
@@ -125,6 +140,13 @@ private:
     void _qMetaRegister();
     void _qMetaUpdateStatus(qmeta::QInfo::QStatus qStatus);
     void _qMetaAddChunks(std::vector<int> const& chunks);
+    void _addChunkJob(qproc::TaskMsgFactory& taskMsgFactory, TmpTableName& ttn,
+                      qproc::ChunkQuerySpec const& cs);
+    void _addMultiChunkJob(qproc::TaskMsgFactory& taskMsgFactory, TmpTableName& ttn,
+                           std::vector<qproc::ChunkQuerySpec> const& specs);
+    std::shared_ptr<MergingHandler> _newMergingHandler(std::string const& db, int chunkId,
+                                                       std::string const& chunkResultName);
+    bool _joinUnowned();
 
     // Delegate classes
     std::shared_ptr<qproc::QuerySession> _qSession;
@@ -134,6 +156,9 @@ private:
     std::shared_ptr<rproc::InfileMerger> _infileMerger;
     std::shared_ptr<qproc::SecondaryIndex> _secondaryIndex;
     std::shared_ptr<qmeta::QMeta> _queryMetadata;
+    std::shared_ptr<util::WorkQueue> _decodeQueue; ///< Decodes result messages
+    int const _chunksPerMsg; ///< Max chunks per TaskMsg, 1 to send chunks alone
+    std::shared_ptr<ChunkPlacement> _chunkPlacement; ///< Where chunks were seen, may be null
 
     qmeta::CzarId _qMetaCzarId;     ///< Czar ID in QMeta database
     qmeta::QueryId _qMetaQueryId;   ///< Query ID in QMeta database
@@ -143,6 +168,11 @@ private:
     int _sequence;                  ///< Sequence number for subtask ids
     std::string _errorExtra;        ///< Additional error information
     std::string _resultTable;       ///< Result table name
+
+    /// Chunks sent in multi-chunk TaskMsgs, in case they have to be sent again
+    std::map<int, qproc::ChunkQuerySpec> _multiChunkSpecs;
+    std::mutex _unownedMutex;       ///< Protects _unownedChunks
+    std::vector<int> _unownedChunks; ///< Multi-chunk chunks their worker did not hold
 };
 
 }}} // namespace lsst::qserv:ccontrol
@@ -0,0 +1,252 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsstcorp.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ /**
+  * @brief Test MergingHandler decoding result messages on a WorkQueue, with
+  * a fake merger so that no mysqld is needed.
+  */
+
+// System headers
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Qserv headers
+#include "ccontrol/MergingHandler.h"
+#include "global/ResourceUnit.h"
+#include "proto/ProtoHeaderWrap.h"
+#include "proto/WorkerResponse.h"
+#include "proto/worker.pb.h"
+#include "qdisp/JobDescription.h"
+#include "qdisp/JobQuery.h"
+#include "qdisp/JobStatus.h"
+#include "util/StringHash.h"
+#include "util/WorkQueue.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE MergingHandler_1
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+using lsst::qserv::ResourceUnit;
+using lsst::qserv::ccontrol::MergingHandler;
+using lsst::qserv::proto::ProtoHeader;
+using lsst::qserv::proto::ProtoHeaderWrap;
+using lsst::qserv::proto::Result;
+using lsst::qserv::proto::WorkerResponse;
+using lsst::qserv::util::StringHash;
+using lsst::qserv::util::WorkQueue;
+namespace qdisp = lsst::qserv::qdisp;
+
+namespace {
+
+/// Records the order of the merged messages, by Result.session. Merges
+/// block while the gate is closed.
+class FakeMergingHandler : public MergingHandler {
+public:
+    typedef std::shared_ptr<FakeMergingHandler> Ptr;
+
+    explicit FakeMergingHandler(std::shared_ptr<WorkQueue> const& decodeQueue)
+        : MergingHandler(nullptr, nullptr, "result", decodeQueue) {}
+
+    void setGate(bool open) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _open = open;
+        _cv.notify_all();
+    }
+
+    /// Wait until count merges were started.
+    void waitEntered(int count) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this, count](){ return _entered >= count; });
+    }
+
+    std::vector<int> getMerged() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _merged;
+    }
+
+    /// Make later messages quicker to merge than earlier ones.
+    bool slowFirst = false;
+
+protected:
+    bool _infileMerge(std::shared_ptr<WorkerResponse> const& response) override {
+        int session = response->result.session();
+        std::unique_lock<std::mutex> lock(_mutex);
+        ++_entered;
+        _cv.notify_all();
+        _cv.wait(lock, [this](){ return _open; });
+        if (slowFirst) {
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(5 - session % 5));
+            lock.lock();
+        }
+        _merged.push_back(session);
+        return true;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _open = true;
+    int _entered = 0;
+    std::vector<int> _merged;
+};
+
+/// A job without an Executive, which can be marked cancelled.
+class JobQueryFake : public qdisp::JobQuery {
+public:
+    typedef std::shared_ptr<JobQueryFake> Ptr;
+
+    JobQueryFake(qdisp::JobDescription const& jobDescription)
+        : qdisp::JobQuery{nullptr, jobDescription, std::make_shared<qdisp::JobStatus>(), nullptr, 12345} {}
+
+    static Ptr newJobQueryFake(std::shared_ptr<qdisp::ResponseHandler> const& handler) {
+        qdisp::JobDescription jobDesc(0, ResourceUnit("/chk/Mock/1234"), "", handler);
+        Ptr job = std::make_shared<JobQueryFake>(jobDesc);
+        job->_setup(); // Must call _setup() by hand as bypassing newJobQuery().
+        return job;
+    }
+
+    void setCancelled() { _cancelled = true; }
+};
+
+struct Fixture {
+    /// @return the header and Result message with session set to seq.
+    std::vector<std::string> message(int seq, bool continues) {
+        Result result;
+        result.set_continues(continues);
+        result.set_session(seq);
+        result.mutable_rowschema();
+        std::string msg;
+        result.SerializeToString(&msg);
+        ProtoHeader ph;
+        ph.set_protocol(2);
+        ph.set_size(msg.size());
+        ph.set_md5(StringHash::getMd5(msg.data(), msg.size()));
+        std::string header;
+        ph.SerializeToString(&header);
+        return {ProtoHeaderWrap::wrap(header), msg};
+    }
+
+    /// Feed buf to handler, as QueryRequest does.
+    bool feed(MergingHandler& handler, std::string const& buf, bool& last) {
+        std::vector<char>& dest = handler.nextBuffer();
+        BOOST_REQUIRE_EQUAL(dest.size(), buf.size());
+        std::copy(buf.begin(), buf.end(), dest.begin());
+        last = false;
+        return handler.flush(buf.size(), last);
+    }
+
+    /// Feed message seq of a stream of count messages.
+    bool feedMessage(MergingHandler& handler, int seq, int count) {
+        bool last = false;
+        auto bufs = message(seq, seq + 1 < count);
+        bool ok = feed(handler, bufs[0], last) && feed(handler, bufs[1], last);
+        BOOST_CHECK_EQUAL(last, seq + 1 == count);
+        return ok;
+    }
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(Suite, Fixture)
+
+BOOST_AUTO_TEST_CASE(MergeOrder) {
+    auto decodeQueue = std::make_shared<WorkQueue>(4);
+    auto handler = std::make_shared<FakeMergingHandler>(decodeQueue);
+    auto job = JobQueryFake::newJobQueryFake(handler);
+    handler->slowFirst = true;
+    int const count = 20;
+    for (int seq = 0; seq < count; ++seq) {
+        BOOST_REQUIRE(feedMessage(*handler, seq, count));
+    }
+    BOOST_CHECK(handler->drain());
+    std::vector<int> expected;
+    for (int seq = 0; seq < count; ++seq) {
+        expected.push_back(seq);
+    }
+    auto merged = handler->getMerged();
+    BOOST_CHECK_EQUAL_COLLECTIONS(merged.begin(), merged.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(Backpressure) {
+    auto decodeQueue = std::make_shared<WorkQueue>(1);
+    auto handler = std::make_shared<FakeMergingHandler>(decodeQueue);
+    auto job = JobQueryFake::newJobQueryFake(handler);
+    handler->setGate(false);
+    int const count = MergingHandler::MAX_DECODES_IN_FLIGHT + 2;
+    int seq = 0;
+    for (; seq < MergingHandler::MAX_DECODES_IN_FLIGHT; ++seq) {
+        BOOST_REQUIRE(feedMessage(*handler, seq, count));
+    }
+    handler->waitEntered(1);
+
+    // The next message waits for the merger.
+    std::atomic<bool> fed{false};
+    std::thread feeder([this, &handler, &fed, seq, count]() {
+        fed = feedMessage(*handler, seq, count);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK(!fed);
+    BOOST_CHECK(handler->getMerged().empty());
+    handler->setGate(true);
+    feeder.join();
+    BOOST_CHECK(fed);
+
+    // The last message is merged in flush(), after all of the others.
+    BOOST_REQUIRE(feedMessage(*handler, seq + 1, count));
+    BOOST_CHECK(handler->drain());
+    std::vector<int> expected{0, 1, 2, 3};
+    auto merged = handler->getMerged();
+    BOOST_CHECK_EQUAL_COLLECTIONS(merged.begin(), merged.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(CancelQueued) {
+    auto decodeQueue = std::make_shared<WorkQueue>(1);
+    auto handler = std::make_shared<FakeMergingHandler>(decodeQueue);
+    auto job = JobQueryFake::newJobQueryFake(handler);
+    handler->setGate(false);
+    int const count = 10;
+    for (int seq = 0; seq < MergingHandler::MAX_DECODES_IN_FLIGHT; ++seq) {
+        BOOST_REQUIRE(feedMessage(*handler, seq, count));
+    }
+    handler->waitEntered(1);
+
+    // The merge in progress completes, the queued message is dropped.
+    job->setCancelled();
+    handler->setGate(true);
+    handler->processCancel();
+    std::vector<int> expected{0};
+    auto merged = handler->getMerged();
+    BOOST_CHECK_EQUAL_COLLECTIONS(merged.begin(), merged.end(), expected.begin(), expected.end());
+    BOOST_CHECK(!handler->drain());
+    BOOST_CHECK(!feedMessage(*handler, MergingHandler::MAX_DECODES_IN_FLIGHT, count));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,194 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// System headers
+#include <map>
+#include <string>
+#include <vector>
+
+// Qserv headers
+#include "ccontrol/MultiChunkHandler.h"
+#include "global/MsgReceiver.h"
+#include "proto/ProtoHeaderWrap.h"
+#include "proto/worker.pb.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE MultiChunkHandler_1
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+using lsst::qserv::ccontrol::MultiChunkHandler;
+using lsst::qserv::proto::ProtoHeader;
+using lsst::qserv::proto::ProtoHeaderWrap;
+namespace qdisp = lsst::qserv::qdisp;
+
+/// Reads a header and then a message, like MergingHandler. A message
+/// starting with "more" continues, one starting with "fail" fails.
+class ChunkHandler : public qdisp::ResponseHandler {
+public:
+    std::vector<char>& nextBuffer() override { return _buffer; }
+
+    bool flush(int bLen, bool& last) override {
+        if (_headerWait) {
+            auto response = std::make_shared<lsst::qserv::proto::WorkerResponse>();
+            BOOST_REQUIRE(ProtoHeaderWrap::unwrap(response, _buffer));
+            _buffer.resize(response->protoHeader.size());
+            _headerWait = false;
+            return true;
+        }
+        std::string msg(_buffer.begin(), _buffer.end());
+        if (msg.compare(0, 4, "fail") == 0) {
+            _error = Error(42, "failed");
+            return false;
+        }
+        msgs.push_back(msg);
+        last = msg.compare(0, 4, "more") != 0;
+        _buffer.resize(ProtoHeaderWrap::PROTO_HEADER_SIZE);
+        _headerWait = true;
+        return true;
+    }
+
+    void errorFlush(std::string const& msg, int code) override { _error = Error(code, msg); }
+    bool finished() const override { return true; }
+    bool reset() override { return true; }
+    std::ostream& print(std::ostream& os) const override { return os << "ChunkHandler"; }
+    Error getError() const override { return _error; }
+
+    std::vector<std::string> msgs;
+
+private:
+    std::vector<char> _buffer = std::vector<char>(ProtoHeaderWrap::PROTO_HEADER_SIZE);
+    bool _headerWait = true;
+    Error _error;
+};
+
+class Receiver : public lsst::qserv::MsgReceiver {
+public:
+    void operator()(int code, std::string const& msg) override { msgs.push_back(msg); }
+    std::vector<std::string> msgs;
+};
+
+struct Fixture {
+    Fixture() {
+        for (int chunkId : {10, 20, 30}) {
+            handlers[chunkId] = std::make_shared<ChunkHandler>();
+            receivers[chunkId] = std::make_shared<Receiver>();
+            chunks.push_back({chunkId, receivers[chunkId], handlers[chunkId]});
+        }
+    }
+
+    std::string header(int chunkId, size_t size, bool unowned=false) {
+        ProtoHeader ph;
+        ph.set_size(size);
+        ph.set_chunkid(chunkId);
+        if (unowned) {
+            ph.set_unowned(true);
+        }
+        std::string s;
+        ph.SerializeToString(&s);
+        return ProtoHeaderWrap::wrap(s);
+    }
+
+    /// Feed buf to handler, as QueryRequest does.
+    bool feed(MultiChunkHandler& handler, std::string const& buf, bool& last, bool streamEnds=false) {
+        std::vector<char>& dest = handler.nextBuffer();
+        BOOST_REQUIRE_EQUAL(dest.size(), buf.size());
+        std::copy(buf.begin(), buf.end(), dest.begin());
+        last = streamEnds;
+        return handler.flush(buf.size(), last);
+    }
+
+    /// Feed a header and its message of chunkId.
+    bool send(MultiChunkHandler& handler, int chunkId, std::string const& msg, bool& last,
+              bool streamEnds=false) {
+        return feed(handler, header(chunkId, msg.size()), last)
+            && !last && feed(handler, msg, last, streamEnds);
+    }
+
+    std::map<int, std::shared_ptr<ChunkHandler>> handlers;
+    std::map<int, std::shared_ptr<Receiver>> receivers;
+    std::vector<MultiChunkHandler::Chunk> chunks;
+    std::vector<int> unowned;
+    MultiChunkHandler::UnownedFunc unownedFunc = [this](int chunkId) { unowned.push_back(chunkId); };
+};
+
+BOOST_FIXTURE_TEST_SUITE(suite, Fixture)
+
+BOOST_AUTO_TEST_CASE(Interleaved) {
+    MultiChunkHandler handler(chunks, unownedFunc);
+    bool last = false;
+    BOOST_CHECK(send(handler, 20, "more20a", last));
+    BOOST_CHECK(!last);
+    BOOST_CHECK(send(handler, 10, "more10a", last));
+    BOOST_CHECK(send(handler, 20, "end20b", last));
+    BOOST_CHECK(send(handler, 30, "end30a", last));
+    BOOST_CHECK(!last);
+    BOOST_CHECK(send(handler, 10, "end10b", last, true));
+    BOOST_CHECK(last);
+    BOOST_CHECK(handler.nextBuffer().empty());
+    BOOST_CHECK(handlers[10]->msgs == std::vector<std::string>({"more10a", "end10b"}));
+    BOOST_CHECK(handlers[20]->msgs == std::vector<std::string>({"more20a", "end20b"}));
+    BOOST_CHECK(handlers[30]->msgs == std::vector<std::string>({"end30a"}));
+    BOOST_CHECK(unowned.empty());
+}
+
+BOOST_AUTO_TEST_CASE(Unowned) {
+    MultiChunkHandler handler(chunks, unownedFunc);
+    bool last = false;
+    BOOST_CHECK(feed(handler, header(30, 0, true), last));
+    BOOST_CHECK(send(handler, 10, "end10", last));
+    BOOST_CHECK(!last);
+    BOOST_CHECK(feed(handler, header(20, 0, true), last, true));
+    BOOST_CHECK(last);
+    BOOST_CHECK(unowned == std::vector<int>({30, 20}));
+    BOOST_CHECK(handlers[20]->msgs.empty());
+}
+
+BOOST_AUTO_TEST_CASE(ChunkError) {
+    MultiChunkHandler handler(chunks, unownedFunc);
+    bool last = false;
+    BOOST_CHECK(send(handler, 10, "more10", last));
+    BOOST_CHECK(!send(handler, 20, "fail20", last));
+    auto err = handler.getError();
+    BOOST_CHECK_EQUAL(err.getCode(), 42);
+    BOOST_CHECK(err.getMsg().find("Chunk 20") != std::string::npos);
+    BOOST_CHECK_EQUAL(receivers[20]->msgs.size(), 1U);
+    BOOST_CHECK(receivers[10]->msgs.empty());
+    // Chunks that already started cannot be retried.
+    BOOST_CHECK(!handler.reset());
+}
+
+BOOST_AUTO_TEST_CASE(BadStream) {
+    MultiChunkHandler handler(chunks, unownedFunc);
+    bool last = false;
+    // Unknown chunk
+    BOOST_CHECK(!feed(handler, header(40, 3), last));
+    BOOST_CHECK(handler.reset());
+    // Stream ending before every chunk did
+    BOOST_CHECK(send(handler, 10, "end10", last));
+    BOOST_CHECK(!send(handler, 20, "end20", last, true));
+    BOOST_CHECK(handler.getError().getMsg().find("1 chunks missing") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -25,56 +25,178 @@
 #include "memman/MemFile.h"
 
 // System Headers
+#include <condition_variable>
 #include <errno.h>
+#include <functional>
+#include <list>
 #include <mutex>
 #include <unordered_map>
 
-namespace lsst {
-namespace qserv {
-namespace memman {
-
 /******************************************************************************/
 /*                  L o c a l   S t a t i c   O b j e c t s                   */
 /******************************************************************************/
   
 namespace {
-std::mutex                                cacheMutex;
-std::unordered_map<std::string, MemFile*> fileCache;
+
+// The file cache is split in shards by file path so that obtaining and
+// releasing different files does not serialize on a single mutex. Waiting for
+// a file to be locked by someone else is done on the file's shard.
+//
+struct CacheShard {
+    std::mutex              mtx;
+    std::condition_variable lockDone;
+    std::unordered_map<std::string, lsst::qserv::memman::MemFile*> files;
+};
+
+int const  cacheShards = 16;
+CacheShard fileCache[cacheShards];
+
+CacheShard& shardOf(std::string const& fPath) {
+    return fileCache[std::hash<std::string>()(fPath) % cacheShards];
+}
+
+// Resident files (locked but unreferenced), least recently released first,
+// and where the scan of each table last was. All protected by resMutex which
+// may be obtained while holding a shard mutex but not the other way around.
+//
+std::mutex                                resMutex;
+std::list<lsst::qserv::memman::MemFile*>  resList;
+std::unordered_map<std::string, int>      scanChunk;
+int                                       maxChunk = 0;
+lsst::qserv::memman::MemFile::ResStats    resCounts = {0, 0, 0, 0, 0};
+
+// Number of least recently released files considered for eviction. Only one
+// thread at a time evicts as it deletes the resident files it picks.
+//
+int const  evictWindow = 8;
+std::mutex evictMutex;
 }
 
+namespace lsst {
+namespace qserv {
+namespace memman {
+
 /******************************************************************************/
-/*                               m e m L o c k                                */
+/*                                 e v i c t                                  */
 /******************************************************************************/
 
-MemFile::MLResult MemFile::memLock(uint64_t maxBytes, int minRefs) {
+uint64_t MemFile::evict(Memory& mem, uint64_t bytes) {
 
-    std::lock_guard<std::mutex> guard(cacheMutex);
+    std::lock_guard<std::mutex> evictGuard(evictMutex);
+    uint64_t freed = 0;
 
-    // If the file is already locked, indicate success
+    // Evict resident files until we freed the wanted number of bytes. Among
+    // the oldest resident files we pick the one a scan will need last as the
+    // chunks are scanned in ascending order. A file that was reused before we
+    // got to it is simply skipped.
     //
-    if (_isLocked) {
-        if (_isFlex) _memory.flexNum(1);
-        MLResult aokResult(_memInfo.size(), 0);
-        return aokResult;
+    while (freed < bytes) {
+        MemFile* victim = nullptr;
+        int      vDist  = -1, n = 0;
+        {   std::lock_guard<std::mutex> guard(resMutex);
+            auto it = resList.begin();
+            for (; it != resList.end() && n < evictWindow; it++) {
+                if (&((*it)->_memory) != &mem) continue;
+                n++;
+                int dist = (*it)->scanDistance();
+                if (dist > vDist) {
+                    victim = *it;
+                    vDist  = dist;
+                }
+            }
+        }
+        if (victim == nullptr) break;
+        uint64_t bytesFreed = victim->unlink();
+        if (bytesFreed == 0) continue;
+        freed += bytesFreed;
+        std::lock_guard<std::mutex> guard(resMutex);
+        resCounts.numEvicts++;
     }
+    return freed;
+}
+
+/******************************************************************************/
+/*                         f l u s h R e s i d e n t                          */
+/******************************************************************************/
 
-    // If the file doesn't meet the refcount restriction, don't lock it
+void MemFile::flushResident(Memory& mem) {
+
+    std::lock_guard<std::mutex> evictGuard(evictMutex);
+
+    // Unlock every resident file using the memory object
     //
-    if (_refs < minRefs) {
-        MLResult nilResult(0,0);
-        return nilResult;
+    while (true) {
+        MemFile* mfP = nullptr;
+        {   std::lock_guard<std::mutex> guard(resMutex);
+            for (auto resP : resList) {
+                if (&(resP->_memory) == &mem) {
+                    mfP = resP;
+                    break;
+                }
+            }
+        }
+        if (mfP == nullptr) break;
+        mfP->unlink();
     }
+}
+
+/******************************************************************************/
+/*                              i s L o c k e d                               */
+/******************************************************************************/
+
+bool MemFile::isLocked(std::string const& fPath) {
+
+    CacheShard& shard = shardOf(fPath);
+    std::lock_guard<std::mutex> guard(shard.mtx);
+
+    auto it = shard.files.find(fPath);
+    return it != shard.files.end() && it->second->_isLocked;
+}
+
+/******************************************************************************/
+/*                                c a n c e l                                 */
+/******************************************************************************/
+
+void MemFile::cancel() {
+
+    CacheShard& shard = shardOf(_fPath);
 
-    // If space is wanted, check now before we attempt to lock the file
+    // Give back the reservation and tell anyone waiting for the file that it
+    // was not locked as there was not enough memory for the whole file set.
     //
-    if (maxBytes != 0 && _memInfo.size() > maxBytes) {
-        MLResult bigResult(0, ENOMEM);
-        return bigResult;
-    }
+    _memory.unreserve(_memInfo.size());
+    std::lock_guard<std::mutex> guard(shard.mtx);
+    _isLocking = false;
+    _lockErr   = ENOMEM;
+    shard.lockDone.notify_all();
+}
+
+/******************************************************************************/
+/*                               m e m L o c k                                */
+/******************************************************************************/
 
-    // Lock this table in memory if possible.
+MemFile::MLResult MemFile::memLock() {
+
+    CacheShard& shard = shardOf(_fPath);
+
+    // Lock this table in memory if possible. This is done without holding
+    // any mutex as mapping and locking a file takes a while. Should the
+    // system refuse for lack of memory, give back resident files and try once
+    // more.
     //
+    Memory::FileId fileId = _memory.fileId(_fPath);
     MemInfo mInfo = _memory.memLock(_fPath, _isFlex);
+    if (!mInfo.isValid() && mInfo.errCode() == ENOMEM
+    &&  MemFile::evict(_memory, _memInfo.size()) != 0) {
+        mInfo = _memory.memLock(_fPath, _isFlex);
+    }
+    _memory.unreserve(_memInfo.size());
+
+    // Record the outcome and tell anyone waiting for the file about it
+    //
+    std::lock_guard<std::mutex> guard(shard.mtx);
+    _isLocking = false;
+    shard.lockDone.notify_all();
 
     // If we successfully locked this file, then indicate so, update the
     // memory information and return.
@@ -83,11 +205,15 @@ MemFile::MLResult MemFile::memLock(uint64_t maxBytes, int minRefs) {
         MLResult aokResult(mInfo.size(),0);
         _isLocked = 1;
         _memInfo = mInfo;
+        _fileId  = fileId;
+        std::lock_guard<std::mutex> resGuard(resMutex);
+        resCounts.numMisses++;
         return aokResult;
     }
 
     // Diagnose any errors
     //
+    _lockErr = mInfo.errCode();
     MLResult errResult(0, mInfo.errCode());
     return errResult;
 }
@@ -98,38 +224,56 @@ MemFile::MLResult MemFile::memLock(uint64_t maxBytes, int minRefs) {
 
 uint32_t MemFile::numFiles() {
 
-    std::lock_guard<std::mutex> guard(cacheMutex);
+    uint32_t num = 0;
 
     // Simply return the size of our file cache
     //
-    return fileCache.size();
+    for (auto& shard : fileCache) {
+        std::lock_guard<std::mutex> guard(shard.mtx);
+        num += shard.files.size();
+    }
+    return num;
 }
 
 /******************************************************************************/
 /*                                o b t a i n                                 */
 /******************************************************************************/
   
-MemFile::MFResult MemFile::obtain(std::string const& fPath,
-                                  Memory& mem, bool isFlex) {
+MemFile::MFResult MemFile::obtain(std::string const& fPath, Memory& mem,
+                                  bool isFlex, std::string const& table,
+                                  int chunk) {
 
-    std::lock_guard<std::mutex> guard(cacheMutex);
+    CacheShard& shard = shardOf(fPath);
 
-    // First look up if this table already exists in our cache and is using the
-    // the same memory object (error if not). If so, up the reference count and
-    // return the object as it may be shared. Note: it->second == MemFile*!
+    // Track where the scan over this table is for eviction decisions
     //
-    auto it = fileCache.find(fPath);
-    if (it != fileCache.end()) {
-        if (&(it->second->_memory) != &mem) {
-            MFResult errResult(nullptr, EXDEV);
-            return errResult;
-        }
-        it->second->_refs++;
-        MFResult aokResult(it->second,0);
-        return aokResult;
+    {   std::lock_guard<std::mutex> guard(resMutex);
+        scanChunk[table] = chunk;
+        if (chunk > maxChunk) maxChunk = chunk;
     }
 
-    // Validate the file and get its size
+    // First look up if this table already exists in our cache. If so, reuse
+    // the object as it may be shared. A resident file is first checked
+    // against the file on disk, without the lock as it needs a system call.
+    //
+    std::unique_lock<std::mutex> guard(shard.mtx);
+    auto it = shard.files.find(fPath);
+    if (it != shard.files.end()) {
+        if (it->second->_refs != 0) return it->second->reuse(mem);
+        Memory::FileId fileId = it->second->_fileId;
+        guard.unlock();
+        if (mem.fileId(fPath) != fileId) {
+            unlinkStale(fPath, fileId);
+        } else {
+            guard.lock();
+            it = shard.files.find(fPath);
+            if (it != shard.files.end()) return it->second->reuse(mem);
+            guard.unlock();
+        }
+    } else guard.unlock();
+
+    // Validate the file and get its size. We do this without the lock as it
+    // needs a system call.
     //
     MemInfo mInfo = mem.fileInfo(fPath);
     if (!mInfo.isValid()) {
@@ -137,10 +281,16 @@ MemFile::MFResult MemFile::obtain(std::string const& fPath,
         return errResult;
     }
 
-    // Get a new file object and insert it into the map
+    // Get a new file object and insert it into the map. Should someone else
+    // have inserted the file in the meantime, use theirs instead.
     //
-    MemFile* mfP = new MemFile(fPath, mem, mInfo, isFlex);
-    fileCache.insert({fPath, mfP});
+    MemFile* mfP = new MemFile(fPath, mem, mInfo, isFlex, table, chunk);
+    guard.lock();
+    auto ins = shard.files.insert({fPath, mfP});
+    if (!ins.second) {
+        delete mfP;
+        return ins.first->second->reuse(mem);
+    }
 
     // Return the pointer to the file object
     //
@@ -154,25 +304,211 @@ MemFile::MFResult MemFile::obtain(std::string const& fPath,
 
 void MemFile::release() {
 
-    std::lock_guard<std::mutex> guard(cacheMutex);
+    CacheShard& shard = shardOf(_fPath);
+    std::unique_lock<std::mutex> guard(shard.mtx);
 
     // Decrease the reference count. If there are still references, return
     //
     _refs--;
     if (_refs > 0) return;
 
-    // Release the memory
+    // If the file is locked keep it that way as a resident file, it will be
+    // unlocked when its memory is needed.
     //
-    _memory.memRel(_memInfo);
+    if (_isLocked) {
+        std::lock_guard<std::mutex> resGuard(resMutex);
+        _resIt = resList.insert(resList.end(), this);
+        resCounts.bytesResident += _memInfo.size();
+        return;
+    }
 
     // Remove the object from our cache
     //
-    auto it = fileCache.find(_fPath);
-    if (it != fileCache.end()) fileCache.erase(it);
+    shard.files.erase(_fPath);
+    guard.unlock();
+
+    // Release the memory
+    //
+    _memory.memRel(_memInfo);
 
     // Delete ourselves as we are done
     //
     delete this;
 }
-}}} // namespace lsst:qserv:memman
 
+/******************************************************************************/
+/*                               r e s e r v e                                */
+/******************************************************************************/
+
+MemFile::MLResult MemFile::reserve(uint64_t maxBytes, int minRefs, bool mayEvict) {
+
+    CacheShard& shard = shardOf(_fPath);
+
+    // If the file is already locked, indicate success. If someone else is
+    // locking it, the outcome must be waited for. Otherwise, if the file
+    // doesn't meet the refcount restriction, don't lock it.
+    //
+    {   std::lock_guard<std::mutex> guard(shard.mtx);
+        if (_isLocked) {
+            if (_isFlex) _memory.flexNum(1);
+            MLResult aokResult(_memInfo.size(), 0);
+            return aokResult;
+        }
+        if (_isLocking) {
+            MLResult waitResult(_memInfo.size(), 0, MLResult::Pending::WAIT);
+            return waitResult;
+        }
+        if (_refs < minRefs) {
+            MLResult nilResult(0,0);
+            return nilResult;
+        }
+    }
+
+    // If space is wanted, check now before we attempt to lock the file. We
+    // may make room by evicting resident files, if allowed.
+    //
+    if (maxBytes != 0 && _memInfo.size() > maxBytes) {
+        uint64_t freed = 0;
+        if (mayEvict) freed = MemFile::evict(_memory, _memInfo.size() - maxBytes);
+        if (_memInfo.size() > maxBytes + freed) {
+            MLResult bigResult(0, ENOMEM);
+            return bigResult;
+        }
+    }
+
+    // Reserve the memory. No one else can have started locking the file in
+    // the meantime as calls to reserve() are serialized.
+    //
+    _memory.reserve(_memInfo.size());
+    std::lock_guard<std::mutex> guard(shard.mtx);
+    _isLocking = true;
+    MLResult lockResult(_memInfo.size(), 0, MLResult::Pending::LOCK);
+    return lockResult;
+}
+
+/******************************************************************************/
+/*                             r e s S t a t s                                */
+/******************************************************************************/
+
+MemFile::ResStats MemFile::resStats() {
+
+    std::lock_guard<std::mutex> guard(resMutex);
+
+    return resCounts;
+}
+
+/******************************************************************************/
+/*                                 r e u s e                                  */
+/******************************************************************************/
+
+MemFile::MFResult MemFile::reuse(Memory& mem) {
+
+    // The file must be using the same memory object (error if not). Up the
+    // reference count and, for a resident file, take it off the resident list
+    // as it is in use again. Note: the shard mutex must be held!
+    //
+    if (&_memory != &mem) {
+        MFResult errResult(nullptr, EXDEV);
+        return errResult;
+    }
+    if (_refs == 0) {
+        std::lock_guard<std::mutex> guard(resMutex);
+        resList.erase(_resIt);
+        resCounts.bytesResident -= _memInfo.size();
+        resCounts.bytesSaved    += _memInfo.size();
+        resCounts.numHits++;
+    }
+    _refs++;
+    MFResult aokResult(this,0);
+    return aokResult;
+}
+
+/******************************************************************************/
+/*                          s c a n D i s t a n c e                           */
+/******************************************************************************/
+
+int MemFile::scanDistance() {
+
+    // Return how many chunks the scan over our table must still go through
+    // before it gets to our chunk; behind the scan means the next pass.
+    // Note: resMutex must be held!
+    //
+    auto it = scanChunk.find(_table);
+    if (it == scanChunk.end()) return maxChunk + 1;
+    int dist = _chunk - it->second;
+    if (dist <= 0) dist += maxChunk + 1;
+    return dist;
+}
+
+/******************************************************************************/
+/*                                u n l i n k                                 */
+/******************************************************************************/
+
+uint64_t MemFile::unlink() {
+
+    CacheShard& shard = shardOf(_fPath);
+
+    // Remove a resident file from the cache unless it was reused in the
+    // meantime. This is safe as only the holder of evictMutex deletes
+    // resident files.
+    //
+    {   std::lock_guard<std::mutex> guard(shard.mtx);
+        if (_refs != 0) return 0;
+        std::lock_guard<std::mutex> resGuard(resMutex);
+        resList.erase(_resIt);
+        resCounts.bytesResident -= _memInfo.size();
+        shard.files.erase(_fPath);
+    }
+
+    // Unlock the memory and delete ourselves, no one can find us anymore
+    //
+    uint64_t bytes = _memInfo.size();
+    _memory.memRel(_memInfo);
+    delete this;
+    return bytes;
+}
+
+/******************************************************************************/
+/*                           u n l i n k S t a l e                            */
+/******************************************************************************/
+
+void MemFile::unlinkStale(std::string const& fPath,
+                          Memory::FileId const& fileId) {
+
+    std::lock_guard<std::mutex> evictGuard(evictMutex);
+    CacheShard& shard = shardOf(fPath);
+    MemFile*    mfP   = nullptr;
+
+    // Unlock the resident copy of a file that changed on disk, unless it was
+    // evicted or reused in the meantime. As for evict(), holding evictMutex
+    // keeps anyone else from deleting it once we let go of the shard mutex.
+    //
+    {   std::lock_guard<std::mutex> guard(shard.mtx);
+        auto it = shard.files.find(fPath);
+        if (it != shard.files.end() && it->second->_refs == 0
+        &&  it->second->_fileId == fileId) mfP = it->second;
+    }
+    if (mfP != nullptr) mfP->unlink();
+}
+
+/******************************************************************************/
+/*                              w a i t L o c k                               */
+/******************************************************************************/
+
+MemFile::MLResult MemFile::waitLock() {
+
+    CacheShard& shard = shardOf(_fPath);
+    std::unique_lock<std::mutex> guard(shard.mtx);
+
+    // Wait for whoever is locking the file to be done and return the outcome
+    //
+    shard.lockDone.wait(guard, [this]() {return !_isLocking;});
+    if (_isLocked) {
+        if (_isFlex) _memory.flexNum(1);
+        MLResult aokResult(_memInfo.size(), 0);
+        return aokResult;
+    }
+    MLResult errResult(0, _lockErr);
+    return errResult;
+}
+}}} // namespace lsst:qserv:memman
@@ -27,6 +27,7 @@
 // System headers
 #include <atomic>
 #include <cstdint>
+#include <list>
 #include <mutex>
 #include <string>
 #include <unistd.h>
@@ -40,33 +41,99 @@ namespace memman {
 
 //-----------------------------------------------------------------------------
 //! @brief Description of a memory based file.
+//!
+//! A locked file whose last reference is released stays locked (resident) so
+//! that a later request for the same file, typically the next scan over the
+//! chunks, need not read it again. Resident files are unlocked (evicted) only
+//! when memory is needed to lock a required file. The victim is picked among
+//! the least recently released files as the one a scan reaches last. Before
+//! a resident file is reused it is checked against the file on disk; should
+//! the table have been re-created or rewritten since it was locked, the stale
+//! copy is unlocked and the file is locked anew.
+//!
+//! Locking a file is done in two steps. The memory for the file is reserved
+//! by reserve(), whose calls must be serialized by the caller so that each
+//! has a predictable view of memory. The file is then mapped and locked by
+//! memLock() without holding any lock, so several files may be locked at
+//! once. Anyone else wanting the file meanwhile waits for it via waitLock().
 //-----------------------------------------------------------------------------
 
 class MemFile {
 public:
 
     //-----------------------------------------------------------------------------
-    //! @brief Lock database file in memory.
+    //! @brief Reserve memory for locking database file in memory.
     //!
     //! @param  maxBytes- maximum file size for locking the table file.
     //!                   A value of zero skips the check.
     //! @param  minRefs - minimum reference count for locking the table file.
+    //! @param  mayEvict- When true, resident files may be evicted to make
+    //!                   room for this file when it exceeds maxBytes.
     //!
-    //! @return MLResult  When bLocked > 0 this number of bytes locked.
-    //!                   When bLocked = 0 no bytes were locked and retc holds
-    //!                   the reason. When retc = 0 the file did not meet the
-    //!                   minRefs restriction. Otherwise, retc is the errno
-    //!                   value indicating the reason for the failure.
+    //! @return MLResult  When bLocked > 0 this number of bytes locked or
+    //!                   reserved, see pending. When bLocked = 0 no bytes were
+    //!                   locked and retc holds the reason. When retc = 0 the
+    //!                   file did not meet the minRefs restriction. Otherwise,
+    //!                   retc is the errno value indicating the reason for the
+    //!                   failure. When pending is LOCK, memLock() or cancel()
+    //!                   must be called. When it is WAIT, someone else is
+    //!                   locking the file and waitLock() tells the outcome.
     //-----------------------------------------------------------------------------
 
     struct MLResult {
+        enum class Pending {NONE, LOCK, WAIT};
         uint64_t bLocked;
         int      retc;
+        Pending  pending = Pending::NONE;
         MLResult() {}
-        MLResult(uint64_t lksz, int rc) : bLocked(lksz), retc(rc) {}
+        MLResult(uint64_t lksz, int rc, Pending pnd=Pending::NONE)
+                : bLocked(lksz), retc(rc), pending(pnd) {}
     };
 
-    MLResult    memLock(uint64_t maxBytes=0, int minRefs=0);
+    MLResult    reserve(uint64_t maxBytes=0, int minRefs=0, bool mayEvict=true);
+
+    //-----------------------------------------------------------------------------
+    //! @brief Lock database file in memory after reserve() reserved memory
+    //!        for it. The reservation is given back whatever the outcome.
+    //!
+    //! @return MLResult  When bLocked > 0 this number of bytes locked.
+    //!                   Otherwise, retc is the errno value indicating the
+    //!                   reason for the failure.
+    //-----------------------------------------------------------------------------
+
+    MLResult    memLock();
+
+    //-----------------------------------------------------------------------------
+    //! @brief Give back memory reserved by reserve() without locking the file.
+    //-----------------------------------------------------------------------------
+
+    void        cancel();
+
+    //-----------------------------------------------------------------------------
+    //! @brief Wait for someone else to lock database file in memory.
+    //!
+    //! @return MLResult  As for memLock().
+    //-----------------------------------------------------------------------------
+
+    MLResult    waitLock();
+
+    //-----------------------------------------------------------------------------
+    //! @brief Unlock and delete all resident files using a memory object.
+    //!
+    //! @param  mem     - Reference to the memory object.
+    //-----------------------------------------------------------------------------
+
+    static void flushResident(Memory& mem);
+
+    //-----------------------------------------------------------------------------
+    //! @brief Check whether a file is currently locked in memory.
+    //!
+    //! @param  fPath   - The path to the file.
+    //!
+    //! @return true if the file is locked (in use or resident), false if not.
+    //-----------------------------------------------------------------------------
+
+    static bool isLocked(std::string const& fPath);
 
     //-----------------------------------------------------------------------------
     //! @brief Get number of active files (global count).
@@ -76,6 +143,22 @@ public:
 
     static uint32_t numFiles();
 
+    //-----------------------------------------------------------------------------
+    //! @brief Get residency statistics (global counts).
+    //!
+    //! @return The residency statistics.
+    //-----------------------------------------------------------------------------
+
+    struct ResStats {
+        uint64_t bytesResident; //!< Bytes locked by resident files
+        uint64_t bytesSaved;    //!< Bytes not read because files were resident
+        uint32_t numHits;       //!< Number of times a resident file was reused
+        uint32_t numMisses;     //!< Number of times a file had to be locked
+        uint32_t numEvicts;     //!< Number of resident files evicted
+    };
+
+    static ResStats resStats();
+
     //-----------------------------------------------------------------------------
     //! @brief Obtain an object describing a in-memory file.
     //!
@@ -83,6 +166,8 @@ public:
     //! @param  fPath   - The path to the file.
     //! @param  mem     - Reference to the memory object to use for the file.
     //! @param  isFlex  - Tag file as flexible or not (only if new file).
+    //! @param  table   - Name identifying the table file across chunks.
+    //! @param  chunk   - The chunk number of the file.
     //!
     //! @return MFResult  When mfP is zero or retc is not zero, the MemFile
     //!                   object could not be obtained and retc holds errno.
@@ -95,7 +180,8 @@ public:
         MFResult(MemFile* mfp, int rc) : mfP(mfp), retc(rc) {}
     };
 
-    static MFResult obtain(std::string const& fPath, Memory& mem, bool isFlex);
+    static MFResult obtain(std::string const& fPath, Memory& mem, bool isFlex,
+                           std::string const& table, int chunk);
 
     //-----------------------------------------------------------------------------
     //! @brief Release this table. Upon return it may not be references by
@@ -112,22 +198,40 @@ private:
     //! @param  mem     - Reference to the associated memory object.
     //! @param  mInfo   - Initial value of the MemInfo object for the file.
     //! @param  isFlex  - Tag file as flexible or not (for statistical reasons).
+    //! @param  table   - Name identifying the table file across chunks.
+    //! @param  chunk   - The chunk number of the file.
     //-----------------------------------------------------------------------------
 
     MemFile(std::string const& fPath,
             Memory&            mem,
             MemInfo const&     minfo,
-            bool               isFlex)
-           : _fPath(fPath), _memory(mem), _memInfo(minfo), _isFlex(isFlex) {}
+            bool               isFlex,
+            std::string const& table,
+            int                chunk)
+           : _fPath(fPath), _memory(mem), _memInfo(minfo), _isFlex(isFlex),
+             _table(table), _chunk(chunk) {}
 
    ~MemFile() {}
 
+    static uint64_t evict(Memory& mem, uint64_t bytes);
+    MFResult        reuse(Memory& mem);
+    int             scanDistance();
+    uint64_t        unlink();
+    static void     unlinkStale(std::string const& fPath,
+                                Memory::FileId const& fileId);
+
     std::string _fPath;
     Memory&     _memory;
     MemInfo     _memInfo;
-    int         _refs = 1;           // Protected by cacheMutex
+    int         _refs = 1;           // Protected by the file's cache shard mutex
     bool        _isLocked = false;   // Ditto
+    bool        _isLocking = false;  // Ditto, memory reserved and lock pending
+    int         _lockErr = 0;        // Ditto, why the last lock failed
+    Memory::FileId _fileId;          // Ditto, the file that was locked
     bool        _isFlex;             // Set once at object creation
+    std::string _table;              // Ditto
+    int         _chunk;              // Ditto
+    std::list<MemFile*>::iterator _resIt; // Valid when resident (_refs == 0)
 };
 
 }}} // namespace lsst:qserv:memman
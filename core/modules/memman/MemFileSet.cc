@@ -41,10 +41,12 @@ namespace memman {
   
 MemFileSet::~MemFileSet() {
 
-    // Unreference every fle in our file set. This action will also cause
+    // Give back memory reserved for files that were never locked. Then
+    // unreference every fle in our file set. This action will also cause
     // memory to be unlocked if no one else is using the file then the file
     // object will be deleted as well.
     //
+    for (auto&& toLock : _toLock) {toLock.first->cancel();}
     for (auto mfP : _lockFiles) {mfP->release();}
     for (auto mfP : _flexFiles) {mfP->release();}
 }
@@ -60,7 +62,9 @@ int MemFileSet::add(std::string const& tabname, int chunk,
 
     // Obtain a memory file object for this table and chunk
     //
-    MemFile::MFResult mfResult = MemFile::obtain(fPath, _memory, !mustLK);
+    std::string table(iFile ? tabname + "/index" : tabname);
+    MemFile::MFResult mfResult = MemFile::obtain(fPath, _memory, !mustLK,
+                                                 table, chunk);
     if (mfResult.mfP == 0) return mfResult.retc;
 
     // Add to the appropriate file set
@@ -81,46 +85,76 @@ int MemFileSet::add(std::string const& tabname, int chunk,
 int MemFileSet::lockAll() {
 
     MemFile::MLResult mlResult;
-    uint64_t bytesLocked, bytesMax, freeBytes;
+    int retc = 0;
 
-    // Calculate the number of bytes available at this point. Note that we force
-    // freeBytes to be atleast 1 to make memlock check before it tries locking
-    // the file to avoid a useless memory map operation if it can't be locked.
-    // By the time we get here someone else may have already locked the file.
+    // Lock the files we reserved memory for. Once a required file could not
+    // be locked there is no point in locking the others.
     //
-    bytesMax    = _memory.bytesMax();
-    bytesLocked = _memory.bytesLocked();
-    if (bytesMax <= bytesLocked) {
-        freeBytes = 1;
-    } else {
-        freeBytes = bytesMax - bytesLocked;
+    for (auto&& toLock : _toLock) {
+        if (retc != 0) {
+            toLock.first->cancel();
+            continue;
+        }
+        mlResult = toLock.first->memLock();
+        _lockBytes += mlResult.bLocked;
+        if (mlResult.retc != 0 && toLock.second) retc = mlResult.retc;
     }
+    _toLock.clear();
+
+    // Wait for the required files someone else is locking
+    //
+    for (auto mfP : _toWait) {
+        if (retc != 0) break;
+        mlResult = mfP->waitLock();
+        _lockBytes += mlResult.bLocked;
+        retc = mlResult.retc;
+    }
+    _toWait.clear();
+    return retc;
+}
+
+/******************************************************************************/
+/*                            r e s e r v e A l l                             */
+/******************************************************************************/
+
+int MemFileSet::reserveAll() {
 
-    // Try to lock all of the required tables
+    MemFile::MLResult mlResult;
+
+    // Reserve memory for all of the required tables. These may evict resident
+    // files to make room, so the bytes available are recalculated for each.
     //
     for (auto mfP : _lockFiles) {
-        mlResult = mfP->memLock(freeBytes);
+        mlResult = mfP->reserve(_freeBytes());
         if (mlResult.retc != 0) return mlResult.retc;
-        _lockBytes += mlResult.bLocked;
-        if (freeBytes  > mlResult.bLocked) {
-            freeBytes -= mlResult.bLocked;
-        } else {
-            freeBytes = 1;
+        switch (mlResult.pending) {
+            case MemFile::MLResult::Pending::LOCK:
+                _toLock.push_back({mfP, true});
+                break;
+            case MemFile::MLResult::Pending::WAIT:
+                _toWait.push_back(mfP);
+                break;
+            default:
+                _lockBytes += mlResult.bLocked;
         }
     }
 
     // Try locking as many flexible files as we can. We only lock the file table
     // if the reference count >= 2 to optimize memory usage. At some point we
     // will place unlocked flex files on a "want to lock" queue. FUTURE!!!
+    // Flexible files never evict resident files and we don't wait for them.
     //
     for (auto mfP : _flexFiles) {
-        mlResult = mfP->memLock(freeBytes, 2);
+        mlResult = mfP->reserve(_freeBytes(), 2, false);
         if (mlResult.bLocked == 0) continue;
-        _lockBytes += mlResult.bLocked;
-        if (freeBytes  > mlResult.bLocked) {
-            freeBytes -= mlResult.bLocked;
-        } else {
-            freeBytes = 1;
+        switch (mlResult.pending) {
+            case MemFile::MLResult::Pending::LOCK:
+                _toLock.push_back({mfP, false});
+                break;
+            case MemFile::MLResult::Pending::WAIT:
+                break;
+            default:
+                _lockBytes += mlResult.bLocked;
         }
     }
 
@@ -129,6 +163,25 @@ int MemFileSet::lockAll() {
     return 0;
 }
 
+/******************************************************************************/
+/*                             f r e e B y t e s                              */
+/******************************************************************************/
+
+uint64_t MemFileSet::_freeBytes() {
+
+    uint64_t bytesLocked, bytesMax;
+
+    // Calculate the number of bytes available at this point. Note that we force
+    // freeBytes to be atleast 1 to make memlock check before it tries locking
+    // the file to avoid a useless memory map operation if it can't be locked.
+    // By the time we get here someone else may have already locked the file.
+    //
+    bytesMax    = _memory.bytesMax();
+    bytesLocked = _memory.bytesLocked() + _memory.bytesReserved();
+    if (bytesMax <= bytesLocked) return 1;
+    return bytesMax - bytesLocked;
+}
+
 /******************************************************************************/
 /*                                s t a t u s                                 */
 /******************************************************************************/
@@ -27,6 +27,7 @@
 // System headers
 #include <cstdint>
 #include <string>
+#include <utility>
 #include <unistd.h>
 
 // Qserv headers
@@ -73,8 +74,8 @@ public:
     bool   isOwner(Memory const& memory) {return &memory == &_memory;}
 
     //-----------------------------------------------------------------------------
-    //! @bried Lock all of the required tables in a table set and as many
-    //!        flexible files as possible.
+    //! @bried Lock all of the files reserveAll() reserved memory for and wait
+    //!        for required files someone else is locking.
     //!
     //! @return =0 all required bytes that could be locked were locked.
     //! @return !0 A required file could not be locked, errno value is returned.
@@ -82,6 +83,16 @@ public:
 
     int    lockAll();
 
+    //-----------------------------------------------------------------------------
+    //! @brief Reserve memory for all of the required tables in a table set and
+    //!        as many flexible files as possible. Calls must be serialized.
+    //!
+    //! @return =0 all required bytes that could be reserved were reserved.
+    //! @return !0 A required file could not be reserved, errno is returned.
+    //-----------------------------------------------------------------------------
+
+    int    reserveAll();
+
     //-----------------------------------------------------------------------------
     //! @brief Retrn status.
     //!
@@ -108,9 +119,13 @@ public:
     ~MemFileSet();
 
 private:
+    uint64_t              _freeBytes();
+
     Memory&               _memory;
     std::vector<MemFile*> _lockFiles;
     std::vector<MemFile*> _flexFiles;
+    std::vector<std::pair<MemFile*, bool>> _toLock; // Reserved, true if required
+    std::vector<MemFile*> _toWait;        // Required, locked by someone else
     uint64_t              _lockBytes;     // Total bytes locked
     uint32_t              _numFiles;
     int                   _chunk;
@@ -134,6 +134,24 @@ public:
 
     virtual void  unlockAll() = 0;
 
+    //-----------------------------------------------------------------------------
+    //! @brief Start reading a set of tables for a chunk into memory, without
+    //!        locking them, so that a later lock() of them does not wait as
+    //!        long for the disk.
+    //!
+    //! Prefetched files count against the memory available for locking until
+    //! they are locked, unlockAll() is called, or they reach a maximum age
+    //! without being locked, in which case they are counted as wasted. Files
+    //! that do not fit are not prefetched.
+    //!
+    //! @param  tables - Reference to the tables to process.
+    //! @param  chunk  - The chunk number associated with the tables.
+    //!
+    //! @return The number of bytes for which reading was started.
+    //-----------------------------------------------------------------------------
+
+    virtual uint64_t prefetch(std::vector<TableInfo> const& tables, int chunk) = 0;
+
     //-----------------------------------------------------------------------------
     //! @brief Obtain statistics about this memory manager.
     //!
@@ -150,6 +168,15 @@ public:
         uint32_t numFlexLock;  //!< Number  flexible files that were locked
         uint32_t numLocks;     //!< Number of calls to lock()
         uint32_t numErrors;    //!< Number of calls that failed
+        uint64_t bytesPrefetch;//!< Number  bytes of files prefetched
+        uint64_t bytesPrefWaste;//!< Number bytes prefetched but never locked
+        uint32_t numPrefetch;  //!< Number  files prefetched
+        uint32_t numPrefHits;  //!< Number  prefetched files that were locked
+        uint64_t bytesResident;//!< Number  bytes locked by unused files
+        uint64_t bytesResSaved;//!< Number  bytes not read as files were resident
+        uint32_t numResHits;   //!< Number  files found resident when locked
+        uint32_t numResMisses; //!< Number  files that had to be read and locked
+        uint32_t numResEvicts; //!< Number  resident files unlocked for room
     };
 
     virtual Statistics getStatistics() = 0;
@@ -58,6 +58,9 @@ public:
 
     void  unlockAll() override {}
 
+    uint64_t prefetch(std::vector<TableInfo> const& tables, int chunk) override
+                     {(void)tables; (void)chunk; return 0;}
+
     Statistics getStatistics() override {return _myStats;}
 
     Status getStatus(Handle handle) override {(void)handle; return _status;}
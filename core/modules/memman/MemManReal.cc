@@ -25,6 +25,7 @@
 #include "memman/MemManReal.h"
 
 // System Headers
+#include <chrono>
 #include <errno.h>
 #include <mutex>
 #include <string.h>
@@ -40,13 +41,29 @@
   
 namespace {
 
-std::mutex hanMutex;
+// The handle cache is split in shards by handle so that looking up and
+// unlocking different handles does not serialize on a single mutex.
+//
+struct HandleShard {
+    std::mutex mtx;
+    std::unordered_map<lsst::qserv::memman::MemMan::Handle,
+                       lsst::qserv::memman::MemFileSet*> fileSets;
+};
 
-std::unordered_map<lsst::qserv::memman::MemMan::Handle,
-                   lsst::qserv::memman::MemFileSet*> hanCache;
+int const   hanShards = 16;
+HandleShard hanCache[hanShards];
 
-lsst::qserv::memman::MemMan::Handle handleNum
-                             = lsst::qserv::memman::MemMan::HandleType::ISEMPTY;
+HandleShard& shardOf(lsst::qserv::memman::MemMan::Handle handle) {
+    return hanCache[handle % hanShards];
+}
+
+// Reserving memory for file sets is serialized so that each has a predictable
+// view of memory; this mutex is not held while files are being locked.
+//
+std::mutex lockMutex;
+
+std::atomic<lsst::qserv::memman::MemMan::Handle> handleNum
+                            {lsst::qserv::memman::MemMan::HandleType::ISEMPTY};
 }
 
 namespace lsst {
@@ -69,15 +86,31 @@ MemMan::Statistics MemManReal::getStatistics() {
     stats.numLocks     = _numLocks;
     stats.numErrors    = _numErrors;
     stats.numFiles     = MemFile::numFiles();
-    stats.numFiles     = MemFile::numFiles();
 
-    // The following requires a lock
-    //
-    hanMutex.lock();
-    stats.numFSets = hanCache.size();
+    MemFile::ResStats resStats = MemFile::resStats();
+    stats.bytesResident = resStats.bytesResident;
+    stats.bytesResSaved = resStats.bytesSaved;
+    stats.numResHits    = resStats.numHits;
+    stats.numResMisses  = resStats.numMisses;
+    stats.numResEvicts  = resStats.numEvicts;
+
     stats.numReqdFiles = _numReqdFiles;
     stats.numFlexFiles = _numFlexFiles;
-    hanMutex.unlock();
+
+    // The following requires a lock for each shard
+    //
+    stats.numFSets = 0;
+    for (auto& shard : hanCache) {
+        std::lock_guard<std::mutex> guard(shard.mtx);
+        stats.numFSets += shard.fileSets.size();
+    }
+
+    std::lock_guard<std::mutex> guard(_pfMutex);
+    _prefetchExpire();
+    stats.bytesPrefetch  = _pfBytes;
+    stats.bytesPrefWaste = _pfWaste;
+    stats.numPrefetch    = _pfNum;
+    stats.numPrefHits    = _pfHits;
     return stats;
 }
 
@@ -93,14 +126,13 @@ MemMan::Status MemManReal::getStatus(Handle handle) {
     // Once found, get its real status from the file set object.
     //
     if (handle != HandleType::INVALID && handle != HandleType::ISEMPTY) {
-       hanMutex.lock();
-       auto it = hanCache.find(handle);
-       if (it != hanCache.end() && it->second->isOwner(_memory)) {
+       HandleShard& shard = shardOf(handle);
+       std::lock_guard<std::mutex> guard(shard.mtx);
+       auto it = shard.fileSets.find(handle);
+       if (it != shard.fileSets.end() && it->second->isOwner(_memory)) {
           status = it->second->status();
-          hanMutex.unlock();
           return status;
        }
-       hanMutex.unlock();
      }
 
     // Return null status
@@ -152,23 +184,33 @@ MemMan::Handle MemManReal::lock(std::vector<TableInfo> const& tables, int chunk)
         }
      }
 
-    // If we ended with no errors then try to memlock the file set. We do this
-    // with a global mutex to make sure we have a predictable view of memory.
+    // If we ended with no errors then try to memlock the file set. Memory is
+    // reserved with a global mutex to make sure we have a predictable view of
+    // memory. The files are then locked without holding it.
     //
     if (retc == 0) {
-       std::lock_guard<std::mutex> guard(hanMutex);
+       {   std::lock_guard<std::mutex> guard(lockMutex);
+           retc = fileSet->reserveAll();
+       }
+       if (retc == 0) retc = fileSet->lockAll();
 
-       // Lock all required tables and any flexible tables we can. Upon success
-       // (with global lock held) update statistics, generate a file handle,
-       // add it to the handle cache, and return the handle.
+       // Upon success update statistics, generate a file handle, add it to
+       // the handle cache, and return the handle.
        //
-       retc = fileSet->lockAll();
        if (retc == 0) {
           _numReqdFiles += lockNum;
           _numFlexFiles += flexNum;
-          handleNum++;
-          hanCache.insert({handleNum, fileSet});
-          return handleNum;
+          for (auto&& tab : tables) {
+              if (tab.theData  != TableInfo::LockType::NOLOCK)
+                 _prefetchUsed(tab.tableName, chunk, false);
+              if (tab.theIndex != TableInfo::LockType::NOLOCK)
+                 _prefetchUsed(tab.tableName, chunk, true);
+          }
+          Handle handle = ++handleNum;
+          HandleShard& shard = shardOf(handle);
+          std::lock_guard<std::mutex> guard(shard.mtx);
+          shard.fileSets.insert({handle, fileSet});
+          return handle;
        }
     }
 
@@ -180,29 +222,127 @@ MemMan::Handle MemManReal::lock(std::vector<TableInfo> const& tables, int chunk)
     return HandleType::INVALID;
 }
   
+/******************************************************************************/
+/*                              p r e f e t c h                               */
+/******************************************************************************/
+
+uint64_t MemManReal::prefetch(std::vector<TableInfo> const& tables, int chunk) {
+
+    uint64_t bytes = 0;
+
+    // Prefetch the files lock() would lock for the same request
+    //
+    for (auto&& tab : tables) {
+        if (tab.theData  != TableInfo::LockType::NOLOCK)
+           bytes += _prefetch(tab.tableName, chunk, false);
+        if (tab.theIndex != TableInfo::LockType::NOLOCK)
+           bytes += _prefetch(tab.tableName, chunk, true);
+    }
+    return bytes;
+}
+
+uint64_t MemManReal::_prefetch(std::string const& dbTable, int chunk, bool isIndex) {
+
+    std::string fPath(_memory.filePath(dbTable, chunk, isIndex));
+    std::lock_guard<std::mutex> guard(_pfMutex);
+
+    // Prefetches that were never locked stop counting against memory
+    //
+    _prefetchExpire();
+
+    // Nothing to do if the file was already prefetched or is still locked
+    //
+    if (_pfFiles.count(fPath) != 0) return 0;
+    if (MemFile::isLocked(fPath)) return 0;
+
+    // Prefetched files count against the memory left for locking. Resident
+    // files do not as they are evicted when the memory is needed.
+    //
+    uint64_t bytesUsed = _memory.bytesLocked() + _memory.bytesReserved()
+                       + _pfPending;
+    uint64_t bytesRes  = MemFile::resStats().bytesResident;
+    bytesUsed = (bytesUsed > bytesRes ? bytesUsed - bytesRes : 0);
+    if (bytesUsed >= _memory.bytesMax()) return 0;
+    MemInfo mInfo = _memory.prefetch(fPath, _memory.bytesMax() - bytesUsed);
+    if (!mInfo.isValid()) return 0;
+
+    // Remember it until it is locked or expires
+    //
+    _pfFiles[fPath] = PfFile{mInfo.size(), std::chrono::steady_clock::now()};
+    _pfPending += mInfo.size();
+    _pfBytes   += mInfo.size();
+    _pfNum++;
+    return mInfo.size();
+}
+
+/******************************************************************************/
+/*                       p r e f e t c h E x p i r e                          */
+/******************************************************************************/
+
+// Must be called with _pfMutex held.
+//
+void MemManReal::_prefetchExpire() {
+
+    // A file prefetched longer ago than the maximum age was not locked by
+    // the scan it was read for (it skipped the chunk or was cancelled) and
+    // its pages may well have been reclaimed; count it as wasted.
+    //
+    auto oldest = std::chrono::steady_clock::now() - _pfMaxAge;
+    auto it = _pfFiles.begin();
+    while (it != _pfFiles.end()) {
+        if (it->second.when < oldest) {
+            _pfWaste   += it->second.bytes;
+            _pfPending -= it->second.bytes;
+            it = _pfFiles.erase(it);
+        } else it++;
+    }
+}
+
+/******************************************************************************/
+/*                         p r e f e t c h U s e d                            */
+/******************************************************************************/
+
+void MemManReal::_prefetchUsed(std::string const& dbTable, int chunk, bool isIndex) {
+
+    std::string fPath(_memory.filePath(dbTable, chunk, isIndex));
+    std::lock_guard<std::mutex> guard(_pfMutex);
+    _prefetchExpire();
+
+    // Count the hit, if this file was prefetched. Other prefetched files are
+    // left alone; several scans may read the same table in any chunk order.
+    //
+    auto it = _pfFiles.find(fPath);
+    if (it == _pfFiles.end()) return;
+    _pfHits++;
+    _pfPending -= it->second.bytes;
+    _pfFiles.erase(it);
+}
+
 /******************************************************************************/
 /*                                u n l o c k                                 */
 /******************************************************************************/
 
 bool MemManReal::unlock(Handle handle) {
 
-    std::lock_guard<std::mutex> guard(hanMutex);
-
     // If this is a nill handle, then we need not do anything more. If this is
     // a bad handle, return failure.
     //
     if (handle == HandleType::ISEMPTY) return true;
     if (handle == HandleType::INVALID) return false;
 
-    // Find the table set in the set cache
+    // Find the table set in the set cache and remove it from the map
     //
-    auto it = hanCache.find(handle);
-    if (it == hanCache.end() || !(it->second->isOwner(_memory))) return false;
-
-    // Delete the file set and remove it from the map
+    HandleShard& shard = shardOf(handle);
+    std::unique_lock<std::mutex> guard(shard.mtx);
+    auto it = shard.fileSets.find(handle);
+    if (it == shard.fileSets.end() || !(it->second->isOwner(_memory))) return false;
+    MemFileSet* fileSet = it->second;
+    shard.fileSets.erase(it);
+    guard.unlock();
+
+    // Delete the file set outside of the lock
     //
-    delete it->second;
-    hanCache.erase(it);
+    delete fileSet;
     return true;
 }
 
@@ -212,19 +352,43 @@ bool MemManReal::unlock(Handle handle) {
   
 void MemManReal::unlockAll() {
 
-    std::lock_guard<std::mutex> guard(hanMutex);
+    std::lock_guard<std::mutex> lockGuard(lockMutex);
 
     // Delete all of the file set entries that we own via handle cache. The
     // file set destructor will unlock any memory that it needs to unlock.
     //
-    auto it = hanCache.begin();
-
-    while(it != hanCache.end()) {
-         if (it->second->isOwner(_memory)) {
-            delete it->second;
-            it = hanCache.erase(it);
-         } else it++;
+    for (auto& shard : hanCache) {
+        std::lock_guard<std::mutex> guard(shard.mtx);
+        auto it = shard.fileSets.begin();
+
+        while(it != shard.fileSets.end()) {
+             if (it->second->isOwner(_memory)) {
+                delete it->second;
+                it = shard.fileSets.erase(it);
+             } else it++;
+        }
     }
+
+    // Files left locked for reuse must be unlocked as well
+    //
+    MemFile::flushResident(_memory);
+
+    // Pending prefetches will not be locked by these handles; forget them
+    //
+    std::lock_guard<std::mutex> pfGuard(_pfMutex);
+    for (auto&& pf : _pfFiles) _pfWaste += pf.second.bytes;
+    _pfFiles.clear();
+    _pfPending = 0;
+}
+
+/******************************************************************************/
+/*                      s e t P r e f e t c h M a x A g e                     */
+/******************************************************************************/
+
+void MemManReal::setPrefetchMaxAge(std::chrono::milliseconds maxAge) {
+
+    std::lock_guard<std::mutex> guard(_pfMutex);
+    _pfMaxAge = maxAge;
 }
 }}} // namespace lsst:qserv:memman
 
@@ -26,7 +26,9 @@
 
 // System headers
 #include <atomic>
+#include <chrono>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 
 // Qserv Headers
@@ -50,10 +52,21 @@ public:
 
     void   unlockAll() override;
 
+    uint64_t prefetch(std::vector<TableInfo> const& tables, int chunk) override;
+
     Statistics getStatistics() override;
 
     Status     getStatus(Handle handle) override;
 
+    //-----------------------------------------------------------------------------
+    //! @brief Set how long a prefetched file may go unlocked before it is
+    //!        counted as wasted and no longer counts against memory.
+    //!
+    //! @param  maxAge - The maximum age (default 5 minutes).
+    //-----------------------------------------------------------------------------
+
+    void       setPrefetchMaxAge(std::chrono::milliseconds maxAge);
+
     MemManReal & operator=(const MemManReal&) = delete;
     MemManReal(const MemManReal&) = delete;
 
@@ -65,11 +78,30 @@ public:
 
 private:
 
+    uint64_t _prefetch(std::string const& dbTable, int chunk, bool isIndex);
+    void     _prefetchExpire();
+    void     _prefetchUsed(std::string const& dbTable, int chunk, bool isIndex);
+
     Memory           _memory;
     std::atomic_uint _numLocks;
     std::atomic_uint _numErrors;
-    uint32_t         _numReqdFiles;  // Under control of hanMutex
-    uint32_t         _numFlexFiles;  // Ditto
+    std::atomic_uint _numReqdFiles;
+    std::atomic_uint _numFlexFiles;
+
+    // Prefetched files not locked yet, by file path, with their sizes and
+    // when they were prefetched.
+    struct PfFile {
+        uint64_t bytes;
+        std::chrono::steady_clock::time_point when;
+    };
+    std::mutex       _pfMutex;
+    std::unordered_map<std::string, PfFile> _pfFiles; // Under _pfMutex
+    std::chrono::milliseconds _pfMaxAge{300000};      // Ditto
+    uint64_t         _pfPending = 0; // Bytes in _pfFiles, ditto
+    uint64_t         _pfBytes   = 0; // Ditto
+    uint64_t         _pfWaste   = 0; // Ditto
+    uint32_t         _pfNum     = 0; // Ditto
+    uint32_t         _pfHits    = 0; // Ditto
 };
 
 }}} // namespace lsst:qserv:memman
@@ -61,6 +61,27 @@ MemInfo Memory::fileInfo(std::string const& fPath) {
     return fInfo;
 }
 
+/******************************************************************************/
+/*                                f i l e I d                                 */
+/******************************************************************************/
+
+Memory::FileId Memory::fileId(std::string const& fPath) {
+
+    FileId      fId;
+    struct stat sBuff;
+
+    // A re-created file has a new inode, a rewritten one a new mtime
+    //
+    if (stat(fPath.c_str(), &sBuff) == 0) {
+        fId.dev   = static_cast<uint64_t>(sBuff.st_dev);
+        fId.ino   = static_cast<uint64_t>(sBuff.st_ino);
+        fId.mtime = static_cast<int64_t>(sBuff.st_mtim.tv_sec) * 1000000000
+                  + sBuff.st_mtim.tv_nsec;
+        fId.size  = static_cast<uint64_t>(sBuff.st_size);
+    }
+    return fId;
+}
+
 /******************************************************************************/
 /*                              f i l e P a t h                               */
 /******************************************************************************/
@@ -138,6 +159,53 @@ MemInfo Memory::memLock(std::string const& fPath, bool isFlex) {
     return mInfo;
 }
 
+/******************************************************************************/
+/*                               p r e f e t c h                              */
+/******************************************************************************/
+
+MemInfo Memory::prefetch(std::string const& fPath, uint64_t maxBytes) {
+
+    MemInfo     mInfo;
+    struct stat sBuff;
+    int         fdNum, rc;
+
+    // Open the file read only, it is never mapped.
+    //
+    fdNum = open(fPath.c_str(), O_RDONLY);
+    if (fdNum < 0 || fstat(fdNum, &sBuff)) {
+        mInfo.setErrCode(errno);
+        if (fdNum >= 0) close(fdNum);
+        return mInfo;
+    }
+
+    // Verify the size of the file and that it fits
+    //
+    if (sBuff.st_size <= 0) {
+        close(fdNum);
+        mInfo.setErrCode(ESPIPE);
+        return mInfo;
+    }
+    if (static_cast<uint64_t>(sBuff.st_size) > maxBytes) {
+        close(fdNum);
+        mInfo.setErrCode(ENOMEM);
+        return mInfo;
+    }
+
+    // Have the kernel read the file in the background
+    //
+    rc = posix_fadvise(fdNum, 0, sBuff.st_size, POSIX_FADV_WILLNEED);
+    if (rc) {
+        mInfo.setErrCode(rc);
+    } else {
+        mInfo._memSize = static_cast<uint64_t>(sBuff.st_size);
+    }
+
+    // Close the file and return result
+    //
+    close(fdNum);
+    return mInfo;
+}
+
 /******************************************************************************/
 /*                                m e m R e l                                 */
 /******************************************************************************/
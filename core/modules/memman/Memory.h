@@ -107,6 +107,14 @@ public:
 
     uint64_t bytesMax() {return _maxBytes;}
 
+    //-----------------------------------------------------------------------------
+    //! Obtain number of bytes reserved for files that are being locked.
+    //!
+    //! @return The number of bytes reserved.
+    //-----------------------------------------------------------------------------
+
+    uint64_t bytesReserved() {return _resBytes;}
+
     //-----------------------------------------------------------------------------
     //! @brief Get file information.
     //!
@@ -118,6 +126,29 @@ public:
 
     MemInfo fileInfo(std::string const& fPath);
 
+    //-----------------------------------------------------------------------------
+    //! @brief Identify the current version of a file so that a locked copy
+    //!        of a file that was re-created or rewritten since can be told.
+    //!
+    //! @param  fPath - File path for which the identity is obtained.
+    //!
+    //! @return The file identity. It is all zero if the file cannot be found.
+    //-----------------------------------------------------------------------------
+
+    struct FileId {
+        uint64_t dev   = 0;
+        uint64_t ino   = 0;
+        int64_t  mtime = 0; //!< Nanoseconds
+        uint64_t size  = 0;
+        bool operator==(FileId const& other) const {
+            return dev == other.dev && ino == other.ino
+                && mtime == other.mtime && size == other.size;
+        }
+        bool operator!=(FileId const& other) const {return !(*this == other);}
+    };
+
+    FileId  fileId(std::string const& fPath);
+
     //-----------------------------------------------------------------------------
     //! @brief Generate a file path given directory, a table name and chunk.
     //!
@@ -157,6 +188,19 @@ public:
 
     MemInfo memLock(std::string const& fPath, bool isFlex=false);
 
+    //-----------------------------------------------------------------------------
+    //! @brief Start reading a database file into the file system cache. This
+    //!        does not wait for the read and nothing is locked.
+    //!
+    //! @param  fPath    - Path of the database file to be read.
+    //! @param  maxBytes - Maximum file size for reading the file.
+    //!
+    //! @return A MemInfo object corresponding to the file. Use the MemInfo
+    //!         methods to determine if reading the file was started.
+    //-----------------------------------------------------------------------------
+
+    MemInfo prefetch(std::string const& fPath, uint64_t maxBytes);
+
     //-----------------------------------------------------------------------------
     //! @brief Unlock a memory object.
     //!
@@ -165,6 +209,16 @@ public:
 
     void    memRel(MemInfo& mInfo);
 
+    //-----------------------------------------------------------------------------
+    //! @brief Reserve memory for a file that is about to be locked, or give
+    //!        back the reservation once it is locked or not.
+    //!
+    //! @param  bytes   - Number of bytes to reserve or give back.
+    //-----------------------------------------------------------------------------
+
+    void    reserve(uint64_t bytes)   {_resBytes += bytes;}
+    void    unreserve(uint64_t bytes) {_resBytes -= bytes;}
+
     //-----------------------------------------------------------------------------
     //! Constructor
     //!
@@ -173,7 +227,8 @@ public:
     //-----------------------------------------------------------------------------
 
     Memory(std::string const& dbDir, uint64_t memSZ)
-          : _dbDir(dbDir), _maxBytes(memSZ), _lokBytes(0), _flexNum(0) {}
+          : _dbDir(dbDir), _maxBytes(memSZ), _lokBytes(0), _resBytes(0),
+            _flexNum(0) {}
 
     ~Memory() {}
 
@@ -182,6 +237,7 @@ private:
     std::string        _dbDir;
     uint64_t           _maxBytes;
     std::atomic_ullong _lokBytes;
+    std::atomic_ullong _resBytes;
     std::atomic_uint   _flexNum;
 };
 }}} // namespace lsst:qserv:memman
@@ -0,0 +1,154 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+/**
+  * @file
+  *
+  * @brief Stress benchmark for concurrent memory manager lock and unlock.
+  *
+  * Creates a scratch database directory with one small table file per chunk
+  * and has several threads lock and unlock random chunks through MemManReal,
+  * as scan schedulers and finishing tasks do on a worker. Reports the rate
+  * of lock/unlock pairs for increasing thread counts, and checks that every
+  * handle could be unlocked and that all memory is unlocked at the end.
+  * Locking needs RLIMIT_MEMLOCK to allow the memory; failed locks are counted.
+  * Timings are not meaningful as a unit test.
+  *
+  * Usage: testMemManBench [maxThreads [chunks [kilobytes [seconds]]]]
+  */
+
+// System headers
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Qserv headers
+#include "memman/MemManReal.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+using lsst::qserv::memman::MemMan;
+using lsst::qserv::memman::MemManReal;
+using lsst::qserv::memman::TableInfo;
+
+struct Result {
+    uint64_t pairs = 0;
+    uint64_t failed = 0;
+    uint64_t badUnlock = 0;
+};
+
+/// Have nThreads threads lock and unlock random chunks for the given time.
+Result run(MemMan& memMan, int nThreads, int chunks, double seconds) {
+    std::vector<TableInfo> tables{TableInfo("bench.Object")};
+    std::atomic<uint64_t> pairs{0}, failed{0}, badUnlock{0};
+    auto end = Clock::now() + std::chrono::duration<double>(seconds);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 gen(t);
+            std::uniform_int_distribution<int> chunk(0, chunks - 1);
+            uint64_t n = 0, nFailed = 0, nBad = 0;
+            while (Clock::now() < end) {
+                MemMan::Handle h = memMan.lock(tables, chunk(gen));
+                if (h == MemMan::HandleType::INVALID) {
+                    ++nFailed;
+                    continue;
+                }
+                memMan.getStatus(h);
+                if (!memMan.unlock(h)) ++nBad;
+                ++n;
+            }
+            pairs += n;
+            failed += nFailed;
+            badUnlock += nBad;
+        });
+    }
+    for (auto& thrd : threads) thrd.join();
+    Result result;
+    result.pairs = pairs;
+    result.failed = failed;
+    result.badUnlock = badUnlock;
+    return result;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    int maxThreads = argc > 1 ? std::atoi(argv[1]) : 64;
+    int chunks = argc > 2 ? std::atoi(argv[2]) : 256;
+    size_t kb = argc > 3 ? std::atoi(argv[3]) : 64;
+    double seconds = argc > 4 ? std::atof(argv[4]) : 2.0;
+
+    // Table files are named as Memory::filePath() expects.
+    char dirTemplate[] = "/tmp/testMemManBench.XXXXXX";
+    char* dir = mkdtemp(dirTemplate);
+    if (dir == nullptr) {
+        std::cerr << "Unable to create scratch directory" << std::endl;
+        return 1;
+    }
+    std::string data(kb * 1024, 'x');
+    std::vector<std::string> files;
+    for (int c = 0; c < chunks; ++c) {
+        files.push_back(std::string(dir) + "/bench.Object_" + std::to_string(c) + ".MYD");
+        std::ofstream(files.back()) << data;
+    }
+
+    // Only half of the chunks fit, so resident files get evicted as well.
+    uint64_t maxBytes = static_cast<uint64_t>(chunks) * kb * 1024 / 2;
+    int status = 0;
+    std::cout << "lock/unlock pairs per second, " << chunks << " chunks of "
+              << kb << "KB, memory for half of them" << std::endl;
+    for (int nThreads = 1; nThreads <= maxThreads; nThreads *= 4) {
+        MemManReal memMan(dir, maxBytes);
+        MemMan::Statistics s0 = memMan.getStatistics(); // Residency counts are global
+        Result r = run(memMan, nThreads, chunks, seconds);
+        MemMan::Statistics s = memMan.getStatistics();
+        std::cout << nThreads << " threads: " << r.pairs / seconds << " /s"
+                  << " failed=" << r.failed
+                  << " resident hits=" << s.numResHits - s0.numResHits
+                  << " misses=" << s.numResMisses - s0.numResMisses
+                  << " evicts=" << s.numResEvicts - s0.numResEvicts << std::endl;
+        if (r.badUnlock != 0 || s.numFSets != 0) {
+            std::cout << "ERROR: unlock failures=" << r.badUnlock
+                      << " file sets left=" << s.numFSets << std::endl;
+            status = 1;
+        }
+        memMan.unlockAll();
+        if (memMan.getStatistics().bytesLocked != 0) {
+            std::cout << "ERROR: memory still locked" << std::endl;
+            status = 1;
+        }
+    }
+
+    for (auto const& f : files) unlink(f.c_str());
+    rmdir(dir);
+    return status;
+}
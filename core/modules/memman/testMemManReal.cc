@@ -0,0 +1,251 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+/**
+  * @file
+  *
+  * @brief Test MemManReal over table files in a scratch directory.
+  *
+  * Files are small so that locking them stays within the default
+  * RLIMIT_MEMLOCK.
+  */
+
+// System headers
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Qserv headers
+#include "memman/MemManReal.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE MemManReal
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+using lsst::qserv::memman::MemMan;
+using lsst::qserv::memman::MemManReal;
+using lsst::qserv::memman::TableInfo;
+
+namespace {
+
+uint64_t const fileBytes = 64 * 1024;
+int const      numChunks = 8;
+
+/// Scratch database directory with one table file per chunk, named as
+/// Memory::filePath() expects.
+struct Fixture {
+    Fixture() {
+        char dirTemplate[] = "/tmp/testMemManReal.XXXXXX";
+        if (mkdtemp(dirTemplate) == nullptr) {
+            throw std::runtime_error("Unable to create scratch directory");
+        }
+        dir = dirTemplate;
+        for (int c = 0; c < numChunks; ++c) writeFile(c);
+    }
+
+    ~Fixture() {
+        for (int c = 0; c < numChunks; ++c) unlink(path(c).c_str());
+        rmdir(dir.c_str());
+    }
+
+    std::string path(int chunk) const {
+        return dir + "/test.Object_" + std::to_string(chunk) + ".MYD";
+    }
+
+    void writeFile(int chunk) const {
+        std::ofstream(path(chunk)) << std::string(fileBytes, 'x');
+    }
+
+    std::string dir;
+    std::vector<TableInfo> tables{TableInfo("test.Object")};
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(Suite, Fixture)
+
+BOOST_AUTO_TEST_CASE(PrefetchHit) {
+    MemManReal memMan(dir, 4 * fileBytes);
+    BOOST_CHECK_EQUAL(memMan.prefetch(tables, 1), fileBytes);
+    BOOST_CHECK_EQUAL(memMan.prefetch(tables, 1), 0U); // Already pending
+    MemMan::Handle h = memMan.lock(tables, 1);
+    BOOST_REQUIRE(h != MemMan::HandleType::INVALID);
+    MemMan::Statistics s = memMan.getStatistics();
+    BOOST_CHECK_EQUAL(s.numPrefetch, 1U);
+    BOOST_CHECK_EQUAL(s.numPrefHits, 1U);
+    BOOST_CHECK_EQUAL(s.bytesPrefetch, fileBytes);
+    BOOST_CHECK_EQUAL(s.bytesPrefWaste, 0U);
+    BOOST_CHECK(memMan.unlock(h));
+}
+
+BOOST_AUTO_TEST_CASE(PrefetchAnyOrder) {
+    // A scan wrapping around, or two scans of the same table, lock chunks
+    // out of order; a lower chunk locked later is still a hit.
+    MemManReal memMan(dir, 4 * fileBytes);
+    BOOST_CHECK_EQUAL(memMan.prefetch(tables, 6), fileBytes);
+    BOOST_CHECK_EQUAL(memMan.prefetch(tables, 2), fileBytes);
+    MemMan::Handle h6 = memMan.lock(tables, 6);
+    MemMan::Handle h2 = memMan.lock(tables, 2);
+    BOOST_REQUIRE(h6 != MemMan::HandleType::INVALID);
+    BOOST_REQUIRE(h2 != MemMan::HandleType::INVALID);
+    MemMan::Statistics s = memMan.getStatistics();
+    BOOST_CHECK_EQUAL(s.numPrefHits, 2U);
+    BOOST_CHECK_EQUAL(s.bytesPrefWaste, 0U);
+    memMan.unlockAll();
+}
+
+BOOST_AUTO_TEST_CASE(PrefetchExpires) {
+    // Room for one pending prefetch only
+    MemManReal memMan(dir, fileBytes);
+    BOOST_CHECK_EQUAL(memMan.prefetch(tables, 3), fileBytes);
+    BOOST_CHECK_EQUAL(memMan.prefetch(tables, 4), 0U);
+
+    // Once chunk 3 is too old it no longer holds the memory
+    memMan.setPrefetchMaxAge(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    BOOST_CHECK_EQUAL(memMan.getStatistics().bytesPrefWaste, fileBytes);
+    BOOST_CHECK_EQUAL(memMan.prefetch(tables, 4), fileBytes);
+
+    // Locking an expired file is not a hit
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    MemMan::Handle h = memMan.lock(tables, 4);
+    BOOST_REQUIRE(h != MemMan::HandleType::INVALID);
+    MemMan::Statistics s = memMan.getStatistics();
+    BOOST_CHECK_EQUAL(s.numPrefHits, 0U);
+    BOOST_CHECK_EQUAL(s.bytesPrefWaste, 2 * fileBytes);
+    memMan.unlockAll();
+}
+
+BOOST_AUTO_TEST_CASE(UnlockAllDropsPrefetch) {
+    MemManReal memMan(dir, fileBytes);
+    BOOST_CHECK_EQUAL(memMan.prefetch(tables, 5), fileBytes);
+    memMan.unlockAll();
+    BOOST_CHECK_EQUAL(memMan.getStatistics().bytesPrefWaste, fileBytes);
+    BOOST_CHECK_EQUAL(memMan.prefetch(tables, 7), fileBytes);
+    memMan.unlockAll();
+}
+
+BOOST_AUTO_TEST_CASE(ResidentHit) {
+    // Residency counts are global, so only their changes are checked
+    MemManReal memMan(dir, 4 * fileBytes);
+    MemMan::Statistics s0 = memMan.getStatistics();
+    BOOST_CHECK(memMan.unlock(memMan.lock(tables, 1)));
+    MemMan::Statistics s1 = memMan.getStatistics();
+    BOOST_CHECK_EQUAL(s1.bytesLocked, fileBytes);
+    BOOST_CHECK_EQUAL(s1.bytesResident - s0.bytesResident, fileBytes);
+    BOOST_CHECK_EQUAL(s1.numResMisses - s0.numResMisses, 1U);
+
+    MemMan::Handle h = memMan.lock(tables, 1);
+    BOOST_REQUIRE(h != MemMan::HandleType::INVALID);
+    MemMan::Statistics s2 = memMan.getStatistics();
+    BOOST_CHECK_EQUAL(s2.bytesLocked, fileBytes);
+    BOOST_CHECK_EQUAL(s2.bytesResident, s0.bytesResident);
+    BOOST_CHECK_EQUAL(s2.bytesResSaved - s0.bytesResSaved, fileBytes);
+    BOOST_CHECK_EQUAL(s2.numResHits - s0.numResHits, 1U);
+    BOOST_CHECK_EQUAL(s2.numResMisses - s0.numResMisses, 1U);
+    BOOST_CHECK(memMan.unlock(h));
+}
+
+BOOST_AUTO_TEST_CASE(EvictByScanDistance) {
+    MemManReal memMan(dir, 3 * fileBytes);
+    for (int c : {1, 2, 3}) BOOST_CHECK(memMan.unlock(memMan.lock(tables, c)));
+    MemMan::Statistics s0 = memMan.getStatistics();
+
+    // The scan is now at chunk 4; of the resident files it gets back to
+    // chunk 3 last, so that one makes room.
+    MemMan::Handle h = memMan.lock(tables, 4);
+    BOOST_REQUIRE(h != MemMan::HandleType::INVALID);
+    MemMan::Statistics s1 = memMan.getStatistics();
+    BOOST_CHECK_EQUAL(s1.numResEvicts - s0.numResEvicts, 1U);
+    BOOST_CHECK_EQUAL(s1.bytesLocked, 3 * fileBytes);
+    BOOST_CHECK(memMan.unlock(h));
+
+    for (int c : {1, 2}) BOOST_CHECK(memMan.unlock(memMan.lock(tables, c)));
+    MemMan::Statistics s2 = memMan.getStatistics();
+    BOOST_CHECK_EQUAL(s2.numResHits - s1.numResHits, 2U);
+    BOOST_CHECK_EQUAL(s2.numResMisses, s1.numResMisses);
+}
+
+BOOST_AUTO_TEST_CASE(FlexibleNoEvict) {
+    MemManReal memMan(dir, 2 * fileBytes);
+    for (int c : {1, 2}) BOOST_CHECK(memMan.unlock(memMan.lock(tables, c)));
+    MemMan::Statistics s0 = memMan.getStatistics();
+
+    // A flexible file is only locked if there is room to spare
+    std::vector<TableInfo> flexTables{TableInfo("test.Object", TableInfo::LockType::FLEXIBLE)};
+    MemMan::Handle h = memMan.lock(flexTables, 3);
+    BOOST_REQUIRE(h != MemMan::HandleType::INVALID);
+    MemMan::Statistics s1 = memMan.getStatistics();
+    BOOST_CHECK_EQUAL(s1.numResEvicts, s0.numResEvicts);
+    BOOST_CHECK_EQUAL(s1.numFlexLock, s0.numFlexLock);
+    BOOST_CHECK_EQUAL(s1.bytesResident, s0.bytesResident);
+    BOOST_CHECK(memMan.unlock(h));
+}
+
+BOOST_AUTO_TEST_CASE(UnlockAllFlushesResident) {
+    MemManReal memMan(dir, 4 * fileBytes);
+    MemMan::Statistics s0 = memMan.getStatistics();
+    for (int c : {1, 2}) BOOST_CHECK(memMan.unlock(memMan.lock(tables, c)));
+    MemMan::Statistics s1 = memMan.getStatistics();
+    BOOST_CHECK_EQUAL(s1.bytesResident - s0.bytesResident, 2 * fileBytes);
+    BOOST_CHECK_EQUAL(s1.bytesLocked, 2 * fileBytes);
+    BOOST_CHECK_EQUAL(s1.numFiles - s0.numFiles, 2U);
+
+    memMan.unlockAll();
+    MemMan::Statistics s2 = memMan.getStatistics();
+    BOOST_CHECK_EQUAL(s2.bytesResident, s0.bytesResident);
+    BOOST_CHECK_EQUAL(s2.bytesLocked, 0U);
+    BOOST_CHECK_EQUAL(s2.numFiles, s0.numFiles);
+}
+
+BOOST_AUTO_TEST_CASE(ReplacedFileNotReused) {
+    MemManReal memMan(dir, 4 * fileBytes);
+    BOOST_CHECK(memMan.unlock(memMan.lock(tables, 1)));
+
+    // Re-create the table file; the resident copy maps the old one
+    unlink(path(1).c_str());
+    writeFile(1);
+    MemMan::Statistics s0 = memMan.getStatistics();
+    MemMan::Handle h = memMan.lock(tables, 1);
+    BOOST_REQUIRE(h != MemMan::HandleType::INVALID);
+    MemMan::Statistics s1 = memMan.getStatistics();
+    BOOST_CHECK_EQUAL(s1.numResHits, s0.numResHits);
+    BOOST_CHECK_EQUAL(s1.numResMisses - s0.numResMisses, 1U);
+    BOOST_CHECK_EQUAL(s1.bytesResident - (s0.bytesResident - fileBytes), 0U);
+    BOOST_CHECK_EQUAL(s1.bytesLocked, fileBytes);
+    BOOST_CHECK(memMan.unlock(h));
+
+    // An unchanged file is still reused
+    h = memMan.lock(tables, 1);
+    BOOST_REQUIRE(h != MemMan::HandleType::INVALID);
+    BOOST_CHECK_EQUAL(memMan.getStatistics().numResHits - s1.numResHits, 1U);
+    BOOST_CHECK(memMan.unlock(h));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
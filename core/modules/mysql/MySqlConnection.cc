@@ -73,6 +73,7 @@ namespace mysql {
 MySqlConnection::MySqlConnection()
     : _mysql(nullptr),
       _mysql_res(nullptr),
+      _mysql_stmt(nullptr),
       _isConnected(false),
       _isExecuting(false),
       _interrupted(false) {
@@ -81,6 +82,7 @@ MySqlConnection::MySqlConnection()
 MySqlConnection::MySqlConnection(MySqlConfig const& sqlConfig)
     : _mysql(nullptr),
       _mysql_res(nullptr),
+      _mysql_stmt(nullptr),
       _isConnected(false),
       _sqlConfig(std::make_shared<MySqlConfig>(sqlConfig)),
       _isExecuting(false),
@@ -94,6 +96,7 @@ MySqlConnection::~MySqlConnection() {
             while((row = mysql_fetch_row(_mysql_res))); // Drain results.
             _mysql_res = nullptr;
         }
+        freeStatement();
         mysql_close(_mysql);
     }
 }
@@ -109,6 +112,30 @@ MySqlConnection::connect() {
     return _isConnected;
 }
 
+bool
+MySqlConnection::ping() {
+    return _mysql && mysql_ping(_mysql) == 0;
+}
+
+bool
+MySqlConnection::resetSession() {
+    if (!_mysql || _mysql_res || _mysql_stmt) {
+        return false; // Pending rows would be lost.
+    }
+    // mysql_change_user resets all session state, and works with client
+    // libraries older than mysql_reset_connection.
+    if (mysql_change_user(_mysql,
+                          _sqlConfig->username.empty() ? 0 : _sqlConfig->username.c_str(),
+                          _sqlConfig->password.empty() ? 0 : _sqlConfig->password.c_str(),
+                          _sqlConfig->dbName.empty() ? 0 : _sqlConfig->dbName.c_str())) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(_interruptMutex);
+    _isExecuting = false;
+    _interrupted = false;
+    return true;
+}
+
 bool
 MySqlConnection::queryUnbuffered(std::string const& query) {
     // run query, store into list.
@@ -126,6 +153,40 @@ MySqlConnection::queryUnbuffered(std::string const& query) {
     return true;
 }
 
+bool
+MySqlConnection::prepareStatement(std::string const& query) {
+    freeStatement();
+    _mysql_stmt = mysql_stmt_init(_mysql);
+    if (!_mysql_stmt) { return false; }
+    if (mysql_stmt_prepare(_mysql_stmt, query.c_str(), query.length())) {
+        freeStatement();
+        return false;
+    }
+    return true;
+}
+
+bool
+MySqlConnection::executeStatement() {
+    int rc;
+    {
+        std::lock_guard<std::mutex> lock(_interruptMutex);
+        _isExecuting = true;
+        _interrupted = false;
+    }
+    rc = mysql_stmt_execute(_mysql_stmt);
+    _isExecuting = false;
+    return rc == 0;
+}
+
+/// Close the prepared statement, discarding any rows not fetched.
+void
+MySqlConnection::freeStatement() {
+    if (_mysql_stmt) {
+        mysql_stmt_close(_mysql_stmt);
+        _mysql_stmt = nullptr;
+    }
+}
+
 /// Cancel existing query
 /// @return 0 on success.
 /// 1 indicates error in connecting. (may try again)
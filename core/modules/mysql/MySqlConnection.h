@@ -58,6 +58,12 @@ public:
     bool connect();
 
     bool connected() const { return _isConnected; }
+    /// @return true if the server still answers on this connection
+    bool ping();
+    /// Reset the session to its state just after connect(): roll back any
+    /// transaction, drop temporary tables and user variables, and select the
+    /// configured database again.
+    bool resetSession();
     // instance destruction invalidates this return value
     MYSQL* getMySql() { return _mysql;}
     MySqlConfig const& getMySqlConfig() const { return *_sqlConfig; }
@@ -67,6 +73,21 @@ public:
 
     MYSQL_RES* getResult() { return _mysql_res; }
     void freeResult() { mysql_free_result(_mysql_res); _mysql_res = nullptr; }
+
+    /// Prepare query as a server-side statement, whose rows are then sent in
+    /// the binary protocol. Not all statements can be prepared.
+    bool prepareStatement(std::string const& query);
+    /// Execute the prepared statement, leaving its rows to be fetched
+    /// unbuffered (see StatementResult).
+    bool executeStatement();
+    MYSQL_STMT* getStatement() { return _mysql_stmt; }
+    void freeStatement();
+    unsigned int getStatementErrno() const { return mysql_stmt_errno(_mysql_stmt); }
+    std::string getStatementError() const { return std::string(mysql_stmt_error(_mysql_stmt)); }
+    /// @return the number of result columns of the prepared statement, 0 if
+    /// it produces no result set
+    unsigned int getStatementFieldCount() const { return mysql_stmt_field_count(_mysql_stmt); }
+
     int getResultFieldCount() {
         assert(_mysql);
         return mysql_field_count(_mysql);
@@ -83,9 +104,10 @@ private:
 
     MYSQL* _mysql;
     MYSQL_RES* _mysql_res;
+    MYSQL_STMT* _mysql_stmt;
     bool _isConnected;
     std::shared_ptr<MySqlConfig> _sqlConfig;
-    bool _isExecuting; ///< true during mysql_real_query and mysql_use_result
+    bool _isExecuting; ///< true during mysql_real_query, mysql_use_result and mysql_stmt_execute
     bool _interrupted; ///< true if cancellation requested
     std::mutex _interruptMutex;
 };
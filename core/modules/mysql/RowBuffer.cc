@@ -35,6 +35,7 @@
 #include <mysql/mysql.h>
 
 // Qserv headers
+#include "mysql/escapeString.h"
 #include "mysql/LocalInfileError.h"
 #include "proto/worker.pb.h"
 #include "sql/Schema.h"
@@ -66,28 +67,6 @@ inline int addString(char* cursor, std::string const& s) {
     return sSize;
 }
 
-inline int escapeString(char* dest, char const* src, int srcLength) {
-    //mysql_real_escape_string(_mysql, cursor, col, r.lengths[i]);
-    assert(srcLength >= 0);
-    assert(srcLength < std::numeric_limits<int>::max() / 2);
-    char const* end = src + srcLength;
-    char const * originalSrc = src;
-    while(src != end) {
-        switch(*src) {
-        case '\0': *dest++ = '\\'; *dest++ = '0'; break;
-        case '\b': *dest++ = '\\'; *dest++ = 'b'; break;
-        case '\n': *dest++ = '\\'; *dest++ = 'n'; break;
-        case '\r': *dest++ = '\\'; *dest++ = 'r'; break;
-        case '\t': *dest++ = '\\'; *dest++ = 't'; break;
-        case '\032': *dest++ = '\\'; *dest++ = 'Z'; break;
-        default: *dest++ = *src; break;
-            // Null (\N) is not treated by escaping in this context.
-        }
-        ++src;
-    }
-    return src - originalSrc;
-}
-
 inline int maxColFootprint(int columnLength, std::string const& sep) {
     const int overhead = 2 + sep.size(); // NULL decl + sep size
     return overhead + (2 * columnLength);
@@ -0,0 +1,163 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "mysql/StatementResult.h"
+
+// System headers
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/// Initial size of text buffers. Longer values are fetched again into a
+/// larger buffer.
+unsigned long const TEXT_BUFFER_SIZE = 1024;
+
+} // anonymous namespace
+
+namespace lsst {
+namespace qserv {
+namespace mysql {
+
+StatementResult::StatementResult(MYSQL_STMT* stmt)
+    : _stmt(stmt), _metadata(mysql_stmt_result_metadata(stmt)) {
+    if (_metadata) {
+        _bind();
+    }
+}
+
+StatementResult::~StatementResult() {
+    if (_metadata) {
+        mysql_free_result(_metadata);
+    }
+}
+
+void StatementResult::_bind() {
+    unsigned int const count = mysql_num_fields(_metadata);
+    MYSQL_FIELD const* fields = mysql_fetch_fields(_metadata);
+    _columns.resize(count);
+    _binds.resize(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        MYSQL_FIELD const& f = fields[i];
+        Column& col = _columns[i];
+        MYSQL_BIND& bind = _binds[i];
+        std::memset(&bind, 0, sizeof(bind));
+        switch(f.type) {
+        case MYSQL_TYPE_TINY: case MYSQL_TYPE_SHORT: case MYSQL_TYPE_INT24:
+        case MYSQL_TYPE_LONG: case MYSQL_TYPE_YEAR:
+            col.type = Type::INT64;
+            break;
+        case MYSQL_TYPE_LONGLONG:
+            // Unsigned values may not fit in an int64.
+            col.type = (f.flags & UNSIGNED_FLAG) ? Type::TEXT : Type::INT64;
+            break;
+        case MYSQL_TYPE_FLOAT:
+            col.type = Type::FLOAT;
+            break;
+        case MYSQL_TYPE_DOUBLE:
+            col.type = Type::DOUBLE;
+            break;
+        default:
+            col.type = Type::TEXT;
+            break;
+        }
+        switch(col.type) {
+        case Type::INT64:
+            bind.buffer_type = MYSQL_TYPE_LONGLONG;
+            bind.buffer = &col.value.i;
+            break;
+        case Type::FLOAT:
+            bind.buffer_type = MYSQL_TYPE_FLOAT;
+            bind.buffer = &col.value.f;
+            break;
+        case Type::DOUBLE:
+            bind.buffer_type = MYSQL_TYPE_DOUBLE;
+            bind.buffer = &col.value.d;
+            break;
+        case Type::TEXT:
+            // One more byte than bound, for the terminating NUL.
+            col.text.resize(std::min(f.length, TEXT_BUFFER_SIZE) + 1);
+            bind.buffer_type = MYSQL_TYPE_STRING;
+            bind.buffer = &col.text[0];
+            bind.buffer_length = col.text.size() - 1;
+            break;
+        }
+        bind.length = &col.length;
+        bind.is_null = &col.isNull;
+        bind.error = &col.truncated;
+    }
+    if (mysql_stmt_bind_result(_stmt, _binds.data())) {
+        _error = true;
+    }
+}
+
+bool StatementResult::fetch() {
+    if (!isValid()) {
+        return false;
+    }
+    int rc = mysql_stmt_fetch(_stmt);
+    if (rc == MYSQL_DATA_TRUNCATED) {
+        if (!_fetchTruncated()) {
+            _error = true;
+            return false;
+        }
+        rc = 0;
+    }
+    if (rc == MYSQL_NO_DATA) {
+        return false;
+    }
+    if (rc != 0) {
+        _error = true;
+        return false;
+    }
+    for (auto& col : _columns) {
+        if (col.type == Type::TEXT && !col.isNull) {
+            col.text[col.length] = '\0';
+        }
+    }
+    return true;
+}
+
+/// Fetch the text values that did not fit their buffers again, into grown
+/// buffers, which then stay bound for the following rows.
+bool StatementResult::_fetchTruncated() {
+    bool rebind = false;
+    for (size_t i = 0; i < _columns.size(); ++i) {
+        Column& col = _columns[i];
+        if (!col.truncated || col.type != Type::TEXT) {
+            continue;
+        }
+        col.text.resize(col.length + 1);
+        MYSQL_BIND& bind = _binds[i];
+        bind.buffer = &col.text[0];
+        bind.buffer_length = col.text.size() - 1;
+        if (mysql_stmt_fetch_column(_stmt, &bind, i, 0)) {
+            return false;
+        }
+        rebind = true;
+    }
+    return !rebind || !mysql_stmt_bind_result(_stmt, _binds.data());
+}
+
+}}} // namespace lsst::qserv::mysql
@@ -0,0 +1,103 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_MYSQL_STATEMENTRESULT_H
+#define LSST_QSERV_MYSQL_STATEMENTRESULT_H
+
+// System headers
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Third-party headers
+#include "boost/utility.hpp"
+#include <mysql/mysql.h>
+
+namespace lsst {
+namespace qserv {
+namespace mysql {
+
+/// StatementResult fetches the rows of an executed prepared statement in the
+/// MySQL binary protocol, into buffers bound according to the column types.
+/// Integer, FLOAT and DOUBLE values arrive as numbers, so mysqld does not
+/// format them as text and nobody parses them back. UNSIGNED BIGINT and all
+/// other types are fetched as text.
+class StatementResult : boost::noncopyable {
+public:
+    enum class Type { INT64, FLOAT, DOUBLE, TEXT };
+
+    /// @param stmt an executed statement, which must outlive this
+    explicit StatementResult(MYSQL_STMT* stmt);
+    ~StatementResult();
+
+    /// @return false if the statement has no result set, or binding failed
+    bool isValid() const { return _metadata != nullptr && !_error; }
+
+    /// @return result set metadata, for SchemaFactory::newFromResult
+    MYSQL_RES* getMetadata() const { return _metadata; }
+
+    int getColumnCount() const { return _columns.size(); }
+
+    /// Fetch the next row into the bound buffers.
+    /// @return false after the last row, or on error (see isError())
+    bool fetch();
+    bool isError() const { return _error; }
+
+    Type getType(int col) const { return _columns[col].type; }
+    bool isNull(int col) const { return _columns[col].isNull; }
+    int64_t getInt64(int col) const { return _columns[col].value.i; }
+    float getFloat(int col) const { return _columns[col].value.f; }
+    double getDouble(int col) const { return _columns[col].value.d; }
+
+    /// @return the NUL-terminated value of a TEXT column
+    char const* getText(int col, size_t& length) const {
+        length = _columns[col].length;
+        return &_columns[col].text[0];
+    }
+
+private:
+    struct Column {
+        Type type;
+        union {
+            int64_t i;
+            float f;
+            double d;
+        } value;
+        std::vector<char> text; ///< TEXT buffer, grown for long values
+        unsigned long length;
+        my_bool isNull;
+        my_bool truncated;
+    };
+
+    void _bind();
+    bool _fetchTruncated();
+
+    MYSQL_STMT* _stmt;
+    MYSQL_RES* _metadata;
+    std::vector<Column> _columns;
+    std::vector<MYSQL_BIND> _binds;
+    bool _error {false};
+};
+
+}}} // namespace lsst::qserv::mysql
+
+#endif // LSST_QSERV_MYSQL_STATEMENTRESULT_H
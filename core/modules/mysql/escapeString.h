@@ -0,0 +1,169 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_MYSQL_ESCAPESTRING_H
+#define LSST_QSERV_MYSQL_ESCAPESTRING_H
+
+// System headers
+#include <cassert>
+#include <limits>
+#include <string.h>
+
+// Third-party headers
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace lsst {
+namespace qserv {
+namespace mysql {
+
+/// @return the character following '\' in the LOAD DATA INFILE escape
+/// sequence for c, or 0 if c needs no escaping.
+inline char infileEscapeCode(char c) {
+    switch(c) {
+    case '\0':   return '0';
+    case '\b':   return 'b';
+    case '\n':   return 'n';
+    case '\r':   return 'r';
+    case '\t':   return 't';
+    case '\032': return 'Z';
+    default:     return 0;
+        // Null (\N) is not treated by escaping in this context.
+    }
+}
+
+#if defined(__AVX2__)
+typedef __m256i EscapeBlock;
+inline EscapeBlock loadBlock(char const* p) {
+    return _mm256_loadu_si256(reinterpret_cast<EscapeBlock const*>(p));
+}
+inline void storeBlock(char* p, EscapeBlock v) {
+    _mm256_storeu_si256(reinterpret_cast<EscapeBlock*>(p), v);
+}
+/// @return a bit mask of the bytes in v that need escaping.
+inline unsigned escapeMask(EscapeBlock v) {
+    __m256i m = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\b')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\032')));
+    return static_cast<unsigned>(_mm256_movemask_epi8(m));
+}
+#elif defined(__SSE2__)
+typedef __m128i EscapeBlock;
+inline EscapeBlock loadBlock(char const* p) {
+    return _mm_loadu_si128(reinterpret_cast<EscapeBlock const*>(p));
+}
+inline void storeBlock(char* p, EscapeBlock v) {
+    _mm_storeu_si128(reinterpret_cast<EscapeBlock*>(p), v);
+}
+/// @return a bit mask of the bytes in v that need escaping.
+inline unsigned escapeMask(EscapeBlock v) {
+    __m128i m = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\b')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\032')));
+    return static_cast<unsigned>(_mm_movemask_epi8(m));
+}
+#endif
+
+/// Escape a bytestring for LOAD DATA INFILE, as specified by MySQL doc:
+/// https://dev.mysql.com/doc/refman/5.1/en/load-data.html
+/// This is limited to:
+/// Character    Escape Sequence
+/// \0     An ASCII NUL (0x00) character
+/// \b     A backspace character
+/// \n     A newline (linefeed) character
+/// \r     A carriage return character
+/// \t     A tab character.
+/// \Z     ASCII 26 (Control+Z)
+/// \N     NULL
+///
+/// At most destLen bytes are written, and an escape sequence is never split,
+/// so a source string may be escaped across several calls. Runs of bytes
+/// needing no escape are copied a vector register at a time when SSE2 (or
+/// AVX2) is available.
+/// @param srcUsed is set to the number of source bytes consumed
+/// @return the number of bytes written to dest
+inline int escapeString(char* dest, int destLen,
+                        char const* src, int srcLength, int& srcUsed) {
+    assert(srcLength >= 0);
+    assert(srcLength < std::numeric_limits<int>::max() / 2);
+    char* d = dest;
+    char* const dEnd = dest + destLen;
+    char const* s = src;
+    char const* const sEnd = src + srcLength;
+#if defined(__AVX2__) || defined(__SSE2__)
+    int const blockSize = sizeof(EscapeBlock);
+    while((sEnd - s >= blockSize) && (dEnd - d >= blockSize)) {
+        EscapeBlock v = loadBlock(s);
+        unsigned mask = escapeMask(v);
+        if (mask == 0) { // Nothing to escape: copy the whole block.
+            storeBlock(d, v);
+            s += blockSize;
+            d += blockSize;
+            continue;
+        }
+        // Copy the clean prefix, then escape the first special byte.
+        int clean = __builtin_ctz(mask);
+        memcpy(d, s, clean);
+        s += clean;
+        d += clean;
+        if (dEnd - d < 2) {
+            break;
+        }
+        *d++ = '\\';
+        *d++ = infileEscapeCode(*s++);
+    }
+#endif
+    // Scalar tail, and the whole string on other architectures.
+    for(; s != sEnd; ++s) {
+        char code = infileEscapeCode(*s);
+        if (code) {
+            if (dEnd - d < 2) break;
+            *d++ = '\\';
+            *d++ = code;
+        } else {
+            if (d == dEnd) break;
+            *d++ = *s;
+        }
+    }
+    srcUsed = s - src;
+    return d - dest;
+}
+
+/// Escape all of src into dest, which must have room for 2 * srcLength bytes.
+/// @return the number of bytes written to dest
+inline int escapeString(char* dest, char const* src, int srcLength) {
+    int srcUsed = 0;
+    return escapeString(dest, 2 * srcLength, src, srcLength, srcUsed);
+}
+
+}}} // namespace lsst::qserv::mysql
+
+#endif // LSST_QSERV_MYSQL_ESCAPESTRING_H
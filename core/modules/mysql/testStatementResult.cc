@@ -0,0 +1,162 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsstcorp.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ /**
+  * @brief Test fetching typed rows of a prepared statement with
+  * StatementResult. Depends on a local mysqld.
+  *
+  * Usage: testStatementResult [socket [user [db]]]
+  */
+
+// System headers
+#include <string>
+
+// Qserv headers
+#include "mysql/MySqlConfig.h"
+#include "mysql/MySqlConnection.h"
+#include "mysql/StatementResult.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE StatementResult
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+using lsst::qserv::mysql::MySqlConfig;
+using lsst::qserv::mysql::MySqlConnection;
+using lsst::qserv::mysql::StatementResult;
+
+namespace {
+
+MySqlConfig newConfig() {
+    auto const& suite = boost::unit_test::framework::master_test_suite();
+    MySqlConfig config;
+    config.socket = suite.argc > 1 ? suite.argv[1] : "/home/qserv/qserv-run/git/var/lib/mysql/mysql.sock";
+    config.username = suite.argc > 2 ? suite.argv[2] : "qsmaster";
+    config.dbName = suite.argc > 3 ? suite.argv[3] : "test";
+    return config;
+}
+
+struct Fixture {
+    Fixture() : conn(newConfig()) {
+        BOOST_REQUIRE(conn.connect());
+        run("CREATE TEMPORARY TABLE StatementResultTest ("
+            "ti TINYINT, i INT, bi BIGINT, ubi BIGINT UNSIGNED, f FLOAT, d DOUBLE, "
+            "dc DECIMAL(10,3), s VARCHAR(2000), n INT)");
+        run("INSERT INTO StatementResultTest VALUES "
+            "(-5, 123456, -9000000000, 18446744073709551615, 1.5, 2.25, 12.345, "
+            "REPEAT('x', 1500), NULL), "
+            "(NULL, NULL, NULL, NULL, NULL, NULL, NULL, 'short', NULL)");
+    }
+
+    void run(std::string const& query) {
+        BOOST_REQUIRE_MESSAGE(mysql_query(conn.getMySql(), query.c_str()) == 0,
+                              mysql_error(conn.getMySql()));
+    }
+
+    MySqlConnection conn;
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(Suite, Fixture)
+
+BOOST_AUTO_TEST_CASE(TypedFetch) {
+    BOOST_REQUIRE(conn.prepareStatement("SELECT * FROM StatementResultTest ORDER BY i DESC"));
+    BOOST_CHECK_EQUAL(conn.getStatementFieldCount(), 9U);
+    BOOST_REQUIRE(conn.executeStatement());
+    {
+        StatementResult result(conn.getStatement());
+        BOOST_REQUIRE(result.isValid());
+        BOOST_REQUIRE_EQUAL(result.getColumnCount(), 9);
+        typedef StatementResult::Type Type;
+        Type const types[] = {Type::INT64, Type::INT64, Type::INT64, Type::TEXT,
+                              Type::FLOAT, Type::DOUBLE, Type::TEXT, Type::TEXT, Type::INT64};
+        for (int i = 0; i < 9; ++i) {
+            BOOST_CHECK(result.getType(i) == types[i]);
+        }
+
+        BOOST_REQUIRE(result.fetch());
+        size_t length;
+        BOOST_CHECK_EQUAL(result.getInt64(0), -5);
+        BOOST_CHECK_EQUAL(result.getInt64(1), 123456);
+        BOOST_CHECK_EQUAL(result.getInt64(2), -9000000000LL);
+        BOOST_CHECK_EQUAL(result.getText(3, length), "18446744073709551615");
+        BOOST_CHECK_EQUAL(result.getFloat(4), 1.5f);
+        BOOST_CHECK_EQUAL(result.getDouble(5), 2.25);
+        BOOST_CHECK_EQUAL(result.getText(6, length), "12.345");
+        // Longer than the initial text buffer, fetched again.
+        BOOST_CHECK_EQUAL(result.getText(7, length), std::string(1500, 'x'));
+        BOOST_CHECK_EQUAL(length, 1500U);
+        BOOST_CHECK(result.isNull(8));
+        BOOST_CHECK(!result.isNull(0));
+
+        BOOST_REQUIRE(result.fetch());
+        for (int i = 0; i < 9; ++i) {
+            BOOST_CHECK_EQUAL(result.isNull(i), i != 7);
+        }
+        BOOST_CHECK_EQUAL(result.getText(7, length), "short");
+        BOOST_CHECK_EQUAL(length, 5U);
+
+        BOOST_CHECK(!result.fetch());
+        BOOST_CHECK(!result.isError());
+    }
+    conn.freeStatement();
+}
+
+BOOST_AUTO_TEST_CASE(TextBufferSize) {
+    // Values filling the initial text buffer exactly, and one byte more.
+    size_t const bufferSize = 1024;
+    run("INSERT INTO StatementResultTest (i, s) VALUES "
+        "(1, REPEAT('y', " + std::to_string(bufferSize) + ")), "
+        "(2, REPEAT('z', " + std::to_string(bufferSize + 1) + "))");
+    BOOST_REQUIRE(conn.prepareStatement("SELECT s FROM StatementResultTest WHERE i IN (1, 2) ORDER BY i"));
+    BOOST_REQUIRE(conn.executeStatement());
+    {
+        StatementResult result(conn.getStatement());
+        BOOST_REQUIRE(result.isValid());
+        size_t length;
+        BOOST_REQUIRE(result.fetch());
+        BOOST_CHECK_EQUAL(result.getText(0, length), std::string(bufferSize, 'y'));
+        BOOST_CHECK_EQUAL(length, bufferSize);
+        BOOST_REQUIRE(result.fetch());
+        BOOST_CHECK_EQUAL(result.getText(0, length), std::string(bufferSize + 1, 'z'));
+        BOOST_CHECK_EQUAL(length, bufferSize + 1);
+        BOOST_CHECK(!result.fetch());
+        BOOST_CHECK(!result.isError());
+    }
+    conn.freeStatement();
+}
+
+BOOST_AUTO_TEST_CASE(NoResultSet) {
+    // Run as text by QueryRunner.
+    BOOST_REQUIRE(conn.prepareStatement("UPDATE StatementResultTest SET n = 1"));
+    BOOST_CHECK_EQUAL(conn.getStatementFieldCount(), 0U);
+    conn.freeStatement();
+
+    // A failed prepare leaves no statement behind.
+    BOOST_CHECK(!conn.prepareStatement("SELECT 1; SELECT 2"));
+    BOOST_CHECK(conn.getStatement() == nullptr);
+    BOOST_CHECK(conn.resetSession());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
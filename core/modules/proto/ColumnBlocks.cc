@@ -0,0 +1,483 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "proto/ColumnBlocks.h"
+
+// System headers
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Third-party headers
+#include <mysql/mysql.h>
+
+// Values are packed in host byte order, which must be the little-endian
+// order of the wire format.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "ColumnBlocks requires a little-endian host"
+#endif
+
+namespace { // File-scope helpers
+
+using lsst::qserv::proto::ColumnBlock;
+
+size_t const MAX_NUMBER_TEXT = 32; ///< Longest formatted numeric value
+
+size_t valueWidth(ColumnBlock::Encoding encoding) {
+    switch(encoding) {
+    case ColumnBlock::INT64: return sizeof(int64_t);
+    case ColumnBlock::FLOAT: return sizeof(float);
+    case ColumnBlock::DOUBLE: return sizeof(double);
+    default: return 0;
+    }
+}
+
+ColumnBlock::Encoding encodingOf(int mysqlType) {
+    switch(mysqlType) {
+    case MYSQL_TYPE_TINY: case MYSQL_TYPE_SHORT: case MYSQL_TYPE_INT24:
+    case MYSQL_TYPE_LONG: case MYSQL_TYPE_LONGLONG: case MYSQL_TYPE_YEAR:
+        return ColumnBlock::INT64;
+    case MYSQL_TYPE_FLOAT:
+        return ColumnBlock::FLOAT;
+    case MYSQL_TYPE_DOUBLE:
+        return ColumnBlock::DOUBLE;
+    default:
+        return ColumnBlock::TEXT;
+    }
+}
+
+/// @return true if the NUL-terminated value of length bytes parsed entirely
+bool parsed(char const* value, unsigned long length, char const* end) {
+    return length > 0 && end == value + length && errno == 0
+        && !std::isspace(static_cast<unsigned char>(value[0]));
+}
+
+size_t formatInt64(int64_t val, char* buf) {
+    char tmp[MAX_NUMBER_TEXT];
+    char* p = tmp + sizeof(tmp);
+    // Negate as unsigned so that INT64_MIN does not overflow.
+    uint64_t u = val < 0 ? 0 - static_cast<uint64_t>(val) : val;
+    do {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while (u != 0);
+    if (val < 0) {
+        *--p = '-';
+    }
+    size_t size = tmp + sizeof(tmp) - p;
+    std::memcpy(buf, p, size);
+    return size;
+}
+
+/// Format val as a plain decimal with the fewest fractional digits that
+/// read back as val, the way mysqld reads text into a double, or into a
+/// double rounded to float if isFloat. An integer r below 2^53 over an exact
+/// power of ten 10^k reads as the correctly rounded quotient r / 10^k, which
+/// is what is checked. This covers most values much faster than snprintf().
+/// @return false if there are too many significant digits.
+bool formatDecimal(double val, bool isFloat, char* buf, size_t& size) {
+    double const exactLimit = 9007199254740992.0; // 2^53
+    double const a = std::fabs(val);
+    if (!(a < exactLimit)) {
+        return false; // Large, infinite or NaN
+    }
+    double scale = 1;
+    for (int k = 0; k <= 22; ++k, scale *= 10) { // Powers of ten to 1e22 are exact
+        double scaled = a * scale;
+        if (scaled >= exactLimit) {
+            return false;
+        }
+        double r = std::floor(scaled + 0.5);
+        double back = r / scale;
+        if (isFloat ? static_cast<float>(back) != static_cast<float>(a) : back != a) {
+            continue;
+        }
+        char tmp[MAX_NUMBER_TEXT];
+        char* p = tmp + sizeof(tmp);
+        uint64_t u = static_cast<uint64_t>(r);
+        for (int digit = 0; digit <= k || u != 0; ++digit) {
+            if (digit == k && k != 0) {
+                *--p = '.';
+            }
+            *--p = '0' + u % 10;
+            u /= 10;
+        }
+        if (val < 0 && r != 0) {
+            *--p = '-';
+        }
+        size = tmp + sizeof(tmp) - p;
+        std::memcpy(buf, p, size);
+        return true;
+    }
+    return false;
+}
+
+/// Format with the fewest digits that read back as the same double, which is
+/// normally the text mysqld sent.
+size_t formatDouble(double val, char* buf) {
+    size_t fixedSize;
+    if (formatDecimal(val, false, buf, fixedSize)) {
+        return fixedSize;
+    }
+    int size = 0;
+    for (int precision = 15; precision <= 17; ++precision) {
+        size = std::snprintf(buf, MAX_NUMBER_TEXT, "%.*g", precision, val);
+        if (std::strtod(buf, nullptr) == val) {
+            break;
+        }
+    }
+    return size;
+}
+
+/// As formatDouble, for floats. mysqld reads FLOAT values as a double
+/// rounded to float, so that is what must read back.
+size_t formatFloat(float val, char* buf) {
+    size_t fixedSize;
+    if (formatDecimal(val, true, buf, fixedSize)) {
+        return fixedSize;
+    }
+    int size = 0;
+    for (int precision = 6; precision <= 9; ++precision) {
+        size = std::snprintf(buf, MAX_NUMBER_TEXT, "%.*g", precision, val);
+        if (static_cast<float>(std::strtod(buf, nullptr)) == val) {
+            break;
+        }
+    }
+    return size;
+}
+
+/// Format the packed numeric value at p.
+size_t formatNumber(ColumnBlock::Encoding encoding, char const* p, char* buf) {
+    switch(encoding) {
+    case ColumnBlock::INT64: {
+        int64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return formatInt64(v, buf);
+    }
+    case ColumnBlock::FLOAT: {
+        float v;
+        std::memcpy(&v, p, sizeof(v));
+        return formatFloat(v, buf);
+    }
+    default: {
+        double v;
+        std::memcpy(&v, p, sizeof(v));
+        return formatDouble(v, buf);
+    }
+    }
+}
+
+template <typename T>
+void appendPacked(std::string& s, T val) {
+    s.append(reinterpret_cast<char const*>(&val), sizeof(val));
+}
+
+uint32_t getOffset(char const* offsets, int row) {
+    uint32_t offset;
+    std::memcpy(&offset, offsets + row * sizeof(offset), sizeof(offset));
+    return offset;
+}
+
+} // anonymous namespace
+
+namespace lsst {
+namespace qserv {
+namespace proto {
+
+int getRowCount(Result const& result) {
+    return result.has_rowcount() ? result.rowcount() : result.row_size();
+}
+
+////////////////////////////////////////////////////////////////////////
+// ColumnBlockWriter
+////////////////////////////////////////////////////////////////////////
+ColumnBlockWriter::ColumnBlockWriter(RowSchema const& schema) {
+    for (auto const& cs : schema.columnschema()) {
+        Column col;
+        col.schemaEncoding = cs.has_mysqltype() ? encodingOf(cs.mysqltype())
+                                                : ColumnBlock::TEXT;
+        col.encoding = col.schemaEncoding;
+        col.hasNull = false;
+        _columns.push_back(col);
+    }
+}
+
+void ColumnBlockWriter::addRow(char const* const* values, unsigned long const* lengths) {
+    for (size_t i = 0, e = _columns.size(); i < e; ++i) {
+        _addValue(_columns[i], values[i], lengths[i]);
+    }
+    ++_rowCount;
+}
+
+void ColumnBlockWriter::addNull(int col) {
+    _addValue(_columns[col], nullptr, 0);
+}
+
+void ColumnBlockWriter::addInt64(int col, int64_t val) {
+    Column& c = _columns[col];
+    _startValue(c, false);
+    if (c.encoding == ColumnBlock::INT64) {
+        appendPacked(c.values, val);
+    } else {
+        _appendNumberText(c, ColumnBlock::INT64, &val);
+    }
+}
+
+void ColumnBlockWriter::addFloat(int col, float val) {
+    Column& c = _columns[col];
+    _startValue(c, false);
+    if (c.encoding == ColumnBlock::FLOAT) {
+        appendPacked(c.values, val);
+    } else {
+        _appendNumberText(c, ColumnBlock::FLOAT, &val);
+    }
+}
+
+void ColumnBlockWriter::addDouble(int col, double val) {
+    Column& c = _columns[col];
+    _startValue(c, false);
+    if (c.encoding == ColumnBlock::DOUBLE) {
+        appendPacked(c.values, val);
+    } else {
+        _appendNumberText(c, ColumnBlock::DOUBLE, &val);
+    }
+}
+
+void ColumnBlockWriter::addText(int col, char const* value, size_t length) {
+    _addValue(_columns[col], value, length);
+}
+
+/// Grow the NULL bitmap of col for the current row.
+void ColumnBlockWriter::_startValue(Column& col, bool isNull) {
+    if ((_rowCount & 7) == 0) {
+        col.nulls.push_back(0);
+    }
+    if (isNull) {
+        col.nulls.back() |= 1 << (_rowCount & 7);
+        col.hasNull = true;
+    }
+}
+
+/// Add a text value (or NULL), packing it if col has a numeric encoding
+/// and it parses.
+void ColumnBlockWriter::_addValue(Column& col, char const* value, unsigned long length) {
+    _startValue(col, !value);
+    if (!value) {
+        length = 0;
+    }
+    char* end = nullptr;
+    errno = 0;
+    switch(col.encoding) {
+    case ColumnBlock::INT64: {
+        int64_t v = value ? std::strtoll(value, &end, 10) : 0;
+        if (!value || parsed(value, length, end)) {
+            appendPacked(col.values, v);
+            return;
+        }
+        break;
+    }
+    case ColumnBlock::FLOAT: {
+        float v = value ? static_cast<float>(std::strtod(value, &end)) : 0;
+        if (!value || parsed(value, length, end)) {
+            appendPacked(col.values, v);
+            return;
+        }
+        break;
+    }
+    case ColumnBlock::DOUBLE: {
+        double v = value ? std::strtod(value, &end) : 0;
+        if (!value || parsed(value, length, end)) {
+            appendPacked(col.values, v);
+            return;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    _appendText(col, value ? value : "", length);
+}
+
+void ColumnBlockWriter::_appendText(Column& col, char const* value, size_t length) {
+    if (col.encoding != ColumnBlock::TEXT) {
+        _convertToText(col);
+    }
+    col.values.append(value, length);
+    appendPacked(col.offsets, static_cast<uint32_t>(col.values.size()));
+}
+
+/// Add a number of another type than col as text.
+void ColumnBlockWriter::_appendNumberText(Column& col, ColumnBlock::Encoding encoding,
+                                          void const* val) {
+    char buf[MAX_NUMBER_TEXT];
+    _appendText(col, buf, formatNumber(encoding, static_cast<char const*>(val), buf));
+}
+
+/// Reformat the values of the rows added so far as text.
+void ColumnBlockWriter::_convertToText(Column& col) {
+    std::string packed;
+    packed.swap(col.values);
+    size_t const width = valueWidth(col.encoding);
+    char buf[MAX_NUMBER_TEXT];
+    col.offsets.clear();
+    for (int row = 0; row < _rowCount; ++row) {
+        if (!(col.nulls[row >> 3] >> (row & 7) & 1)) {
+            col.values.append(buf, formatNumber(col.encoding, &packed[row * width], buf));
+        }
+        appendPacked(col.offsets, static_cast<uint32_t>(col.values.size()));
+    }
+    col.encoding = ColumnBlock::TEXT;
+}
+
+size_t ColumnBlockWriter::getByteSize() const {
+    size_t size = 0;
+    for (auto const& col : _columns) {
+        size += col.values.size() + col.offsets.size() + (col.hasNull ? col.nulls.size() : 0);
+    }
+    return size;
+}
+
+void ColumnBlockWriter::moveTo(Result& result) {
+    result.set_rowcount(_rowCount);
+    for (auto& col : _columns) {
+        ColumnBlock* block = result.add_columnblock();
+        block->set_encoding(col.encoding);
+        block->mutable_values()->swap(col.values);
+        if (col.encoding == ColumnBlock::TEXT) {
+            block->mutable_offsets()->swap(col.offsets);
+        }
+        if (col.hasNull) {
+            block->mutable_nulls()->swap(col.nulls);
+        }
+        col.encoding = col.schemaEncoding;
+        col.values.clear();
+        col.offsets.clear();
+        col.nulls.clear();
+        col.hasNull = false;
+    }
+    _rowCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// ColumnBlockReader
+////////////////////////////////////////////////////////////////////////
+ColumnBlockReader::ColumnBlockReader(Result const& result)
+    : _rowCount(result.rowcount()) {
+    for (auto const& block : result.columnblock()) {
+        Column col;
+        col.encoding = block.encoding();
+        col.values = block.values().data();
+        col.offsets = block.offsets().data();
+        col.nulls = block.nulls().empty() ? nullptr : block.nulls().data();
+        _columns.push_back(col);
+    }
+}
+
+bool ColumnBlockReader::isValid(Result const& result) {
+    int const rows = result.rowcount();
+    if (result.columnblock_size() == 0) {
+        return rows == 0;
+    }
+    if (rows < 0 || result.row_size() != 0) {
+        return false;
+    }
+    int schemaColumns = result.rowschema().columnschema_size();
+    if (schemaColumns != 0 && schemaColumns != result.columnblock_size()) {
+        return false; // Only the first message of a result carries its schema.
+    }
+    for (auto const& block : result.columnblock()) {
+        if (!block.nulls().empty() && block.nulls().size() != static_cast<size_t>(rows + 7) / 8) {
+            return false;
+        }
+        size_t width = valueWidth(block.encoding());
+        if (width != 0) {
+            if (block.values().size() != rows * width) {
+                return false;
+            }
+            continue;
+        }
+        if (block.offsets().size() != rows * sizeof(uint32_t)) {
+            return false;
+        }
+        uint32_t previous = 0;
+        for (int row = 0; row < rows; ++row) {
+            uint32_t offset = getOffset(block.offsets().data(), row);
+            if (offset < previous) {
+                return false;
+            }
+            previous = offset;
+        }
+        if (previous > block.values().size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ColumnBlockReader::getText(int row, int col, std::string& scratch,
+                                char const*& data, size_t& size) const {
+    Column const& c = _columns[col];
+    size_t width = valueWidth(c.encoding);
+    if (width == 0) {
+        uint32_t begin = row == 0 ? 0 : getOffset(c.offsets, row - 1);
+        data = c.values + begin;
+        size = getOffset(c.offsets, row) - begin;
+        return;
+    }
+    scratch.resize(MAX_NUMBER_TEXT);
+    size = formatNumber(c.encoding, c.values + row * width, &scratch[0]);
+    data = scratch.data();
+}
+
+void columnsToRows(Result& result) {
+    if (result.columnblock_size() == 0) {
+        return;
+    }
+    {
+        ColumnBlockReader reader(result);
+        std::string scratch;
+        char const* data;
+        size_t size;
+        for (int row = 0, rows = reader.getRowCount(); row < rows; ++row) {
+            RowBundle* rb = result.add_row();
+            for (int col = 0, cols = reader.getColumnCount(); col < cols; ++col) {
+                if (reader.isNull(row, col)) {
+                    rb->add_column();
+                    rb->add_isnull(true);
+                } else {
+                    reader.getText(row, col, scratch, data, size);
+                    rb->add_column(data, size);
+                    rb->add_isnull(false);
+                }
+            }
+        }
+    }
+    result.clear_columnblock();
+    result.clear_rowcount();
+}
+
+}}} // namespace lsst::qserv::proto
@@ -0,0 +1,146 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_PROTO_COLUMNBLOCKS_H
+#define LSST_QSERV_PROTO_COLUMNBLOCKS_H
+ /**
+  * @file
+  *
+  * @brief Encode and decode the column blocks of protocol 3 Result messages.
+  *
+  */
+
+// System headers
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Qserv headers
+#include "proto/worker.pb.h"
+
+namespace lsst {
+namespace qserv {
+namespace proto {
+
+/// @return the number of rows in result, whether they are sent as RowBundles
+/// (protocol 2) or column blocks (protocol 3)
+int getRowCount(Result const& result);
+
+/// ColumnBlockWriter accumulates the rows of a MySQL result as column
+/// blocks. Integer, FLOAT and DOUBLE columns are packed in binary, all other
+/// columns (DECIMAL included, to stay exact) are sent as text. If a value of a
+/// numeric column does not parse, e.g. an UNSIGNED BIGINT beyond the int64
+/// range, or has another type, that column falls back to text until the next
+/// moveTo().
+///
+/// Rows come either as text, from mysql_fetch_row, or one typed value at a
+/// time, from the binary protocol.
+class ColumnBlockWriter {
+public:
+    /// @param schema of the rows to be added, with mysqltype set
+    explicit ColumnBlockWriter(RowSchema const& schema);
+
+    /// Add a row as returned by mysql_fetch_row/mysql_fetch_lengths.
+    void addRow(char const* const* values, unsigned long const* lengths);
+
+    /// Add the value of column col of the current row. Each column of the
+    /// row must be added, in any order, before endRow().
+    void addNull(int col);
+    void addInt64(int col, int64_t val);
+    void addFloat(int col, float val);
+    void addDouble(int col, double val);
+    /// @param value NUL-terminated text of length bytes
+    void addText(int col, char const* value, size_t length);
+    void endRow() { ++_rowCount; }
+
+    int getRowCount() const { return _rowCount; }
+
+    /// @return the size of the accumulated blocks, without protobuf framing
+    size_t getByteSize() const;
+
+    /// Move the accumulated rows into result, leaving the writer empty.
+    void moveTo(Result& result);
+
+private:
+    struct Column {
+        ColumnBlock::Encoding encoding;
+        ColumnBlock::Encoding schemaEncoding; ///< encoding after moveTo()
+        std::string values;
+        std::string offsets;
+        std::string nulls;
+        bool hasNull;
+    };
+
+    void _startValue(Column& col, bool isNull);
+    void _addValue(Column& col, char const* value, unsigned long length);
+    void _appendText(Column& col, char const* value, size_t length);
+    void _appendNumberText(Column& col, ColumnBlock::Encoding encoding, void const* val);
+    void _convertToText(Column& col);
+
+    std::vector<Column> _columns;
+    int _rowCount {0};
+};
+
+/// ColumnBlockReader gives access by row and column to the values of the
+/// column blocks of a Result, which must outlive it and be valid (see
+/// isValid()).
+class ColumnBlockReader {
+public:
+    explicit ColumnBlockReader(Result const& result);
+
+    /// @return true if result has no column blocks, or consistent ones
+    static bool isValid(Result const& result);
+
+    int getRowCount() const { return _rowCount; }
+    int getColumnCount() const { return _columns.size(); }
+
+    bool isNull(int row, int col) const {
+        char const* nulls = _columns[col].nulls;
+        return nulls && (nulls[row >> 3] >> (row & 7) & 1);
+    }
+
+    /// Point data at the text of a non-NULL value, as MySQL would read it.
+    /// Numeric values are formatted in scratch, which must stay unchanged
+    /// while data is used.
+    void getText(int row, int col, std::string& scratch,
+                 char const*& data, size_t& size) const;
+
+private:
+    struct Column {
+        ColumnBlock::Encoding encoding;
+        char const* values;
+        char const* offsets; ///< TEXT only, possibly unaligned
+        char const* nulls; ///< nullptr if no row is NULL
+    };
+
+    std::vector<Column> _columns;
+    int _rowCount;
+};
+
+/// Replace the column blocks of result by RowBundles, for consumers that
+/// work row by row. Does nothing to a protocol 2 result.
+void columnsToRows(Result& result);
+
+}}} // namespace lsst::qserv::proto
+
+#endif // LSST_QSERV_PROTO_COLUMNBLOCKS_H
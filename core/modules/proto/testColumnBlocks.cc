@@ -0,0 +1,262 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// System headers
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Third-party headers
+#include <mysql/mysql.h>
+
+// Qserv headers
+#include "proto/ColumnBlocks.h"
+#include "proto/worker.pb.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE ColumnBlocks_1
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+using lsst::qserv::proto::ColumnBlock;
+using lsst::qserv::proto::ColumnBlockReader;
+using lsst::qserv::proto::ColumnBlockWriter;
+using lsst::qserv::proto::Result;
+using lsst::qserv::proto::RowSchema;
+
+typedef std::vector<std::string> Strings;
+
+struct Fixture {
+    Fixture(void) {
+        addColumn(MYSQL_TYPE_LONGLONG);
+        addColumn(MYSQL_TYPE_FLOAT);
+        addColumn(MYSQL_TYPE_DOUBLE);
+        addColumn(MYSQL_TYPE_NEWDECIMAL);
+        addColumn(MYSQL_TYPE_VAR_STRING);
+    }
+    ~Fixture(void) { }
+
+    void addColumn(int type) {
+        auto cs = schema.add_columnschema();
+        cs->set_name("c" + std::to_string(schema.columnschema_size()));
+        cs->set_hasdefault(false);
+        cs->set_sqltype("");
+        cs->set_mysqltype(type);
+    }
+
+    /// Add a row as mysql_fetch_row would return it, where "NULL" is NULL.
+    void addRow(ColumnBlockWriter& writer, Strings const& cols) {
+        std::vector<char const*> values;
+        std::vector<unsigned long> lengths;
+        for (auto const& c : cols) {
+            values.push_back(c == "NULL" ? nullptr : c.c_str());
+            lengths.push_back(c == "NULL" ? 0 : c.size());
+        }
+        writer.addRow(&values[0], &lengths[0]);
+    }
+
+    /// @return the rows of result as text, via a serialized copy.
+    std::vector<Strings> readRows(Result const& result) {
+        std::string msg;
+        BOOST_REQUIRE(result.SerializeToString(&msg));
+        Result copy;
+        BOOST_REQUIRE(copy.ParseFromString(msg));
+        BOOST_REQUIRE(ColumnBlockReader::isValid(copy));
+        ColumnBlockReader reader(copy);
+        BOOST_CHECK_EQUAL(reader.getRowCount(), lsst::qserv::proto::getRowCount(copy));
+        std::vector<Strings> rows;
+        std::string scratch;
+        char const* data;
+        size_t size;
+        for (int r = 0; r < reader.getRowCount(); ++r) {
+            Strings row;
+            for (int c = 0; c < reader.getColumnCount(); ++c) {
+                if (reader.isNull(r, c)) {
+                    row.push_back("NULL");
+                } else {
+                    reader.getText(r, c, scratch, data, size);
+                    row.push_back(std::string(data, size));
+                }
+            }
+            rows.push_back(row);
+        }
+        return rows;
+    }
+
+    Result newResult() {
+        Result result;
+        result.set_continues(false);
+        result.mutable_rowschema()->CopyFrom(schema);
+        return result;
+    }
+
+    RowSchema schema;
+};
+
+BOOST_FIXTURE_TEST_SUITE(suite, Fixture)
+
+BOOST_AUTO_TEST_CASE(RoundTrip) {
+    ColumnBlockWriter writer(schema);
+    std::vector<Strings> rows {
+        {"1", "1.5", "0.1", "12.3400", "abc"},
+        {"-9223372036854775808", "0.123457", "-2.2250738585072014e-308", "NULL", ""},
+        {"NULL", "NULL", "NULL", "0.0", "NULL"},
+        {"9223372036854775807", "3.40282e+38", "1.7976931348623157e+308", "-1", "tab\there"}};
+    for (auto const& row : rows) {
+        addRow(writer, row);
+    }
+    BOOST_CHECK_EQUAL(writer.getRowCount(), 4);
+    BOOST_CHECK(writer.getByteSize() > 0);
+    Result result = newResult();
+    writer.moveTo(result);
+    BOOST_CHECK_EQUAL(writer.getRowCount(), 0);
+    BOOST_CHECK_EQUAL(result.row_size(), 0);
+    BOOST_REQUIRE_EQUAL(result.columnblock_size(), 5);
+    BOOST_CHECK_EQUAL(result.columnblock(0).encoding(), ColumnBlock::INT64);
+    BOOST_CHECK_EQUAL(result.columnblock(1).encoding(), ColumnBlock::FLOAT);
+    BOOST_CHECK_EQUAL(result.columnblock(2).encoding(), ColumnBlock::DOUBLE);
+    BOOST_CHECK_EQUAL(result.columnblock(3).encoding(), ColumnBlock::TEXT);
+    BOOST_CHECK(readRows(result) == rows);
+}
+
+/** @test
+ * Formatted FLOAT and DOUBLE values must read back as the values sent,
+ * as mysqld reads them.
+ */
+BOOST_AUTO_TEST_CASE(NumberRoundTrip) {
+    ColumnBlockWriter writer(schema);
+    std::vector<double> doubles;
+    std::vector<float> floats;
+    uint64_t seed = 12345;
+    char buf[64];
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double mantissa = static_cast<double>(seed >> 11) / (1ULL << 53) - 0.5;
+        int exponent = static_cast<int>(seed % 41) - 20;
+        std::snprintf(buf, sizeof(buf), "%.*g", 1 + i % 17, mantissa * std::pow(10.0, exponent));
+        std::string text(buf);
+        doubles.push_back(std::strtod(buf, nullptr));
+        floats.push_back(static_cast<float>(doubles.back()));
+        addRow(writer, {"0", text, text, "0", ""});
+    }
+    Result result = newResult();
+    writer.moveTo(result);
+    auto rows = readRows(result);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        BOOST_CHECK_EQUAL(static_cast<float>(std::strtod(rows[i][1].c_str(), nullptr)), floats[i]);
+        BOOST_CHECK_EQUAL(std::strtod(rows[i][2].c_str(), nullptr), doubles[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TextFallback) {
+    ColumnBlockWriter writer(schema);
+    addRow(writer, {"1", "1", "1", "1", "a"});
+    addRow(writer, {"NULL", "1", "1", "1", "a"});
+    addRow(writer, {"18446744073709551615", "1", "1", "1", "a"}); // UNSIGNED BIGINT
+    Result result = newResult();
+    writer.moveTo(result);
+    BOOST_CHECK_EQUAL(result.columnblock(0).encoding(), ColumnBlock::TEXT);
+    auto rows = readRows(result);
+    BOOST_CHECK_EQUAL(rows[0][0], "1");
+    BOOST_CHECK_EQUAL(rows[1][0], "NULL");
+    BOOST_CHECK_EQUAL(rows[2][0], "18446744073709551615");
+
+    // The next message starts over with the schema encoding.
+    addRow(writer, {"2", "1", "1", "1", "a"});
+    Result next = newResult();
+    writer.moveTo(next);
+    BOOST_CHECK_EQUAL(next.columnblock(0).encoding(), ColumnBlock::INT64);
+    BOOST_CHECK_EQUAL(readRows(next)[0][0], "2");
+}
+
+/** @test
+ * Rows added value by value, as fetched in the binary protocol
+ */
+BOOST_AUTO_TEST_CASE(TypedRows) {
+    ColumnBlockWriter writer(schema);
+    writer.addInt64(0, -42);
+    writer.addFloat(1, 0.25f);
+    writer.addDouble(2, 1e-300);
+    writer.addText(3, "1.50", 4);
+    writer.addText(4, "abc", 3);
+    writer.endRow();
+    writer.addNull(0);
+    writer.addNull(1);
+    writer.addInt64(2, 7); // Not a double: the column falls back to text
+    writer.addDouble(3, 2.5);
+    writer.addNull(4);
+    writer.endRow();
+    Result result = newResult();
+    writer.moveTo(result);
+    BOOST_CHECK_EQUAL(result.columnblock(0).encoding(), ColumnBlock::INT64);
+    BOOST_CHECK_EQUAL(result.columnblock(1).encoding(), ColumnBlock::FLOAT);
+    BOOST_CHECK_EQUAL(result.columnblock(2).encoding(), ColumnBlock::TEXT);
+    auto rows = readRows(result);
+    BOOST_CHECK(rows[0] == Strings({"-42", "0.25", "1e-300", "1.50", "abc"}));
+    BOOST_CHECK(rows[1] == Strings({"NULL", "NULL", "7", "2.5", "NULL"}));
+}
+
+BOOST_AUTO_TEST_CASE(ToRows) {
+    ColumnBlockWriter writer(schema);
+    addRow(writer, {"7", "2.5", "NULL", "1.10", "x"});
+    Result result = newResult();
+    writer.moveTo(result);
+    lsst::qserv::proto::columnsToRows(result);
+    BOOST_CHECK_EQUAL(result.columnblock_size(), 0);
+    BOOST_CHECK(!result.has_rowcount());
+    BOOST_REQUIRE_EQUAL(result.row_size(), 1);
+    BOOST_CHECK_EQUAL(lsst::qserv::proto::getRowCount(result), 1);
+    auto const& rb = result.row(0);
+    BOOST_CHECK_EQUAL(rb.column(0), "7");
+    BOOST_CHECK_EQUAL(rb.column(1), "2.5");
+    BOOST_CHECK(rb.isnull(2));
+    BOOST_CHECK_EQUAL(rb.column(3), "1.10");
+    BOOST_CHECK_EQUAL(rb.column(4), "x");
+}
+
+BOOST_AUTO_TEST_CASE(Invalid) {
+    ColumnBlockWriter writer(schema);
+    addRow(writer, {"1", "1", "1", "1", "abc"});
+    addRow(writer, {"2", "2", "2", "2", "de"});
+    Result result = newResult();
+    writer.moveTo(result);
+    BOOST_CHECK(ColumnBlockReader::isValid(result));
+
+    Result bad(result);
+    bad.mutable_columnblock(0)->mutable_values()->resize(12);
+    BOOST_CHECK(!ColumnBlockReader::isValid(bad));
+    bad = result;
+    bad.mutable_columnblock(4)->mutable_values()->resize(4); // Offsets run past values
+    BOOST_CHECK(!ColumnBlockReader::isValid(bad));
+    bad = result;
+    bad.set_rowcount(3);
+    BOOST_CHECK(!ColumnBlockReader::isValid(bad));
+    bad = result;
+    bad.mutable_columnblock()->RemoveLast();
+    BOOST_CHECK(!ColumnBlockReader::isValid(bad));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -116,7 +116,9 @@ struct ProtocolFixture : public lsst::qserv::proto::FakeProtocolFixture {
                               lsst::qserv::proto::ProtoHeader const& p2) {
         return ((p1.protocol() == p2.protocol())
                 && (p1.size() == p2.size())
-                && (p1.md5() == p2.md5()));
+                && (p1.md5() == p2.md5())
+                && (p1.checksumtype() == p2.checksumtype())
+                && (p1.checksum() == p2.checksum()));
     }
 
     int counter;
@@ -137,9 +137,16 @@ PostPlugin::applyPhysical(QueryPlugin::Plan& plan,
     if (_limit != NOTSET) {
         // [ORDER BY ...] LIMIT ... is a special case which require sort on worker and sort/aggregation on czar
         if (context.hasChunks()) {
-             LOGS(_log, LOG_LVL_DEBUG, "Add merge operation");
-             context.needsMerge = true;
-         }
+            // Without aggregation (which already requested a merge), DISTINCT
+            // or GROUP BY, the merge step only sorts and truncates whole
+            // rows, so the czar may stop merging rows once it has enough.
+            if (!context.needsMerge && !plan.stmtOriginal.hasGroupBy()
+                && !plan.stmtOriginal.hasHaving()) {
+                context.mergeRowLimit = _limit;
+            }
+            LOGS(_log, LOG_LVL_DEBUG, "Add merge operation");
+            context.needsMerge = true;
+        }
     } else if (_orderBy) {
         // If there is no LIMIT clause, remove ORDER BY clause from all Czar queries because it is performed by
         // mysql-proxy (mysql doesn't garantee result order for non ORDER BY queries)
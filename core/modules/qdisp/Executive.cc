@@ -188,8 +188,17 @@ bool Executive::join() {
         LOGS(_log, LOG_LVL_ERROR, "Query execution failed: " << _requestCount
              << " jobs dispatched, but only " << sCount << " jobs completed");
     }
+    bool limitSatisfied = false;
+    if (_limitSquashed) {
+        // Jobs squashed once the LIMIT was reached do not count as failures,
+        // but errors recorded before that do.
+        std::lock_guard<std::mutex> lock(_errorsMutex);
+        limitSatisfied = _multiError.empty();
+        LOGS(_log, LOG_LVL_DEBUG, "Query execution stopped after " << _resultRows
+             << " rows for LIMIT " << _rowLimit << ", errors=" << !limitSatisfied);
+    }
     _updateProxyMessages();
-    bool empty = (sCount == _requestCount);
+    bool empty = (sCount == _requestCount) || limitSatisfied;
     _empty.store(empty);
     LOGS(_log, LOG_LVL_DEBUG, "Flag set to _empty=" << empty << ", sCount=" << sCount
          << ", requestCount=" << _requestCount);
@@ -201,6 +210,12 @@ void Executive::markCompleted(int jobId, bool success) {
     std::string idStr = qmeta::QueryIdHelper::makeIdStr(_id, jobId);
     LOGS(_log, LOG_LVL_DEBUG, "Executive::markCompleted " << idStr
             << " " << success);
+    if (!success && _limitSquashed) {
+        // The job was squashed (or failed) after enough rows were merged.
+        LOGS(_log, LOG_LVL_DEBUG, "Executive: " << idStr << " ended after LIMIT was reached");
+        _unTrack(jobId);
+        return;
+    }
     if (!success) {
         {
             std::lock_guard<std::mutex> lock(_incompleteJobsMutex);
@@ -231,7 +246,25 @@ void Executive::markCompleted(int jobId, bool success) {
         LOGS(_log, LOG_LVL_ERROR, "Executive: requesting squash, cause: "
              << idStr << " failed (code=" << err.getCode() << " " << err.getMsg() << ")");
         squash(); // ask to squash
+    } else {
+        _squashIfLimitReached();
+    }
+}
+
+/// Squash the remaining jobs if enough rows have been merged to satisfy the
+/// query. This is only done from markCompleted(), once a job has finished
+/// delivering its rows, so that no job is cancelled while it is merging.
+void Executive::_squashIfLimitReached() {
+    int64_t rowLimit = _rowLimit;
+    if (rowLimit <= 0 || _resultRows < rowLimit || _cancelled) {
+        return;
+    }
+    if (_limitSquashed.exchange(true)) {
+        return;
     }
+    LOGS(_log, LOG_LVL_INFO, _idStr << " Executive: " << _resultRows << " rows merged for LIMIT "
+         << rowLimit << ", squashing remaining jobs");
+    squash();
 }
 
 
@@ -28,6 +28,7 @@
 
 // System headers
 #include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <sstream>
 #include <vector>
@@ -91,6 +92,19 @@ public:
     /// Squash all the jobs.
     void squash();
 
+    /// Set the number of merged result rows that satisfies the query
+    /// (a LIMIT without ORDER BY or aggregation). Once that many rows have
+    /// been merged, and a job has completed, the remaining jobs are squashed
+    /// and the query still succeeds. 0 (the default) means no limit.
+    void setRowLimit(int64_t rowLimit) { _rowLimit = rowLimit; }
+
+    /// Record rowCount result rows as merged.
+    void addResultRows(int64_t rowCount) { _resultRows += rowCount; }
+
+    /// @return true if the remaining jobs were squashed because enough rows
+    /// had been merged.
+    bool getLimitSquashed() const { return _limitSquashed; }
+
     bool getEmpty() { return _empty; }
 
     void setQueryId(qmeta::QueryId id);
@@ -128,6 +142,8 @@ private:
 
     void _waitAllUntilEmpty();
 
+    void _squashIfLimitReached();
+
     // for debugging
     void _printState(std::ostream& os);
 
@@ -144,6 +160,10 @@ private:
     int _requestCount; ///< Count of submitted jobs
     util::Flag<bool> _cancelled {false}; ///< Has execution been cancelled.
 
+    std::atomic<int64_t> _rowLimit {0}; ///< Rows satisfying the query, 0 if unlimited
+    std::atomic<int64_t> _resultRows {0}; ///< Rows merged so far
+    std::atomic<bool> _limitSquashed {false}; ///< Squashed because _rowLimit was reached
+
     // Mutexes
     std::mutex _incompleteJobsMutex; ///< protect incompleteJobs map.
 
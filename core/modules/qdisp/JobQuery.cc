@@ -114,18 +114,21 @@ void JobQuery::provisioningFailed(std::string const& msg, int code) {
 bool JobQuery::cancel() {
     LOGS_DEBUG(getIdStr() << " JobQuery::cancel()");
     if (_cancelled.exchange(true) == false) {
-        std::lock_guard<std::recursive_mutex> lock(_rmutex);
-        // If _queryRequestPtr is not nullptr, then this job has been passed to xrootd and cancellation is complicated.
-        if (_queryRequestPtr != nullptr) {
-            LOGS_DEBUG(getIdStr() << " cancel QueryRequest in progress");
-            _queryRequestPtr->cancel();
-        } else {
-            std::ostringstream os;
-            os << getIdStr() <<" cancel before QueryRequest" ;
-            LOGS_DEBUG(os.str());
-            getDescription().respHandler()->errorFlush(os.str(), -1);
-            _executive->markCompleted(getIdInt(), false);
+        {
+            std::lock_guard<std::recursive_mutex> lock(_rmutex);
+            // If _queryRequestPtr is not nullptr, then this job has been passed to xrootd and cancellation is complicated.
+            if (_queryRequestPtr != nullptr) {
+                LOGS_DEBUG(getIdStr() << " cancel QueryRequest in progress");
+                _queryRequestPtr->cancel();
+            } else {
+                std::ostringstream os;
+                os << getIdStr() <<" cancel before QueryRequest" ;
+                LOGS_DEBUG(os.str());
+                getDescription().respHandler()->errorFlush(os.str(), -1);
+                _executive->markCompleted(getIdInt(), false);
+            }
         }
+        // This may wait for results being merged, so not while holding _rmutex.
         _jobDescription.respHandler()->processCancel();
         return true;
     }
@@ -65,6 +65,7 @@ public:
     std::string const& getIdStr() const { return _idStr; }
     JobDescription& getDescription() { return _jobDescription; }
     JobStatus::Ptr getStatus() { return _jobStatus; }
+    Executive* getExecutive() { return _executive; }
 
     void setQueryRequest(std::shared_ptr<QueryRequest> const& qr) {
         std::lock_guard<std::recursive_mutex> lock(_rmutex);
@@ -210,6 +210,10 @@ void QueryRequest::ProcessResponseData(char *buff, int blen, bool last) { // Ste
     }
     jq->getStatus()->updateInfo(JobStatus::RESPONSE_DATA);
     bool flushOk = jq->getDescription().respHandler()->flush(blen, last);
+    if (flushOk && last) {
+        // The handler may still be merging earlier buffers.
+        flushOk = jq->getDescription().respHandler()->drain();
+    }
     if (flushOk) {
         if (last) {
             auto sz = jq->getDescription().respHandler()->nextBuffer().size();
@@ -231,6 +235,7 @@ void QueryRequest::ProcessResponseData(char *buff, int blen, bool last) { // Ste
         }
     } else {
         LOGS(_log, LOG_LVL_DEBUG, _jobIdStr << " ProcessResponse data flush failed");
+        jq->getDescription().respHandler()->drain(); // Let pending merges end first.
         ResponseHandler::Error err = jq->getDescription().respHandler()->getError();
         jq->getStatus()->updateInfo(JobStatus::MERGE_ERROR, err.getCode(), err.getMsg());
         // @todo DM-2378 Take a closer look at what causes this error and take
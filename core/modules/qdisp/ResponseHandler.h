@@ -50,9 +50,11 @@ public:
 
     typedef std::shared_ptr<ResponseHandler> Ptr;
     ResponseHandler() {}
-    void setJobQuery(std::shared_ptr<JobQuery> const& jobQuery) { _jobQuery = jobQuery; }
     virtual ~ResponseHandler() {}
 
+    /// Set the job this handler receives results for.
+    virtual void setJobQuery(std::shared_ptr<JobQuery> const& jobQuery) { _jobQuery = jobQuery; }
+
     /// @return a char vector to receive the next message. The vector
     /// should be sized to the request size. The buffer will be filled
     /// before flush(), unless the response is completed (no more
@@ -67,6 +69,11 @@ public:
     /// Signal an unrecoverable error condition. No further calls are expected.
     virtual void errorFlush(std::string const& msg, int code) = 0;
 
+    /// Block until the data passed to flush() has been fully processed, for
+    /// handlers that process it asynchronously.
+    /// @return true if it was processed without error
+    virtual bool drain() { return true; }
+
     /// @return true if the receiver has completed its duties.
     virtual bool finished() const = 0;
     virtual bool reset() = 0; ///< Reset the state that a request can be retried.
@@ -233,6 +233,10 @@ QuerySession::getMergeStmt() const {
     }
 }
 
+int QuerySession::getMergeRowLimit() const {
+    return _context->mergeRowLimit;
+}
+
 void QuerySession::finalize() {
     if (_isFinal) {
         return;
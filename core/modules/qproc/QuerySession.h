@@ -123,6 +123,11 @@ public:
 
     std::shared_ptr<query::SelectStmt> getMergeStmt() const;
 
+    /// @return the LIMIT the czar may apply to chunk result rows as they are
+    /// merged, or NOTSET if all rows must be merged.
+    /// @see query::QueryContext::mergeRowLimit
+    int getMergeRowLimit() const;
+
     /// Finalize a query after chunk coverage has been updated
     void finalize();
     // Iteration
@@ -60,8 +60,10 @@ namespace qproc {
 ////////////////////////////////////////////////////////////////////////
 class TaskMsgFactory::Impl {
 public:
-    Impl(uint64_t session, std::string const& resultTable)
-        : _session(session), _resultTable(resultTable) {
+    Impl(uint64_t session, std::string const& resultTable, int resultProtocol,
+         int compressionLevel)
+        : _session(session), _resultTable(resultTable),
+          _resultProtocol(resultProtocol), _compressionLevel(compressionLevel) {
     }
     std::shared_ptr<proto::TaskMsg> makeMsg(ChunkQuerySpec const& s,
                                             std::string const& chunkResultName,
@@ -93,6 +95,8 @@ private:
 
     uint64_t _session;
     std::string _resultTable;
+    int _resultProtocol;
+    int _compressionLevel;
     std::shared_ptr<proto::TaskMsg> _taskMsg;
 };
 
@@ -106,7 +110,12 @@ TaskMsgFactory::Impl::makeMsg(ChunkQuerySpec const& s,
     // shared
     _taskMsg->set_session(_session);
     _taskMsg->set_db(s.db);
-    _taskMsg->set_protocol(2);
+    _taskMsg->set_protocol(_resultProtocol);
+    _taskMsg->set_checksumtype(proto::ProtoHeader::CRC32C);
+    if (_compressionLevel > 0) {
+        _taskMsg->set_compression(proto::ProtoHeader::ZLIB);
+        _taskMsg->set_compressionlevel(_compressionLevel);
+    }
     _taskMsg->set_queryid(queryId);
     _taskMsg->set_jobid(jobId);
     // scanTables (for shared scans)
@@ -161,8 +170,8 @@ TaskMsgFactory::Impl::makeMsg(ChunkQuerySpec const& s,
 ////////////////////////////////////////////////////////////////////////
 // class TaskMsgFactory
 ////////////////////////////////////////////////////////////////////////
-TaskMsgFactory::TaskMsgFactory(uint64_t session)
-    : _impl(std::make_shared<Impl>(session, "Asdfasfd" )) {
+TaskMsgFactory::TaskMsgFactory(uint64_t session, int resultProtocol, int compressionLevel)
+    : _impl(std::make_shared<Impl>(session, "Asdfasfd", resultProtocol, compressionLevel)) {
 }
 
 void TaskMsgFactory::serializeMsg(ChunkQuerySpec const& s,
@@ -173,4 +182,26 @@ void TaskMsgFactory::serializeMsg(ChunkQuerySpec const& s,
     m->SerializeToOstream(&os);
 }
 
+void TaskMsgFactory::serializeMsg(std::vector<ChunkQuerySpec const*> const& specs,
+                                  std::vector<std::string> const& chunkResultNames,
+                                  uint64_t queryId, int jobId,
+                                  std::ostream& os) {
+    if (specs.empty() || specs.size() != chunkResultNames.size()) {
+        throw QueryProcessingBug("TaskMsgFactory: mismatched multi-chunk specs");
+    }
+    std::shared_ptr<proto::TaskMsg> m = _impl->makeMsg(*specs[0], chunkResultNames[0],
+                                                       queryId, jobId);
+    for (size_t i = 1; i < specs.size(); ++i) {
+        if (specs[i]->db != specs[0]->db) {
+            throw QueryProcessingBug("TaskMsgFactory: multi-chunk specs of several dbs");
+        }
+        std::shared_ptr<proto::TaskMsg> chunkMsg = _impl->makeMsg(*specs[i], chunkResultNames[i],
+                                                                  queryId, jobId);
+        proto::TaskMsg::ChunkBlock* block = m->add_chunkblock();
+        block->set_chunkid(specs[i]->chunkId);
+        block->mutable_fragment()->Swap(chunkMsg->mutable_fragment());
+    }
+    m->SerializeToOstream(&os);
+}
+
 }}} // namespace lsst::qserv::qproc
@@ -34,6 +34,8 @@
 // System headers
 #include <iostream>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace lsst {
 namespace qserv {
@@ -44,13 +46,26 @@ class ChunkQuerySpec;
 /// TaskMsgFactory is a factory for TaskMsg (protobuf) objects.
 class TaskMsgFactory {
 public:
-    TaskMsgFactory(uint64_t session);
+    /// @param resultProtocol result protocol requested from workers
+    /// @param compressionLevel zlib level of results requested from
+    ///        workers, 0 for none
+    TaskMsgFactory(uint64_t session, int resultProtocol=2, int compressionLevel=0);
 
     /// Construct a TaskMsg and serialize it to a stream
     void serializeMsg(ChunkQuerySpec const& s,
                       std::string const& chunkResultName,
                       uint64_t queryId, int jobId,
                       std::ostream& os);
+
+    /// Construct a TaskMsg for several chunks of the same database, to be
+    /// run by the worker holding all of them, and serialize it to a stream.
+    /// The message is addressed to the first chunk, the others go in
+    /// TaskMsg.chunkblock.
+    /// @param chunkResultNames result table of each chunk of specs
+    void serializeMsg(std::vector<ChunkQuerySpec const*> const& specs,
+                      std::vector<std::string> const& chunkResultNames,
+                      uint64_t queryId, int jobId,
+                      std::ostream& os);
 private:
     class Impl;
 
@@ -134,6 +134,7 @@ BOOST_AUTO_TEST_CASE(Limit) {
     }
 
     BOOST_CHECK_EQUAL(ss.getLimit(), 2);
+    BOOST_CHECK_EQUAL(context->mergeRowLimit, 2);
 }
 
 BOOST_AUTO_TEST_CASE(OrderBy) {
@@ -617,7 +618,9 @@ BOOST_AUTO_TEST_CASE(Petasky1) {
     // An example slow query from French Petasky colleagues
     std::string stmt = "SELECT objectId as id, COUNT(sourceId) AS c"
         " FROM Source GROUP BY objectId HAVING  c > 1000 LIMIT 10;";
-    queryAnaHelper.buildQuerySession(qsTest, stmt);
+    std::shared_ptr<QuerySession> qs = queryAnaHelper.buildQuerySession(qsTest, stmt);
+    // Aggregated rows cannot be limited before they are merged.
+    BOOST_CHECK_EQUAL(qs->getMergeRowLimit(), lsst::qserv::NOTSET);
 }
 
 BOOST_AUTO_TEST_CASE(Expression) {
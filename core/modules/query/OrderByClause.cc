@@ -83,6 +83,16 @@ public:
 ////////////////////////////////////////////////////////////////////////
 // OrderByTerm
 ////////////////////////////////////////////////////////////////////////
+OrderByTerm::Order
+OrderByTerm::getOrder() const {
+    return _order;
+}
+
+std::string
+OrderByTerm::getCollate() const {
+    return _collate;
+}
+
 void
 OrderByTerm::renderTo(QueryTemplate& qt) const {
     ValueExpr::render r(qt, true);
@@ -67,6 +67,7 @@ public:
 
     std::string sqlFragment() const;
     std::shared_ptr<ValueExpr>& getExpr() { return _expr; }
+    std::shared_ptr<ValueExpr const> getExpr() const { return _expr; }
     Order getOrder() const;
     std::string getCollate() const;
     void renderTo(QueryTemplate& qt) const;
@@ -96,6 +97,7 @@ public:
     std::shared_ptr<OrderByClause> copySyntax();
 
     void findValueExprs(ValueExprPtrVector& list);
+    OrderByTermVector const& getTerms() const { return *_terms; }
 private:
     friend std::ostream& operator<<(std::ostream& os, OrderByClause const& oc);
     friend class parser::ModFactory;
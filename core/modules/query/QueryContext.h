@@ -35,6 +35,7 @@
 
 // Local headers
 #include "css/CssAccess.h"
+#include "global/constants.h"
 #include "proto/ScanTableInfo.h"
 #include "qana/QueryMapping.h"
 #include "query/DbTablePair.h"
@@ -60,7 +61,7 @@ class QueryContext {
 public:
     typedef std::shared_ptr<QueryContext> Ptr;
 
-    QueryContext() : chunkCount(0), needsMerge(false) {}
+    QueryContext() : chunkCount(0), needsMerge(false), mergeRowLimit(NOTSET) {}
     typedef std::vector<std::shared_ptr<QsRestrictor> > RestrList;
 
     std::shared_ptr<css::CssAccess> css;  ///< interface to CSS
@@ -84,6 +85,12 @@ public:
 
     bool needsMerge; ///< Does this query require a merge/post-processing step?
 
+    /// LIMIT of a chunked query whose merge step only sorts and truncates
+    /// whole result rows (no aggregation, DISTINCT or GROUP BY). Chunk result
+    /// rows that cannot be part of the final result need not be merged.
+    /// NOTSET if every row must be merged.
+    int mergeRowLimit;
+
     css::StripingParams getDbStriping() {
         return css->getDbStriping(dominantDb); }
     bool containsDb(std::string const& dbName) {
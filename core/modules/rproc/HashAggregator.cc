@@ -0,0 +1,405 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "rproc/HashAggregator.h"
+
+// System headers
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+// Third-party headers
+#include <mysql/mysql.h>
+
+// LSST headers
+#include "lsst/log/Log.h"
+
+// Qserv headers
+#include "proto/WorkerResponse.h"
+#include "query/ColumnRef.h"
+#include "query/FuncExpr.h"
+#include "query/GroupByClause.h"
+#include "query/SelectList.h"
+#include "query/SelectStmt.h"
+#include "query/ValueExpr.h"
+#include "query/ValueFactor.h"
+
+namespace { // File-scope helpers
+
+LOG_LOGGER _log = LOG_GET("lsst.qserv.rproc.HashAggregator");
+
+using lsst::qserv::query::FuncExpr;
+using lsst::qserv::query::ValueExpr;
+using lsst::qserv::query::ValueExprPtr;
+using lsst::qserv::query::ValueExprPtrVector;
+using lsst::qserv::query::ValueFactor;
+using lsst::qserv::rproc::HashAggregator;
+
+typedef HashAggregator::Fold Fold;
+typedef std::unordered_map<std::string, Fold> FoldMap;
+
+/// Rows per response handed back for loading
+size_t const ROWS_PER_RESPONSE = 10000;
+
+std::string toLower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+/// @return the fold operator for a merge function name, or Fold::KEY if the
+/// function is not a merge operator.
+Fold mergeOperator(std::string const& funcName) {
+    std::string name = toLower(funcName);
+    if (name == "sum") { return Fold::SUM; }
+    if (name == "min") { return Fold::MIN; }
+    if (name == "max") { return Fold::MAX; }
+    return Fold::KEY;
+}
+
+/// Record that column is used with fold. A column is either a key (used
+/// outside merge operators) or folded with exactly one operator.
+/// @return false if column was already used otherwise.
+bool noteColumn(std::string const& column, Fold fold, FoldMap& folds) {
+    auto result = folds.insert(std::make_pair(toLower(column), fold));
+    return result.second || result.first->second == fold;
+}
+
+bool collectFolds(ValueExpr const& expr, FoldMap& folds, bool& hasAgg);
+
+bool collectFolds(ValueFactor const& factor, FoldMap& folds, bool& hasAgg) {
+    switch(factor.getType()) {
+    case ValueFactor::COLUMNREF:
+        return noteColumn(factor.getColumnRef()->column, Fold::KEY, folds);
+    case ValueFactor::CONST:
+        return true;
+    case ValueFactor::EXPR:
+        return factor.getExpr() && collectFolds(*factor.getExpr(), folds, hasAgg);
+    case ValueFactor::FUNCTION:
+    case ValueFactor::AGGFUNC:
+        {
+            std::shared_ptr<FuncExpr const> fe = factor.getFuncExpr();
+            if (!fe) { return false; }
+            Fold fold = mergeOperator(fe->name);
+            if (fold != Fold::KEY) {
+                // Merge operators written by AggregatePlugin take one column.
+                if (fe->params.size() != 1 || !fe->params[0]
+                    || !fe->params[0]->isColumnRef()) {
+                    return false;
+                }
+                hasAgg = true;
+                return noteColumn(fe->params[0]->getColumnRef()->column, fold, folds);
+            }
+            if (factor.getType() == ValueFactor::AGGFUNC) {
+                return false; // Not a merge operator, e.g. COUNT
+            }
+            for (auto const& param : fe->params) {
+                if (!param || !collectFolds(*param, folds, hasAgg)) { return false; }
+            }
+            return true;
+        }
+    default:
+        return false; // STAR and anything unknown
+    }
+}
+
+bool collectFolds(ValueExpr const& expr, FoldMap& folds, bool& hasAgg) {
+    for (auto const& factorOp : expr.getFactorOps()) {
+        if (!factorOp.factor || !collectFolds(*factorOp.factor, folds, hasAgg)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Parse s as a 64-bit integer, accepting nothing but optional sign and digits.
+bool parseInt(std::string const& s, long long& val) {
+    if (s.empty() || s.size() > 20) { return false; }
+    char const* begin = s.c_str();
+    char* end = nullptr;
+    errno = 0;
+    val = std::strtoll(begin, &end, 10);
+    return errno == 0 && end == begin + s.size() && !std::isspace(s[0]);
+}
+
+bool parseDouble(std::string const& s, long double& val) {
+    if (s.empty() || std::isspace(s[0])) { return false; }
+    char const* begin = s.c_str();
+    char* end = nullptr;
+    val = std::strtold(begin, &end);
+    return end == begin + s.size();
+}
+
+bool isFloatType(int mysqlType) {
+    return mysqlType == MYSQL_TYPE_FLOAT || mysqlType == MYSQL_TYPE_DOUBLE;
+}
+
+bool isNumericType(int mysqlType) {
+    switch(mysqlType) {
+    case MYSQL_TYPE_TINY: case MYSQL_TYPE_SHORT: case MYSQL_TYPE_INT24:
+    case MYSQL_TYPE_LONG: case MYSQL_TYPE_LONGLONG:
+    case MYSQL_TYPE_FLOAT: case MYSQL_TYPE_DOUBLE:
+    case MYSQL_TYPE_DECIMAL: case MYSQL_TYPE_NEWDECIMAL:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// Append a length-prefixed value (or a null marker) to key.
+void appendKeyPart(std::string& key, std::string const& val, bool isNull) {
+    if (isNull) {
+        key.push_back('\0');
+        return;
+    }
+    std::uint32_t len = val.size();
+    key.push_back('\1');
+    key.append(reinterpret_cast<char const*>(&len), sizeof(len));
+    key.append(val);
+}
+
+} // anonymous namespace
+
+namespace lsst {
+namespace qserv {
+namespace rproc {
+
+HashAggregator::Ptr
+HashAggregator::newHashAggregator(query::SelectStmt& mergeStmt, size_t maxGroups) {
+    // Filtering and DISTINCT are applied per row, so they cannot be
+    // applied after folding.
+    if (mergeStmt.hasWhereClause() || mergeStmt.hasHaving() || mergeStmt.getDistinct()) {
+        return Ptr();
+    }
+    FoldMap folds;
+    bool hasAgg = false;
+    auto selectExprs = mergeStmt.getSelectList().getValueExprList();
+    if (!selectExprs) { return Ptr(); }
+    for (auto const& expr : *selectExprs) {
+        if (!expr || !collectFolds(*expr, folds, hasAgg)) {
+            LOGS(_log, LOG_LVL_DEBUG, "Merge statement is not foldable");
+            return Ptr();
+        }
+    }
+    if (mergeStmt.hasGroupBy()) {
+        ValueExprPtrVector groupExprs;
+        mergeStmt.getGroupBy().findValueExprs(groupExprs);
+        for (auto const& expr : groupExprs) {
+            if (!expr || !collectFolds(*expr, folds, hasAgg)) { return Ptr(); }
+        }
+    }
+    if (!hasAgg) { return Ptr(); }
+    // Keys need not be listed: any column without a fold is a key.
+    for (auto i = folds.begin(); i != folds.end(); ) {
+        if (i->second == Fold::KEY) {
+            i = folds.erase(i);
+        } else {
+            ++i;
+        }
+    }
+    return std::make_shared<HashAggregator>(folds, maxGroups);
+}
+
+HashAggregator::HashAggregator(std::unordered_map<std::string, Fold> const& columnFolds,
+                               size_t maxGroups)
+    : _columnFolds(columnFolds),
+      _maxGroupsPerShard(std::max<size_t>(1, maxGroups / SHARD_COUNT)) {
+}
+
+void HashAggregator::_initSchema(proto::RowSchema const& schema) {
+    _schema = schema;
+    for (auto const& col : schema.columnschema()) {
+        auto i = _columnFolds.find(toLower(col.name()));
+        _folds.push_back(i == _columnFolds.end() ? Fold::KEY : i->second);
+        _mysqlTypes.push_back(col.has_mysqltype() ? col.mysqltype() : -1);
+    }
+}
+
+bool HashAggregator::add(proto::Result const& result, ResponseVector& toLoad) {
+    if (result.row_size() == 0) {
+        return true;
+    }
+    std::call_once(_schemaOnce, [this, &result]() { _initSchema(result.rowschema()); });
+    for (auto const& rb : result.row()) {
+        if (static_cast<size_t>(rb.column_size()) != _folds.size()) {
+            LOGS(_log, LOG_LVL_ERROR, "HashAggregator: row has " << rb.column_size()
+                 << " columns, schema has " << _folds.size());
+            return false;
+        }
+    }
+    _rowsIn += result.row_size();
+    std::hash<std::string> hasher;
+    for (auto const& rb : result.row()) {
+        std::string key = _makeKey(rb);
+        Shard& shard = _shards[hasher(key) % SHARD_COUNT];
+        std::vector<Row> full;
+        {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            auto iter = shard.index.find(key);
+            if (iter != shard.index.end() && _fold(shard.rows[iter->second], rb)) {
+                continue;
+            }
+            Row row;
+            row.columns.reserve(rb.column_size());
+            for (int i = 0; i < rb.column_size(); ++i) {
+                row.columns.push_back(rb.column(i));
+                row.isNull.push_back(i < rb.isnull_size() && rb.isnull(i));
+            }
+            if (iter == shard.index.end()) {
+                shard.index.insert(std::make_pair(std::move(key), shard.rows.size()));
+            }
+            shard.rows.push_back(std::move(row));
+            if (shard.rows.size() > _maxGroupsPerShard) {
+                full.swap(shard.rows);
+                shard.index.clear();
+            }
+        }
+        if (!full.empty()) {
+            LOGS(_log, LOG_LVL_DEBUG, "HashAggregator shard full, releasing "
+                 << full.size() << " rows");
+            ResponseVector r = _toResponses(full);
+            toLoad.insert(toLoad.end(), r.begin(), r.end());
+        }
+    }
+    return true;
+}
+
+HashAggregator::ResponseVector HashAggregator::flush() {
+    ResponseVector responses;
+    for (auto& shard : _shards) {
+        std::vector<Row> rows;
+        {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            rows.swap(shard.rows);
+            shard.index.clear();
+        }
+        ResponseVector r = _toResponses(rows);
+        responses.insert(responses.end(), r.begin(), r.end());
+    }
+    return responses;
+}
+
+std::string HashAggregator::_makeKey(proto::RowBundle const& rb) const {
+    std::string key;
+    for (size_t i = 0, e = _folds.size(); i < e; ++i) {
+        if (_folds[i] == Fold::KEY) {
+            bool isNull = static_cast<int>(i) < rb.isnull_size() && rb.isnull(i);
+            appendKeyPart(key, rb.column(i), isNull);
+        }
+    }
+    return key;
+}
+
+/// Fold the values of rb into acc. Nothing is changed unless every column
+/// can be folded.
+bool HashAggregator::_fold(Row& acc, proto::RowBundle const& rb) const {
+    std::vector<std::pair<size_t, std::string>> updates;
+    for (size_t i = 0, e = _folds.size(); i < e; ++i) {
+        if (_folds[i] == Fold::KEY) { continue; }
+        bool valNull = static_cast<int>(i) < rb.isnull_size() && rb.isnull(i);
+        if (valNull) { continue; } // Aggregates ignore nulls
+        if (acc.isNull[i]) {
+            updates.push_back(std::make_pair(i, rb.column(i)));
+            continue;
+        }
+        std::string folded = acc.columns[i];
+        if (!_foldValue(_folds[i], _mysqlTypes[i], folded, rb.column(i))) {
+            return false;
+        }
+        updates.push_back(std::make_pair(i, std::move(folded)));
+    }
+    for (auto& u : updates) {
+        acc.columns[u.first].swap(u.second);
+        acc.isNull[u.first] = false;
+    }
+    return true;
+}
+
+/// Fold val into acc.
+/// @return false if the result cannot be represented exactly as text that
+/// MySQL would compute the same way.
+bool HashAggregator::_foldValue(Fold fold, int mysqlType,
+                                std::string& acc, std::string const& val) const {
+    long long a, b;
+    bool isInt = parseInt(acc, a) && parseInt(val, b);
+    if (fold == Fold::SUM) {
+        if (isInt) {
+            long long sum;
+            if (__builtin_add_overflow(a, b, &sum)) { return false; }
+            acc = std::to_string(sum);
+            return true;
+        }
+        long double x, y;
+        if (isFloatType(mysqlType) && parseDouble(acc, x) && parseDouble(val, y)) {
+            // MySQL sums FLOAT and DOUBLE columns as doubles.
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.17g",
+                          static_cast<double>(x) + static_cast<double>(y));
+            acc = buf;
+            return true;
+        }
+        return false;
+    }
+    bool takeVal;
+    if (isInt) {
+        takeVal = (fold == Fold::MIN) ? b < a : b > a;
+    } else {
+        long double x, y;
+        if (!isNumericType(mysqlType) || !parseDouble(acc, x) || !parseDouble(val, y)) {
+            return false;
+        }
+        if (x == y) {
+            return acc == val; // Equal values with different text (e.g. 1.0, 1.00)
+        }
+        takeVal = (fold == Fold::MIN) ? y < x : y > x;
+    }
+    if (takeVal) { acc = val; }
+    return true;
+}
+
+HashAggregator::ResponseVector HashAggregator::_toResponses(std::vector<Row>& rows) {
+    ResponseVector responses;
+    std::shared_ptr<proto::WorkerResponse> response;
+    for (auto& row : rows) {
+        if (!response || response->result.row_size() >= static_cast<int>(ROWS_PER_RESPONSE)) {
+            response = std::make_shared<proto::WorkerResponse>();
+            response->result.set_continues(false);
+            response->result.mutable_rowschema()->CopyFrom(_schema);
+            responses.push_back(response);
+        }
+        proto::RowBundle* rb = response->result.add_row();
+        for (size_t i = 0, e = row.columns.size(); i < e; ++i) {
+            rb->add_column()->swap(row.columns[i]);
+            rb->add_isnull(row.isNull[i]);
+        }
+    }
+    _rowsOut += rows.size();
+    rows.clear();
+    return responses;
+}
+
+}}} // namespace lsst::qserv::rproc
@@ -0,0 +1,138 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_RPROC_HASHAGGREGATOR_H
+#define LSST_QSERV_RPROC_HASHAGGREGATOR_H
+
+// System headers
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Qserv headers
+#include "proto/worker.pb.h"
+
+// Forward declarations
+namespace lsst {
+namespace qserv {
+namespace proto {
+    struct WorkerResponse;
+}
+namespace query {
+    class SelectStmt;
+}
+}} // End of forward declarations
+
+namespace lsst {
+namespace qserv {
+namespace rproc {
+
+/// HashAggregator folds partial aggregate rows from chunk results in memory,
+/// as they arrive, so that the merge table receives (about) one row per group
+/// instead of one row per group per chunk.
+///
+/// The merge statement written by qana::AggregatePlugin combines per-chunk
+/// partial results with SUM (of COUNTs and SUMs, and both halves of AVG), MIN
+/// and MAX (the merge operators of query::AggOp::Mgr). Rows sharing the
+/// values of all other columns (the group key) are folded with the same
+/// operator. The merge statement is still applied to the folded rows, so the
+/// folding only has to be correct, not complete: keys are compared bytewise
+/// (MySQL may further group them by collation), and when a value cannot be
+/// folded exactly (e.g. a SUM of fractional DECIMALs, a MIN of strings) the
+/// row is kept unfolded.
+///
+/// Group state is sharded by key hash, so concurrent add() calls from
+/// different result streams rarely contend. When the number of groups held
+/// exceeds a limit, groups are handed back to the caller for loading, which
+/// bounds memory for high-cardinality GROUP BY.
+class HashAggregator {
+public:
+    typedef std::shared_ptr<HashAggregator> Ptr;
+    typedef std::vector<std::shared_ptr<proto::WorkerResponse>> ResponseVector;
+
+    /// Per-column fold operators
+    enum class Fold { KEY, SUM, MIN, MAX };
+
+    /// @return a HashAggregator for mergeStmt, or nullptr when the merge
+    /// statement is not a simple aggregation that can be folded.
+    /// @param maxGroups groups held in memory before they are flushed.
+    static Ptr newHashAggregator(query::SelectStmt& mergeStmt, size_t maxGroups);
+
+    /// Fold the rows of result.
+    /// @param toLoad receives responses holding rows that must be loaded now
+    /// to stay under the group limit (usually none).
+    /// @return false, folding nothing, if a row does not match the schema
+    bool add(proto::Result const& result, ResponseVector& toLoad);
+
+    /// @return responses holding all remaining groups.
+    ResponseVector flush();
+
+    /// @return number of rows passed to add()
+    size_t getRowsIn() const { return _rowsIn; }
+    /// @return number of rows returned for loading
+    size_t getRowsOut() const { return _rowsOut; }
+
+    /// @param columnFolds fold operator of each aggregated column, by
+    /// lowercase column name. Other columns are part of the group key.
+    HashAggregator(std::unordered_map<std::string, Fold> const& columnFolds, size_t maxGroups);
+
+private:
+    /// A row being folded: column values and null flags.
+    struct Row {
+        std::vector<std::string> columns;
+        std::vector<bool> isNull;
+    };
+    /// Groups whose key hashes to the same shard.
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_map<std::string, size_t> index; ///< key -> position in rows
+        std::vector<Row> rows; ///< Folded rows, and rows that could not be folded
+    };
+
+    void _initSchema(proto::RowSchema const& schema);
+    std::string _makeKey(proto::RowBundle const& rb) const;
+    bool _fold(Row& acc, proto::RowBundle const& rb) const;
+    bool _foldValue(Fold fold, int mysqlType, std::string& acc, std::string const& val) const;
+    ResponseVector _toResponses(std::vector<Row>& rows);
+
+    std::unordered_map<std::string, Fold> const _columnFolds; ///< By lowercase name
+    size_t const _maxGroupsPerShard;
+
+    std::once_flag _schemaOnce;
+    proto::RowSchema _schema; ///< Schema of incoming (and outgoing) rows
+    std::vector<Fold> _folds; ///< Fold operator for each column of _schema
+    std::vector<int> _mysqlTypes; ///< mysql type of each column of _schema
+
+    static int const SHARD_COUNT = 16;
+    Shard _shards[SHARD_COUNT];
+
+    std::atomic<size_t> _rowsIn{0};
+    std::atomic<size_t> _rowsOut{0};
+};
+
+}}} // namespace lsst::qserv::rproc
+
+#endif // LSST_QSERV_RPROC_HASHAGGREGATOR_H
@@ -41,6 +41,7 @@
 // System headers
 #include <chrono> // &&& delete maybe
 #include <cstddef>
+#include <deque>
 #include <iostream>
 #include <sstream>
 #include <sys/time.h>
@@ -56,9 +57,12 @@
 // Qserv headers
 #include "mysql/LocalInfile.h"
 #include "mysql/MySqlConnection.h"
+#include "proto/ColumnBlocks.h"
 #include "proto/WorkerResponse.h"
 #include "proto/ProtoImporter.h"
 #include "query/SelectStmt.h"
+#include "rproc/HashAggregator.h"
+#include "rproc/LimitFilter.h"
 #include "rproc/ProtoRowBuffer.h"
 #include "sql/Schema.h"
 #include "sql/SqlConnection.h"
@@ -113,9 +117,14 @@ namespace rproc {
 ////////////////////////////////////////////////////////////////////////
 
 /// InfileMerger::Mgr is a delegate class of InfileMerger that manages a queue
-/// of jobs to import rows into a mysqld. The purpose of maintaining a queue and
-/// not performing parallel loading is poor performance (as measured in MySQL
-/// 5.1). While performance might be better when the merge/result table is an
+/// of jobs to import rows into a mysqld. Rows are imported through a fixed
+/// set of Loaders, each owning a mysql connection and a target table, and the
+/// queue runs one thread per Loader. With a single Loader, imports are
+/// serialized, which used to be the only option because of poor parallel
+/// loading performance into a single table (as measured in MySQL 5.1). With
+/// several Loaders, each one writes into its own partition of the merge
+/// table, so the loads do not contend for the same table lock.  While
+/// performance might be better when the merge/result table is an
 /// ENGINE=MEMORY table, we cannot use in-memory by default because result
 /// tables could spill physical RAM--baseline LSST query requirements allow for
 /// large result sets.
@@ -124,7 +133,8 @@ public:
     class ActionMerge;
     friend class ActionMerge;
 
-    Mgr(mysql::MySqlConfig const& config, std::string const& mergeTable);
+    /// @param loadTables one table per Loader connection
+    Mgr(mysql::MySqlConfig const& config, std::vector<std::string> const& loadTables);
 
     ~Mgr() {}
 
@@ -139,31 +149,68 @@ public:
         while(_numInflight > 0) {
             _inflightZero.wait(lock);
         }
-        return true;
+        return _numFailed == 0;
     }
 
-    /// Apply a mysql query, using synchronization to prevent contention.
-    bool applyMysql(std::string const& query);
-
     /// Report completion of an action (used by Action threads to report their
     /// completion before they destroy themselves).
     void signalDone(bool success, ActionMerge& a) {
         std::lock_guard<std::mutex> lock(_inflightMutex);
         --_numInflight;
-        // TODO: do something with the result so we can catch errors.
+        if (!success) {
+            ++_numFailed;
+        }
         if (_numInflight == 0) {
             _inflightZero.notify_all();
         }
     }
 
 private:
+    class Loader;
+
     bool _doMerge(std::shared_ptr<proto::WorkerResponse>& response);
+    Loader& _acquireLoader();
+    void _releaseLoader(Loader& loader);
 
     void _incrementInflight() {
         std::lock_guard<std::mutex> lock(_inflightMutex);
         ++_numInflight;
     }
 
+    std::vector<std::unique_ptr<Loader>> _loaders;
+    std::deque<Loader*> _idleLoaders; ///< Loaders not currently loading
+    std::mutex _idleMutex;
+    std::condition_variable _loaderIdle;
+
+    util::WorkQueue _workQueue; ///< One runner per Loader
+    std::mutex _inflightMutex;
+    std::condition_variable _inflightZero;
+    int _numInflight;
+    int _numFailed;
+};
+
+/// Loader is a mysql connection dedicated to LOAD DATA LOCAL INFILE into one
+/// table. A Loader is used by one ActionMerge at a time.
+class InfileMerger::Mgr::Loader {
+public:
+    Loader(mysql::MySqlConfig const& config, std::string const& table)
+        : _mysqlConn(config), _table(table) {
+        if (!_setupConnection()) {
+            throw InfileMergerError(util::ErrorCode::MYSQLCONNECT,
+                                    "InfileMerger mysql connect failure.");
+        }
+    }
+
+    /// Load the rows of 'response' into this Loader's table.
+    bool load(std::shared_ptr<proto::WorkerResponse>& response) {
+        std::string virtFile = _infileMgr.prepareSrc(newProtoRowBuffer(response->result));
+        std::string infileStatement = sql::formLoadInfile(_table, virtFile);
+        return _applyMysql(infileStatement);
+    }
+
+    std::string const& getTable() const { return _table; }
+
+private:
     bool _setupConnection() {
         if (_mysqlConn.connect()) {
             _infileMgr.attach(_mysqlConn.getMySql());
@@ -172,15 +219,27 @@ private:
         return false;
     }
 
-    mysql::MySqlConnection _mysqlConn;
-    std::mutex _mysqlMutex;
-    std::string const& _mergeTable;
-
-    util::WorkQueue _workQueue;
-    std::mutex _inflightMutex;
-    std::condition_variable _inflightZero;
-    int _numInflight;
+    bool _applyMysql(std::string const& query) {
+        if (!_mysqlConn.connected()) {
+            // should have connected during Loader construction
+            // Try reconnecting--maybe we timed out.
+            if (!_setupConnection()) {
+                return false; // Reconnection failed. This is an error.
+            }
+        }
+        // Go direct--MySqlConnection API expects results and will report
+        // an error if there is no result.
+        int rc = mysql_real_query(_mysqlConn.getMySql(),
+                                  query.data(), query.size());
+        if (rc != 0) {
+            LOGS(_log, LOG_LVL_ERROR, "InfileMerger load into " << _table
+                 << " failed: " << _mysqlConn.getError());
+        }
+        return rc == 0;
+    }
 
+    mysql::MySqlConnection _mysqlConn;
+    std::string const _table;
     lsst::qserv::mysql::LocalInfile::Mgr _infileMgr;
 };
 
@@ -191,8 +250,8 @@ public:
         // Delay preparing the virtual file until just before it is needed.
     }
     void operator()() {
-        auto result = _mgr._doMerge(_response);
-        assert(result);
+        // A failed load is counted by signalDone() and reported by join().
+        bool result = _mgr._doMerge(_response);
         _mgr.signalDone(result, *this);
     }
     Mgr& _mgr;
@@ -202,13 +261,14 @@ public:
 ////////////////////////////////////////////////////////////////////////
 // InfileMerger::Mgr implementation
 ////////////////////////////////////////////////////////////////////////
-InfileMerger::Mgr::Mgr(mysql::MySqlConfig const& config, std::string const& mergeTable)
-    : _mysqlConn(config),
-      _mergeTable(mergeTable),
-      _workQueue(1),
-      _numInflight(0) {
-    if (!_setupConnection()) {
-        throw InfileMergerError(util::ErrorCode::MYSQLCONNECT, "InfileMerger mysql connect failure.");
+InfileMerger::Mgr::Mgr(mysql::MySqlConfig const& config,
+                       std::vector<std::string> const& loadTables)
+    : _workQueue(loadTables.size()),
+      _numInflight(0),
+      _numFailed(0) {
+    for(auto const& table : loadTables) {
+        _loaders.emplace_back(new Loader(config, table));
+        _idleLoaders.push_back(_loaders.back().get());
     }
 }
 
@@ -220,34 +280,38 @@ void InfileMerger::Mgr::queMerge(std::shared_ptr<proto::WorkerResponse> response
     // a->operator()(); // Comment out above line and enable this to wait until the write completes.
 }
 
-/** Load data from the 'response' into the 'table'. Return true if successful.
+/** Load data from the 'response' into the table of an idle Loader.
+ *  Return true if successful.
  */
 bool InfileMerger::Mgr::_doMerge(std::shared_ptr<proto::WorkerResponse>& response) {
-    std::string virtFile = _infileMgr.prepareSrc(newProtoRowBuffer(response->result));
+    Loader& loader = _acquireLoader();
     auto start = std::chrono::system_clock::now();
-    std::string infileStatement = sql::formLoadInfile(_mergeTable, virtFile);
-    auto ret = applyMysql(infileStatement);
+    auto ret = loader.load(response);
     auto end = std::chrono::system_clock::now();
+    _releaseLoader(loader);
     auto mergeDur = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-    LOGS(_log, LOG_LVL_DEBUG, "mergeDur=" << mergeDur.count());
+    LOGS(_log, LOG_LVL_DEBUG, "mergeDur=" << mergeDur.count()
+         << " table=" << loader.getTable()
+         << " rows=" << proto::getRowCount(response->result));
     return ret;
 }
 
-bool InfileMerger::Mgr::applyMysql(std::string const& query) {
-    std::lock_guard<std::mutex> lock(_mysqlMutex);
-    if (!_mysqlConn.connected()) {
-        // should have connected during Mgr construction
-        // Try reconnecting--maybe we timed out.
-        if (!_setupConnection()) {
-            return false; // Reconnection failed. This is an error.
-        }
+/// @return an idle Loader, waiting for one if necessary. There are as many
+/// queue runners as Loaders, so the wait is normally not taken.
+InfileMerger::Mgr::Loader& InfileMerger::Mgr::_acquireLoader() {
+    std::unique_lock<std::mutex> lock(_idleMutex);
+    while(_idleLoaders.empty()) {
+        _loaderIdle.wait(lock);
     }
-    // Go direct--MySqlConnection API expects results and will report
-    // an error if there is no result.
-    // bool result = _mysqlConn.queryUnbuffered(query);  // expects a result
-    int rc = mysql_real_query(_mysqlConn.getMySql(),
-                              query.data(), query.size());
-    return rc == 0;
+    Loader* loader = _idleLoaders.front();
+    _idleLoaders.pop_front();
+    return *loader;
+}
+
+void InfileMerger::Mgr::_releaseLoader(Loader& loader) {
+    std::lock_guard<std::mutex> lock(_idleMutex);
+    _idleLoaders.push_back(&loader);
+    _loaderIdle.notify_one();
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -261,8 +325,14 @@ InfileMerger::InfileMerger(InfileMergerConfig const& c)
     _fixupTargetName();
     if (_config.mergeStmt) {
         _config.mergeStmt->setFromListAsTable(_mergeTable);
+        if (_config.limitRows) {
+            _limitFilter = LimitFilter::newLimitFilter(*_config.mergeStmt);
+        } else if (_config.aggregateMaxGroups > 0) {
+            _aggregator = HashAggregator::newHashAggregator(*_config.mergeStmt,
+                                                            _config.aggregateMaxGroups);
+        }
     }
-    _mgr.reset(new Mgr(*_sqlConfig, _mergeTable));
+    _mgr.reset(new Mgr(*_sqlConfig, _loadTables));
 }
 
 InfileMerger::~InfileMerger() {
@@ -278,7 +348,7 @@ bool InfileMerger::merge(std::shared_ptr<proto::WorkerResponse> response) {
          "Executing InfileMerger::merge("
          << "sizes=" << static_cast<short>(response->headerSize)
          << ", " << response->protoHeader.size()
-         << ", rowcount=" << response->result.row_size()
+         << ", rowcount=" << proto::getRowCount(response->result)
          << ", errCode=" << response->result.has_errorcode()
          << "hasErrorMsg=" << response->result.has_errormsg() << ")");
 
@@ -292,37 +362,65 @@ bool InfileMerger::merge(std::shared_ptr<proto::WorkerResponse> response) {
             return false;
         }
     }
+    if (_limitFilter || _aggregator) {
+        // These work row by row; plain loads read column blocks directly.
+        proto::columnsToRows(response->result);
+    }
+    if (_limitFilter) {
+        _limitFilter->filter(response->result);
+    }
     return _importResponse(response);
 }
 
 bool InfileMerger::finalize() {
+    if (_aggregator) {
+        // Load the groups still held in memory.
+        for (auto const& response : _aggregator->flush()) {
+            _mgr->queMerge(response);
+        }
+        LOGS(_log, LOG_LVL_INFO, "InfileMerger folded " << _aggregator->getRowsIn()
+             << " rows into " << _aggregator->getRowsOut());
+    }
+    if (_limitFilter) {
+        LOGS(_log, LOG_LVL_INFO, "InfileMerger skipped " << _limitFilter->getRowsDropped()
+             << " rows beyond the LIMIT");
+    }
     bool finalizeOk = _mgr->join();
     // TODO: Should check for error condition before continuing.
     if (_isFinished) {
         LOGS(_log, LOG_LVL_ERROR, "InfileMerger::finalize(), but _isFinished == true");
     }
     if (_mergeTable != _config.targetTable) {
-        // Aggregation needed: Do the aggregation.
-        std::string mergeSelect = _config.mergeStmt->getQueryTemplate().sqlFragment();
+        // Aggregation needed: Do the aggregation. Partitioned loading without
+        // aggregation only needs the partitions copied into the target.
+        std::string mergeSelect = _config.mergeStmt
+            ? _config.mergeStmt->getQueryTemplate().sqlFragment()
+            : "SELECT * FROM " + _mergeTable;
         // Using MyISAM as single thread writing with no need to recover from errors.
         std::string createMerge = "CREATE TABLE " + _config.targetTable
             + " ENGINE=MyISAM " + mergeSelect;
         LOGS(_log, LOG_LVL_DEBUG, "Merging w/" << createMerge);
-        finalizeOk = _applySqlLocal(createMerge);
+        finalizeOk = _applySqlLocal(createMerge) && finalizeOk;
 
-        // Cleanup merge table.
-        sql::SqlErrorObject eObj;
-        // Don't report failure on not exist
-        LOGS(_log, LOG_LVL_DEBUG, "Cleaning up " << _mergeTable);
+        // Cleanup merge table, and its partitions if there are any.
+        std::vector<std::string> cleanupTables{_mergeTable};
+        if (_isPartitioned()) {
+            cleanupTables.insert(cleanupTables.end(), _loadTables.begin(), _loadTables.end());
+        }
+        for(auto const& table : cleanupTables) {
+            sql::SqlErrorObject eObj;
+            // Don't report failure on not exist
+            LOGS(_log, LOG_LVL_DEBUG, "Cleaning up " << table);
 #if 1 // Set to 0 when we want to retain mergeTables for debugging.
-        bool cleanupOk = _sqlConn->dropTable(_mergeTable, eObj,
-                                             false,
-                                             _config.targetDb);
+            bool cleanupOk = _sqlConn && _sqlConn->dropTable(table, eObj,
+                                                             false,
+                                                             _config.targetDb);
 #else
-        bool cleanupOk = true;
+            bool cleanupOk = true;
 #endif
-        if (!cleanupOk) {
-            LOGS(_log, LOG_LVL_DEBUG, "Failure cleaning up table " << _mergeTable);
+            if (!cleanupOk) {
+                LOGS(_log, LOG_LVL_DEBUG, "Failure cleaning up table " << table);
+            }
         }
     }
     LOGS(_log, LOG_LVL_DEBUG, "Merged " << _mergeTable << " into " << _config.targetTable);
@@ -397,8 +495,19 @@ bool InfileMerger::_verifySession(int sessionId) {
 
 bool InfileMerger::_importResponse(std::shared_ptr<proto::WorkerResponse> response) {
     // Check for the no-row condition
-    if (response->result.row_size() == 0) {
+    if (proto::getRowCount(response->result) == 0) {
         // Nothing further, don't bother importing
+    } else if (_aggregator) {
+        // Fold rows in memory, loading only what the aggregator releases.
+        HashAggregator::ResponseVector folded;
+        if (!_aggregator->add(response->result, folded)) {
+            _error = InfileMergerError(util::ErrorCode::RESULT_IMPORT,
+                                       "Result row does not match the result schema");
+            return false;
+        }
+        for (auto const& f : folded) {
+            _mgr->queMerge(f);
+        }
     } else {
         // Delegate merging thread mgmt to mgr
         _mgr->queMerge(response);
@@ -432,17 +541,31 @@ bool InfileMerger::_setupTable(proto::WorkerResponse const& response) {
 
             s.columns.push_back(scs);
         }
-        std::string createStmt = sql::formCreateTable(_mergeTable, s);
         // Specifying engine. There is some question about whether InnoDB or MyISAM is the better
         // choice when multiple threads are writing to the result table.
-        createStmt += " ENGINE=MyISAM";
-        LOGS(_log, LOG_LVL_DEBUG, "InfileMerger query prepared: " << createStmt);
-
-        if (not _applySqlLocal(createStmt)) {
-            _error = InfileMergerError(util::ErrorCode::CREATE_TABLE, "Error creating table (" + _mergeTable + ")");
-            _isFinished = true; // Cannot continue.
-            LOGS(_log, LOG_LVL_ERROR, "InfileMerger sql error: " << _error.getMsg());
-            return false;
+        // Partitioned loading avoids the question by giving each loader
+        // connection its own MyISAM table, unified by a MERGE table.
+        std::vector<std::string> createStmts;
+        for(auto const& table : _loadTables) {
+            createStmts.push_back(sql::formCreateTable(table, s) + " ENGINE=MyISAM");
+        }
+        if (_isPartitioned()) {
+            std::string unionList;
+            for(auto const& table : _loadTables) {
+                if (!unionList.empty()) { unionList += ","; }
+                unionList += table;
+            }
+            createStmts.push_back(sql::formCreateTable(_mergeTable, s)
+                                  + " ENGINE=MERGE UNION=(" + unionList + ") INSERT_METHOD=NO");
+        }
+        for(auto const& createStmt : createStmts) {
+            LOGS(_log, LOG_LVL_DEBUG, "InfileMerger query prepared: " << createStmt);
+            if (not _applySqlLocal(createStmt)) {
+                _error = InfileMergerError(util::ErrorCode::CREATE_TABLE, "Error creating table (" + _mergeTable + ")");
+                _isFinished = true; // Cannot continue.
+                LOGS(_log, LOG_LVL_ERROR, "InfileMerger sql error: " << _error.getMsg());
+                return false;
+            }
         }
         _needCreateTable = false;
     } else {
@@ -461,11 +584,20 @@ void InfileMerger::_fixupTargetName() {
                                % _config.targetDb % getTimeStampId()).str();
     }
 
-    if (_config.mergeStmt) {
+    if (_config.mergeStmt || _config.loadConnections > 1) {
         // Set merging temporary if needed.
         _mergeTable = _config.targetTable + "_m";
     } else {
         _mergeTable = _config.targetTable;
     }
+
+    _loadTables.clear();
+    if (_config.loadConnections > 1) {
+        for(int i = 0; i < _config.loadConnections; ++i) {
+            _loadTables.push_back(_mergeTable + "_" + std::to_string(i));
+        }
+    } else {
+        _loadTables.push_back(_mergeTable);
+    }
 }
 }}} // namespace lsst::qserv::rproc
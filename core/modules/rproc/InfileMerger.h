@@ -33,6 +33,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 // Qserv headers
 #include "util/Error.h"
@@ -64,6 +65,9 @@ namespace lsst {
 namespace qserv {
 namespace rproc {
 
+class HashAggregator;
+class LimitFilter;
+
 /** \typedef InfileMergerError Store InfileMerger error code.
  *
  * \note:
@@ -80,9 +84,13 @@ public:
     InfileMergerConfig(std::string const& targetDb_,
                        std::string const& targetTable_,
                        std::shared_ptr<query::SelectStmt> mergeStmt_,
-                       std::string const& user_, std::string const& socket_)
+                       std::string const& user_, std::string const& socket_,
+                       int loadConnections_=1,
+                       int aggregateMaxGroups_=0)
         :  targetDb(targetDb_),  targetTable(targetTable_),
-           mergeStmt(mergeStmt_), user(user_), socket(socket_)
+           mergeStmt(mergeStmt_), user(user_), socket(socket_),
+           loadConnections(loadConnections_),
+           aggregateMaxGroups(aggregateMaxGroups_)
     {
     }
 
@@ -91,6 +99,24 @@ public:
     std::shared_ptr<query::SelectStmt> mergeStmt;
     std::string user;
     std::string socket;
+    /// Number of mysql connections used to load results in parallel. With
+    /// more than one, each connection loads its own partition of the merge
+    /// table, and the partitions are combined in finalize().
+    int loadConnections {1};
+    /// Maximum number of groups folded in memory by a HashAggregator before
+    /// they are loaded. 0 disables in-memory aggregation.
+    int aggregateMaxGroups {0};
+    /// mergeStmt only sorts and limits whole rows (see
+    /// query::QueryContext::mergeRowLimit), so rows that cannot be part of
+    /// the result need not be loaded.
+    bool limitRows {false};
+    /// Result protocol requested from workers (see proto/worker.proto).
+    /// Protocol 3 column blocks are smaller and cheaper to decode, but
+    /// workers that predate it reject such tasks.
+    int resultProtocol {2};
+    /// zlib level (1-9) at which workers are asked to compress result
+    /// messages. 0 asks for uncompressed results.
+    int compressionLevel {0};
 };
 
 /// InfileMerger is a row-based merger that imports rows from result messages
@@ -105,6 +131,18 @@ public:
 /// Bytes 1 - size_ph : ProtoHeader message (containing size of result message)
 /// Bytes size_ph - size_ph + size_rm : Result message
 /// At present, Result messages are not chained.
+///
+/// When InfileMergerConfig::loadConnections > 1, rows are loaded through that
+/// many connections, each into its own MyISAM partition table
+/// (<mergeTable>_0 .. <mergeTable>_k). The partitions are presented as a
+/// single ENGINE=MERGE table <mergeTable>, so the merge statement (or a plain
+/// copy when there is none) reads all of them in finalize().
+///
+/// When the merge statement is a simple aggregation and
+/// InfileMergerConfig::aggregateMaxGroups > 0, rows are first folded by group
+/// in memory by a HashAggregator, and only the folded rows are loaded.
+/// When InfileMergerConfig::limitRows is set, a LimitFilter drops rows that
+/// cannot be within the LIMIT of the merge statement before they are loaded.
 class InfileMerger {
 public:
     explicit InfileMerger(InfileMergerConfig const& c);
@@ -136,12 +174,14 @@ private:
     bool _applySql(std::string const& sql);
     bool _applySqlLocal(std::string const& sql);
     void _fixupTargetName();
+    bool _isPartitioned() const { return _loadTables.size() > 1; }
 
     InfileMergerConfig _config; ///< Configuration
     std::shared_ptr<mysql::MySqlConfig> _sqlConfig; ///< SQL connection config
     std::shared_ptr<sql::SqlConnection> _sqlConn; ///< SQL connection
 
     std::string _mergeTable; ///< Table for result loading
+    std::vector<std::string> _loadTables; ///< Tables written by loader connections
     InfileMergerError _error; ///< Error state
 
     bool _isFinished; ///< Completed?
@@ -150,6 +190,8 @@ private:
 
     class Mgr;
     std::unique_ptr<Mgr> _mgr; ///< Delegate merging action object
+    std::shared_ptr<HashAggregator> _aggregator; ///< In-memory folding, if possible
+    std::shared_ptr<LimitFilter> _limitFilter; ///< Drops rows beyond the LIMIT
 
     bool _needCreateTable; ///< Does the target table need creating?
 };
@@ -0,0 +1,227 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "rproc/LimitFilter.h"
+
+// System headers
+#include <cctype>
+#include <cstdlib>
+#include <limits>
+#include <strings.h>
+
+// Third-party headers
+#include <mysql/mysql.h>
+
+// LSST headers
+#include "lsst/log/Log.h"
+
+// Qserv headers
+#include "proto/worker.pb.h"
+#include "query/ColumnRef.h"
+#include "query/OrderByClause.h"
+#include "query/SelectStmt.h"
+#include "query/ValueExpr.h"
+
+namespace { // File-scope helpers
+
+LOG_LOGGER _log = LOG_GET("lsst.qserv.rproc.LimitFilter");
+
+bool isNumericType(int mysqlType) {
+    switch(mysqlType) {
+    case MYSQL_TYPE_TINY: case MYSQL_TYPE_SHORT: case MYSQL_TYPE_INT24:
+    case MYSQL_TYPE_LONG: case MYSQL_TYPE_LONGLONG:
+    case MYSQL_TYPE_FLOAT: case MYSQL_TYPE_DOUBLE:
+    case MYSQL_TYPE_DECIMAL: case MYSQL_TYPE_NEWDECIMAL:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// Parse a numeric column value. Rounding to long double preserves order
+/// (though not strict order), so filtering on parsed keys stays conservative.
+bool parseKey(std::string const& s, long double& val) {
+    if (s.empty() || std::isspace(s[0])) { return false; }
+    char const* begin = s.c_str();
+    char* end = nullptr;
+    val = std::strtold(begin, &end);
+    return end == begin + s.size();
+}
+
+} // anonymous namespace
+
+namespace lsst {
+namespace qserv {
+namespace rproc {
+
+LimitFilter::Ptr LimitFilter::newLimitFilter(query::SelectStmt& mergeStmt) {
+    if (!mergeStmt.hasLimit() || mergeStmt.getLimit() < 0) {
+        return Ptr();
+    }
+    std::vector<SortColumn> sortColumns;
+    if (mergeStmt.hasOrderBy()) {
+        for (auto const& term : mergeStmt.getOrderBy().getTerms()) {
+            auto expr = term.getExpr();
+            auto columnRef = expr ? expr->getColumnRef() : nullptr;
+            if (!columnRef || !term.getCollate().empty()) {
+                return Ptr(); // Cannot evaluate the sort order.
+            }
+            SortColumn sc;
+            sc.name = columnRef->column;
+            sc.descending = term.getOrder() == query::OrderByTerm::DESC;
+            sortColumns.push_back(sc);
+        }
+    }
+    return std::make_shared<LimitFilter>(mergeStmt.getLimit(), sortColumns);
+}
+
+LimitFilter::LimitFilter(int limit, std::vector<SortColumn> const& sortColumns)
+    : _limit(limit), _sortColumns(sortColumns),
+      _best(SortsBefore{&_descending}) {
+    for (auto const& sc : _sortColumns) {
+        _descending.push_back(sc.descending);
+    }
+}
+
+bool LimitFilter::SortsBefore::operator()(SortKey const& a, SortKey const& b) const {
+    for (size_t i = 0, e = a.size(); i < e; ++i) {
+        if (a[i] != b[i]) {
+            return (*descending)[i] ? a[i] > b[i] : a[i] < b[i];
+        }
+    }
+    return false;
+}
+
+/// Find the sort columns in the result schema. Called with _mtx held.
+void LimitFilter::_initSchema(proto::RowSchema const& schema) {
+    _schemaKnown = true;
+    for (auto const& sc : _sortColumns) {
+        int found = -1;
+        for (int i = 0; i < schema.columnschema_size(); ++i) {
+            auto const& cs = schema.columnschema(i);
+            if (::strcasecmp(cs.name().c_str(), sc.name.c_str()) == 0) {
+                if (found >= 0 || !cs.has_mysqltype() || !isNumericType(cs.mysqltype())) {
+                    found = -1; // Ambiguous or not numeric
+                    break;
+                }
+                found = i;
+            }
+        }
+        if (found < 0) {
+            LOGS(_log, LOG_LVL_DEBUG, "LimitFilter cannot sort on " << sc.name
+                 << ", keeping all rows");
+            _sortable = false;
+            return;
+        }
+        _keyColumns.push_back(found);
+    }
+}
+
+int LimitFilter::filter(proto::Result& result) {
+    int const rowCount = result.row_size();
+    if (rowCount == 0) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (!_schemaKnown) {
+        _initSchema(result.rowschema());
+    }
+    if (!_sortable) {
+        return 0;
+    }
+    auto rows = result.mutable_row();
+    int kept = 0;
+    SortKey key(_keyColumns.size());
+    for (int i = 0; i < rowCount; ++i) {
+        bool keep;
+        if (_keyColumns.empty()) {
+            keep = _keepUnordered();
+        } else {
+            proto::RowBundle const& rb = rows->Get(i);
+            bool parsed = true;
+            for (size_t k = 0; k < _keyColumns.size() && parsed; ++k) {
+                int c = _keyColumns[k];
+                if (c < rb.isnull_size() && rb.isnull(c)) {
+                    // MySQL sorts NULL before any value.
+                    key[k] = -std::numeric_limits<long double>::infinity();
+                } else {
+                    parsed = c < rb.column_size() && parseKey(rb.column(c), key[k]);
+                }
+            }
+            keep = !parsed || _keepOrdered(key);
+        }
+        if (keep) {
+            if (kept != i) {
+                rows->SwapElements(kept, i);
+            }
+            ++kept;
+        }
+    }
+    int dropped = rowCount - kept;
+    if (dropped > 0) {
+        rows->DeleteSubrange(kept, dropped);
+        _rowsDropped += dropped;
+    }
+    return dropped;
+}
+
+/// Called with _mtx held.
+bool LimitFilter::_keepUnordered() {
+    if (_rowsKept >= _limit) {
+        return false;
+    }
+    ++_rowsKept;
+    return true;
+}
+
+/// Called with _mtx held.
+bool LimitFilter::_keepOrdered(SortKey const& key) {
+    if (_limit == 0) {
+        return false;
+    }
+    if (_best.size() >= _limit) {
+        if (SortsBefore{&_descending}(_best.top(), key)) {
+            return false; // Sorts after the n best rows.
+        }
+        // Ties with the current n-th row are kept, but do not displace it.
+        if (!SortsBefore{&_descending}(key, _best.top())) {
+            return true;
+        }
+        _best.pop();
+    }
+    _best.push(key);
+    return true;
+}
+
+bool LimitFilter::isSatisfied() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _sortColumns.empty() && _sortable && _rowsKept >= _limit;
+}
+
+size_t LimitFilter::getRowsDropped() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _rowsDropped;
+}
+
+}}} // namespace lsst::qserv::rproc
@@ -0,0 +1,120 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_RPROC_LIMITFILTER_H
+#define LSST_QSERV_RPROC_LIMITFILTER_H
+
+// System headers
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+// Forward declarations
+namespace lsst {
+namespace qserv {
+namespace proto {
+    class Result;
+    class RowSchema;
+}
+namespace query {
+    class SelectStmt;
+}
+}} // End of forward declarations
+
+namespace lsst {
+namespace qserv {
+namespace rproc {
+
+/// LimitFilter drops chunk result rows that cannot be part of the result of
+/// a merge statement that only sorts and truncates whole rows
+/// ([ORDER BY ...] LIMIT n).
+///
+/// Without ORDER BY, any n rows will do, so rows past the first n are
+/// dropped. With ORDER BY, the sort keys of the best n rows seen so far are
+/// kept in a heap, and rows sorting strictly after all of them are dropped.
+/// Ties are kept, and the merge statement still sorts and limits the loaded
+/// rows, so the filter only has to be conservative. Sort keys are compared
+/// numerically, so ordering is only filtered when every ORDER BY term is a
+/// numeric result column; otherwise all rows are kept.
+class LimitFilter {
+public:
+    typedef std::shared_ptr<LimitFilter> Ptr;
+
+    /// @return a LimitFilter for mergeStmt, or nullptr if it has no LIMIT or
+    /// its ORDER BY terms are not all plain columns. The caller must know
+    /// that mergeStmt does not aggregate rows.
+    static Ptr newLimitFilter(query::SelectStmt& mergeStmt);
+
+    /// Sort key column of the merge ORDER BY clause
+    struct SortColumn {
+        std::string name;
+        bool descending;
+    };
+
+    /// @param sortColumns ORDER BY terms, empty for a plain LIMIT.
+    LimitFilter(int limit, std::vector<SortColumn> const& sortColumns);
+
+    /// Remove rows of result that cannot be part of the final result.
+    /// @return the number of rows removed
+    int filter(proto::Result& result);
+
+    /// @return true if further rows will be dropped whatever they hold, i.e.
+    /// the limit was reached and there is no ORDER BY.
+    bool isSatisfied() const;
+
+    /// @return number of rows removed by filter()
+    size_t getRowsDropped() const;
+
+private:
+    typedef std::vector<long double> SortKey;
+
+    /// Orders sort keys by the merge ORDER BY clause. The key that sorts last
+    /// is at the top of a priority_queue using it.
+    struct SortsBefore {
+        std::vector<bool> const* descending;
+        bool operator()(SortKey const& a, SortKey const& b) const;
+    };
+    typedef std::priority_queue<SortKey, std::vector<SortKey>, SortsBefore> Heap;
+
+    void _initSchema(proto::RowSchema const& schema);
+    bool _keepUnordered();
+    bool _keepOrdered(SortKey const& key);
+
+    size_t const _limit;
+    std::vector<SortColumn> const _sortColumns;
+    bool _sortable {true}; ///< false if sort columns are missing from results
+    std::vector<bool> _descending; ///< Per sort column
+    std::vector<int> _keyColumns; ///< Result column index of each sort column
+    bool _schemaKnown {false};
+
+    mutable std::mutex _mtx; ///< Protects the members below
+    size_t _rowsKept {0}; ///< Rows kept (no ORDER BY)
+    size_t _rowsDropped {0};
+    Heap _best; ///< Sort keys of the best rows kept (ORDER BY)
+};
+
+}}} // namespace lsst::qserv::rproc
+
+#endif // LSST_QSERV_RPROC_LIMITFILTER_H
@@ -24,194 +24,169 @@
 
 // System headers
 #include <cassert>
-#include <limits>
-#include <sstream>
-#include <stdexcept>
+#include <memory>
 #include <string.h>
 
-// Third-party headers
-#include <mysql/mysql.h>
-
 // Qserv headers
+#include "mysql/escapeString.h"
+#include "mysql/LocalInfileError.h"
+#include "proto/ColumnBlocks.h"
 #include "proto/worker.pb.h"
-#include "sql/Schema.h"
-
-////////////////////////////////////////////////////////////////////////
-// Helpful constants
-////////////////////////////////////////////////////////////////////////
-std::string const mysqlNull("\\N");
 
 namespace lsst {
 namespace qserv {
 namespace rproc {
 ////////////////////////////////////////////////////////////////////////
-// Helpers
-////////////////////////////////////////////////////////////////////////
-
-/// Escape a bytestring for LOAD DATA INFILE, as specified by MySQL doc:
-/// https://dev.mysql.com/doc/refman/5.1/en/load-data.html
-/// This is limited to:
-/// Character    Escape Sequence
-/// \0     An ASCII NUL (0x00) character
-/// \b     A backspace character
-/// \n     A newline (linefeed) character
-/// \r     A carriage return character
-/// \t     A tab character.
-/// \Z     ASCII 26 (Control+Z)
-/// \N     NULL
-///
-/// @return the number of bytes written to dest
-template <typename Iter, typename CIter>
-inline int escapeString(Iter destBegin, CIter srcBegin, CIter srcEnd) {
-    //mysql_real_escape_string(_mysql, cursor, col, r.lengths[i]);
-    // empty string isn't escaped
-    if (srcEnd == srcBegin) return 0;
-    assert(srcEnd - srcBegin > 0);
-    assert(srcEnd - srcBegin < std::numeric_limits<int>::max() / 2);
-    Iter destI = destBegin;
-    for(CIter i = srcBegin; i != srcEnd; ++i) {
-        switch(*i) {
-          case '\0':   *destI++ = '\\'; *destI++ = '0'; break;
-          case '\b':   *destI++ = '\\'; *destI++ = 'b'; break;
-          case '\n':   *destI++ = '\\'; *destI++ = 'n'; break;
-          case '\r':   *destI++ = '\\'; *destI++ = 'r'; break;
-          case '\t':   *destI++ = '\\'; *destI++ = 't'; break;
-          case '\032': *destI++ = '\\'; *destI++ = 'Z'; break;
-          default: *destI++ = *i; break;
-            // Null (\N) is not treated by escaping in this context.
-        }
-    }
-    return destI - destBegin;
-}
-
-/// Copy a rawColumn to an STL container
-template <typename T>
-inline int copyColumn(T& dest, std::string const& rawColumn) {
-    int existingSize = dest.size();
-    dest.resize(existingSize + 2 + 2 * rawColumn.size());
-    dest[existingSize] = '\'';
-    int valSize = escapeString(dest.begin() + existingSize + 1,
-                               rawColumn.begin(), rawColumn.end());
-    dest[existingSize + 1 + valSize] = '\'';
-    dest.resize(existingSize + 2 + valSize);
-    return 2 + valSize;
-}
-////////////////////////////////////////////////////////////////////////
 // ProtoRowBuffer
 ////////////////////////////////////////////////////////////////////////
 
 /// ProtoRowBuffer is an implementation of RowBuffer designed to allow a
-/// LocalInfile object to use a Protobufs Result message as a row source
+/// LocalInfile object to use a Protobufs Result message as a row source.
+/// Rows are encoded directly into the caller's buffer, as many as fit per
+/// fetch(), without intermediate copies. A cursor (row, column, stage within
+/// the column, bytes of the column consumed) into the Result message allows
+/// a fetch() to stop anywhere, even within a column, and the next fetch() to
+/// resume there. Protocol 3 messages are read from their column blocks, with
+/// numeric values formatted as they are encoded.
 class ProtoRowBuffer : public mysql::RowBuffer {
 public:
     ProtoRowBuffer(proto::Result& res);
     virtual unsigned fetch(char* buffer, unsigned bufLen);
 
 private:
-    void _initCurrentRow();
-    void _initSchema();
-    void _readNextRow();
-    // Copy a row bundle into a destination STL char container
-    template <typename T>
-    int _copyRowBundle(T& dest, proto::RowBundle const& rb) {
-        int sizeBefore = dest.size();
-        for(int ci=0, ce=rb.column_size(); ci != ce; ++ci) {
-            if (ci != 0) {
-                dest.insert(dest.end(), _colSep.begin(), _colSep.end());
-            }
-
-            if (!rb.isnull(ci)) {
-                copyColumn(dest, rb.column(ci));
-            } else {
-                dest.insert(dest.end(), _nullToken.begin(), _nullToken.end() );
-            }
+    /// Encoding stages of a single column
+    enum class Stage { SEPARATOR, OPEN, BODY, CLOSE };
+
+    int _columnCount() const;
+    bool _openColumn();
+    bool _encodeColumn(char*& cursor, char* end);
+    inline bool _addToken(char*& cursor, char* end, std::string const& token) {
+        if (static_cast<size_t>(end - cursor) < token.size()) {
+            return false;
         }
-        return dest.size() - sizeBefore;
+        memcpy(cursor, token.data(), token.size());
+        cursor += token.size();
+        return true;
     }
 
     std::string _colSep; ///< Column separator
     std::string _rowSep; ///< Row separator
     std::string _nullToken; ///< Null indicator (e.g. \N)
+    std::string _quote; ///< Column enclosure (see sql::formLoadInfile)
     proto::Result& _result; ///< Ref to Resultmessage
+    std::unique_ptr<proto::ColumnBlockReader> _columns; ///< Protocol 3 only
 
-    sql::Schema _schema; ///< Schema object
     int _rowIdx; ///< Row index
     int _rowTotal; ///< Total row count
-    std::vector<char> _currentRow; ///< char buffer representing current row.
+    int _colIdx; ///< Column index within the current row
+    Stage _stage; ///< Encoding stage within the current column
+    size_t _colOffset; ///< Bytes of the current column already escaped
+    char const* _colData; ///< Text of the current column
+    size_t _colSize;
+    std::string _scratch; ///< Formatted numeric value of the current column
 };
 
 ProtoRowBuffer::ProtoRowBuffer(proto::Result& res)
     : _colSep("\t"),
       _rowSep("\n"),
       _nullToken("\\N"),
+      _quote("'"),
       _result(res),
       _rowIdx(0),
-      _rowTotal(res.row_size()),
-      _currentRow(0) {
-    _initSchema();
-    if (_result.row_size() > 0) {
-        _initCurrentRow();
+      _rowTotal(proto::getRowCount(res)),
+      _colIdx(0),
+      _stage(Stage::SEPARATOR),
+      _colOffset(0),
+      _colData(nullptr),
+      _colSize(0) {
+    if (res.columnblock_size() > 0) {
+        _columns.reset(new proto::ColumnBlockReader(res));
     }
 }
 
-/// Fetch a up to a single row from from the Result message
-unsigned ProtoRowBuffer::fetch(char* buffer, unsigned bufLen) {
-    unsigned fetched = 0;
-    if (bufLen <= _currentRow.size()) {
-        memcpy(buffer, &_currentRow[0], bufLen);
-        _currentRow.erase(_currentRow.begin(), _currentRow.begin() + bufLen);
-        fetched = bufLen;
-    } else { // Want more than we have.
-        if (_currentRow.size()) {
-            memcpy(buffer, &_currentRow[0], _currentRow.size());
-            fetched = _currentRow.size();
-            _currentRow.clear();
+int ProtoRowBuffer::_columnCount() const {
+    return _columns ? _columns->getColumnCount() : _result.row(_rowIdx).column_size();
+}
+
+/// Point _colData at the text of the current column.
+/// @return false if it is NULL.
+bool ProtoRowBuffer::_openColumn() {
+    if (_columns) {
+        if (_columns->isNull(_rowIdx, _colIdx)) {
+            return false;
         }
+        _columns->getText(_rowIdx, _colIdx, _scratch, _colData, _colSize);
+        return true;
     }
-    if ((_currentRow.size() == 0) && (_rowIdx < _rowTotal)) {
-        _readNextRow();
+    proto::RowBundle const& rb = _result.row(_rowIdx);
+    if (rb.isnull(_colIdx)) {
+        return false;
     }
-    return fetched;
+    std::string const& col = rb.column(_colIdx);
+    _colData = col.data();
+    _colSize = col.size();
+    return true;
 }
 
-/// Import schema from the proto message into a Schema object
-void ProtoRowBuffer::_initSchema() {
-    _schema.columns.clear();
-    proto::RowSchema const& prs = _result.rowschema();
-    for(int i=0, e=prs.columnschema_size(); i != e; ++i) {
-        proto::ColumnSchema const& pcs = prs.columnschema(i);
-        sql::ColSchema cs;
-        if (pcs.has_name()) {
-            cs.name = pcs.name();
-        }
-        cs.hasDefault = pcs.has_defaultvalue();
-        if (cs.hasDefault) {
-            cs.defaultValue = pcs.defaultvalue();
-        }
-        cs.colType.sqlType = pcs.sqltype();
-        if (pcs.has_mysqltype()) {
-            cs.colType.mysqlType = pcs.mysqltype();
+/// Fetch as many rows from the Result message as fit in buffer. The last row
+/// (or column) may be partial.
+unsigned ProtoRowBuffer::fetch(char* buffer, unsigned bufLen) {
+    char* cursor = buffer;
+    char* const end = buffer + bufLen;
+    for(; _rowIdx < _rowTotal; ++_rowIdx) {
+        for(int colTotal = _columnCount(); _colIdx < colTotal; ++_colIdx) {
+            if (!_encodeColumn(cursor, end)) {
+                if (cursor == buffer) {
+                    // Zero bytes would be read as EOF.
+                    throw mysql::LocalInfileError("ProtoRowBuffer::fetch: Buffer too small");
+                }
+                return cursor - buffer;
+            }
         }
-        _schema.columns.push_back(cs);
-    }
-}
-/// Import the next row into the buffer
-void ProtoRowBuffer::_readNextRow() {
-    ++_rowIdx;
-    if (_rowIdx >= _rowTotal) {
-        return;
+        _colIdx = 0;
     }
-    _currentRow.clear();
-    // Row separator
-    _currentRow.insert(_currentRow.end(), _rowSep.begin(), _rowSep.end());
-    _copyRowBundle(_currentRow, _result.row(_rowIdx));
+    return cursor - buffer;
 }
 
-/// Setup the row byte buffer
-void ProtoRowBuffer::_initCurrentRow() {
-    // Copy row and reserve 2x size.
-    int rowSize = _copyRowBundle(_currentRow, _result.row(_rowIdx));
-    _currentRow.reserve(rowSize*2); // for future usage
+/// Encode the (remainder of the) current column at cursor, which is advanced.
+/// @return false if the buffer filled before the column was complete.
+bool ProtoRowBuffer::_encodeColumn(char*& cursor, char* end) {
+    switch(_stage) {
+    case Stage::SEPARATOR:
+        // Rows are separated, not terminated.
+        if (_colIdx != 0) {
+            if (!_addToken(cursor, end, _colSep)) return false;
+        } else if (_rowIdx != 0) {
+            if (!_addToken(cursor, end, _rowSep)) return false;
+        }
+        _stage = Stage::OPEN;
+        // fall through
+    case Stage::OPEN:
+        if (!_openColumn()) {
+            if (!_addToken(cursor, end, _nullToken)) return false;
+            _stage = Stage::SEPARATOR;
+            return true;
+        }
+        if (!_addToken(cursor, end, _quote)) return false;
+        _colOffset = 0;
+        _stage = Stage::BODY;
+        // fall through
+    case Stage::BODY:
+        {
+            int used = 0;
+            cursor += mysql::escapeString(cursor, end - cursor,
+                                          _colData + _colOffset, _colSize - _colOffset,
+                                          used);
+            _colOffset += used;
+            if (_colOffset < _colSize) return false;
+        }
+        _stage = Stage::CLOSE;
+        // fall through
+    case Stage::CLOSE:
+        if (!_addToken(cursor, end, _quote)) return false;
+        _stage = Stage::SEPARATOR;
+    }
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,230 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// System headers
+#include <map>
+#include <string>
+#include <vector>
+
+// Third-party headers
+#include <mysql/mysql.h>
+
+// Qserv headers
+#include "proto/worker.pb.h"
+#include "proto/WorkerResponse.h"
+#include "query/FuncExpr.h"
+#include "query/SelectList.h"
+#include "query/SelectStmt.h"
+#include "query/ValueExpr.h"
+#include "query/ValueFactor.h"
+#include "query/WhereClause.h"
+#include "rproc/HashAggregator.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE HashAggregator_1
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+using lsst::qserv::proto::Result;
+using lsst::qserv::rproc::HashAggregator;
+namespace query = lsst::qserv::query;
+
+typedef std::vector<std::string> Strings;
+typedef std::map<std::string, Strings> RowMap;
+
+struct Fixture {
+    Fixture(void) {}
+    ~Fixture(void) { }
+
+    /// @return an empty Result with a key column and one column per fold
+    Result newResult() {
+        Result result;
+        result.set_continues(false);
+        auto schema = result.mutable_rowschema();
+        addColumn(schema, "k", MYSQL_TYPE_VAR_STRING);
+        addColumn(schema, "QS1_SUM", MYSQL_TYPE_LONGLONG);
+        addColumn(schema, "QS2_MIN", MYSQL_TYPE_DOUBLE);
+        addColumn(schema, "QS3_MAX", MYSQL_TYPE_NEWDECIMAL);
+        return result;
+    }
+
+    void addColumn(lsst::qserv::proto::RowSchema* schema, std::string const& name, int type) {
+        auto cs = schema->add_columnschema();
+        cs->set_name(name);
+        cs->set_hasdefault(false);
+        cs->set_sqltype("");
+        cs->set_mysqltype(type);
+    }
+
+    /// Add a row, where "NULL" is a null value
+    void addRow(Result& result, Strings const& cols) {
+        auto row = result.add_row();
+        for(auto const& c : cols) {
+            row->add_column(c == "NULL" ? "" : c);
+            row->add_isnull(c == "NULL");
+        }
+    }
+
+    /// @return rows of responses, by key column. Keys must be unique.
+    RowMap collect(HashAggregator::ResponseVector const& responses) {
+        RowMap rows;
+        for(auto const& r : responses) {
+            for(auto const& rb : r->result.row()) {
+                Strings cols;
+                for(int i = 0; i < rb.column_size(); ++i) {
+                    cols.push_back(rb.isnull(i) ? "NULL" : rb.column(i));
+                }
+                BOOST_CHECK(rows.insert(std::make_pair(cols[0], cols)).second);
+            }
+        }
+        return rows;
+    }
+
+    HashAggregator::Ptr newAggregator(size_t maxGroups) {
+        std::unordered_map<std::string, HashAggregator::Fold> folds {
+            {"qs1_sum", HashAggregator::Fold::SUM},
+            {"qs2_min", HashAggregator::Fold::MIN},
+            {"qs3_max", HashAggregator::Fold::MAX}};
+        return std::make_shared<HashAggregator>(folds, maxGroups);
+    }
+
+    /// @return a merge statement selecting exprs
+    std::shared_ptr<query::SelectStmt> newMergeStmt(query::ValueExprPtrVector const& exprs) {
+        auto stmt = std::make_shared<query::SelectStmt>();
+        auto selectList = std::make_shared<query::SelectList>();
+        auto list = selectList->getValueExprList();
+        list->insert(list->end(), exprs.begin(), exprs.end());
+        stmt->setSelectList(selectList);
+        return stmt;
+    }
+
+    query::ValueExprPtr func(std::string const& name, std::string const& column) {
+        return query::ValueExpr::newSimple(
+            query::ValueFactor::newFuncFactor(query::FuncExpr::newArg1(name, column)));
+    }
+
+    query::ValueExprPtr column(std::string const& column) {
+        return query::ValueExpr::newSimple(
+            query::ValueFactor::newColumnRefFactor(
+                std::make_shared<query::ColumnRef>("", "", column)));
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(suite, Fixture)
+
+BOOST_AUTO_TEST_CASE(FoldGroups) {
+    auto agg = newAggregator(1000);
+    Result r1 = newResult();
+    addRow(r1, {"a", "3", "1.5", "10.25"});
+    addRow(r1, {"b", "4", "2.5", "NULL"});
+    Result r2 = newResult();
+    addRow(r2, {"a", "5", "0.5", "9.75"});
+    addRow(r2, {"b", "-1", "NULL", "1.5"});
+    addRow(r2, {"NULL", "7", "7", "7"});
+    HashAggregator::ResponseVector toLoad;
+    BOOST_CHECK(agg->add(r1, toLoad));
+    BOOST_CHECK(agg->add(r2, toLoad));
+    BOOST_CHECK(toLoad.empty());
+    RowMap rows = collect(agg->flush());
+    BOOST_CHECK_EQUAL(rows.size(), 3U);
+    BOOST_CHECK(rows["a"] == Strings({"a", "8", "0.5", "10.25"}));
+    BOOST_CHECK(rows["b"] == Strings({"b", "3", "2.5", "1.5"}));
+    BOOST_CHECK(rows["NULL"] == Strings({"NULL", "7", "7", "7"}));
+    BOOST_CHECK_EQUAL(agg->getRowsIn(), 5U);
+    BOOST_CHECK_EQUAL(agg->getRowsOut(), 3U);
+    BOOST_CHECK(agg->flush().empty());
+}
+
+BOOST_AUTO_TEST_CASE(KeepUnfoldable) {
+    auto agg = newAggregator(1000);
+    Result r = newResult();
+    addRow(r, {"a", "9223372036854775807", "1", "1"});
+    addRow(r, {"a", "1", "1", "1"}); // SUM overflows int64
+    addRow(r, {"b", "1", "1", "1.0"});
+    addRow(r, {"b", "1", "1", "1.00"}); // Equal DECIMALs, different text
+    HashAggregator::ResponseVector toLoad;
+    BOOST_CHECK(agg->add(r, toLoad));
+    size_t count = 0;
+    for(auto const& resp : agg->flush()) {
+        count += resp->result.row_size();
+    }
+    BOOST_CHECK_EQUAL(count, 4U);
+}
+
+BOOST_AUTO_TEST_CASE(GroupLimit) {
+    auto agg = newAggregator(16); // One group per shard
+    Result r = newResult();
+    for(int i = 0; i < 1000; ++i) {
+        addRow(r, {std::to_string(i), "1", "1", "1"});
+    }
+    size_t count = 0;
+    HashAggregator::ResponseVector toLoad;
+    BOOST_CHECK(agg->add(r, toLoad));
+    for(auto const& resp : toLoad) {
+        count += resp->result.row_size();
+    }
+    BOOST_CHECK(count > 0);
+    for(auto const& resp : agg->flush()) {
+        count += resp->result.row_size();
+    }
+    BOOST_CHECK_EQUAL(count, 1000U);
+    BOOST_CHECK_EQUAL(agg->getRowsOut(), 1000U);
+}
+
+BOOST_AUTO_TEST_CASE(SchemaMismatch) {
+    auto agg = newAggregator(1000);
+    Result r1 = newResult();
+    addRow(r1, {"a", "3", "1.5", "10.25"});
+    HashAggregator::ResponseVector toLoad;
+    BOOST_CHECK(agg->add(r1, toLoad));
+    // A short row fails the whole result, instead of being dropped.
+    Result r2 = newResult();
+    addRow(r2, {"a", "5", "0.5", "9.75"});
+    addRow(r2, {"b", "4", "2.5"});
+    BOOST_CHECK(!agg->add(r2, toLoad));
+    BOOST_CHECK_EQUAL(agg->getRowsIn(), 1U);
+    RowMap rows = collect(agg->flush());
+    BOOST_CHECK(rows["a"] == Strings({"a", "3", "1.5", "10.25"}));
+}
+
+BOOST_AUTO_TEST_CASE(Eligibility) {
+    // SELECT k, SUM(QS1_SUM), MIN(QS2_MIN) ... GROUP BY k is foldable.
+    auto stmt = newMergeStmt({column("k"), func("SUM", "QS1_SUM"), func("MIN", "QS2_MIN")});
+    BOOST_CHECK(HashAggregator::newHashAggregator(*stmt, 100));
+    // No aggregate
+    stmt = newMergeStmt({column("k")});
+    BOOST_CHECK(!HashAggregator::newHashAggregator(*stmt, 100));
+    // A column both aggregated and used as a key
+    stmt = newMergeStmt({column("QS1_SUM"), func("SUM", "QS1_SUM")});
+    BOOST_CHECK(!HashAggregator::newHashAggregator(*stmt, 100));
+    // Unknown merge operator
+    stmt = newMergeStmt({func("COUNT", "QS1_SUM")});
+    BOOST_CHECK(!HashAggregator::newHashAggregator(*stmt, 100));
+    // Filtering
+    stmt = newMergeStmt({func("SUM", "QS1_SUM")});
+    stmt->setWhereClause(std::make_shared<query::WhereClause>());
+    BOOST_CHECK(!HashAggregator::newHashAggregator(*stmt, 100));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,133 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+/**
+  * @file
+  *
+  * @brief Ingest benchmark for InfileMerger.
+  *
+  * Loads a fixed set of synthetic Result messages through InfileMerger with an
+  * increasing number of load connections and reports rows/sec for each. Needs
+  * a running mysqld and a writable result database, and so is not run as a
+  * unit test.
+  *
+  * Usage: testInfileMergerLoad [socket [db [user [messages [rowsPerMsg]]]]]
+  */
+
+// System headers
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Qserv headers
+#include "proto/WorkerResponse.h"
+#include "rproc/InfileMerger.h"
+
+using lsst::qserv::proto::WorkerResponse;
+using lsst::qserv::rproc::InfileMerger;
+using lsst::qserv::rproc::InfileMergerConfig;
+
+namespace {
+
+/// @return a response carrying rowCount rows of (BIGINT, DOUBLE, DOUBLE, CHAR)
+std::shared_ptr<WorkerResponse> makeResponse(int msgId, int rowCount) {
+    auto response = std::make_shared<WorkerResponse>();
+    auto& result = response->result;
+    result.set_continues(false);
+    auto rowSchema = result.mutable_rowschema();
+    char const* names[] = {"objectId", "ra", "decl", "tag"};
+    char const* types[] = {"BIGINT", "DOUBLE", "DOUBLE", "CHAR(16)"};
+    for(int i = 0; i < 4; ++i) {
+        auto cs = rowSchema->add_columnschema();
+        cs->set_name(names[i]);
+        cs->set_hasdefault(false);
+        cs->set_sqltype(types[i]);
+    }
+    for(int r = 0; r < rowCount; ++r) {
+        auto row = result.add_row();
+        long long id = static_cast<long long>(msgId) * rowCount + r;
+        row->add_column(std::to_string(id));
+        row->add_column(std::to_string(0.001 * r));
+        row->add_column(std::to_string(-0.002 * r));
+        row->add_column("tag" + std::to_string(r % 1000));
+        for(int i = 0; i < 4; ++i) {
+            row->add_isnull(false);
+        }
+    }
+    return response;
+}
+
+/// @return seconds spent loading and finalizing, or 0 on failure.
+/// The result table is left in place; its name is printed.
+double runLoad(InfileMergerConfig const& config,
+               std::vector<std::shared_ptr<WorkerResponse>> const& responses) {
+    auto start = std::chrono::steady_clock::now();
+    InfileMerger merger(config);
+    std::cout << "loading into " << merger.getTargetTable() << std::endl;
+    for(auto const& r : responses) {
+        if (!merger.merge(r)) {
+            std::cerr << "merge failed: " << merger.getError().getMsg() << std::endl;
+            return 0;
+        }
+    }
+    if (!merger.finalize()) {
+        std::cerr << "finalize failed: " << merger.getError().getMsg() << std::endl;
+        return 0;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    std::string socket = argc > 1 ? argv[1] : "/home/qserv/qserv-run/git/var/lib/mysql/mysql.sock";
+    std::string db = argc > 2 ? argv[2] : "qservResult";
+    std::string user = argc > 3 ? argv[3] : "qsmaster";
+    int messages = argc > 4 ? std::atoi(argv[4]) : 200;
+    int rowsPerMsg = argc > 5 ? std::atoi(argv[5]) : 10000;
+
+    std::vector<std::shared_ptr<WorkerResponse>> responses;
+    for(int i = 0; i < messages; ++i) {
+        responses.push_back(makeResponse(i, rowsPerMsg));
+    }
+    double totalRows = static_cast<double>(messages) * rowsPerMsg;
+
+    for(int conns : {1, 2, 4, 8, 16}) {
+        // Empty target table: InfileMerger generates a unique name.
+        InfileMergerConfig config(db, "",
+                                  std::shared_ptr<lsst::qserv::query::SelectStmt>(),
+                                  user, socket, conns);
+        double secs = runLoad(config, responses);
+        if (secs <= 0) {
+            return 1;
+        }
+        std::cout << "loadConnections=" << conns
+                  << " rows=" << totalRows
+                  << " seconds=" << secs
+                  << " rows/sec=" << totalRows / secs << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// System headers
+#include <string>
+#include <vector>
+
+// Third-party headers
+#include <mysql/mysql.h>
+
+// Qserv headers
+#include "proto/worker.pb.h"
+#include "rproc/LimitFilter.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE LimitFilter_1
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+using lsst::qserv::proto::Result;
+using lsst::qserv::rproc::LimitFilter;
+
+typedef std::vector<std::string> Strings;
+
+struct Fixture {
+    Fixture(void) {}
+    ~Fixture(void) { }
+
+    /// @return a Result with columns (id, ra, name) and one row per id
+    Result newResult(Strings const& ids, Strings const& ras) {
+        Result result;
+        result.set_continues(false);
+        auto schema = result.mutable_rowschema();
+        addColumn(schema, "id", MYSQL_TYPE_LONGLONG);
+        addColumn(schema, "ra", MYSQL_TYPE_DOUBLE);
+        addColumn(schema, "name", MYSQL_TYPE_VAR_STRING);
+        for(size_t i = 0; i < ids.size(); ++i) {
+            auto row = result.add_row();
+            row->add_column(ids[i]);
+            row->add_isnull(false);
+            row->add_column(ras[i] == "NULL" ? "" : ras[i]);
+            row->add_isnull(ras[i] == "NULL");
+            row->add_column("x");
+            row->add_isnull(false);
+        }
+        return result;
+    }
+
+    void addColumn(lsst::qserv::proto::RowSchema* schema, std::string const& name, int type) {
+        auto cs = schema->add_columnschema();
+        cs->set_name(name);
+        cs->set_hasdefault(false);
+        cs->set_sqltype("");
+        cs->set_mysqltype(type);
+    }
+
+    /// @return the id column of result rows
+    Strings ids(Result const& result) {
+        Strings s;
+        for(auto const& rb : result.row()) {
+            s.push_back(rb.column(0));
+        }
+        return s;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(suite, Fixture)
+
+BOOST_AUTO_TEST_CASE(Unordered) {
+    LimitFilter filter(3, std::vector<LimitFilter::SortColumn>());
+    Result r1 = newResult({"1", "2"}, {"0", "0"});
+    BOOST_CHECK_EQUAL(filter.filter(r1), 0);
+    BOOST_CHECK(!filter.isSatisfied());
+    Result r2 = newResult({"3", "4", "5"}, {"0", "0", "0"});
+    BOOST_CHECK_EQUAL(filter.filter(r2), 2);
+    BOOST_CHECK(ids(r2) == Strings({"3"}));
+    BOOST_CHECK(filter.isSatisfied());
+    Result r3 = newResult({"6"}, {"0"});
+    BOOST_CHECK_EQUAL(filter.filter(r3), 1);
+    BOOST_CHECK_EQUAL(r3.row_size(), 0);
+    BOOST_CHECK_EQUAL(filter.getRowsDropped(), 3U);
+}
+
+BOOST_AUTO_TEST_CASE(Ascending) {
+    std::vector<LimitFilter::SortColumn> sortColumns{{"RA", false}};
+    LimitFilter filter(2, sortColumns);
+    Result r1 = newResult({"1", "2", "3"}, {"5", "3", "4"});
+    // Rows sorting after the two best seen so far are dropped.
+    filter.filter(r1);
+    BOOST_CHECK(ids(r1) == Strings({"1", "2", "3"}));
+    Result r2 = newResult({"4", "5", "6", "7"}, {"6", "4", "1", "NULL"});
+    filter.filter(r2);
+    // Best keys are now {3, 4}: 6 is dropped, a tie at 4 is kept,
+    // then 1 and NULL (sorting first) are kept.
+    BOOST_CHECK(ids(r2) == Strings({"5", "6", "7"}));
+    Result r3 = newResult({"8", "9"}, {"3", "1"});
+    filter.filter(r3);
+    // Best keys are now {NULL, 1}: 3 is dropped, the tie at 1 is kept.
+    BOOST_CHECK(ids(r3) == Strings({"9"}));
+    BOOST_CHECK(!filter.isSatisfied());
+}
+
+BOOST_AUTO_TEST_CASE(Descending) {
+    std::vector<LimitFilter::SortColumn> sortColumns{{"ra", true}};
+    LimitFilter filter(1, sortColumns);
+    Result r = newResult({"1", "2", "3", "4"}, {"2.5", "1e3", "NULL", "999.5"});
+    filter.filter(r);
+    BOOST_CHECK(ids(r) == Strings({"1", "2"}));
+}
+
+BOOST_AUTO_TEST_CASE(NotSortable) {
+    // Strings are not compared, so nothing is dropped.
+    std::vector<LimitFilter::SortColumn> sortColumns{{"name", false}};
+    LimitFilter filter(1, sortColumns);
+    Result r = newResult({"1", "2", "3"}, {"1", "2", "3"});
+    BOOST_CHECK_EQUAL(filter.filter(r), 0);
+    BOOST_CHECK_EQUAL(r.row_size(), 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
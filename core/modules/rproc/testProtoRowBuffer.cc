@@ -21,7 +21,11 @@
  * see <http://www.lsstcorp.org/LegalNotices/>.
  */
 
+// Third-party headers
+#include <mysql/mysql.h>
+
 // Qserv headers
+#include "proto/ColumnBlocks.h"
 #include "proto/worker.pb.h"
 #include "proto/FakeProtocolFixture.h"
 
@@ -37,9 +41,30 @@ namespace gio = google::protobuf::io;
 struct Fixture {
     Fixture(void) {}
     ~Fixture(void) { }
+
+    /// Add a row of non-null columns to a Result message
+    void addRow(lsst::qserv::proto::Result& result, std::vector<std::string> const& cols) {
+        auto row = result.add_row();
+        for(auto const& c : cols) {
+            row->add_column(c);
+            row->add_isnull(false);
+        }
+    }
+
+    /// Drain a RowBuffer using fetch() calls of at most bufLen bytes.
+    std::string drain(lsst::qserv::mysql::RowBuffer& rb, unsigned bufLen) {
+        std::string out;
+        std::vector<char> buf(bufLen);
+        for(unsigned fetched = rb.fetch(&buf[0], bufLen); fetched > 0;
+            fetched = rb.fetch(&buf[0], bufLen)) {
+            BOOST_REQUIRE(fetched <= bufLen);
+            out.append(&buf[0], fetched);
+        }
+        return out;
+    }
 };
-using lsst::qserv::rproc::copyColumn;
-using lsst::qserv::rproc::escapeString;
+using lsst::qserv::mysql::escapeString;
+using lsst::qserv::rproc::newProtoRowBuffer;
 
 BOOST_FIXTURE_TEST_SUITE(suite, Fixture)
 
@@ -53,7 +78,7 @@ BOOST_AUTO_TEST_CASE(TestEscape) {
     std::string eTest1 = "abcdef \\0 \\b \\n \\r \\t \\Z \\N";
     std::string target(test1.size() * 2, 'X');
 
-    int count = escapeString(target.begin(), test1.begin(), test1.end());
+    int count = escapeString(&target[0], test1.data(), test1.size());
     BOOST_CHECK_EQUAL(count, static_cast<int>(eTest1.size()));
     BOOST_CHECK_EQUAL(target.substr(0, count), eTest1);
 }
@@ -63,18 +88,115 @@ BOOST_AUTO_TEST_CASE(TestEscapeEmptyString) {
 
     std::string target("XXX");
 
-    int count = escapeString(target.begin(), test1.begin(), test1.end());
+    int count = escapeString(&target[0], test1.data(), test1.size());
     BOOST_CHECK_EQUAL(count, 0);
     BOOST_CHECK_EQUAL(target.substr(0, count), "");
 }
 
+BOOST_AUTO_TEST_CASE(TestEscapeLong) {
+    // Long enough to exercise the vectorized path, with special characters
+    // at block boundaries and in runs.
+    std::string src;
+    std::string expected;
+    char const specials[] = {'\0', '\b', '\n', '\r', '\t', '\032'};
+    char const codes[] = {'0', 'b', 'n', 'r', 't', 'Z'};
+    for(int i = 0; i < 1000; ++i) {
+        if (i % 15 == 0 || i % 32 == 31 || (i > 500 && i < 540)) {
+            src += specials[i % 6];
+            expected += '\\';
+            expected += codes[i % 6];
+        } else {
+            char c = 'a' + (i % 26);
+            src += c;
+            expected += c;
+        }
+    }
+    std::string target(src.size() * 2, 'X');
+    int count = escapeString(&target[0], src.data(), src.size());
+    BOOST_CHECK_EQUAL(count, static_cast<int>(expected.size()));
+    BOOST_CHECK_EQUAL(target.substr(0, count), expected);
+
+    // Bounded escaping in small steps must give the same result and never
+    // split an escape sequence.
+    for(int step : {1, 2, 3, 17, 33}) {
+        std::string out;
+        int offset = 0;
+        while(offset < static_cast<int>(src.size())) {
+            int used = 0;
+            int written = escapeString(&target[0], step, src.data() + offset,
+                                       src.size() - offset, used);
+            BOOST_REQUIRE(written <= step);
+            BOOST_REQUIRE(used > 0 || step < 2);
+            if (used == 0) break;
+            out.append(target.data(), written);
+            offset += used;
+        }
+        if (step >= 2) {
+            BOOST_CHECK_EQUAL(out, expected);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(TestCopyColumn) {
     std::string simple = "Hello my name is bob";
     std::string eSimple = "'" + simple + "'";
-    std::string target;
-    int copied = copyColumn(target, simple);
-    BOOST_CHECK_EQUAL(copied, static_cast<int>(eSimple.size()));
-    BOOST_CHECK_EQUAL(target, eSimple);
+    lsst::qserv::proto::Result result;
+    addRow(result, {simple});
+    auto rb = newProtoRowBuffer(result);
+    BOOST_CHECK_EQUAL(drain(*rb, 1024), eSimple);
+}
+
+BOOST_AUTO_TEST_CASE(TestFetchRows) {
+    lsst::qserv::proto::Result result;
+    std::string expected;
+    for(int i = 0; i < 100; ++i) {
+        std::string a = "row" + std::to_string(i);
+        std::string b(i, 'x');
+        b += "\t\n";
+        addRow(result, {a, b});
+        auto row = result.mutable_row(i);
+        row->add_column(std::string());
+        row->add_isnull(true);
+        if (i) expected += "\n";
+        expected += "'" + a + "'\t'" + std::string(i, 'x') + "\\t\\n'\t\\N";
+    }
+    // Any fetch size must yield the same stream, including sizes that split
+    // rows, columns, and separators.
+    for(unsigned bufLen : {2u, 3u, 7u, 64u, 1024u, 1024u * 1024u}) {
+        auto rb = newProtoRowBuffer(result);
+        BOOST_CHECK_EQUAL(drain(*rb, bufLen), expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestFetchColumnBlocks) {
+    // Protocol 3 message with an integer, a double and a string column
+    lsst::qserv::proto::RowSchema schema;
+    for(int type : {MYSQL_TYPE_LONG, MYSQL_TYPE_DOUBLE, MYSQL_TYPE_VAR_STRING}) {
+        auto cs = schema.add_columnschema();
+        cs->set_hasdefault(false);
+        cs->set_sqltype("");
+        cs->set_mysqltype(type);
+    }
+    lsst::qserv::proto::ColumnBlockWriter writer(schema);
+    std::string expected;
+    for(int i = 0; i < 100; ++i) {
+        std::string a = std::to_string(i - 50);
+        std::string b = std::to_string(i) + ".25";
+        std::string c(i, 'x');
+        c += "\t";
+        char const* values[] = {a.c_str(), i % 7 ? b.c_str() : nullptr, c.c_str()};
+        unsigned long lengths[] = {a.size(), i % 7 ? b.size() : 0, c.size()};
+        writer.addRow(values, lengths);
+        if (i) expected += "\n";
+        expected += "'" + a + "'\t" + (i % 7 ? "'" + b + "'" : "\\N")
+            + "\t'" + std::string(i, 'x') + "\\t'";
+    }
+    lsst::qserv::proto::Result result;
+    writer.moveTo(result);
+    for(unsigned bufLen : {2u, 3u, 7u, 64u, 1024u * 1024u}) {
+        auto rb = newProtoRowBuffer(result);
+        BOOST_CHECK_EQUAL(drain(*rb, bufLen), expected);
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,254 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+/**
+  * @file
+  *
+  * @brief Microbenchmark for ProtoRowBuffer and LOAD DATA INFILE escaping.
+  *
+  * Compares the MB/s of the streaming ProtoRowBuffer against the former
+  * row-at-a-time implementation (reproduced below), and of the vectorized
+  * escapeString against a byte-at-a-time loop. Also compares the size and
+  * parse-and-drain cost of the same rows sent as protocol 2 RowBundles and
+  * as protocol 3 column blocks. No database is needed, but timings are not
+  * meaningful as a unit test.
+  *
+  * Usage: testProtoRowBufferBench [rows [wideColumnBytes]]
+  */
+
+// System headers
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string.h>
+#include <vector>
+
+// Third-party headers
+#include <mysql/mysql.h>
+
+// Qserv headers
+#include "mysql/escapeString.h"
+#include "proto/ColumnBlocks.h"
+#include "proto/worker.pb.h"
+#include "rproc/ProtoRowBuffer.h"
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////
+// Former implementation, for comparison
+////////////////////////////////////////////////////////////////////////
+int legacyEscape(char* dest, char const* src, int srcLength) {
+    char* destI = dest;
+    for(char const* i = src, *e = src + srcLength; i != e; ++i) {
+        switch(*i) {
+          case '\0':   *destI++ = '\\'; *destI++ = '0'; break;
+          case '\b':   *destI++ = '\\'; *destI++ = 'b'; break;
+          case '\n':   *destI++ = '\\'; *destI++ = 'n'; break;
+          case '\r':   *destI++ = '\\'; *destI++ = 'r'; break;
+          case '\t':   *destI++ = '\\'; *destI++ = 't'; break;
+          case '\032': *destI++ = '\\'; *destI++ = 'Z'; break;
+          default: *destI++ = *i; break;
+        }
+    }
+    return destI - dest;
+}
+
+class LegacyProtoRowBuffer : public lsst::qserv::mysql::RowBuffer {
+public:
+    LegacyProtoRowBuffer(lsst::qserv::proto::Result& res)
+        : _result(res), _rowIdx(0), _rowTotal(res.row_size()) {
+        if (_rowTotal > 0) {
+            _copyRowBundle(_currentRow, _result.row(0));
+        }
+    }
+    virtual unsigned fetch(char* buffer, unsigned bufLen) {
+        unsigned fetched = 0;
+        if (bufLen <= _currentRow.size()) {
+            memcpy(buffer, &_currentRow[0], bufLen);
+            _currentRow.erase(_currentRow.begin(), _currentRow.begin() + bufLen);
+            fetched = bufLen;
+        } else if (_currentRow.size()) {
+            memcpy(buffer, &_currentRow[0], _currentRow.size());
+            fetched = _currentRow.size();
+            _currentRow.clear();
+        }
+        if ((_currentRow.size() == 0) && (_rowIdx < _rowTotal)) {
+            ++_rowIdx;
+            if (_rowIdx < _rowTotal) {
+                _currentRow.push_back('\n');
+                _copyRowBundle(_currentRow, _result.row(_rowIdx));
+            }
+        }
+        return fetched;
+    }
+private:
+    void _copyRowBundle(std::vector<char>& dest, lsst::qserv::proto::RowBundle const& rb) {
+        for(int ci=0, ce=rb.column_size(); ci != ce; ++ci) {
+            if (ci != 0) {
+                dest.push_back('\t');
+            }
+            if (!rb.isnull(ci)) {
+                std::string const& col = rb.column(ci);
+                int existingSize = dest.size();
+                dest.resize(existingSize + 2 + 2 * col.size());
+                dest[existingSize] = '\'';
+                int valSize = legacyEscape(&dest[existingSize + 1], col.data(), col.size());
+                dest[existingSize + 1 + valSize] = '\'';
+                dest.resize(existingSize + 2 + valSize);
+            } else {
+                dest.push_back('\\');
+                dest.push_back('N');
+            }
+        }
+    }
+    lsst::qserv::proto::Result& _result;
+    int _rowIdx;
+    int _rowTotal;
+    std::vector<char> _currentRow;
+};
+
+////////////////////////////////////////////////////////////////////////
+// Benchmark helpers
+////////////////////////////////////////////////////////////////////////
+typedef std::chrono::steady_clock Clock;
+
+double mbPerSec(double bytes, Clock::time_point start) {
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return bytes / (1024 * 1024) / elapsed.count();
+}
+
+/// Build a Result resembling an Object query: numeric text columns plus one
+/// wide string column.
+void fillResult(lsst::qserv::proto::Result& result, int rows, int wideBytes) {
+    std::string wide(wideBytes, 'w');
+    for(int i = 0; i < wideBytes; i += 97) {
+        wide[i] = '\t'; // something to escape now and then
+    }
+    for(int r = 0; r < rows; ++r) {
+        auto row = result.add_row();
+        for(int c = 0; c < 20; ++c) {
+            row->add_column(std::to_string(r * 0.123456789 + c));
+            row->add_isnull(false);
+        }
+        row->add_column(wide);
+        row->add_isnull(false);
+        row->add_column(std::string());
+        row->add_isnull(true);
+    }
+}
+
+/// Encode the rows of fillResult as column blocks, as a protocol 3 worker
+/// would, with DOUBLE numeric columns.
+void fillColumns(lsst::qserv::proto::Result& result, int rows, int wideBytes) {
+    lsst::qserv::proto::Result rowResult;
+    fillResult(rowResult, rows, wideBytes);
+    lsst::qserv::proto::RowSchema schema;
+    for(int c = 0; c < 22; ++c) {
+        auto cs = schema.add_columnschema();
+        cs->set_hasdefault(false);
+        cs->set_sqltype("");
+        cs->set_mysqltype(c < 20 ? MYSQL_TYPE_DOUBLE : MYSQL_TYPE_VAR_STRING);
+    }
+    lsst::qserv::proto::ColumnBlockWriter writer(schema);
+    std::vector<char const*> values(22);
+    std::vector<unsigned long> lengths(22);
+    for(auto const& rb : rowResult.row()) {
+        for(int c = 0; c < 22; ++c) {
+            values[c] = rb.isnull(c) ? nullptr : rb.column(c).c_str();
+            lengths[c] = rb.column(c).size();
+        }
+        writer.addRow(&values[0], &lengths[0]);
+    }
+    writer.moveTo(result);
+}
+
+/// Drain a RowBuffer the way LocalInfile does, into a 1MB buffer.
+double drain(lsst::qserv::mysql::RowBuffer& rb, std::vector<char>& buffer, int& fetchCalls) {
+    double total = 0;
+    fetchCalls = 0;
+    for(unsigned f = rb.fetch(&buffer[0], buffer.size()); f > 0;
+        f = rb.fetch(&buffer[0], buffer.size())) {
+        total += f;
+        ++fetchCalls;
+    }
+    return total;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    int rows = argc > 1 ? std::atoi(argv[1]) : 200000;
+    int wideBytes = argc > 2 ? std::atoi(argv[2]) : 256;
+
+    lsst::qserv::proto::Result result;
+    fillResult(result, rows, wideBytes);
+    std::vector<char> buffer(1024 * 1024);
+
+    int calls = 0;
+    auto start = Clock::now();
+    LegacyProtoRowBuffer legacy(result);
+    double bytes = drain(legacy, buffer, calls);
+    std::cout << "ProtoRowBuffer legacy:    " << mbPerSec(bytes, start) << " MB/s, "
+              << calls << " fetch calls" << std::endl;
+
+    start = Clock::now();
+    auto streaming = lsst::qserv::rproc::newProtoRowBuffer(result);
+    bytes = drain(*streaming, buffer, calls);
+    std::cout << "ProtoRowBuffer streaming: " << mbPerSec(bytes, start) << " MB/s, "
+              << calls << " fetch calls" << std::endl;
+
+    // Wire size, and czar cost of parsing and draining, per protocol.
+    for(int protocol : {2, 3}) {
+        lsst::qserv::proto::Result sent;
+        sent.set_continues(false);
+        sent.mutable_rowschema();
+        if (protocol == 2) {
+            fillResult(sent, rows, wideBytes);
+        } else {
+            fillColumns(sent, rows, wideBytes);
+        }
+        std::string msg;
+        sent.SerializeToString(&msg);
+        start = Clock::now();
+        lsst::qserv::proto::Result received;
+        received.ParseFromString(msg);
+        auto rb = lsst::qserv::rproc::newProtoRowBuffer(received);
+        drain(*rb, buffer, calls);
+        std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+        std::cout << "Protocol " << protocol << ": " << msg.size() / (1024 * 1024) << " MB message, "
+                  << "parse and drain " << elapsed.count() << " ms" << std::endl;
+    }
+
+    // Escaping alone, on the wide column repeated.
+    std::string src(64 * 1024 * 1024, 'e');
+    for(size_t i = 0; i < src.size(); i += 997) {
+        src[i] = '\n';
+    }
+    std::vector<char> dest(2 * src.size());
+    start = Clock::now();
+    legacyEscape(&dest[0], src.data(), src.size());
+    std::cout << "escapeString legacy:      " << mbPerSec(src.size(), start) << " MB/s" << std::endl;
+    start = Clock::now();
+    lsst::qserv::mysql::escapeString(&dest[0], src.data(), src.size());
+    std::cout << "escapeString vectorized:  " << mbPerSec(src.size(), start) << " MB/s" << std::endl;
+    return 0;
+}
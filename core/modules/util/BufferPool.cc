@@ -0,0 +1,138 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "util/BufferPool.h"
+
+// System headers
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using lsst::qserv::util::PooledBuffer;
+
+/// Buffers smaller than this are rounded up to it.
+int const MIN_CLASS = 12; // 4 KiB
+/// Buffers larger than this are neither rounded up nor pooled.
+int const MAX_CLASS = 26; // 64 MiB
+/// Free buffers beyond this much memory are released.
+uint64_t const MAX_IDLE_BYTES = 256*1024*1024;
+
+/// @return the smallest size class holding size bytes
+int sizeClass(size_t size) {
+    int c = MIN_CLASS;
+    while (c <= MAX_CLASS && (size_t(1) << c) < size) {
+        ++c;
+    }
+    return c;
+}
+
+class Pool {
+public:
+    std::unique_ptr<char[]> take(int c) {
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto& free = _free[c - MIN_CLASS];
+        if (free.empty()) {
+            ++_stats.misses;
+            return nullptr;
+        }
+        std::unique_ptr<char[]> mem = std::move(free.back());
+        free.pop_back();
+        _stats.idleBytes -= size_t(1) << c;
+        ++_stats.hits;
+        return mem;
+    }
+
+    void give(int c, std::unique_ptr<char[]> mem) {
+        std::lock_guard<std::mutex> lock(_mtx);
+        if (_stats.idleBytes + (size_t(1) << c) > MAX_IDLE_BYTES) {
+            return; // Released outside of the lock, as mem is destroyed.
+        }
+        _free[c - MIN_CLASS].push_back(std::move(mem));
+        _stats.idleBytes += size_t(1) << c;
+    }
+
+    PooledBuffer::Stats getStats() {
+        std::lock_guard<std::mutex> lock(_mtx);
+        return _stats;
+    }
+
+private:
+    std::mutex _mtx;
+    std::vector<std::unique_ptr<char[]>> _free[MAX_CLASS - MIN_CLASS + 1];
+    PooledBuffer::Stats _stats;
+};
+
+Pool& getPool() {
+    static Pool pool;
+    return pool;
+}
+
+} // anonymous namespace
+
+namespace lsst {
+namespace qserv {
+namespace util {
+
+PooledBuffer::Ptr PooledBuffer::create(size_t capacity) {
+    int c = sizeClass(capacity);
+    if (c > MAX_CLASS) {
+        return Ptr(new PooledBuffer(std::unique_ptr<char[]>(new char[capacity]), capacity));
+    }
+    size_t classSize = size_t(1) << c;
+    std::unique_ptr<char[]> mem = getPool().take(c);
+    if (!mem) {
+        mem.reset(new char[classSize]);
+    }
+    return Ptr(new PooledBuffer(std::move(mem), classSize));
+}
+
+PooledBuffer::Ptr PooledBuffer::copyOf(char const* data, size_t size) {
+    Ptr buf = create(size);
+    std::memcpy(buf->data(), data, size);
+    buf->setSize(size);
+    return buf;
+}
+
+PooledBuffer::~PooledBuffer() {
+    int c = sizeClass(_capacity);
+    if (c <= MAX_CLASS && (size_t(1) << c) == _capacity) {
+        getPool().give(c, std::move(_mem));
+    }
+}
+
+void PooledBuffer::setSize(size_t size) {
+    if (size > _capacity) {
+        throw std::out_of_range("PooledBuffer::setSize: size exceeds capacity");
+    }
+    _size = size;
+}
+
+PooledBuffer::Stats PooledBuffer::getStats() {
+    return getPool().getStats();
+}
+
+}}} // namespace lsst::qserv::util
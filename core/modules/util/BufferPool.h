@@ -0,0 +1,83 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_UTIL_BUFFERPOOL_H
+#define LSST_QSERV_UTIL_BUFFERPOOL_H
+
+// System headers
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace lsst {
+namespace qserv {
+namespace util {
+
+/// PooledBuffer is a block of memory taken from a process-wide pool of free
+/// blocks, sorted by size class (powers of two), and returned to it on
+/// destruction. Large result messages go through several such buffers per
+/// second, and reusing them spares the allocator and page faults. Ownership
+/// is passed by moving the Ptr, so a message can be written once and handed
+/// down to the network layer without copies.
+class PooledBuffer {
+public:
+    using Ptr = std::unique_ptr<PooledBuffer>;
+
+    /// @return an empty buffer that can hold at least capacity bytes
+    static Ptr create(size_t capacity);
+
+    /// @return a buffer holding a copy of data
+    static Ptr copyOf(char const* data, size_t size);
+
+    PooledBuffer(PooledBuffer const&) = delete;
+    PooledBuffer& operator=(PooledBuffer const&) = delete;
+    ~PooledBuffer();
+
+    char* data() { return _mem.get(); }
+    char const* data() const { return _mem.get(); }
+    size_t size() const { return _size; }
+    size_t capacity() const { return _capacity; }
+
+    /// Set the number of bytes of data.
+    /// @throw std::out_of_range if size exceeds capacity()
+    void setSize(size_t size);
+
+    /// Pool statistics
+    struct Stats {
+        uint64_t hits {0}; ///< Buffers reused from the pool
+        uint64_t misses {0}; ///< Buffers allocated
+        uint64_t idleBytes {0}; ///< Memory of the free buffers
+    };
+    static Stats getStats();
+
+private:
+    PooledBuffer(std::unique_ptr<char[]> mem, size_t capacity)
+        : _mem(std::move(mem)), _capacity(capacity) {}
+
+    std::unique_ptr<char[]> _mem;
+    size_t const _capacity;
+    size_t _size {0};
+};
+
+}}} // namespace lsst::qserv::util
+
+#endif // LSST_QSERV_UTIL_BUFFERPOOL_H
@@ -0,0 +1,78 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "util/Compression.h"
+
+// Third-party headers
+#include <zlib.h>
+
+namespace lsst {
+namespace qserv {
+namespace util {
+
+bool Compression::compress(char const* buffer, size_t bufferSize, int level, std::string& out) {
+    uLongf outSize = compressBound(bufferSize);
+    out.resize(outSize);
+    int status = compress2(reinterpret_cast<Bytef*>(&out[0]), &outSize,
+                           reinterpret_cast<Bytef const*>(buffer), bufferSize, level);
+    if (status != Z_OK) {
+        out.clear();
+        return false;
+    }
+    out.resize(outSize);
+    return true;
+}
+
+bool Compression::compress(char const* buffer, size_t bufferSize, int level,
+                           char* out, size_t& outSize) {
+    uLongf size = outSize;
+    int status = compress2(reinterpret_cast<Bytef*>(out), &size,
+                           reinterpret_cast<Bytef const*>(buffer), bufferSize, level);
+    if (status != Z_OK) {
+        return false;
+    }
+    outSize = size;
+    return true;
+}
+
+size_t Compression::getBound(size_t bufferSize) {
+    return compressBound(bufferSize);
+}
+
+bool Compression::decompress(char const* buffer, size_t bufferSize,
+                             size_t uncompressedSize, std::string& out) {
+    // One spare byte, so that data longer than promised is detected.
+    out.resize(uncompressedSize + 1);
+    uLongf outSize = out.size();
+    int status = uncompress(reinterpret_cast<Bytef*>(&out[0]), &outSize,
+                            reinterpret_cast<Bytef const*>(buffer), bufferSize);
+    if (status != Z_OK || outSize != uncompressedSize) {
+        out.clear();
+        return false;
+    }
+    out.resize(outSize);
+    return true;
+}
+
+}}} // namespace lsst::qserv::util
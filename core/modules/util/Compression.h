@@ -0,0 +1,61 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#ifndef LSST_QSERV_UTIL_COMPRESSION_H
+#define LSST_QSERV_UTIL_COMPRESSION_H
+
+// System headers
+#include <cstddef>
+#include <string>
+
+namespace lsst {
+namespace qserv {
+namespace util {
+
+/// Small wrappers for zlib compression of whole buffers
+class Compression {
+public:
+    /// Compress buffer into out, replacing its contents.
+    /// @param level 1 (fastest) to 9 (smallest)
+    /// @return false on error
+    static bool compress(char const* buffer, size_t bufferSize, int level, std::string& out);
+
+    /// Compress buffer into out, which holds outSize bytes.
+    /// @param outSize set to the size of the compressed data
+    /// @return false on error, or if the data did not fit
+    static bool compress(char const* buffer, size_t bufferSize, int level,
+                         char* out, size_t& outSize);
+
+    /// @return the largest possible compressed size of bufferSize bytes
+    static size_t getBound(size_t bufferSize);
+
+    /// Decompress buffer into out, replacing its contents.
+    /// @return false if buffer is not compressed data of exactly
+    /// uncompressedSize bytes
+    static bool decompress(char const* buffer, size_t bufferSize,
+                           size_t uncompressedSize, std::string& out);
+};
+
+}}} // namespace lsst::qserv::util
+
+#endif // LSST_QSERV_UTIL_COMPRESSION_H
@@ -0,0 +1,75 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "util/Histogram.h"
+
+// System headers
+#include <algorithm>
+#include <sstream>
+
+namespace lsst {
+namespace qserv {
+namespace util {
+
+Histogram::Histogram(std::string const& label, std::vector<double> const& bucketMaxVals)
+    : _label(label), _maxVals(bucketMaxVals), _counts(bucketMaxVals.size() + 1, 0) {
+}
+
+void Histogram::addEntry(double val) {
+    size_t const bucket = std::lower_bound(_maxVals.begin(), _maxVals.end(), val) - _maxVals.begin();
+    std::lock_guard<std::mutex> lock(_mtx);
+    ++_counts[bucket];
+    ++_total;
+    _sum += val;
+}
+
+uint64_t Histogram::getTotalCount() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _total;
+}
+
+double Histogram::getAvg() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _total == 0 ? 0 : _sum/_total;
+}
+
+std::vector<uint64_t> Histogram::getCounts() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _counts;
+}
+
+std::string Histogram::getString() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    std::ostringstream os;
+    os << _label << " total=" << _total << " avg=" << (_total == 0 ? 0 : _sum/_total);
+    for (size_t i = 0; i < _maxVals.size(); ++i) {
+        os << " <=" << _maxVals[i] << ":" << _counts[i];
+    }
+    if (!_maxVals.empty()) {
+        os << " >" << _maxVals.back() << ":" << _counts.back();
+    }
+    return os.str();
+}
+
+}}} // namespace lsst::qserv::util
@@ -0,0 +1,70 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_UTIL_HISTOGRAM_H
+#define LSST_QSERV_UTIL_HISTOGRAM_H
+
+// System headers
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lsst {
+namespace qserv {
+namespace util {
+
+/// Histogram counts values in buckets bounded by increasing maximum values,
+/// with one more bucket for the values above the last of them. It is thread
+/// safe.
+class Histogram {
+public:
+    /// @param label names the histogram in getString()
+    /// @param bucketMaxVals maximum value of each bucket, in increasing order
+    Histogram(std::string const& label, std::vector<double> const& bucketMaxVals);
+
+    Histogram(Histogram const&) = delete;
+    Histogram& operator=(Histogram const&) = delete;
+
+    void addEntry(double val);
+
+    uint64_t getTotalCount() const;
+    double getAvg() const;
+
+    /// @return the count of each bucket, the one above the maximum values last
+    std::vector<uint64_t> getCounts() const;
+
+    /// @return e.g. "label total=12 avg=0.3 <=0.1:4 <=1:7 >1:1"
+    std::string getString() const;
+
+private:
+    std::string const _label;
+    std::vector<double> const _maxVals;
+    mutable std::mutex _mtx; ///< Protects the members below
+    std::vector<uint64_t> _counts;
+    uint64_t _total {0};
+    double _sum {0};
+};
+
+}}} // namespace lsst::qserv::util
+
+#endif // LSST_QSERV_UTIL_HISTOGRAM_H
@@ -26,8 +26,12 @@
 #include "util/StringHash.h"
 
 // System headers
+#include <cstring>
 #include <iostream>
 #include <sstream>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
 
 // Third-party headers
 #ifdef __APPLE__
@@ -84,6 +88,64 @@ inline std::string wrapHashHex(void const* buffer, int bufferSize) {
     return s.str();
 }
 
+/// Lookup tables for software CRC32C, processing 8 bytes per step
+/// (slicing-by-8).
+struct Crc32cTables {
+    uint32_t t[8][256];
+    Crc32cTables() {
+        uint32_t const poly = 0x82f63b78; // Castagnoli, reflected
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? (c >> 1) ^ poly : c >> 1;
+            }
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int s = 1; s < 8; ++s) {
+                t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+uint32_t crc32cSoftware(uint32_t crc, unsigned char const* p, size_t len) {
+    static Crc32cTables const tables;
+    auto const& t = tables.t;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint32_t lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24);
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff]
+            ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+            ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; len > 0; ++p, --len) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xff];
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardware(uint32_t crc, unsigned char const* p, size_t len) {
+    uint64_t crc64 = crc;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; len > 0; ++p, --len) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+    return crc;
+}
+
+bool hasSse42() {
+    static bool const has = __builtin_cpu_supports("sse4.2");
+    return has;
+}
+#endif
+
 } // anonymous namespace
 
 namespace lsst {
@@ -125,4 +187,17 @@ std::string StringHash::getSha256(char const* buffer, int bufferSize) {
     return wrapHash<SHA256, SHA256_DIGEST_LENGTH>(buffer, bufferSize);
 }
 
+/// @return the CRC32C of the input buffer, continuing from crc
+/// 32 bits, several GB/s with SSE4.2
+uint32_t StringHash::getCrc32c(char const* buffer, size_t bufferSize, uint32_t crc) {
+    auto p = reinterpret_cast<unsigned char const*>(buffer);
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (hasSse42()) {
+        return ~crc32cHardware(crc, p, bufferSize);
+    }
+#endif
+    return ~crc32cSoftware(crc, p, bufferSize);
+}
+
 }}} // namespace lsst::qserv::util
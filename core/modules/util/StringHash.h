@@ -25,6 +25,8 @@
 #define LSST_QSERV_UTIL_STRINGHASH_H
 
 // System headers
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace lsst {
@@ -40,6 +42,11 @@ public:
     static std::string getMd5(char const* buffer, int bufferSize);
     static std::string getSha1(char const* buffer, int bufferSize);
     static std::string getSha256(char const* buffer, int bufferSize);
+
+    /// @return the CRC32C (Castagnoli) checksum of the input buffer, using
+    /// the SSE4.2 crc32 instruction when the CPU has it. Pass the checksum of
+    /// preceding data as crc to checksum a buffer in pieces.
+    static uint32_t getCrc32c(char const* buffer, size_t bufferSize, uint32_t crc=0);
 };
 
 }}} // namespace lsst::qserv::util
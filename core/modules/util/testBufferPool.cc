@@ -0,0 +1,71 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// System headers
+#include <cstring>
+#include <stdexcept>
+
+// Qserv headers
+#include "util/BufferPool.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE BufferPool
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+using lsst::qserv::util::PooledBuffer;
+
+BOOST_AUTO_TEST_SUITE(Suite)
+
+BOOST_AUTO_TEST_CASE(SizeClasses) {
+    auto small = PooledBuffer::create(1);
+    BOOST_CHECK_EQUAL(small->capacity(), 4096U);
+    BOOST_CHECK_EQUAL(small->size(), 0U);
+    auto buf = PooledBuffer::create(5000);
+    BOOST_CHECK_EQUAL(buf->capacity(), 8192U);
+    buf->setSize(8192);
+    BOOST_CHECK_THROW(buf->setSize(8193), std::out_of_range);
+    auto huge = PooledBuffer::create((size_t(1) << 26) + 1);
+    BOOST_CHECK_EQUAL(huge->capacity(), (size_t(1) << 26) + 1);
+}
+
+BOOST_AUTO_TEST_CASE(Reuse) {
+    auto buf = PooledBuffer::create(100000);
+    char* mem = buf->data();
+    auto before = PooledBuffer::getStats();
+    buf.reset();
+    BOOST_CHECK_EQUAL(PooledBuffer::getStats().idleBytes, before.idleBytes + 131072);
+    buf = PooledBuffer::create(70000); // Same size class
+    BOOST_CHECK(buf->data() == mem);
+    BOOST_CHECK_EQUAL(PooledBuffer::getStats().hits, before.hits + 1);
+}
+
+BOOST_AUTO_TEST_CASE(Copy) {
+    char const text[] = "Hello, pool";
+    auto buf = PooledBuffer::copyOf(text, sizeof(text));
+    BOOST_CHECK_EQUAL(buf->size(), sizeof(text));
+    BOOST_CHECK(std::memcmp(buf->data(), text, sizeof(text)) == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,101 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+/**
+ *
+ * @brief test Compression
+ *
+ */
+
+// System headers
+#include <string>
+
+// Qserv headers
+#include "util/Compression.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE Compression
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+namespace util = lsst::qserv::util;
+
+BOOST_AUTO_TEST_SUITE(Suite)
+
+BOOST_AUTO_TEST_CASE(RoundTrip) {
+    std::string src;
+    for (int i = 0; i < 10000; ++i) {
+        src += std::to_string(i * 0.5) + '\t';
+    }
+    for (int level : {1, 6, 9}) {
+        std::string compressed;
+        BOOST_REQUIRE(util::Compression::compress(src.data(), src.size(), level, compressed));
+        BOOST_CHECK(compressed.size() < src.size());
+        std::string out;
+        BOOST_REQUIRE(util::Compression::decompress(compressed.data(), compressed.size(),
+                                                    src.size(), out));
+        BOOST_CHECK(out == src);
+    }
+    std::string compressed;
+    std::string out;
+    BOOST_REQUIRE(util::Compression::compress("", 0, 1, compressed));
+    BOOST_CHECK(util::Compression::decompress(compressed.data(), compressed.size(), 0, out));
+    BOOST_CHECK(out.empty());
+}
+
+/** @test
+ * Compressing into a caller's buffer
+ */
+BOOST_AUTO_TEST_CASE(RawBuffer) {
+    std::string src(5000, 'a');
+    std::string out(util::Compression::getBound(src.size()), '\0');
+    size_t outSize = out.size();
+    BOOST_REQUIRE(util::Compression::compress(src.data(), src.size(), 1, &out[0], outSize));
+    BOOST_CHECK(outSize < src.size());
+    std::string round;
+    BOOST_REQUIRE(util::Compression::decompress(out.data(), outSize, src.size(), round));
+    BOOST_CHECK(round == src);
+    outSize = 4; // Too small
+    BOOST_CHECK(!util::Compression::compress(src.data(), src.size(), 1, &out[0], outSize));
+}
+
+/** @test
+ * Corrupt data or a wrong size must be reported
+ */
+BOOST_AUTO_TEST_CASE(BadInput) {
+    std::string src(5000, 'a');
+    std::string compressed;
+    BOOST_REQUIRE(util::Compression::compress(src.data(), src.size(), 1, compressed));
+    std::string out;
+    BOOST_CHECK(!util::Compression::decompress(compressed.data(), compressed.size(),
+                                               src.size() - 1, out));
+    BOOST_CHECK(!util::Compression::decompress(compressed.data(), compressed.size(),
+                                               src.size() + 1, out));
+    BOOST_CHECK(!util::Compression::decompress(compressed.data(), compressed.size() / 2,
+                                               src.size(), out));
+    compressed[compressed.size() / 2] ^= 0x55;
+    BOOST_CHECK(!util::Compression::decompress(compressed.data(), compressed.size(),
+                                               src.size(), out));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
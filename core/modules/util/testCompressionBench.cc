@@ -0,0 +1,109 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+/**
+  * @file
+  *
+  * @brief Microbenchmark for result message compression.
+  *
+  * For each zlib level, reports the compression ratio and the compression
+  * (worker) and decompression (czar) throughput on 2 MB messages of
+  * synthetic result data: numeric text, as in protocol 2 rows, and packed
+  * doubles, as in protocol 3 column blocks. Compression pays off when the
+  * network is slower than the worker can compress. Timings are not
+  * meaningful as a unit test.
+  *
+  * Usage: testCompressionBench [megabytes]
+  */
+
+// System headers
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Qserv headers
+#include "util/Compression.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+size_t const MSG_SIZE = 2 * 1024 * 1024; // ProtoHeaderWrap::PROTOBUFFER_DESIRED_LIMIT
+
+double seconds(Clock::time_point start) {
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return elapsed.count();
+}
+
+/// Print ratio and throughputs of compressing data in MSG_SIZE messages.
+void run(std::string const& name, std::string const& data) {
+    using lsst::qserv::util::Compression;
+    double const mb = data.size() / (1024.0 * 1024);
+    for (int level : {1, 3, 6, 9}) {
+        std::string compressed;
+        std::string out;
+        size_t totalCompressed = 0;
+        double compressSec = 0;
+        double decompressSec = 0;
+        for (size_t pos = 0; pos < data.size(); pos += MSG_SIZE) {
+            size_t len = std::min(MSG_SIZE, data.size() - pos);
+            auto start = Clock::now();
+            Compression::compress(data.data() + pos, len, level, compressed);
+            compressSec += seconds(start);
+            totalCompressed += compressed.size();
+            start = Clock::now();
+            Compression::decompress(compressed.data(), compressed.size(), len, out);
+            decompressSec += seconds(start);
+        }
+        std::cout << name << " level " << level
+                  << ": ratio " << static_cast<double>(data.size()) / totalCompressed
+                  << ", compress " << mb / compressSec << " MB/s"
+                  << ", decompress " << mb / decompressSec << " MB/s" << std::endl;
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    size_t size = (argc > 1 ? std::atoi(argv[1]) : 64) * 1024 * 1024;
+    std::string text;
+    std::string packed;
+    uint64_t seed = 1;
+    while (text.size() < size || packed.size() < size) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        // Values resembling coordinates and fluxes, with limited precision.
+        double val = static_cast<double>(seed >> 40) / 1000.0;
+        if (text.size() < size) {
+            text += std::to_string(val);
+            text += (seed & 0xf) ? '\t' : '\n';
+        }
+        if (packed.size() < size) {
+            packed.append(reinterpret_cast<char const*>(&val), sizeof(val));
+        }
+    }
+    run("text rows", text);
+    run("packed doubles", packed);
+    return 0;
+}
@@ -0,0 +1,83 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+/**
+ *
+ * @brief test StringHash
+ *
+ */
+
+// System headers
+#include <string>
+
+// Qserv headers
+#include "util/StringHash.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE StringHash
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+namespace util = lsst::qserv::util;
+
+BOOST_AUTO_TEST_SUITE(Suite)
+
+BOOST_AUTO_TEST_CASE(Md5) {
+    std::string s("The quick brown fox jumps over the lazy dog");
+    BOOST_CHECK_EQUAL(util::StringHash::getMd5Hex(s.data(), s.size()),
+                      "9e107d9d372bb6826bd81d3542a419d6");
+    BOOST_CHECK_EQUAL(util::StringHash::getMd5(s.data(), s.size()).size(), 16U);
+}
+
+/** @test
+ * Check CRC32C against published check values
+ */
+BOOST_AUTO_TEST_CASE(Crc32c) {
+    std::string s("123456789");
+    BOOST_CHECK_EQUAL(util::StringHash::getCrc32c(s.data(), s.size()), 0xe3069283U);
+    BOOST_CHECK_EQUAL(util::StringHash::getCrc32c(s.data(), 0), 0U);
+    std::string zeros(32, '\0');
+    BOOST_CHECK_EQUAL(util::StringHash::getCrc32c(zeros.data(), zeros.size()), 0x8a9136aaU);
+    std::string ones(32, '\xff');
+    BOOST_CHECK_EQUAL(util::StringHash::getCrc32c(ones.data(), ones.size()), 0x62a8ab43U);
+}
+
+/** @test
+ * Checksumming a buffer in pieces gives the checksum of the whole buffer
+ */
+BOOST_AUTO_TEST_CASE(Crc32cPieces) {
+    std::string s;
+    for (int i = 0; i < 1000; ++i) {
+        s += static_cast<char>(i * 31 + 7);
+    }
+    uint32_t whole = util::StringHash::getCrc32c(s.data(), s.size());
+    for (size_t split : {1U, 7U, 8U, 13U, 512U, 999U}) {
+        uint32_t crc = util::StringHash::getCrc32c(s.data(), split);
+        crc = util::StringHash::getCrc32c(s.data() + split, s.size() - split, crc);
+        BOOST_CHECK_EQUAL(crc, whole);
+    }
+    s[500] ^= 1;
+    BOOST_CHECK(util::StringHash::getCrc32c(s.data(), s.size()) != whole);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
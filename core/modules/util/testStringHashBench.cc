@@ -0,0 +1,88 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+/**
+  * @file
+  *
+  * @brief Microbenchmark for result message checksums.
+  *
+  * Reports the cost per GB of the result checksums of ProtoHeader: MD5, which
+  * every worker and czar computed before ChecksumType was negotiated, and
+  * CRC32C. Workers compute the checksum once per message and the czar once
+  * more to verify it, so each figure is paid on both sides. Timings are not
+  * meaningful as a unit test.
+  *
+  * Usage: testStringHashBench [megabytes [messageKilobytes]]
+  */
+
+// System headers
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Qserv headers
+#include "util/StringHash.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/// @return seconds to checksum data in messages of msgSize bytes, per GB
+template <typename F>
+double secPerGb(std::string const& data, size_t msgSize, F hashFunc) {
+    auto start = Clock::now();
+    size_t sink = 0;
+    for (size_t pos = 0; pos < data.size(); pos += msgSize) {
+        size_t len = std::min(msgSize, data.size() - pos);
+        sink += hashFunc(data.data() + pos, len);
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    if (sink == 1) { std::cout << ""; } // Keep the loop from being optimized out.
+    return elapsed.count() * (1024.0 * 1024 * 1024) / data.size();
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    using lsst::qserv::util::StringHash;
+    size_t mb = argc > 1 ? std::atoi(argv[1]) : 512;
+    size_t msgKb = argc > 2 ? std::atoi(argv[2]) : 2048; // PROTOBUFFER_DESIRED_LIMIT
+    std::string data(mb * 1024 * 1024, '\0');
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i * 2654435761U >> 24);
+    }
+    size_t msgSize = msgKb * 1024;
+
+    double md5 = secPerGb(data, msgSize, [](char const* p, size_t n) {
+            return StringHash::getMd5(p, n)[0];
+        });
+    double crc = secPerGb(data, msgSize, [](char const* p, size_t n) {
+            return StringHash::getCrc32c(p, n);
+        });
+    std::cout << "Checksum cost per GB of results, " << msgKb << "KB messages, "
+              << "paid once on the worker and once on the czar" << std::endl;
+    std::cout << "MD5:    " << md5 << " s/GB" << std::endl;
+    std::cout << "CRC32C: " << crc << " s/GB (" << md5 / crc << "x faster)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,164 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "wbase/MultiChunkChannel.h"
+
+// LSST headers
+#include "lsst/log/Log.h"
+
+// Qserv headers
+#include "global/debugUtil.h"
+#include "proto/ProtoHeaderWrap.h"
+#include "proto/worker.pb.h"
+#include "util/StringHash.h"
+
+namespace {
+
+LOG_LOGGER _log = LOG_GET("lsst.qserv.wbase.MultiChunkChannel");
+
+/// @return a wrapped ProtoHeader for a message of chunkId
+std::string wrapHeader(lsst::qserv::proto::ProtoHeader& header, int chunkId) {
+    header.set_protocol(2);
+    header.set_wname(lsst::qserv::getHostname());
+    header.set_chunkid(chunkId);
+    std::string headerString;
+    header.SerializeToString(&headerString);
+    return lsst::qserv::proto::ProtoHeaderWrap::wrap(headerString);
+}
+
+} // anonymous namespace
+
+namespace lsst {
+namespace qserv {
+namespace wbase {
+
+/// Channel for the messages of one chunk. Each ProtoHeader is held back
+/// until its Result is sent.
+class MultiChunkChannel::ChunkChannel : public SendChannel {
+public:
+    ChunkChannel(MultiChunkChannel::Ptr const& mux, int chunkId)
+        : _mux(mux), _chunkId(chunkId) {}
+
+    ~ChunkChannel() override {
+        if (!_ended) {
+            LOGS(_log, LOG_LVL_WARN, "Chunk " << _chunkId << " ended without a last message");
+            sendError("Result of chunk " + std::to_string(_chunkId) + " incomplete", -1);
+        }
+    }
+
+    bool send(char const* buf, int bufLen) override {
+        LOGS(_log, LOG_LVL_ERROR, "Chunk " << _chunkId << " send() unsupported");
+        return false;
+    }
+
+    bool sendFile(int fd, Size fSize) override {
+        LOGS(_log, LOG_LVL_ERROR, "Chunk " << _chunkId << " sendFile() unsupported");
+        return false;
+    }
+
+    /// Send an error Result for this chunk as its last message.
+    bool sendError(std::string const& msg, int code) override {
+        if (_ended) {
+            return false;
+        }
+        proto::Result result;
+        result.set_continues(false);
+        result.mutable_rowschema();
+        result.set_errorcode(code);
+        result.set_errormsg(msg);
+        std::string resultString;
+        result.SerializeToString(&resultString);
+        proto::ProtoHeader header;
+        header.set_size(resultString.size());
+        header.set_md5(util::StringHash::getMd5(resultString.data(), resultString.size()));
+        _headerHeld = false;
+        _ended = true;
+        return _mux->_sendMsg(wrapHeader(header, _chunkId),
+                              util::PooledBuffer::copyOf(resultString.data(), resultString.size()),
+                              true);
+    }
+
+    bool sendStream(char const* buf, int bufLen, bool last) override {
+        if (!_headerHeld && !last) {
+            _header.assign(buf, bufLen);
+            _headerHeld = true;
+            return true;
+        }
+        return sendStream(util::PooledBuffer::copyOf(buf, bufLen), last);
+    }
+
+    bool sendStream(util::PooledBuffer::Ptr buf, bool last) override {
+        if (_ended) {
+            return false;
+        }
+        if (!_headerHeld) {
+            if (last) {
+                LOGS(_log, LOG_LVL_ERROR, "Chunk " << _chunkId << " result without header");
+                return false;
+            }
+            _header.assign(buf->data(), buf->size());
+            _headerHeld = true;
+            return true;
+        }
+        _headerHeld = false;
+        _ended = last;
+        return _mux->_sendMsg(_header, std::move(buf), last);
+    }
+
+private:
+    MultiChunkChannel::Ptr const _mux;
+    int const _chunkId;
+    std::string _header; ///< ProtoHeader waiting for its Result
+    bool _headerHeld{false};
+    bool _ended{false}; ///< The last message of the chunk was sent
+};
+
+SendChannel::Ptr MultiChunkChannel::newChunkChannel(int chunkId) {
+    return std::make_shared<ChunkChannel>(shared_from_this(), chunkId);
+}
+
+bool MultiChunkChannel::sendUnowned(int chunkId) {
+    proto::ProtoHeader header;
+    header.set_size(0);
+    header.set_unowned(true);
+    return _sendMsg(wrapHeader(header, chunkId), nullptr, true);
+}
+
+/// Send header, followed by msg if there is one, as one unit.
+/// @param chunkLast true if this is the last message of its chunk
+bool MultiChunkChannel::_sendMsg(std::string const& header, util::PooledBuffer::Ptr msg,
+                                 bool chunkLast) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    bool last = false;
+    if (chunkLast && _chunksLeft > 0) {
+        last = --_chunksLeft == 0;
+    }
+    bool ok = _channel->sendStream(header.data(), header.size(), last && !msg);
+    if (ok && msg) {
+        ok = _channel->sendStream(std::move(msg), last);
+    }
+    return ok;
+}
+
+}}} // namespace lsst::qserv::wbase
@@ -0,0 +1,82 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_WBASE_MULTICHUNKCHANNEL_H
+#define LSST_QSERV_WBASE_MULTICHUNKCHANNEL_H
+
+// System headers
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Qserv headers
+#include "util/BufferPool.h"
+#include "wbase/SendChannel.h"
+
+namespace lsst {
+namespace qserv {
+namespace wbase {
+
+/// MultiChunkChannel shares one result stream between the Tasks of a
+/// multi-chunk TaskMsg (see TaskMsg.chunkblock in proto/worker.proto).
+///
+/// Each Task sends through its own channel from newChunkChannel(), which
+/// holds back a ProtoHeader until its Result follows, and then passes the
+/// pair on as a unit, so that the messages of different chunks interleave
+/// without splitting. The shared stream is only ended by the last message
+/// of the last chunk to finish.
+class MultiChunkChannel : public std::enable_shared_from_this<MultiChunkChannel> {
+public:
+    using Ptr = std::shared_ptr<MultiChunkChannel>;
+
+    /// @param channel the stream of the request
+    /// @param chunkCount chunks that will send results, or be reported
+    ///        with sendUnowned()
+    MultiChunkChannel(SendChannel::Ptr const& channel, int chunkCount)
+        : _channel(channel), _chunksLeft(chunkCount) {}
+
+    MultiChunkChannel(MultiChunkChannel const&) = delete;
+    MultiChunkChannel& operator=(MultiChunkChannel const&) = delete;
+
+    /// @return a channel for the results of chunkId. sendError() on it sends
+    /// an error Result for that chunk only. If the channel is destroyed
+    /// before its last message, an error Result is sent in its place, so
+    /// that the czar is not left waiting for the chunk.
+    SendChannel::Ptr newChunkChannel(int chunkId);
+
+    /// Tell the czar this worker does not hold chunkId, so that it sends the
+    /// chunk elsewhere.
+    bool sendUnowned(int chunkId);
+
+private:
+    class ChunkChannel;
+
+    bool _sendMsg(std::string const& header, util::PooledBuffer::Ptr msg, bool chunkLast);
+
+    SendChannel::Ptr const _channel;
+    std::mutex _mtx; ///< Keeps messages whole, protects _chunksLeft
+    int _chunksLeft;
+};
+
+}}} // namespace lsst::qserv::wbase
+
+#endif // LSST_QSERV_WBASE_MULTICHUNKCHANNEL_H
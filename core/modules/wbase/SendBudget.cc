@@ -0,0 +1,76 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "wbase/SendBudget.h"
+
+// LSST headers
+#include "lsst/log/Log.h"
+
+namespace {
+LOG_LOGGER _log = LOG_GET("lsst.qserv.wbase.SendBudget");
+}
+
+namespace lsst {
+namespace qserv {
+namespace wbase {
+
+void SendBudget::acquire(size_t bytes, std::function<bool()> const& exempt) {
+    std::unique_lock<std::mutex> lock(_mtx);
+    if (_maxBytes != 0 && _queuedBytes + bytes > _maxBytes && !exempt()) {
+        LOGS(_log, LOG_LVL_DEBUG, "SendBudget full, queued=" << _queuedBytes
+             << " max=" << _maxBytes << " waiting to queue " << bytes);
+        _cv.wait(lock, [this, bytes, &exempt]() {
+                return _queuedBytes + bytes <= _maxBytes || exempt(); });
+    }
+    _queuedBytes += bytes;
+}
+
+void SendBudget::release(size_t bytes) {
+    std::function<void()> roomFunc;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        bool wasFull = isFull();
+        _queuedBytes -= bytes;
+        if (wasFull && !isFull()) {
+            roomFunc = _roomFunc;
+        }
+    }
+    _cv.notify_all();
+    if (roomFunc) {
+        roomFunc();
+    }
+}
+
+void SendBudget::wake() {
+    // Taking the lock orders this after the check of a sender about to wait.
+    { std::lock_guard<std::mutex> lock(_mtx); }
+    _cv.notify_all();
+}
+
+void SendBudget::setRoomFunc(std::function<void()> const& func) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _roomFunc = func;
+}
+
+}}} // namespace lsst::qserv::wbase
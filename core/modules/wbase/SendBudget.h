@@ -0,0 +1,86 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_WBASE_SENDBUDGET_H
+#define LSST_QSERV_WBASE_SENDBUDGET_H
+
+// System headers
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace lsst {
+namespace qserv {
+namespace wbase {
+
+/// SendBudget caps the bytes of result data a worker holds queued for
+/// sending, across all of its result streams. When czars merge slower than
+/// the worker produces, senders block in acquire() instead of letting
+/// worker memory grow, and the scheduler can look at isFull() to hold
+/// back new Tasks until the queues drain.
+class SendBudget {
+public:
+    using Ptr = std::shared_ptr<SendBudget>;
+
+    /// @param maxBytes the cap, 0 for no limit (bytes are still counted)
+    explicit SendBudget(uint64_t maxBytes) : _maxBytes(maxBytes) {}
+
+    SendBudget(SendBudget const&) = delete;
+    SendBudget& operator=(SendBudget const&) = delete;
+
+    /// Wait until bytes fit under the cap, then count them as queued.
+    /// @param exempt evaluated while waiting; bytes are taken at once when it
+    /// returns true. Streams with nothing queued are exempted, so that every
+    /// stream can make progress whatever the other streams hold.
+    void acquire(size_t bytes, std::function<bool()> const& exempt);
+
+    /// Return bytes that were sent or dropped, waking blocked senders.
+    void release(size_t bytes);
+
+    /// Wake senders blocked in acquire(), so that they evaluate exempt again.
+    void wake();
+
+    /// @return true if no more bytes fit under the cap
+    bool isFull() const { return _maxBytes != 0 && _queuedBytes >= _maxBytes; }
+
+    uint64_t getQueuedBytes() const { return _queuedBytes; }
+    uint64_t getMaxBytes() const { return _maxBytes; }
+
+    /// Set a function called whenever release() leaves the budget no longer
+    /// full, e.g. to wake a scheduler holding back Tasks.
+    void setRoomFunc(std::function<void()> const& func);
+
+private:
+    uint64_t const _maxBytes;
+    std::atomic<uint64_t> _queuedBytes{0};
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    std::function<void()> _roomFunc; ///< protected by _mtx
+};
+
+}}} // namespace lsst::qserv::wbase
+
+#endif // LSST_QSERV_WBASE_SENDBUDGET_H
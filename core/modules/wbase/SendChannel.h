@@ -32,6 +32,7 @@
 
 // Qserv headers
 #include "global/Bug.h"
+#include "util/BufferPool.h"
 #include "util/Callable.h"
 
 namespace lsst {
@@ -60,6 +61,13 @@ public:
         throw Bug("Streaming is unimplemented, should not see this");
     }
 
+    /// Send a bucket of bytes, handing over ownership of its buffer so that
+    /// implementations that queue data need not copy it.
+    /// @param last true if no more sendStream calls will be invoked.
+    virtual bool sendStream(util::PooledBuffer::Ptr buf, bool last) {
+        return sendStream(buf->data(), buf->size(), last);
+    }
+
     /// Set a function to be called when a resources from a deferred send*
     /// operation may be released. This allows a sendFile() caller to be
     /// notified when the file descriptor may be closed and perhaps reclaimed.
@@ -27,6 +27,7 @@
 
 // System headers
 #include <atomic>
+#include <chrono>
 #include <deque>
 #include <memory>
 #include <mutex>
@@ -129,6 +130,8 @@ public:
     time_t entryTime {0}; ///< Timestamp for task admission
     char timestr[100]; ///< ::ctime_r(&t.entryTime, timestr)
     // Note that manpage spec of "26 bytes"  is insufficient
+    /// When a scheduler last queued the task, for queue wait statistics
+    std::chrono::steady_clock::time_point queuedTime;
 
     void cancel();
     bool getCancelled() const { return _cancelled; }
@@ -147,6 +150,7 @@ public:
 
     static IdSet allIds; // set of all task jobId numbers that are not complete.
     std::string getIdStr() {return _idStr;}
+    qmeta::QueryId getQueryId() const { return _qId; }
 
 private:
     uint64_t const    _qId{0}; //< queryId from czar
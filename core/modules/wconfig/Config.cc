@@ -42,7 +42,7 @@ using lsst::qserv::wconfig::Config;
 
 namespace {
 // Settings declaration ////////////////////////////////////////////////
-static const int settingsCount = 16;
+static const int settingsCount = 26;
 // key, env var name, default, description
 static const char* settings[settingsCount][4] = {
     {"mysqlSocket", "QSW_DBSOCK", "/var/lib/mysql/mysql.sock",
@@ -61,6 +61,10 @@ static const char* settings[settingsCount][4] = {
      "Memory available for locking tables"},
     {"QSW_MEMMAN_LOCATION", "QSW_MEMMAN_LOCATION", "/u1/qserv-run/var/lib/mysql",
      "Path to database tables"},
+    {"QSW_MEMMAN_LOCK_THREADS", "QSW_MEMMAN_LOCK_THREADS", "2",
+     "Threads locking chunk tables in memory for the scan schedulers, 0 to lock them while scheduling"},
+    {"QSW_MEMMAN_PREFETCH_CHUNKS", "QSW_MEMMAN_PREFETCH_CHUNKS", "1",
+     "Chunks ahead of the current one whose tables a scan reads into memory, within QSW_MEMMAN_MB"},
     {"QSW_THRDPOOLSZ", "QSW_THRDPOOLSZ", "15",
      "Thread pool size"},
     {"QSW_GROUPSZ", "QSW_GROUPSZ", "10",
@@ -76,7 +80,23 @@ static const char* settings[settingsCount][4] = {
     {"QSW_RESERVEMED", "QSW_RESERVEMED", "2",
      "Maximum number of threads to reserve for medium scan"},
     {"QSW_RESERVEFAST", "QSW_RESERVEFAST", "2",
-     "Maximum number of threads to reserve for fast scan"}
+     "Maximum number of threads to reserve for fast scan"},
+    {"QSW_SCAN_QUERY_SHARE", "QSW_SCAN_QUERY_SHARE", "100",
+     "Percent of a scan scheduler's threads one query may use while others wait"},
+    {"QSW_SCAN_MAX_WAIT_SEC", "QSW_SCAN_MAX_WAIT_SEC", "0",
+     "Seconds before a Task deferred to the next pass of a scan joins the current one, 0 for never"},
+    {"QSW_SUBCHUNK_CACHE_MB", "QSW_SUBCHUNK_CACHE_MB", "0",
+     "Memory for subchunk tables kept after their last query"},
+    {"QSW_STREAM_MAX_MB", "QSW_STREAM_MAX_MB", "16",
+     "Result data queued for one czar request before sending blocks, 0 for no limit"},
+    {"QSW_SEND_MAX_MB", "QSW_SEND_MAX_MB", "1000",
+     "Result data queued by the worker before sending blocks, 0 for no limit"},
+    {"QSW_RESULT_CACHE_MB", "QSW_RESULT_CACHE_MB", "0",
+     "Memory for results kept to answer identical requests, 0 to disable"},
+    {"QSW_INVENTORY_REFRESH_SEC", "QSW_INVENTORY_REFRESH_SEC", "60",
+     "Seconds between checks for changed chunk tables, which drop cached results"},
+    {"QSW_SHARED_SCAN", "QSW_SHARED_SCAN", "0",
+     "Answer simple queries on fixed format MyISAM tables by shared scans of their files, 1 to enable"}
 };
 
 
@@ -43,7 +43,10 @@
 #include "wbase/SendChannel.h"
 #include "wconfig/Config.h"
 #include "wdb/ChunkResource.h"
+#include "wdb/ConnectionPool.h"
 #include "wdb/QueryRunner.h"
+#include "wdb/ResultCache.h"
+#include "wdb/SharedScan.h"
 
 namespace {
 LOG_LOGGER _log = LOG_GET("lsst.qserv.wcontrol.Foreman");
@@ -60,11 +63,29 @@ Foreman::Ptr Foreman::newForeman(Scheduler::Ptr const& sched, uint poolSize) {
 Foreman::Foreman(Scheduler::Ptr const& s, uint poolSize) : _scheduler{s} {
     // Make the chunk resource mgr
     mysql::MySqlConfig c(wconfig::getConfig().getSqlConfig());
-    _chunkResourceMgr = wdb::ChunkResourceMgr::newMgr(c);
+    uint64_t subChunkCacheMb = wconfig::getConfig().getInt("QSW_SUBCHUNK_CACHE_MB", 0);
+    _chunkResourceMgr = wdb::ChunkResourceMgr::newMgr(c, subChunkCacheMb*1000000);
+    // Each pool thread runs one QueryRunner at a time, which may also use
+    // the connections of idle threads to run fragments in parallel.
+    _connectionPool = std::make_shared<wdb::ConnectionPool>(c, poolSize, 2*poolSize);
+    uint64_t resultCacheMb = wconfig::getConfig().getInt("QSW_RESULT_CACHE_MB", 0);
+    if (resultCacheMb > 0) {
+        _resultCache = std::make_shared<wdb::ResultCache>(resultCacheMb*1000000);
+    }
+    if (wconfig::getConfig().getInt("QSW_SHARED_SCAN", 0) != 0) {
+        // The data directory of mysqld, which memman locks files in.
+        _sharedScanMgr = std::make_shared<wdb::SharedScanMgr>(
+            wconfig::getConfig().getString("QSW_MEMMAN_LOCATION"));
+    }
     assert(s); // Cannot operate without scheduler.
 
-    LOGS(_log, LOG_LVL_DEBUG, "poolSize=" << poolSize);
+    LOGS(_log, LOG_LVL_DEBUG, "poolSize=" << poolSize << " resultCacheMb=" << resultCacheMb
+         << " sharedScan=" << (_sharedScanMgr != nullptr));
     _pool = util::ThreadPool::newThreadPool(poolSize, _scheduler);
+    if (_resultCache) {
+        // Replays only wait on czars reading, so a few threads are enough.
+        _replayPool = util::ThreadPool::newThreadPool(2, nullptr);
+    }
 }
 
 Foreman::~Foreman() {
@@ -72,6 +93,9 @@ Foreman::~Foreman() {
     // It will take significant effort to have xrootd shutdown cleanly and this will never get called
     // until that happens.
     _pool->endAll();
+    if (_replayPool) {
+        _replayPool->endAll();
+    }
 }
 
 /// Put the task on the scheduler to be run later.
@@ -93,11 +117,27 @@ void Foreman::processTask(std::shared_ptr<wbase::Task> const& task) {
     };
 
     task->setFunc(func);
+    if (_resultCache && _resultCache->contains(task->hash)) {
+        auto replay = std::make_shared<util::Command>([this, task](util::CmdData*) {
+            if (task->getCancelled()) {
+                return;
+            }
+            if (!_resultCache->replay(task->hash, *task->sendChannel)) {
+                // Dropped from the cache since, so run it after all.
+                _scheduler->queCmd(task);
+            }
+        });
+        _replayPool->getQueue()->queCmd(replay);
+        return;
+    }
     _scheduler->queCmd(task);
 }
 
 std::shared_ptr<wdb::QueryRunner> Foreman::_newQueryRunner(wbase::Task::Ptr const& t) {
-    wdb::QueryRunnerArg a(t, _chunkResourceMgr);
+    wdb::QueryRunnerArg a(t, _chunkResourceMgr, _connectionPool);
+    a.maxParallel = _scheduler->getTaskParallelism();
+    a.cache = _resultCache;
+    a.scans = _sharedScanMgr;
     auto qa = wdb::QueryRunner::newQueryRunner(a);
     return qa;
 }
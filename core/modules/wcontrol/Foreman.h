@@ -38,7 +38,10 @@ namespace lsst {
 namespace qserv {
 namespace wdb {
     class ChunkResourceMgr;
+    class ConnectionPool;
     class QueryRunner;
+    class ResultCache;
+    class SharedScanMgr;
 }
 }}
 
@@ -59,11 +62,17 @@ public:
     /// nothing should be harmless, but some Schedulers may work better if cancelled
     /// tasks are removed.
     virtual void taskCancelled(wbase::Task *task) { return; }
+
+    /// @return the number of mysqld connections a starting Task may use to
+    /// run its fragments in parallel.
+    virtual int getTaskParallelism() { return 1; }
 };
 
 /// Foreman is used to maintain a thread pool and schedule Tasks for the thread pool.
 /// It also manages sub-chunk tables with the ChunkResourceMgr.
 /// The schedulers may limit the number of threads they will use from the thread pool.
+/// Tasks whose result is in the ResultCache bypass the schedulers, and are
+/// answered from the cache by a separate small pool of threads.
 class Foreman : public wbase::MsgProcessor {
 public:
     using Ptr = std::shared_ptr<Foreman>;
@@ -76,11 +85,18 @@ public:
 
     void processTask(std::shared_ptr<wbase::Task> const& task) override;
 
+    /// @return the cache of Task results, nullptr if disabled
+    std::shared_ptr<wdb::ResultCache> getResultCache() const { return _resultCache; }
+
 protected:
     std::shared_ptr<wdb::QueryRunner> _newQueryRunner(wbase::Task::Ptr const& t);
 
     std::shared_ptr<wdb::ChunkResourceMgr> _chunkResourceMgr;
+    std::shared_ptr<wdb::ConnectionPool> _connectionPool; ///< Reused by QueryRunners
+    std::shared_ptr<wdb::ResultCache> _resultCache; ///< May be nullptr
+    std::shared_ptr<wdb::SharedScanMgr> _sharedScanMgr; ///< May be nullptr
     util::ThreadPool::Ptr _pool;
+    util::ThreadPool::Ptr _replayPool; ///< Sends cached results
     Scheduler::Ptr _scheduler;
 };
 
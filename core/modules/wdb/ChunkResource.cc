@@ -34,8 +34,12 @@
 
 // System headers
 #include <cstddef>
+#include <cstdlib>
 #include <iostream>
+#include <list>
+#include <map>
 #include <mutex>
+#include <sstream>
 
 // Third-party headers
 #include "boost/format.hpp"
@@ -213,6 +217,28 @@ public:
         _discard(v.begin(), v.end());
     }
 
+    /// @return the memory used by the tables of a loaded subchunk,
+    /// including its overlap table.
+    uint64_t getSize(ScTable const& t) {
+        if (_isFake) {
+            return 1;
+        }
+        std::ostringstream sql;
+        sql << "SELECT SUM(DATA_LENGTH + INDEX_LENGTH) FROM information_schema.TABLES"
+            << " WHERE TABLE_SCHEMA = '" << SUBCHUNKDB_PREFIX << t.db << "_" << t.chunkId << "'"
+            << " AND TABLE_NAME IN ('" << t.table << "_" << t.chunkId << "_" << t.subChunkId
+            << "', '" << t.table << "FullOverlap_" << t.chunkId << "_" << t.subChunkId << "')";
+        sql::SqlResults results;
+        sql::SqlErrorObject err;
+        std::string size;
+        if (!_sqlConn.runQuery(sql.str(), results, err)
+            || !results.extractFirstValue(size, err)) {
+            LOGS(_log, LOG_LVL_WARN, "Could not size " << t << " err=" << err.printErrMsg());
+            return 0;
+        }
+        return std::strtoull(size.c_str(), nullptr, 10);
+    }
+
     enum LockStatus {UNLOCKED, LOCKED_OTHER, LOCKED_OURS};
 
     void memLockRequireOwnership() {
@@ -389,6 +415,8 @@ std::ostream& operator<<(std::ostream& os, const Backend::LockStatus& ls) {
 
 /// ChunkEntry is an entry that represents table subchunks for a given
 /// database and chunkid.
+/// Subchunks whose count dropped to zero stay in the map while their tables
+/// are kept in the ChunkResourceMgr cache, until evicted.
 class ChunkEntry {
 public:
     typedef std::map<int, int> SubChunkMap; // subchunkid -> count
@@ -399,9 +427,12 @@ public:
     ChunkEntry(int chunkId) : _chunkId(chunkId), _refCount(0) {}
 
     /// Acquire a resource, loading if needed
-    void acquire(std::string const& db,
-                 StringVector const& tables,
-                 IntVector const& sc, Backend::Ptr backend) {
+    /// @param revived receives the cached subchunks that were unused
+    /// @return the number of subchunk tables loaded
+    size_t acquire(std::string const& db,
+                   StringVector const& tables,
+                   IntVector const& sc, Backend::Ptr backend,
+                   ScTableVector& revived) {
         ScTableVector needed;
         std::lock_guard<std::mutex> lock(_mutex);
         backend->memLockRequireOwnership();
@@ -417,6 +448,9 @@ public:
                     needed.push_back(ScTable(db, _chunkId, *ti, *i));
                 } else {
                     last = it->second;
+                    if (last == 0) {
+                        revived.push_back(ScTable(db, _chunkId, *ti, *i));
+                    }
                 }
                 scm[*i] = last + 1; // write new value
             } // All subchunks
@@ -428,81 +462,75 @@ public:
             bool loadOk = backend->load(needed, err);
             if (!loadOk) {
                 // Release
-                _release(needed);
+                _release(tables, sc, needed);
+                revived.clear();
                 throw err;
             }
         }
+        return needed.size();
     }
 
-    /// Release a resource, flushing if no more users need it.
+    /// Release a resource.
+    /// @param unused receives the subchunks no longer needed by anyone, whose
+    /// tables are left for the caller to cache or evict.
     void release(std::string const& db,
                  StringVector const& tables,
-                 IntVector const& sc, Backend::Ptr backend) {
-        {
-            std::lock_guard<std::mutex> lock(_mutex);
-            backend->memLockRequireOwnership();
-            StringVector::const_iterator ti, te;
-            for(ti=tables.begin(), te=tables.end(); ti != te; ++ti) {
-                SubChunkMap& scm = _tableMap[*ti]; // Should be in there.
-                IntVector::const_iterator i, e;
-                for(i=sc.begin(), e=sc.end(); i != e; ++i) {
-                    SubChunkMap::iterator it = scm.find(*i); // Should be there
-                    if (it == scm.end()) {
-                        throw Bug("ChunkResource ChunkEntry::release: Error releasing un-acquired resource");
-                    }
-                    scm[*i] = it->second - 1; // write new value
-                } // All subchunks
-            } // All tables
-            --_refCount;
-        }
-        flush(db, backend); // Discard resources no longer needed by anyone.
-        // flush could be detached from the release function, to be called at a
-        // high-water mark and/or on periodic intervals
-    }
-
-    /// Flush resources no longer needed by anybody
-    void flush(std::string const& db, Backend::Ptr backend) {
-        ScTableVector discardable;
+                 IntVector const& sc, Backend::Ptr backend,
+                 ScTableVector& unused) {
         std::lock_guard<std::mutex> lock(_mutex);
         backend->memLockRequireOwnership();
-        TableMap::iterator ti, te;
-        for(ti=_tableMap.begin(), te=_tableMap.end(); ti != te; ++ti) {
-            IntVector mapDiscardable;
-            SubChunkMap& scm = ti->second;
-            SubChunkMap::iterator si, se;
-            for(si=scm.begin(), se=scm.end(); si != se; ++si) {
-                if (si->second == 0) {
-                    discardable.push_back(ScTable(db, _chunkId,
-                                                  ti->first,
-                                                  si->first));
-                    mapDiscardable.push_back(si->first);
-                } else if (si->second < 0) {
-                    throw Bug("ChunkResource ChunkEntry::flush: Invalid negative use count when flushing subchunks");
+        StringVector::const_iterator ti, te;
+        for(ti=tables.begin(), te=tables.end(); ti != te; ++ti) {
+            SubChunkMap& scm = _tableMap[*ti]; // Should be in there.
+            IntVector::const_iterator i, e;
+            for(i=sc.begin(), e=sc.end(); i != e; ++i) {
+                SubChunkMap::iterator it = scm.find(*i); // Should be there
+                if (it == scm.end() || it->second <= 0) {
+                    throw Bug("ChunkResource ChunkEntry::release: Error releasing un-acquired resource");
+                }
+                if (--it->second == 0) {
+                    unused.push_back(ScTable(db, _chunkId, *ti, *i));
                 }
             } // All subchunks
-            // Prune zero elements for this db+table+chunk
-            // (invalidates iterators)
-            IntVector::iterator di, de;
-            for(di=mapDiscardable.begin(), de=mapDiscardable.end();
-                di != de; ++di) {
-                scm.erase(*di);
-            }
         } // All tables
-        // Delegate actual table dropping to the backend.
-        if (discardable.size() > 0) {
-            backend->discard(discardable);
+        --_refCount;
+    }
+
+    /// Forget an unused subchunk, whose tables the caller then drops.
+    /// @return false if the subchunk is in use again.
+    bool evict(ScTable const& t) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        SubChunkMap& scm = _tableMap[t.table];
+        SubChunkMap::iterator it = scm.find(t.subChunkId);
+        if (it == scm.end()) {
+            return true;
+        }
+        if (it->second < 0) {
+            throw Bug("ChunkResource ChunkEntry::evict: Invalid negative use count when evicting subchunks");
+        }
+        if (it->second > 0) {
+            return false;
         }
+        scm.erase(it);
+        return true;
     }
 private:
-    void _release(ScTableVector const& needed) {
+    /// Undo the counts of a failed acquire, forgetting the subchunks that
+    /// could not be loaded.
+    void _release(StringVector const& tables, IntVector const& sc,
+                  ScTableVector const& needed) {
         // _mutex should be held.
-        // Release subChunkId for the right table
+        for(auto const& t : tables) {
+            SubChunkMap& scm = _tableMap[t];
+            for(auto id : sc) {
+                --scm[id];
+            }
+        }
         for(ScTableVector::const_iterator i=needed.begin(), e=needed.end();
             i != e; ++i) {
-            SubChunkMap& scm = _tableMap[i->table];
-            int last = scm[i->subChunkId];
-            scm[i->subChunkId] = last - 1;
+            _tableMap[i->table].erase(i->subChunkId);
         }
+        --_refCount;
     }
 
     std::shared_ptr<Backend> _backend; ///< Delegate stage/unstage
@@ -541,7 +569,12 @@ public:
             std::lock_guard<std::mutex> lock(_mapMutex);
             Map& map = _getMap(i.db);
             ChunkEntry& ce = _getChunkEntry(map, i.chunkId);
-            ce.release(i.db, i.tables, i.subChunkIds, _backend);
+            ScTableVector unused;
+            ce.release(i.db, i.tables, i.subChunkIds, _backend, unused);
+            for(auto const& t : unused) {
+                _cacheInsert(t);
+            }
+            _cacheEvict();
         }
     }
     virtual void acquireUnit(ChunkResource::Info const& i) {
@@ -553,15 +586,27 @@ public:
             Map& map = _getMap(i.db); // Select db
             ChunkEntry& ce = _getChunkEntry(map, i.chunkId);
             // Actually acquire
-            ce.acquire(i.db, i.tables, i.subChunkIds, _backend);
+            ScTableVector revived;
+            size_t loaded = ce.acquire(i.db, i.tables, i.subChunkIds, _backend, revived);
+            for(auto const& t : revived) {
+                _cacheRemove(t);
+            }
+            _stats.misses += loaded;
+            _stats.hits += i.tables.size() * i.subChunkIds.size() - loaded;
         }
     }
 
+    virtual CacheStats getCacheStats() {
+        std::lock_guard<std::mutex> lock(_mapMutex);
+        return _stats;
+    }
+
 private:
-    Impl(mysql::MySqlConfig const& c)
-        : _isFake(false), _backend(Backend::newInstance(c)) {
+    Impl(mysql::MySqlConfig const& c, uint64_t cacheBytes)
+        : _isFake(false), _backend(Backend::newInstance(c)), _cacheLimit(cacheBytes) {
     }
-    Impl() : _isFake(true), _backend(Backend::newFakeInstance()) {}
+    Impl(uint64_t cacheBytes)
+        : _isFake(true), _backend(Backend::newFakeInstance()), _cacheLimit(cacheBytes) {}
 
     /// precondition: _mapMutex is held (locked by the caller)
     /// Get the ChunkEntry map for a db, creating if necessary
@@ -589,24 +634,85 @@ private:
         return *(it->second.get());
     }
 
+    static std::string _cacheKey(ScTable const& t) {
+        std::ostringstream os;
+        os << t;
+        return os.str();
+    }
+
+    /// precondition: _mapMutex is held (locked by the caller)
+    /// Keep the tables of an unused subchunk, as the most recently used.
+    void _cacheInsert(ScTable const& t) {
+        uint64_t bytes = _cacheLimit > 0 ? _backend->getSize(t) : 0;
+        _lru.push_front(CachedTable{t, bytes});
+        _lruIndex[_cacheKey(t)] = _lru.begin();
+        _stats.bytes += bytes;
+    }
+
+    /// precondition: _mapMutex is held (locked by the caller)
+    /// Take a subchunk back from the cache as it is used again.
+    void _cacheRemove(ScTable const& t) {
+        auto it = _lruIndex.find(_cacheKey(t));
+        if (it == _lruIndex.end()) {
+            throw Bug("ChunkResourceMgr: Revived subchunk missing from the cache");
+        }
+        _stats.bytes -= it->second->bytes;
+        _lru.erase(it->second);
+        _lruIndex.erase(it);
+    }
+
+    /// precondition: _mapMutex is held (locked by the caller)
+    /// Drop the least recently used subchunk tables until the cache fits
+    /// its budget.
+    void _cacheEvict() {
+        ScTableVector discardable;
+        while (!_lru.empty() && (_stats.bytes > _cacheLimit || _cacheLimit == 0)) {
+            CachedTable const& ct = _lru.back();
+            ChunkEntry& ce = _getChunkEntry(_getMap(ct.table.db), ct.table.chunkId);
+            if (ce.evict(ct.table)) {
+                discardable.push_back(ct.table);
+                ++_stats.evictions;
+            }
+            _stats.bytes -= ct.bytes;
+            _lruIndex.erase(_cacheKey(ct.table));
+            _lru.pop_back();
+        }
+        // Delegate actual table dropping to the backend.
+        if (!discardable.empty()) {
+            LOGS(_log, LOG_LVL_DEBUG, "ChunkResourceMgr evicting " << discardable.size()
+                 << " subchunks, cached bytes=" << _stats.bytes);
+            _backend->discard(discardable);
+        }
+    }
+
+    struct CachedTable {
+        ScTable table;
+        uint64_t bytes;
+    };
+    typedef std::list<CachedTable> CacheList;
+
     friend class ChunkResourceMgr;
     bool _isFake; // Fake versions don't issue any sql queries.
     DbMap _dbMap;
     // Consider having separate mutexes for each db's map if contention becomes
     // a problem.
     std::shared_ptr<Backend> _backend;
+    uint64_t const _cacheLimit; ///< Memory for unused subchunk tables
+    CacheList _lru; ///< Unused subchunks, most recently released first
+    std::map<std::string, CacheList::iterator> _lruIndex;
+    CacheStats _stats;
     std::mutex _mapMutex; // Do not alter map without this mutex
 };
-
 ////////////////////////////////////////////////////////////////////////
 // ChunkResourceMgr
 ////////////////////////////////////////////////////////////////////////
-ChunkResourceMgr::Ptr ChunkResourceMgr::newMgr(mysql::MySqlConfig const& c) {
-    return std::shared_ptr<ChunkResourceMgr>(new Impl(c));
+ChunkResourceMgr::Ptr ChunkResourceMgr::newMgr(mysql::MySqlConfig const& c,
+                                               uint64_t cacheBytes) {
+    return std::shared_ptr<ChunkResourceMgr>(new Impl(c, cacheBytes));
 }
 
-ChunkResourceMgr::Ptr ChunkResourceMgr::newFakeMgr() {
-    return std::shared_ptr<ChunkResourceMgr>(new Impl());
+ChunkResourceMgr::Ptr ChunkResourceMgr::newFakeMgr(uint64_t cacheBytes) {
+    return std::shared_ptr<ChunkResourceMgr>(new Impl(cacheBytes));
 }
 
 }}} // namespace lsst::qserv::wdb
@@ -33,6 +33,7 @@
   */
 
 // System headers
+#include <cstdint>
 #include <deque>
 #include <memory>
 #include <ostream>
@@ -91,15 +92,27 @@ private:
 };
 
 /// ChunkResourceMgr is a lightweight manager for holding reservations on
-/// subchunks.
+/// subchunks. Subchunk tables no longer reserved by anyone are kept for later
+/// queries, dropping the least recently used ones when the memory they take
+/// exceeds the cache size.
 class ChunkResourceMgr {
 public:
     using Ptr = std::shared_ptr<ChunkResourceMgr>;
     /// Factory
-    static Ptr newMgr(mysql::MySqlConfig const& c);
-    static Ptr newFakeMgr();
+    /// @param cacheBytes memory for unused subchunk tables, 0 to drop them
+    /// as soon as they are released.
+    static Ptr newMgr(mysql::MySqlConfig const& c, uint64_t cacheBytes=0);
+    static Ptr newFakeMgr(uint64_t cacheBytes=0);
     virtual ~ChunkResourceMgr() {}
 
+    /// Subchunk table cache statistics, counted per table and subchunk.
+    struct CacheStats {
+        uint64_t hits {0}; ///< Already loaded when acquired
+        uint64_t misses {0}; ///< Loaded when acquired
+        uint64_t evictions {0}; ///< Dropped when no longer used
+        uint64_t bytes {0}; ///< Memory taken by unused tables
+    };
+
     /// Reserve a chunk. Currently, this does not result in any explicit chunk
     /// loading.
     /// @return a ChunkResource which should be used for releasing the
@@ -124,6 +137,8 @@ public:
     /// Acquire a reservation. Block until it is available if it is not
     /// already. Clients should not need to call this explicitly.
     virtual void acquireUnit(ChunkResource::Info const& i) = 0;
+
+    virtual CacheStats getCacheStats() = 0;
 private:
     class Impl; // Nested to share friend access to ChunkResource
 };
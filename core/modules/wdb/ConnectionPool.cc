@@ -0,0 +1,188 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "wdb/ConnectionPool.h"
+
+// LSST headers
+#include "lsst/log/Log.h"
+
+// Qserv headers
+#include "mysql/MySqlConnection.h"
+
+namespace {
+
+LOG_LOGGER _log = LOG_GET("lsst.qserv.wdb.ConnectionPool");
+
+} // anonymous namespace
+
+namespace lsst {
+namespace qserv {
+namespace wdb {
+
+ConnectionPool::ConnectionPool(mysql::MySqlConfig const& config, size_t maxIdle, size_t maxOpen)
+    : _config(config), _maxIdle(maxIdle), _maxOpen(maxOpen) {
+}
+
+ConnectionPool::~ConnectionPool() {
+    LOGS(_log, LOG_LVL_DEBUG, "ConnectionPool hits=" << _hits << " misses=" << _misses);
+}
+
+std::string ConnectionPool::_makeKey(std::string const& user, std::string const& dbName) {
+    return user + '\0' + dbName;
+}
+
+ConnectionPool::ConnPtr ConnectionPool::acquire(std::string const& user,
+                                                std::string const& dbName, bool wait) {
+    mysql::MySqlConfig sc(_config);
+    sc.username = user;
+    if (!dbName.empty()) {
+        sc.dbName = dbName;
+    }
+    std::string const key = _makeKey(sc.username, sc.dbName);
+    while (true) {
+        ConnPtr conn;
+        ConnPtr evicted; // Closed at the end of the iteration, outside of the lock.
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            while (true) {
+                for (auto iter = _idle.begin(), end = _idle.end(); iter != end; ++iter) {
+                    if (iter->key == key) {
+                        conn = std::move(iter->conn);
+                        _idle.erase(iter);
+                        break;
+                    }
+                }
+                if (conn) {
+                    break;
+                }
+                if (_maxOpen == 0 || _open < _maxOpen) {
+                    ++_open;
+                    ++_misses;
+                    break;
+                }
+                if (!_idle.empty()) {
+                    // Make room by closing the least recently used idle connection.
+                    evicted = std::move(_idle.back().conn);
+                    _idle.pop_back();
+                    ++_misses;
+                    break;
+                }
+                if (!wait) {
+                    LOGS(_log, LOG_LVL_DEBUG, "ConnectionPool all " << _maxOpen
+                         << " connections in use, none for " << user);
+                    return nullptr;
+                }
+                _openCv.wait(lock);
+            }
+        }
+        if (!conn) {
+            conn = _connect(sc);
+            if (!conn) {
+                _closed();
+            }
+            return conn;
+        }
+        // Ping outside of the lock, the server may be slow to answer.
+        if (_ping(*conn)) {
+            std::lock_guard<std::mutex> lock(_mtx);
+            ++_hits;
+            return conn;
+        }
+        LOGS(_log, LOG_LVL_DEBUG, "ConnectionPool dropping dead connection for " << user);
+        conn.reset();
+        _closed();
+    }
+}
+
+void ConnectionPool::release(ConnPtr conn, bool healthy) {
+    if (!conn) {
+        return;
+    }
+    if (!healthy || _maxIdle == 0 || !_resetSession(*conn)) {
+        conn.reset();
+        _closed();
+        return;
+    }
+    auto const& sc = conn->getMySqlConfig();
+    Entry entry{_makeKey(sc.username, sc.dbName), std::move(conn)};
+    ConnPtr evicted;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _idle.push_front(std::move(entry));
+        if (_idle.size() > _maxIdle) {
+            // Closed once the lock is released.
+            evicted = std::move(_idle.back().conn);
+            _idle.pop_back();
+            --_open;
+        }
+    }
+    _openCv.notify_all();
+}
+
+/// Account for a connection that was closed, or could not be established.
+void ConnectionPool::_closed() {
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        --_open;
+    }
+    _openCv.notify_all();
+}
+
+ConnectionPool::ConnPtr ConnectionPool::_connect(mysql::MySqlConfig const& config) {
+    ConnPtr conn(new mysql::MySqlConnection(config));
+    if (!conn->connect()) {
+        return nullptr;
+    }
+    return conn;
+}
+
+bool ConnectionPool::_ping(mysql::MySqlConnection& conn) {
+    return conn.ping();
+}
+
+bool ConnectionPool::_resetSession(mysql::MySqlConnection& conn) {
+    return conn.resetSession();
+}
+
+size_t ConnectionPool::getHits() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _hits;
+}
+
+size_t ConnectionPool::getMisses() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _misses;
+}
+
+size_t ConnectionPool::getIdleCount() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _idle.size();
+}
+
+size_t ConnectionPool::getOpenCount() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _open;
+}
+
+}}} // namespace lsst::qserv::wdb
@@ -0,0 +1,114 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_WDB_CONNECTIONPOOL_H
+#define LSST_QSERV_WDB_CONNECTIONPOOL_H
+
+// System headers
+#include <condition_variable>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Qserv headers
+#include "mysql/MySqlConfig.h"
+
+// Forward declarations
+namespace lsst {
+namespace qserv {
+namespace mysql {
+    class MySqlConnection;
+}}} // End of forward declarations
+
+namespace lsst {
+namespace qserv {
+namespace wdb {
+
+/// ConnectionPool keeps idle mysqld connections between tasks, so that short
+/// interactive tasks do not pay for connecting. Connections are keyed by user
+/// and database. A connection is only kept if it was released healthy and its
+/// session could be reset, and is pinged before being handed out again.
+/// At most maxIdle connections are kept, the least recently used ones being
+/// closed first. At most maxOpen connections are open at any time, idle or
+/// handed out; an idle connection for another user or database is closed to
+/// open a new one, and past that acquire() waits for a release, or fails if
+/// asked not to wait. Both are sized to the Foreman thread pool, as each pool
+/// thread uses one connection and its task possibly those of idle threads.
+/// Every connection obtained from acquire() must be given back with release().
+class ConnectionPool {
+public:
+    using Ptr = std::shared_ptr<ConnectionPool>;
+    using ConnPtr = std::unique_ptr<mysql::MySqlConnection>;
+
+    /// @param maxOpen 0 for no limit
+    ConnectionPool(mysql::MySqlConfig const& config, size_t maxIdle, size_t maxOpen=0);
+    ConnectionPool(ConnectionPool const&) = delete;
+    ConnectionPool& operator=(ConnectionPool const&) = delete;
+    virtual ~ConnectionPool();
+
+    /// @return a connection as user to the database, or nullptr if a new
+    /// connection could not be established, or if maxOpen connections are
+    /// open and wait is false. dbName defaults to the configured database.
+    ConnPtr acquire(std::string const& user, std::string const& dbName, bool wait=true);
+
+    /// Return a connection to the pool.
+    /// @param healthy false if the connection may be left in an unknown
+    /// state (e.g. its query was killed), in which case it is closed.
+    void release(ConnPtr conn, bool healthy);
+
+    size_t getHits() const;
+    size_t getMisses() const;
+    size_t getIdleCount() const;
+    size_t getOpenCount() const;
+
+protected:
+    // Connection operations, overridden in tests.
+    /// @return a new connection for config, nullptr if it could not be established
+    virtual ConnPtr _connect(mysql::MySqlConfig const& config);
+    virtual bool _ping(mysql::MySqlConnection& conn);
+    virtual bool _resetSession(mysql::MySqlConnection& conn);
+
+private:
+    struct Entry {
+        std::string key;
+        ConnPtr conn;
+    };
+    static std::string _makeKey(std::string const& user, std::string const& dbName);
+    void _closed();
+
+    mysql::MySqlConfig const _config;
+    size_t const _maxIdle;
+    size_t const _maxOpen;
+
+    mutable std::mutex _mtx; ///< Protects the members below
+    std::condition_variable _openCv; ///< Signalled when a connection is closed or idle
+    std::list<Entry> _idle; ///< Most recently released first
+    size_t _open {0}; ///< Idle, handed out and being established
+    size_t _hits {0};
+    size_t _misses {0};
+};
+
+}}} // namespace lsst::qserv::wdb
+
+#endif // LSST_QSERV_WDB_CONNECTIONPOOL_H
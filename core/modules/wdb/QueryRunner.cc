@@ -34,8 +34,12 @@
 // System headers
 #include <algorithm>
 #include <cstddef>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 // Third-party headers
 #include <mysql/mysql.h>
@@ -53,18 +57,24 @@
 #include "mysql/MySqlConfig.h"
 #include "mysql/MySqlConnection.h"
 #include "mysql/SchemaFactory.h"
+#include "mysql/StatementResult.h"
+#include "proto/ColumnBlocks.h"
 #include "proto/ProtoHeaderWrap.h"
 #include "proto/worker.pb.h"
 #include "sql/Schema.h"
 #include "sql/SqlErrorObject.h"
 #include "util/common.h"
+#include "util/Compression.h"
 #include "util/MultiError.h"
 #include "util/StringHash.h"
 #include "util/threadSafe.h"
+#include "util/Timer.h"
 #include "wbase/Base.h"
 #include "wbase/SendChannel.h"
 #include "wconfig/Config.h"
 #include "wdb/ChunkResource.h"
+#include "wdb/ScanLayout.h"
+#include "wdb/ScanQuery.h"
 
 namespace {
 LOG_LOGGER _log = LOG_GET("lsst.qserv.wdb.QueryRunner");
@@ -89,27 +99,63 @@ QueryRunner::Ptr QueryRunner::newQueryRunner(QueryRunnerArg const& a) {
 /// and correct setup of enable_shared_from_this.
 QueryRunner::QueryRunner(QueryRunnerArg const& a)
     : _task{a.task},
-      _chunkResourceMgr{a.mgr} {
+      _chunkResourceMgr{a.mgr},
+      _connectionPool{a.pool},
+      _resultCache{a.cache},
+      _sharedScanMgr{a.scans},
+      _maxParallel{std::max(a.maxParallel, 1)} {
     int rc = mysql_thread_init();
     assert(rc == 0);
     assert(_task->msg);
 }
 
-/// Initialize the db connection
-bool QueryRunner::_initConnection() {
-    mysql::MySqlConfig sc(wconfig::getConfig().getSqlConfig());
-    sc.username = _task->user.c_str(); // Override with czar-passed username.
-    _mysqlConn.reset(new mysql::MySqlConnection(sc));
-
-    if (!_mysqlConn->connect()) {
+/// @return a new connection for the task user, or nullptr on failure. Failing
+/// to get a required connection is an error of the task, failing to get an
+/// optional one is not, as the task can do without it.
+std::unique_ptr<mysql::MySqlConnection> QueryRunner::_newConnection(bool required) {
+    std::unique_ptr<mysql::MySqlConnection> conn;
+    if (_connectionPool) {
+        // Use czar-passed username and the configured database. Only wait
+        // for a connection to be released if the task needs it.
+        conn = _connectionPool->acquire(_task->user, std::string(), required);
+    } else {
+        mysql::MySqlConfig sc(wconfig::getConfig().getSqlConfig());
+        sc.username = _task->user.c_str(); // Override with czar-passed username.
+        conn.reset(new mysql::MySqlConnection(sc));
+        if (!conn->connect()) {
+            conn.reset();
+        }
+    }
+    if (!conn && !required) {
+        LOGS(_log, LOG_LVL_WARN, "No extra MySQL connection as " << _task->user
+             << ", running on fewer connections " << _task->getIdStr());
+    } else if (!conn) {
         LOGS(_log, LOG_LVL_ERROR, "Cfg error! connect MySQL as "
              << wconfig::getConfig().getString("mysqlSocket")
              << " using " << _task->user);
         util::Error error(-1, "Unable to connect to MySQL as " + _task->user);
-        _multiError.push_back(error);
-        return false;
+        _addError(error);
+    }
+    return conn;
+}
+
+/// Return conn to the pool, if any. Connections of cancelled tasks may have
+/// had their query killed, and are closed instead.
+void QueryRunner::_releaseConnection(std::unique_ptr<mysql::MySqlConnection> conn) {
+    if (_connectionPool && conn) {
+        _connectionPool->release(std::move(conn), !_cancelled);
     }
-    return true;
+}
+
+/// Initialize the db connection
+bool QueryRunner::_initConnection() {
+    _mysqlConn = _newConnection();
+    return _mysqlConn != nullptr;
+}
+
+void QueryRunner::_addError(util::Error const& error) {
+    std::lock_guard<std::mutex> lock(_resultMtx);
+    _multiError.push_back(error);
 }
 
 /// Override _dbName with _msg->db() if available.
@@ -146,6 +192,7 @@ bool QueryRunner::runQuery() {
     if (_task->msg->has_protocol()) {
         switch(_task->msg->protocol()) {
         case 2:
+        case 3:
             return _dispatchChannel(); // Run the query and send the results back.
         case 1:
             throw UnsupportedError("QueryRunner: Expected protocol > 1 in TaskMsg");
@@ -159,14 +206,14 @@ bool QueryRunner::runQuery() {
     return false;
 }
 
-MYSQL_RES* QueryRunner::_primeResult(std::string const& query) {
-        bool queryOk = _mysqlConn->queryUnbuffered(query);
+MYSQL_RES* QueryRunner::_primeResult(mysql::MySqlConnection& conn, std::string const& query) {
+        bool queryOk = conn.queryUnbuffered(query);
         if (!queryOk) {
-            util::Error error(_mysqlConn->getErrno(), _mysqlConn->getError());
-            _multiError.push_back(error);
+            util::Error error(conn.getErrno(), conn.getError());
+            _addError(error);
             return nullptr;
         }
-        return _mysqlConn->getResult();
+        return conn.getResult();
 }
 
 void QueryRunner::_initMsgs() {
@@ -176,6 +223,7 @@ void QueryRunner::_initMsgs() {
 
 void QueryRunner::_initMsg() {
     _result = std::make_shared<proto::Result>();
+    _resultSize = 0;
     _result->mutable_rowschema();
     _result->set_continues(0);
     if (_task->msg->has_session()) {
@@ -201,6 +249,34 @@ void QueryRunner::_fillSchema(MYSQL_RES* result) {
         cs->set_sqltype(i->colType.sqlType);
         cs->set_mysqltype(i->colType.mysqlType);
     }
+    if (_task->msg->protocol() == 3) {
+        _columnWriter.reset(new proto::ColumnBlockWriter(_result->rowschema()));
+    }
+}
+
+/// Fill _result's schema with the columns query selects from records of
+/// layout, typed as mysqld would return them.
+void QueryRunner::_fillSchema(ScanQuery const& query, ScanLayout const& layout) {
+    for (unsigned int i = 0; i < query.getColumns().size(); ++i) {
+        ScanLayout::Column const& column = layout.getColumns()[query.getColumns()[i]];
+        proto::ColumnSchema* cs = _result->mutable_rowschema()->add_columnschema();
+        cs->set_name(query.getNames()[i]);
+        cs->set_hasdefault(false);
+        cs->set_sqltype(column.sqlType);
+        cs->set_mysqltype(column.mysqlType);
+    }
+    if (_task->msg->protocol() == 3) {
+        _columnWriter.reset(new proto::ColumnBlockWriter(_result->rowschema()));
+    }
+}
+
+/// Fill the schema from the first result only.
+void QueryRunner::_fillSchemaOnce(MYSQL_RES* result) {
+    std::lock_guard<std::mutex> lock(_resultMtx);
+    if (!_schemaFilled) {
+        _fillSchema(result);
+        _schemaFilled = true;
+    }
 }
 
 /// Fill one row in the Result msg from one row in MYSQL_RES*
@@ -209,80 +285,348 @@ void QueryRunner::_fillSchema(MYSQL_RES* result) {
 /// continues in later messages.
 bool QueryRunner::_fillRows(MYSQL_RES* result, int numFields) {
     MYSQL_ROW row;
-    size_t size = 0;
     while ((row = mysql_fetch_row(result))) {
         auto lengths = mysql_fetch_lengths(result);
+        // Fragments running in parallel merge their rows one at a time.
+        std::lock_guard<std::mutex> lock(_resultMtx);
+        if (_columnWriter) {
+            _columnWriter->addRow(row, lengths);
+            _resultSize = _columnWriter->getByteSize();
+        } else {
+            proto::RowBundle* rawRow =_result->add_row();
+            for(int i=0; i < numFields; ++i) {
+                if (row[i]) {
+                    rawRow->add_column(row[i], lengths[i]);
+                    rawRow->add_isnull(false);
+                } else {
+                    rawRow->add_column();
+                    rawRow->add_isnull(true);
+                }
+            }
+            _resultSize += rawRow->ByteSize();
+        }
+        if (!_splitIfFull()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Transmit the rows accumulated so far, flagged as continued, if the
+/// message has grown past the desired size. Called with _resultMtx held.
+/// @return false if a single row is too large to send
+bool QueryRunner::_splitIfFull() {
+    // Each element needs to be mysql-sanitized
+    if (_resultSize > proto::ProtoHeaderWrap::PROTOBUFFER_DESIRED_LIMIT) {
+        if (_resultSize > proto::ProtoHeaderWrap::PROTOBUFFER_HARD_LIMIT) {
+            LOGS_ERROR("Message single row too large to send using protobuffer");
+            return false;
+        }
+        LOGS(_log, LOG_LVL_DEBUG, "Large message size=" << _resultSize << ", splitting message");
+        _transmit(false);
+        _initMsg();
+    }
+    return true;
+}
+
+/// Fill one row from the columns query selects from record, as
+/// _fillRows() does for rows from mysqld.
+bool QueryRunner::_addScanRow(ScanQuery const& query, ScanLayout const& layout,
+                              char const* record) {
+    if (_cancelled) {
+        return false;
+    }
+    std::vector<int> const& columns = query.getColumns();
+    std::string text;
+    std::lock_guard<std::mutex> lock(_resultMtx);
+    if (_columnWriter) {
+        for (unsigned int i = 0; i < columns.size(); ++i) {
+            int const col = columns[i];
+            ScanLayout::Column const& column = layout.getColumns()[col];
+            if (layout.isNull(record, col)) {
+                _columnWriter->addNull(i);
+                continue;
+            }
+            switch (column.type) {
+            case ScanLayout::Column::INT:
+                if (!column.isUnsigned || column.length < 8) {
+                    _columnWriter->addInt64(i, layout.getInt64(record, col));
+                    break;
+                }
+                // Beyond the int64 range: sent as text.
+                // fall through
+            case ScanLayout::Column::CHAR:
+                layout.formatText(record, col, text);
+                _columnWriter->addText(i, text.c_str(), text.size());
+                break;
+            case ScanLayout::Column::FLOAT:
+                _columnWriter->addFloat(i, layout.getFloat(record, col));
+                break;
+            case ScanLayout::Column::DOUBLE:
+                _columnWriter->addDouble(i, layout.getDouble(record, col));
+                break;
+            }
+        }
+        _columnWriter->endRow();
+        _resultSize = _columnWriter->getByteSize();
+    } else {
         proto::RowBundle* rawRow =_result->add_row();
-        for(int i=0; i < numFields; ++i) {
-            if (row[i]) {
-                rawRow->add_column(row[i], lengths[i]);
-                rawRow->add_isnull(false);
-            } else {
+        for (int col : columns) {
+            if (layout.isNull(record, col)) {
                 rawRow->add_column();
                 rawRow->add_isnull(true);
+            } else {
+                layout.formatText(record, col, text);
+                rawRow->add_column(text);
+                rawRow->add_isnull(false);
             }
         }
-        size += rawRow->ByteSize();
+        _resultSize += rawRow->ByteSize();
+    }
+    return _splitIfFull();
+}
 
-        // Each element needs to be mysql-sanitized
-        if (size > proto::ProtoHeaderWrap::PROTOBUFFER_DESIRED_LIMIT) {
-            if (size > proto::ProtoHeaderWrap::PROTOBUFFER_HARD_LIMIT) {
-                LOGS_ERROR("Message single row too large to send using protobuffer");
-                return false;
+/// Execute the prepared statement and fill column blocks from its rows,
+/// which mysqld sends in the binary protocol: numeric columns arrive as
+/// numbers and go to the column blocks without text formatting and parsing.
+bool QueryRunner::_fillRowsFromStatement(mysql::MySqlConnection& conn) {
+    if (!conn.executeStatement()) {
+        _addError(util::Error(conn.getStatementErrno(), conn.getStatementError()));
+        conn.freeStatement();
+        return false;
+    }
+    bool ok = true;
+    {
+        mysql::StatementResult result(conn.getStatement());
+        if (!result.isValid()) {
+            _addError(util::Error(conn.getStatementErrno(), conn.getStatementError()));
+            ok = false;
+        } else {
+            _fillSchemaOnce(result.getMetadata());
+            int const numFields = result.getColumnCount();
+            while (ok && result.fetch()) {
+                std::lock_guard<std::mutex> lock(_resultMtx);
+                for (int i = 0; i < numFields; ++i) {
+                    if (result.isNull(i)) {
+                        _columnWriter->addNull(i);
+                        continue;
+                    }
+                    switch(result.getType(i)) {
+                    case mysql::StatementResult::Type::INT64:
+                        _columnWriter->addInt64(i, result.getInt64(i));
+                        break;
+                    case mysql::StatementResult::Type::FLOAT:
+                        _columnWriter->addFloat(i, result.getFloat(i));
+                        break;
+                    case mysql::StatementResult::Type::DOUBLE:
+                        _columnWriter->addDouble(i, result.getDouble(i));
+                        break;
+                    case mysql::StatementResult::Type::TEXT: {
+                        size_t length;
+                        char const* text = result.getText(i, length);
+                        _columnWriter->addText(i, text, length);
+                        break;
+                    }
+                    }
+                }
+                _columnWriter->endRow();
+                _resultSize = _columnWriter->getByteSize();
+                ok = _splitIfFull();
+            }
+            if (result.isError()) {
+                _addError(util::Error(conn.getStatementErrno(), conn.getStatementError()));
+                ok = false;
             }
-            LOGS(_log, LOG_LVL_DEBUG, "Large message size=" << size << ", splitting message");
-            _transmit(false);
-            size = 0;
-            _initMsg();
         }
     }
-    return true;
+    conn.freeStatement();
+    return ok;
 }
 
 /// Transmit result data with its header.
 /// If 'last' is true, this is the last message in the result set
 /// and flags are set accordingly.
+/// The message is serialized and sent by the send thread.
 void QueryRunner::_transmit(bool last) {
     LOGS(_log, LOG_LVL_DEBUG, "_transmit last=" << last << " " << _task->getIdStr());
-    std::string resultString;
     _result->set_continues(!last);
+    if (_columnWriter) {
+        _columnWriter->moveTo(*_result);
+    }
     if (!_multiError.empty()) {
         std::string chunkId = std::to_string(_task->msg->chunkid());
         std::string msg = "Error(s) in result for chunk #" + chunkId + ": " + _multiError.toOneLineString();
         _result->set_errormsg(msg);
         LOGS(_log, LOG_LVL_ERROR, msg);
     }
-    _result->SerializeToString(&resultString);
-    _transmitHeader(resultString);
+    _queueSend(_result, last);
+}
+
+/// Hand msg over to the send thread, once it has sent the previous message,
+/// so that mysqld is drained into the next message while msg is serialized
+/// and sent. A null msg stops the send thread.
+void QueryRunner::_queueSend(std::shared_ptr<proto::Result> const& msg, bool last) {
+    util::Timer t;
+    t.start();
+    std::unique_lock<std::mutex> lock(_sendMtx);
+    _sendCv.wait(lock, [this](){ return !_sendQueued; });
+    t.stop();
+    _stageTimes.waitSend += t.getElapsed();
+    _sendMsg = msg;
+    _sendLast = last;
+    _sendQueued = true;
+    _sendCv.notify_all();
+}
+
+/// Body of the send thread, serializing and transmitting the messages handed
+/// over by _queueSend() until the last one. If a message cannot be sent, the
+/// task is cancelled and the following messages are dropped.
+void QueryRunner::_sendLoop() {
+    bool failed = false;
+    while (true) {
+        std::shared_ptr<proto::Result> msg;
+        bool last;
+        {
+            std::unique_lock<std::mutex> lock(_sendMtx);
+            _sendCv.wait(lock, [this](){ return _sendQueued; });
+            msg = _sendMsg;
+            last = _sendLast;
+        }
+        if (msg && !failed) {
+            try {
+                _send(*msg, last);
+            } catch(std::exception const& e) {
+                LOGS(_log, LOG_LVL_ERROR, "QueryRunner failed to send result "
+                     << _task->getIdStr() << ": " << e.what());
+                failed = true;
+                {
+                    // Not _addError(), the filling thread may hold _resultMtx
+                    // while it waits for this thread.
+                    std::lock_guard<std::mutex> lock(_sendMtx);
+                    _sendError = util::Error(-1, std::string("Failed to send result: ") + e.what());
+                }
+                cancel();
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(_sendMtx);
+            _sendMsg.reset();
+            _sendQueued = false;
+        }
+        _sendCv.notify_all();
+        if (!msg || last) {
+            return;
+        }
+    }
+}
+
+/// Stop the send thread, after the message it was given, if any.
+void QueryRunner::_stopSendThread() {
+    if (!_sendThread.joinable()) {
+        return;
+    }
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(_sendMtx);
+        done = _sendDone;
+        _sendDone = true;
+    }
+    if (!done) {
+        _queueSend(nullptr, true);
+    }
+    _sendThread.join();
+}
+
+/// Serialize msg, and transmit it with its header.
+void QueryRunner::_send(proto::Result& msg, bool last) {
+    util::Timer t;
+    t.start();
+    // Serialize straight into a pooled buffer, which is handed down to the
+    // channel without further copies.
+    size_t size = msg.ByteSize();
+    auto buf = util::PooledBuffer::create(size);
+    msg.SerializeWithCachedSizesToArray(reinterpret_cast<google::protobuf::uint8*>(buf->data()));
+    buf->setSize(size);
+    _compress(buf, msg.continues());
+    t.stop();
+    _stageTimes.serialize += t.getElapsed();
+    _transmitHeader(*buf);
     LOGS(_log, LOG_LVL_DEBUG, "_transmit last=" << last << " " << _task->getIdStr()
-         << " resultString=" << util::prettyCharList(resultString, 5));
+         << " result=" << util::prettyCharBuf(buf->data(), buf->size(), 5));
+    if (_cacheEntry) {
+        _cacheEntry->add(buf->data(), buf->size(), last);
+    }
+    t.start();
     if (!_cancelled) {
-        _task->sendChannel->sendStream(resultString.data(), resultString.size(), last);
+        _task->sendChannel->sendStream(std::move(buf), last);
     } else {
         LOGS(_log, LOG_LVL_DEBUG, "_transmit cancelled");
     }
+    t.stop();
+    _stageTimes.send += t.getElapsed();
+}
+
+/// Compress msg if the czar asked for it and it gets smaller, recording the
+/// compression in _protoHeader.
+void QueryRunner::_compress(util::PooledBuffer::Ptr& msg, bool continues) {
+    _protoHeader->clear_compression();
+    _protoHeader->clear_uncompressedsize();
+    _protoHeader->clear_continues();
+    if (_task->msg->compression() != proto::ProtoHeader::ZLIB) {
+        return;
+    }
+    int level = _task->msg->has_compressionlevel() ? _task->msg->compressionlevel() : 1;
+    size_t compressedSize = util::Compression::getBound(msg->size());
+    auto compressed = util::PooledBuffer::create(compressedSize);
+    if (!util::Compression::compress(msg->data(), msg->size(), level,
+                                     compressed->data(), compressedSize)
+        || compressedSize >= msg->size()) {
+        return;
+    }
+    compressed->setSize(compressedSize);
+    _protoHeader->set_compression(proto::ProtoHeader::ZLIB);
+    _protoHeader->set_uncompressedsize(msg->size());
+    _protoHeader->set_continues(continues);
+    msg = std::move(compressed);
 }
 
 /// Transmit the protoHeader
-void QueryRunner::_transmitHeader(std::string& msg) {
+void QueryRunner::_transmitHeader(util::PooledBuffer const& msg) {
     LOGS(_log, LOG_LVL_DEBUG, "_transmitHeader");
+    util::Timer t;
+    t.start();
     // Set header
-    _protoHeader->set_protocol(2); // protocol 2: row-by-row message
+    // protocol 2: row-by-row message, 3: column blocks
+    _protoHeader->set_protocol(_columnWriter ? 3 : 2);
     _protoHeader->set_size(msg.size());
-    _protoHeader->set_md5(util::StringHash::getMd5(msg.data(), msg.size()));
+    if (_task->msg->checksumtype() == proto::ProtoHeader::CRC32C) {
+        _protoHeader->set_checksumtype(proto::ProtoHeader::CRC32C);
+        _protoHeader->set_checksum(util::StringHash::getCrc32c(msg.data(), msg.size()));
+    } else {
+        _protoHeader->set_md5(util::StringHash::getMd5(msg.data(), msg.size()));
+    }
     _protoHeader->set_wname(getHostname());
+    _protoHeader->set_chunkid(_task->msg->chunkid()); // Identifies multi-chunk results
     std::string protoHeaderString;
     _protoHeader->SerializeToString(&protoHeaderString);
+    t.stop();
+    _stageTimes.checksum += t.getElapsed();
 
     // Flush to channel.
     // Make sure protoheader size can be encoded in a byte.
     assert(protoHeaderString.size() < 255);
     auto msgBuf = proto::ProtoHeaderWrap::wrap(protoHeaderString);
+    if (_cacheEntry) {
+        _cacheEntry->add(msgBuf.data(), msgBuf.size(), false);
+    }
+    t.start();
     if (!_cancelled) {
         _task->sendChannel->sendStream(msgBuf.data(), msgBuf.size(), false);
     } else {
         LOGS(_log, LOG_LVL_DEBUG, "_transmitHeader cancelled");
     }
+    t.stop();
+    _stageTimes.send += t.getElapsed();
 }
 
 class ChunkResourceRequest {
@@ -319,65 +663,308 @@ private:
     proto::TaskMsg const& _msg;
 };
 
+/// Run the queries of fragment i on conn, funneling their rows into the
+/// result.
+/// @return false if any of them failed
+bool QueryRunner::_runFragment(mysql::MySqlConnection& conn, ChunkResourceRequest& req, int i) {
+    proto::TaskMsg const& m = *_task->msg;
+    bool erred = false;
+    proto::TaskMsg_Fragment const& fragment(m.fragment(i));
+    ChunkResource cr(req.getResourceFragment(i));
+    // Use query fragment as-is, funnel results.
+    for(int qi=0, qe=fragment.query_size(); qi != qe; ++qi) {
+        if (_cancelled) {
+            break;
+        }
+        // Column blocks of scan queries are filled from the binary protocol.
+        // Interactive queries return few rows, which would not make up for
+        // the extra prepare round trip. Queries that cannot be prepared
+        // (e.g. several statements) or produce no result set are run as text.
+        if (m.protocol() == 3 && !_task->getScanInfo().infoTables.empty()
+            && conn.prepareStatement(fragment.query(qi))) {
+            if (conn.getStatementFieldCount() > 0) {
+                if (!_fillRowsFromStatement(conn)) {
+                    erred = true;
+                }
+                continue;
+            }
+            conn.freeStatement();
+        }
+        MYSQL_RES* res = _primeResult(conn, fragment.query(qi));
+        if (!res) {
+            erred = true;
+            continue;
+        }
+        // TODO: may want to confirm (cheaply) that
+        // successive queries have the same result schema.
+        _fillSchemaOnce(res);
+        // TODO fritzm: revisit this error strategy
+        // (see pull-request for DM-216)
+        // Now get rows...
+        if (!_fillRows(res, mysql_num_fields(res))) {
+            erred = true;
+        }
+        conn.freeResult();
+    } // Each query in a fragment
+    return !erred;
+}
+
+/// Run the fragments of the task on up to 'parallel' connections, _mysqlConn
+/// and connections opened for this task, each taking the next fragment not
+/// yet started. Fragments are independent, so their rows are merged in
+/// whatever order they arrive.
+/// @return false if any fragment failed
+bool QueryRunner::_runFragmentsParallel(ChunkResourceRequest& req, int parallel) {
+    std::atomic<int> next{0};
+    std::atomic<bool> erred{false};
+    int const count = _task->msg->fragment_size();
+    auto work = [this, &req, &next, &erred, count](mysql::MySqlConnection& conn) {
+        for (int i = next++; i < count && !_cancelled; i = next++) {
+            try {
+                if (!_runFragment(conn, req, i)) {
+                    erred = true;
+                }
+            } catch(sql::SqlErrorObject const& e) {
+                _addError(util::Error(e.errNo(), e.errMsg()));
+                erred = true;
+            } catch(std::exception const& e) {
+                _addError(util::Error(-1, e.what()));
+                erred = true;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < parallel; ++t) {
+        threads.emplace_back([this, &work]() {
+            mysql_thread_init();
+            auto conn = _newConnection(false);
+            if (conn) {
+                {
+                    std::lock_guard<std::mutex> lock(_connMtx);
+                    _extraConns.push_back(conn.get());
+                }
+                work(*conn);
+                {
+                    std::lock_guard<std::mutex> lock(_connMtx);
+                    _extraConns.erase(std::find(_extraConns.begin(), _extraConns.end(),
+                                                conn.get()));
+                }
+                _releaseConnection(std::move(conn));
+            }
+            mysql_thread_end();
+        });
+    }
+    work(*_mysqlConn);
+    for (auto& t : threads) {
+        t.join();
+    }
+    return !erred;
+}
+
+/// Run the task on the SharedScan of its chunk table, sharing one pass over
+/// the table's records with the other queries on it, if its query is a
+/// simple filter or projection the scan evaluates as mysqld would.
+/// @return false if the task must be run by mysqld instead, nothing having
+/// been filled. erred is set if the query left the scan early.
+bool QueryRunner::_runSharedScan(bool& erred) {
+    proto::TaskMsg const& m = *_task->msg;
+    if (m.fragment_size() != 1 || m.fragment(0).query_size() != 1
+        || m.fragment(0).has_subchunks()) {
+        return false;
+    }
+    auto query = ScanQuery::parse(m.fragment(0).query(0));
+    if (!query) {
+        return false;
+    }
+    auto layout = _getScanLayout(query->getDb(), query->getTable());
+    if (!layout) {
+        return false;
+    }
+    auto scan = _sharedScanMgr->getScan(query->getDb(), query->getTable(), layout);
+    if (!scan || !query->bind(scan->getLayout())) {
+        return false;
+    }
+    LOGS(_log, LOG_LVL_DEBUG, "Running on the shared scan of " << query->getDb() << "."
+         << query->getTable() << " " << _task->getIdStr());
+    ScanLayout const& scanLayout = *scan->getLayout();
+    {
+        std::lock_guard<std::mutex> lock(_resultMtx);
+        _fillSchema(*query, scanLayout);
+        _schemaFilled = true;
+    }
+    erred = !scan->run(*query, [this, &query, &scanLayout](char const* record) {
+            return _addScanRow(*query, scanLayout, record);
+        });
+    return true;
+}
+
+/// @return the layout of the records of db.table, or nullptr if they are
+/// not in a fixed format MyISAM file, or the task user cannot read them
+/// (information_schema only shows the tables a user has privileges on).
+/// The layout is kept by _sharedScanMgr until the table is redefined.
+ScanLayout::Ptr QueryRunner::_getScanLayout(std::string const& db, std::string const& table) {
+    // The names are pasted in the queries below, and in the file paths.
+    auto isName = [](std::string const& s) {
+        return !s.empty() && s.find_first_not_of("abcdefghijklmnopqrstuvwxyz"
+                                                 "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_$")
+            == std::string::npos;
+    };
+    if (!isName(db) || !isName(table)) {
+        return nullptr;
+    }
+    ScanLayout::Ptr layout;
+    if (_sharedScanMgr->findLayout(_task->user, db, table, layout)) {
+        return layout;
+    }
+    if (_lookupScanLayout(db, table, layout)) {
+        _sharedScanMgr->keepLayout(_task->user, db, table, layout);
+    }
+    return layout;
+}
+
+/// Set layout from information_schema, as described by _getScanLayout().
+/// @return false if the lookups failed
+bool QueryRunner::_lookupScanLayout(std::string const& db, std::string const& table,
+                                    ScanLayout::Ptr& layout) {
+    layout.reset();
+    std::string const where = " WHERE TABLE_SCHEMA='" + db + "' AND TABLE_NAME='" + table + "'";
+    std::vector<std::vector<std::string>> rows;
+    if (!_selectRows("SELECT ENGINE, ROW_FORMAT, AVG_ROW_LENGTH FROM information_schema.TABLES"
+                     + where, rows)) {
+        return false;
+    }
+    if (rows.size() != 1 || rows[0][0] != "MyISAM" || rows[0][1] != "Fixed") {
+        return true;
+    }
+    std::string const avgRowLength = rows[0][2];
+    rows.clear();
+    if (!_selectRows("SELECT COLUMN_NAME, DATA_TYPE, COLUMN_TYPE, IS_NULLABLE,"
+                     " CHARACTER_OCTET_LENGTH, CHARACTER_MAXIMUM_LENGTH"
+                     " FROM information_schema.COLUMNS" + where + " ORDER BY ORDINAL_POSITION",
+                     rows)) {
+        return false;
+    }
+    std::vector<ColumnDesc> columns;
+    for (auto const& row : rows) {
+        ColumnDesc c;
+        c.name = row[0];
+        c.dataType = row[1];
+        c.columnType = row[2];
+        c.nullable = row[3] == "YES";
+        c.octetLength = std::atoll(row[4].c_str());
+        c.charLength = std::atoll(row[5].c_str());
+        columns.push_back(c);
+    }
+    layout = ScanLayout::build(columns);
+    // MyISAM pads the records of tables with few small columns: only trust
+    // a record length it agrees on.
+    if (layout && std::to_string(layout->getRecordLength()) != avgRowLength) {
+        layout.reset();
+    }
+    return true;
+}
+
+/// Run query on _mysqlConn, with NULLs read as empty strings.
+/// @return false on errors
+bool QueryRunner::_selectRows(std::string const& query,
+                              std::vector<std::vector<std::string>>& rows) {
+    if (!_mysqlConn->queryUnbuffered(query)) {
+        LOGS(_log, LOG_LVL_WARN, "QueryRunner " << query << " failed: " << _mysqlConn->getError());
+        return false;
+    }
+    MYSQL_RES* res = _mysqlConn->getResult();
+    int const numFields = mysql_num_fields(res);
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(res))) {
+        rows.emplace_back();
+        for (int i = 0; i < numFields; ++i) {
+            rows.back().push_back(row[i] ? row[i] : "");
+        }
+    }
+    _mysqlConn->freeResult();
+    return true;
+}
+
 bool QueryRunner::_dispatchChannel() {
     proto::TaskMsg& m = *_task->msg;
     _initMsgs();
-    bool firstResult = true;
     bool erred = false;
-    int numFields = -1;
     if (m.fragment_size() < 1) {
         throw Bug("QueryRunner: No fragments to execute in TaskMsg");
     }
     ChunkResourceRequest req(_chunkResourceMgr, m);
-
-    try {
-        for(int i=0; i < m.fragment_size(); ++i) {
-            if (_cancelled) {
-                break;
-            }
-            proto::TaskMsg_Fragment const& fragment(m.fragment(i));
-            ChunkResource cr(req.getResourceFragment(i));
-            // Use query fragment as-is, funnel results.
-            for(int qi=0, qe=fragment.query_size(); qi != qe; ++qi) {
-                MYSQL_RES* res = _primeResult(fragment.query(qi));
-                if (!res) {
-                    erred = true;
-                    continue;
+    if (_resultCache) {
+        _cacheEntry = _resultCache->newEntry(m.db(), m.chunkid());
+    }
+    util::Timer total;
+    total.start();
+    _sendThread = std::thread(&QueryRunner::_sendLoop, this);
+
+    int const parallel = std::min(_maxParallel, m.fragment_size());
+    if (_sharedScanMgr && _runSharedScan(erred)) {
+        // Answered without mysqld
+    } else if (parallel > 1) {
+        LOGS(_log, LOG_LVL_DEBUG, "Running " << m.fragment_size() << " fragments on "
+             << parallel << " connections " << _task->getIdStr());
+        erred = !_runFragmentsParallel(req, parallel);
+    } else {
+        try {
+            for(int i=0; i < m.fragment_size(); ++i) {
+                if (_cancelled) {
+                    break;
                 }
-                if (firstResult) {
-                    _fillSchema(res);
-                    firstResult = false;
-                    numFields = mysql_num_fields(res);
-                } // TODO: may want to confirm (cheaply) that
-                // successive queries have the same result schema.
-                // TODO fritzm: revisit this error strategy
-                // (see pull-request for DM-216)
-                // Now get rows...
-                if (!_fillRows(res, numFields)) {
+                if (!_runFragment(*_mysqlConn, req, i)) {
                     erred = true;
                 }
-                _mysqlConn->freeResult();
-            } // Each query in a fragment
-        } // Each fragment in a msg.
-    } catch(sql::SqlErrorObject const& e) {
-        util::Error worker_err(e.errNo(), e.errMsg());
-        _multiError.push_back(worker_err);
+            } // Each fragment in a msg.
+        } catch(sql::SqlErrorObject const& e) {
+            util::Error worker_err(e.errNo(), e.errMsg());
+            _addError(worker_err);
+            erred = true;
+        } catch(std::exception const& e) {
+            _addError(util::Error(-1, e.what()));
+            erred = true;
+        }
     }
     if (!_cancelled) {
         // Send results.
         _transmit(true);
+        std::lock_guard<std::mutex> lock(_sendMtx);
+        _sendDone = true;
     } else {
         erred = true;
         // Send poison error.
         _multiError.push_back(util::Error(-1, "Poisoned."));
         // Do we need to do any cleanup?
     }
+    // Filling ends here, the send thread may still be sending.
+    total.stop();
+    _stageTimes.fill = total.getElapsed() - _stageTimes.waitSend;
+    _stopSendThread();
+    if (!_sendError.isNone()) {
+        _addError(_sendError);
+        erred = true;
+    }
+    if (_cacheEntry && !erred && !_cancelled && _multiError.empty()) {
+        _resultCache->insert(_task->hash, _cacheEntry);
+    }
+    _cacheEntry.reset();
+    LOGS(_log, LOG_LVL_DEBUG, "QueryRunner stage times " << _task->getIdStr()
+         << " fill=" << _stageTimes.fill << " waitSend=" << _stageTimes.waitSend
+         << " serialize=" << _stageTimes.serialize << " checksum=" << _stageTimes.checksum
+         << " send=" << _stageTimes.send);
     return !erred;
 }
 
 void QueryRunner::cancel() {
     LOGS(_log, LOG_LVL_WARN, "Trying QueryRunner::cancel() call, experimental");
     _cancelled.store(true);
+    {
+        std::lock_guard<std::mutex> lock(_connMtx);
+        for (auto conn : _extraConns) {
+            conn->cancel();
+        }
+    }
     if (!_mysqlConn.get()) {
         LOGS(_log, LOG_LVL_WARN, "QueryRunner::cancel() no MysqlConn");
         return;
@@ -402,7 +989,11 @@ void QueryRunner::cancel() {
     }
 }
 
+/// The connection is returned to the pool here rather than at the end of
+/// runQuery(), as nobody can call cancel() on it anymore.
 QueryRunner::~QueryRunner() {
+    _stopSendThread();
+    _releaseConnection(std::move(_mysqlConn));
 }
 
 }}} // namespace lsst::qserv::wdb
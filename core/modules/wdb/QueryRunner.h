@@ -35,17 +35,26 @@
 
 // System headers
 #include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 // Qserv headers
 #include "mysql/MySqlConnection.h"
+#include "util/BufferPool.h"
 #include "util/MultiError.h"
 #include "wbase/Task.h"
 #include "wdb/ChunkResource.h"
+#include "wdb/ConnectionPool.h"
+#include "wdb/ResultCache.h"
+#include "wdb/SharedScan.h"
 
 namespace lsst {
 namespace qserv {
 namespace proto {
+class ColumnBlockWriter;
 class ProtoHeader;
 class Result;
 }}}
@@ -54,6 +63,8 @@ namespace lsst {
 namespace qserv {
 namespace wdb {
 
+class ChunkResourceRequest;
+
 /// Bundle of values needed to construct a QueryRunner
 ///
 struct QueryRunnerArg {
@@ -61,10 +72,15 @@ public:
     QueryRunnerArg() {}
 
     QueryRunnerArg(wbase::Task::Ptr const &task_,
-                   ChunkResourceMgr::Ptr const& mgr_)
-        : task{task_}, mgr{mgr_} { }
+                   ChunkResourceMgr::Ptr const& mgr_,
+                   ConnectionPool::Ptr const& pool_=ConnectionPool::Ptr())
+        : task{task_}, mgr{mgr_}, pool{pool_} { }
     wbase::Task::Ptr task; ///< Actual task
     ChunkResourceMgr::Ptr mgr; ///< Resource reservation
+    ConnectionPool::Ptr pool; ///< mysqld connections, may be null
+    int maxParallel {1}; ///< Connections to run fragments on in parallel
+    ResultCache::Ptr cache; ///< Keeps the result for identical Tasks, may be null
+    SharedScanMgr::Ptr scans; ///< Answers simple queries without mysqld, may be null
 };
 
 /// On the worker, run a query related to a Task, writing the results to a table or supplied SendChannel.
@@ -81,31 +97,89 @@ public:
     bool runQuery() override;
     void cancel() override; ///< Cancel the action (in-progress)
 
+    /// Seconds spent in each stage of producing the result. Filling runs
+    /// concurrently with the other stages, which run on the send thread.
+    struct StageTimes {
+        double fill {0}; ///< Running queries and filling messages
+        double waitSend {0}; ///< Waiting for the send thread to take a message
+        double serialize {0}; ///< Serializing and compressing messages
+        double checksum {0}; ///< Computing checksums and headers
+        double send {0}; ///< Handing messages to the SendChannel
+    };
+    /// @return stage times, once runQuery() has returned
+    StageTimes const& getStageTimes() const { return _stageTimes; }
+
 protected:
     QueryRunner(QueryRunnerArg const& a);
 private:
     bool _initConnection();
+    std::unique_ptr<mysql::MySqlConnection> _newConnection(bool required=true);
+    void _releaseConnection(std::unique_ptr<mysql::MySqlConnection> conn);
     void _setDb();
     bool _dispatchChannel(); ///< Dispatch with output sent through a SendChannel
-    MYSQL_RES* _primeResult(std::string const& query); ///< Obtain a result handle for a query.
+    bool _runFragment(mysql::MySqlConnection& conn, ChunkResourceRequest& req, int i);
+    bool _runFragmentsParallel(ChunkResourceRequest& req, int parallel);
+    bool _runSharedScan(bool& erred);
+    ScanLayout::Ptr _getScanLayout(std::string const& db, std::string const& table);
+    bool _lookupScanLayout(std::string const& db, std::string const& table, ScanLayout::Ptr& layout);
+    bool _selectRows(std::string const& query, std::vector<std::vector<std::string>>& rows);
+    /// Obtain a result handle for a query.
+    MYSQL_RES* _primeResult(mysql::MySqlConnection& conn, std::string const& query);
 
     bool _fillRows(MYSQL_RES* result, int numFields);
+    bool _fillRowsFromStatement(mysql::MySqlConnection& conn);
+    bool _splitIfFull();
     void _fillSchema(MYSQL_RES* result);
+    void _fillSchemaOnce(MYSQL_RES* result);
+    void _fillSchema(ScanQuery const& query, ScanLayout const& layout);
+    bool _addScanRow(ScanQuery const& query, ScanLayout const& layout, char const* record);
+    void _addError(util::Error const& error);
     void _initMsgs();
     void _initMsg();
     void _transmit(bool last);
-    void _transmitHeader(std::string& msg);
+    void _queueSend(std::shared_ptr<proto::Result> const& msg, bool last);
+    void _sendLoop();
+    void _stopSendThread();
+    void _send(proto::Result& msg, bool last);
+    void _compress(util::PooledBuffer::Ptr& msg, bool continues);
+    void _transmitHeader(util::PooledBuffer const& msg);
 
     wbase::Task::Ptr _task;
     ChunkResourceMgr::Ptr _chunkResourceMgr;
+    ConnectionPool::Ptr _connectionPool;
+    ResultCache::Ptr _resultCache;
+    ResultCache::Entry::Ptr _cacheEntry; ///< Records what is sent, for _resultCache
+    SharedScanMgr::Ptr _sharedScanMgr;
     std::string _dbName;
     std::atomic<bool> _cancelled{false};
+    int const _maxParallel;
     std::unique_ptr<mysql::MySqlConnection> _mysqlConn;
+    /// Connections of fragments running in parallel, for cancel()
+    std::vector<mysql::MySqlConnection*> _extraConns;
+    std::mutex _connMtx; ///< Protects _extraConns
 
     util::MultiError _multiError; // Error log
 
     std::shared_ptr<proto::ProtoHeader> _protoHeader;
     std::shared_ptr<proto::Result> _result;
+    /// Accumulates rows as column blocks when the czar asked for protocol 3
+    std::unique_ptr<proto::ColumnBlockWriter> _columnWriter;
+    size_t _resultSize {0}; ///< Bytes of rows in _result
+    bool _schemaFilled {false};
+    /// Protects the result and _multiError from fragments running in parallel
+    std::mutex _resultMtx;
+
+    /// Send thread, serializing and sending one message while the next is
+    /// filled
+    std::thread _sendThread;
+    std::mutex _sendMtx; ///< Protects the members below
+    std::condition_variable _sendCv;
+    std::shared_ptr<proto::Result> _sendMsg; ///< Message handed to the send thread
+    bool _sendLast {false};
+    bool _sendQueued {false}; ///< true until the send thread has sent _sendMsg
+    bool _sendDone {false}; ///< true once the last message was queued
+    util::Error _sendError; ///< Why a message could not be sent, if one could not
+    StageTimes _stageTimes;
 };
 
 }}} // namespace
@@ -0,0 +1,147 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "wdb/ResultCache.h"
+
+// System headers
+#include <iterator>
+
+// LSST headers
+#include "lsst/log/Log.h"
+
+// Qserv headers
+#include "wbase/SendChannel.h"
+
+namespace {
+LOG_LOGGER _log = LOG_GET("lsst.qserv.wdb.ResultCache");
+}
+
+namespace lsst {
+namespace qserv {
+namespace wdb {
+
+void ResultCache::Entry::add(char const* data, size_t size, bool last) {
+    if (!_valid) {
+        return;
+    }
+    _bytes += size;
+    if (_bytes > _maxBytes) {
+        _valid = false;
+        _msgs.clear();
+        _msgs.shrink_to_fit();
+        return;
+    }
+    _msgs.emplace_back(std::string(data, size), last);
+}
+
+ResultCache::Entry::Ptr ResultCache::newEntry(std::string const& db, int chunkId) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    uint64_t generation = _generations[ChunkKey(db, chunkId)];
+    return std::make_shared<Entry>(db, chunkId, generation, _maxBytes/4);
+}
+
+bool ResultCache::insert(std::string const& digest, Entry::Ptr const& entry) {
+    if (!entry->isValid() || entry->_msgs.empty() || !entry->_msgs.back().second) {
+        return false; // Too large, or incomplete.
+    }
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (_generations[ChunkKey(entry->_db, entry->_chunkId)] != entry->_generation) {
+        LOGS(_log, LOG_LVL_DEBUG, "ResultCache not keeping " << digest << ", chunk changed");
+        return false;
+    }
+    auto it = _index.find(digest);
+    if (it != _index.end()) {
+        _erase(it->second);
+    }
+    _lru.emplace_front(digest, entry);
+    _index[digest] = _lru.begin();
+    _stats.bytes += entry->getBytes();
+    ++_stats.entries;
+    while (_stats.bytes > _maxBytes && !_lru.empty()) {
+        _erase(std::prev(_lru.end()));
+        ++_stats.evictions;
+    }
+    return true;
+}
+
+bool ResultCache::contains(std::string const& digest) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (_index.find(digest) == _index.end()) {
+        ++_stats.misses;
+        return false;
+    }
+    return true;
+}
+
+bool ResultCache::replay(std::string const& digest, wbase::SendChannel& sendChannel) {
+    Entry::Ptr entry;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto it = _index.find(digest);
+        if (it == _index.end()) {
+            ++_stats.misses;
+            return false;
+        }
+        _lru.splice(_lru.begin(), _lru, it->second);
+        entry = it->second->second;
+        ++_stats.hits;
+    }
+    // Entries are not modified once cached, so they are sent without the lock.
+    LOGS(_log, LOG_LVL_DEBUG, "ResultCache replaying " << digest << " bytes=" << entry->getBytes());
+    for (auto const& msg : entry->_msgs) {
+        if (!sendChannel.sendStream(msg.first.data(), msg.first.size(), msg.second)) {
+            break;
+        }
+    }
+    return true;
+}
+
+void ResultCache::invalidate(std::string const& db, int chunkId) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    ++_generations[ChunkKey(db, chunkId)];
+    for (auto it = _lru.begin(); it != _lru.end();) {
+        auto next = std::next(it);
+        Entry const& entry = *it->second;
+        if (entry._chunkId == chunkId && entry._db == db) {
+            _erase(it);
+            ++_stats.invalidations;
+        }
+        it = next;
+    }
+}
+
+ResultCache::Stats ResultCache::getStats() {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _stats;
+}
+
+/// precondition: _mtx is held
+void ResultCache::_erase(Lru::iterator it) {
+    _stats.bytes -= it->second->getBytes();
+    --_stats.entries;
+    _index.erase(it->first);
+    _lru.erase(it);
+}
+
+}}} // namespace lsst::qserv::wdb
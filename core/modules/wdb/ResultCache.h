@@ -0,0 +1,139 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_WDB_RESULTCACHE_H
+#define LSST_QSERV_WDB_RESULTCACHE_H
+
+// System headers
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Forward declarations
+namespace lsst {
+namespace qserv {
+namespace wbase {
+    class SendChannel;
+}}} // End of forward declarations
+
+namespace lsst {
+namespace qserv {
+namespace wdb {
+
+/// ResultCache keeps the result stream sent for a TaskMsg, keyed by the
+/// TaskMsg digest (wbase::Task::hash), so that a byte-identical request,
+/// e.g. a job retried by the czar, is answered without running its queries.
+/// Entries are kept in memory, least recently used first out, within a byte
+/// budget, and are dropped when the tables of their chunk change.
+class ResultCache {
+public:
+    using Ptr = std::shared_ptr<ResultCache>;
+
+    /// The messages sent for one Task, as they were passed to the SendChannel.
+    class Entry {
+    public:
+        using Ptr = std::shared_ptr<Entry>;
+
+        Entry(std::string const& db, int chunkId, uint64_t generation, uint64_t maxBytes)
+            : _db(db), _chunkId(chunkId), _generation(generation), _maxBytes(maxBytes) {}
+
+        /// Record a message. Recording stops, and the entry becomes
+        /// unusable, once it holds more than the cache accepts.
+        void add(char const* data, size_t size, bool last);
+
+        bool isValid() const { return _valid; }
+        uint64_t getBytes() const { return _bytes; }
+
+    private:
+        friend class ResultCache;
+        std::string const _db;
+        int const _chunkId;
+        uint64_t const _generation; ///< Of the chunk when recording started
+        uint64_t const _maxBytes;
+        std::vector<std::pair<std::string, bool>> _msgs; ///< (bytes, last)
+        uint64_t _bytes {0};
+        bool _valid {true};
+    };
+
+    struct Stats {
+        uint64_t hits {0}; ///< Requests answered from the cache
+        uint64_t misses {0}; ///< Requests not found in the cache
+        uint64_t evictions {0}; ///< Entries dropped to make room
+        uint64_t invalidations {0}; ///< Entries dropped as their chunk changed
+        uint64_t bytes {0}; ///< Memory taken by entries
+        uint64_t entries {0};
+    };
+
+    /// @param maxBytes memory for cached results. A single entry may take at
+    /// most a quarter of it.
+    explicit ResultCache(uint64_t maxBytes) : _maxBytes(maxBytes) {}
+
+    ResultCache(ResultCache const&) = delete;
+    ResultCache& operator=(ResultCache const&) = delete;
+
+    /// @return an Entry to record the result of a Task on chunkId of db into
+    Entry::Ptr newEntry(std::string const& db, int chunkId);
+
+    /// Cache a complete entry under digest, unless it is invalid or its chunk
+    /// changed since newEntry().
+    /// @return true if the entry was cached
+    bool insert(std::string const& digest, Entry::Ptr const& entry);
+
+    /// Look up digest before replay(). A request not found here is counted
+    /// as a miss, one found is counted by replay().
+    /// @return true if a result is cached for digest
+    bool contains(std::string const& digest);
+
+    /// Send the cached result for digest through sendChannel, counting a hit,
+    /// or a miss if nothing is cached for it (any more).
+    /// @return false if nothing is cached for digest
+    bool replay(std::string const& digest, wbase::SendChannel& sendChannel);
+
+    /// Drop the results of chunkId of db, and of Tasks recording them.
+    void invalidate(std::string const& db, int chunkId);
+
+    Stats getStats();
+
+private:
+    using Lru = std::list<std::pair<std::string, Entry::Ptr>>;
+    using ChunkKey = std::pair<std::string, int>;
+
+    void _erase(Lru::iterator it);
+
+    uint64_t const _maxBytes;
+    std::mutex _mtx; ///< Protects all members below
+    Lru _lru; ///< Most recently used first
+    std::unordered_map<std::string, Lru::iterator> _index; ///< By digest
+    std::map<ChunkKey, uint64_t> _generations; ///< Bumped by invalidate()
+    Stats _stats;
+};
+
+}}} // namespace lsst::qserv::wdb
+
+#endif // LSST_QSERV_WDB_RESULTCACHE_H
@@ -0,0 +1,224 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "wdb/ScanLayout.h"
+
+// System headers
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+// Third-party headers
+#include <mysql/mysql.h>
+
+namespace {
+
+using lsst::qserv::wdb::ColumnDesc;
+using lsst::qserv::wdb::ScanLayout;
+
+/// Value at p of a little-endian integer of length bytes, sign-extended
+/// unless isUnsigned.
+int64_t readInt(unsigned char const* p, int length, bool isUnsigned) {
+    uint64_t v = 0;
+    for (int i = length - 1; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+    if (!isUnsigned && length < 8 && (p[length - 1] & 0x80)) {
+        v |= ~uint64_t(0) << (8*length);
+    }
+    return static_cast<int64_t>(v);
+}
+
+std::string toUpper(std::string s) {
+    for (auto& c : s) {
+        c = std::toupper(static_cast<unsigned char>(c));
+    }
+    return s;
+}
+
+/// Fill the type of column from desc.
+/// @return false if columns of its type cannot be decoded
+bool setType(ColumnDesc const& desc, ScanLayout::Column& column) {
+    struct IntType {
+        char const* name;
+        int length;
+        int mysqlType;
+    };
+    static IntType const intTypes[] = {
+        {"tinyint", 1, MYSQL_TYPE_TINY},
+        {"smallint", 2, MYSQL_TYPE_SHORT},
+        {"mediumint", 3, MYSQL_TYPE_INT24},
+        {"int", 4, MYSQL_TYPE_LONG},
+        {"bigint", 8, MYSQL_TYPE_LONGLONG}
+    };
+    std::string const columnType = toUpper(desc.columnType);
+    if (columnType.find("ZEROFILL") != std::string::npos) {
+        return false; // Formatted with leading zeros
+    }
+    column.isUnsigned = columnType.find(" UNSIGNED") != std::string::npos;
+    // mysqld names the types of result columns without their attributes.
+    column.sqlType = columnType.substr(0, columnType.find(' '));
+    for (auto const& t : intTypes) {
+        if (desc.dataType == t.name) {
+            column.type = ScanLayout::Column::INT;
+            column.length = t.length;
+            column.mysqlType = t.mysqlType;
+            return true;
+        }
+    }
+    if (desc.dataType == "float" && columnType == "FLOAT") {
+        column.type = ScanLayout::Column::FLOAT;
+        column.length = 4;
+        column.mysqlType = MYSQL_TYPE_FLOAT;
+        return true;
+    }
+    if (desc.dataType == "double" && columnType == "DOUBLE") {
+        column.type = ScanLayout::Column::DOUBLE;
+        column.length = 8;
+        column.mysqlType = MYSQL_TYPE_DOUBLE;
+        return true;
+    }
+    // Multi-byte character sets pad CHARs to a number of characters.
+    if (desc.dataType == "char" && desc.octetLength == desc.charLength
+        && desc.octetLength > 0 && desc.octetLength < 256) {
+        column.type = ScanLayout::Column::CHAR;
+        column.length = desc.octetLength;
+        column.mysqlType = MYSQL_TYPE_STRING;
+        return true;
+    }
+    return false;
+}
+
+} // anonymous namespace
+
+namespace lsst {
+namespace qserv {
+namespace wdb {
+
+ScanLayout::Ptr ScanLayout::build(std::vector<ColumnDesc> const& columns) {
+    Ptr layout(new ScanLayout());
+    int nullBit = 1; // Bit 0 is cleared in deleted records.
+    for (auto const& desc : columns) {
+        Column column;
+        column.name = desc.name;
+        if (!setType(desc, column)) {
+            return nullptr;
+        }
+        column.nullBit = desc.nullable ? nullBit++ : -1;
+        layout->_columns.push_back(column);
+    }
+    if (layout->_columns.empty()) {
+        return nullptr;
+    }
+    int offset = (nullBit + 7)/8;
+    for (auto& column : layout->_columns) {
+        column.offset = offset;
+        offset += column.length;
+    }
+    layout->_recordLength = offset;
+    return layout;
+}
+
+int ScanLayout::findColumn(std::string const& name) const {
+    for (unsigned int i = 0; i < _columns.size(); ++i) {
+        if (strcasecmp(_columns[i].name.c_str(), name.c_str()) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int64_t ScanLayout::getInt64(char const* record, int col) const {
+    Column const& c = _columns[col];
+    return readInt(reinterpret_cast<unsigned char const*>(record + c.offset),
+                   c.length, c.isUnsigned);
+}
+
+float ScanLayout::getFloat(char const* record, int col) const {
+    uint32_t bits = readInt(reinterpret_cast<unsigned char const*>(record + _columns[col].offset),
+                            4, true);
+    float v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+double ScanLayout::getDouble(char const* record, int col) const {
+    uint64_t bits = readInt(reinterpret_cast<unsigned char const*>(record + _columns[col].offset),
+                            8, true);
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+char const* ScanLayout::getText(char const* record, int col, size_t& length) const {
+    Column const& c = _columns[col];
+    char const* text = record + c.offset;
+    length = c.length;
+    while (length > 0 && text[length - 1] == ' ') {
+        --length;
+    }
+    return text;
+}
+
+void ScanLayout::formatText(char const* record, int col, std::string& text) const {
+    char buf[32];
+    Column const& c = _columns[col];
+    switch (c.type) {
+    case Column::INT:
+        if (c.isUnsigned) {
+            std::snprintf(buf, sizeof(buf), "%llu",
+                          static_cast<unsigned long long>(getInt64(record, col)));
+        } else {
+            std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(getInt64(record, col)));
+        }
+        break;
+    case Column::FLOAT: {
+        float const v = getFloat(record, col);
+        std::snprintf(buf, sizeof(buf), "%.6g", v);
+        if (std::strtof(buf, nullptr) != v) {
+            std::snprintf(buf, sizeof(buf), "%.9g", v);
+        }
+        break;
+    }
+    case Column::DOUBLE: {
+        double const v = getDouble(record, col);
+        std::snprintf(buf, sizeof(buf), "%.15g", v);
+        if (std::strtod(buf, nullptr) != v) {
+            std::snprintf(buf, sizeof(buf), "%.17g", v);
+        }
+        break;
+    }
+    case Column::CHAR: {
+        size_t length;
+        char const* value = getText(record, col, length);
+        text.assign(value, length);
+        return;
+    }
+    }
+    text = buf;
+}
+
+}}} // namespace lsst::qserv::wdb
@@ -0,0 +1,112 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_WDB_SCANLAYOUT_H
+#define LSST_QSERV_WDB_SCANLAYOUT_H
+
+// System headers
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lsst {
+namespace qserv {
+namespace wdb {
+
+/// A column of a table, as described by information_schema.COLUMNS
+struct ColumnDesc {
+    std::string name; ///< COLUMN_NAME
+    std::string dataType; ///< DATA_TYPE, e.g. "int"
+    std::string columnType; ///< COLUMN_TYPE, e.g. "int(10) unsigned"
+    bool nullable {false}; ///< IS_NULLABLE is "YES"
+    int64_t octetLength {0}; ///< CHARACTER_OCTET_LENGTH of character columns
+    int64_t charLength {0}; ///< CHARACTER_MAXIMUM_LENGTH of character columns
+};
+
+/// ScanLayout decodes the records of a fixed format (ROW_FORMAT=Fixed)
+/// MyISAM data file. A record starts with the null flags, one bit per
+/// nullable column after a first bit cleared in deleted records, followed by
+/// the columns in table order: little-endian integers and IEEE floats, and
+/// space-padded CHARs. Only tables whose columns are all integers, FLOAT,
+/// DOUBLE or single-byte CHAR can be decoded.
+class ScanLayout {
+public:
+    using Ptr = std::shared_ptr<ScanLayout>;
+
+    struct Column {
+        enum Type { INT, FLOAT, DOUBLE, CHAR };
+        std::string name;
+        Type type;
+        bool isUnsigned;
+        int offset; ///< Of the value in the record
+        int length; ///< Bytes of the value
+        int nullBit; ///< Of the null flag in the record, -1 if NOT NULL
+        std::string sqlType; ///< As mysql::SchemaFactory names it, e.g. "INT(11)"
+        int mysqlType; ///< enum_field_types
+    };
+
+    /// @return the layout of records of the columns, in table order, or
+    /// nullptr if a column cannot be decoded.
+    static Ptr build(std::vector<ColumnDesc> const& columns);
+
+    std::vector<Column> const& getColumns() const { return _columns; }
+
+    /// @return the bytes taken by a record
+    int getRecordLength() const { return _recordLength; }
+
+    /// @return the index of the column named name (case-insensitive), -1 if none
+    int findColumn(std::string const& name) const;
+
+    bool isDeleted(char const* record) const { return (record[0] & 1) == 0; }
+
+    bool isNull(char const* record, int col) const {
+        int const bit = _columns[col].nullBit;
+        return bit >= 0 && (record[bit >> 3] >> (bit & 7) & 1);
+    }
+
+    /// @return the value of an INT column. UNSIGNED BIGINT values beyond the
+    /// int64 range wrap around.
+    int64_t getInt64(char const* record, int col) const;
+    float getFloat(char const* record, int col) const;
+    double getDouble(char const* record, int col) const;
+
+    /// @return a pointer to the value of a CHAR column, of length bytes once
+    /// the trailing spaces are dropped, as MySQL returns it.
+    char const* getText(char const* record, int col, size_t& length) const;
+
+    /// Replace text by the value of a non-NULL column, formatted as MySQL
+    /// does for the text protocol. FLOAT and DOUBLE values are given with
+    /// the fewest digits that read back to the same value.
+    void formatText(char const* record, int col, std::string& text) const;
+
+private:
+    ScanLayout() {}
+
+    std::vector<Column> _columns;
+    int _recordLength {0};
+};
+
+}}} // namespace lsst::qserv::wdb
+
+#endif // LSST_QSERV_WDB_SCANLAYOUT_H
@@ -0,0 +1,470 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "wdb/ScanQuery.h"
+
+// System headers
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <strings.h>
+
+namespace {
+
+/// Token of the restricted SQL accepted by ScanQuery
+struct Token {
+    enum Kind { IDENT, QUOTED, NUMBER, PUNCT, END, BAD };
+    Kind kind;
+    std::string text;
+};
+
+/// Words that cannot be taken for an alias given without AS
+char const* const reserved[] = {
+    "AND", "AS", "BETWEEN", "BY", "CROSS", "DISTINCT", "DISTINCTROW", "FOR", "FORCE", "FROM", "GROUP",
+    "HAVING", "IGNORE", "IN", "INNER", "INTO", "IS", "JOIN", "LEFT", "LIKE",
+    "LIMIT", "LOCK", "NATURAL", "NOT", "OR", "ORDER", "PARTITION", "PROCEDURE",
+    "RIGHT", "STRAIGHT_JOIN", "UNION", "USE", "WHERE", "XOR"
+};
+
+std::vector<Token> tokenize(std::string const& sql) {
+    std::vector<Token> tokens;
+    size_t i = 0;
+    size_t const n = sql.size();
+    while (true) {
+        while (i < n && std::isspace(static_cast<unsigned char>(sql[i]))) {
+            ++i;
+        }
+        if (i == n) {
+            break;
+        }
+        char const c = sql[i];
+        size_t const start = i;
+        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            while (i < n && (std::isalnum(static_cast<unsigned char>(sql[i]))
+                             || sql[i] == '_' || sql[i] == '$')) {
+                ++i;
+            }
+            tokens.push_back(Token{Token::IDENT, sql.substr(start, i - start)});
+        } else if (c == '`') {
+            size_t const end = sql.find('`', i + 1);
+            if (end == std::string::npos || end == i + 1) {
+                tokens.push_back(Token{Token::BAD, ""});
+                return tokens;
+            }
+            tokens.push_back(Token{Token::QUOTED, sql.substr(i + 1, end - i - 1)});
+            i = end + 1;
+        } else if (std::isdigit(static_cast<unsigned char>(c))
+                   || (c == '.' && i + 1 < n && std::isdigit(static_cast<unsigned char>(sql[i + 1])))) {
+            while (i < n && (std::isdigit(static_cast<unsigned char>(sql[i])) || sql[i] == '.')) {
+                ++i;
+            }
+            if (i < n && (sql[i] == 'e' || sql[i] == 'E')) {
+                ++i;
+                if (i < n && (sql[i] == '+' || sql[i] == '-')) {
+                    ++i;
+                }
+                while (i < n && std::isdigit(static_cast<unsigned char>(sql[i]))) {
+                    ++i;
+                }
+            }
+            // e.g. 1abc, an identifier to MySQL.
+            if (i < n && (std::isalpha(static_cast<unsigned char>(sql[i])) || sql[i] == '_')) {
+                tokens.push_back(Token{Token::BAD, ""});
+                return tokens;
+            }
+            tokens.push_back(Token{Token::NUMBER, sql.substr(start, i - start)});
+        } else {
+            static char const* const puncts[] = {
+                "<=", ">=", "<>", "!=", "=", "<", ">", "(", ")", ",", ".", "*", ";", "-", "+"
+            };
+            std::string punct;
+            for (auto p : puncts) {
+                if (sql.compare(i, std::char_traits<char>::length(p), p) == 0) {
+                    punct = p;
+                    break;
+                }
+            }
+            if (punct.empty()) {
+                // Strings, comments, variables, ... are not supported.
+                tokens.push_back(Token{Token::BAD, ""});
+                return tokens;
+            }
+            tokens.push_back(Token{Token::PUNCT, punct});
+            i += punct.size();
+        }
+    }
+    tokens.push_back(Token{Token::END, ""});
+    return tokens;
+}
+
+/// Recursive descent over tokens, each method returning false on a
+/// construct it does not accept.
+class Parser {
+public:
+    explicit Parser(std::string const& sql) : _tokens(tokenize(sql)) {}
+
+    bool keyword(char const* word) {
+        if (_peek().kind == Token::IDENT && strcasecmp(_peek().text.c_str(), word) == 0) {
+            ++_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool punct(char const* p) {
+        if (_peek().kind == Token::PUNCT && _peek().text == p) {
+            ++_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool atEnd() const { return _tokens[_pos].kind == Token::END; }
+
+    bool ident(std::string& name) {
+        Token const& t = _peek();
+        if (t.kind == Token::QUOTED || (t.kind == Token::IDENT && !_isReserved(t.text))) {
+            name = t.text;
+            ++_pos;
+            return true;
+        }
+        return false;
+    }
+
+    /// [[AS] alias]
+    bool alias(std::string& name) {
+        if (keyword("AS")) {
+            return ident(name);
+        }
+        ident(name);
+        return true;
+    }
+
+    /// Identifiers separated by dots, possibly ending with *
+    bool dotted(std::vector<std::string>& parts, bool& star) {
+        star = false;
+        parts.clear();
+        do {
+            if (!parts.empty() && punct("*")) {
+                star = true;
+                return true;
+            }
+            std::string part;
+            if (!ident(part)) {
+                return false;
+            }
+            parts.push_back(part);
+        } while (parts.size() < 3 && punct("."));
+        return true;
+    }
+
+    /// A number, possibly signed. isInt is set if it has no fraction or
+    /// exponent and fits in an int64.
+    bool number(double& value, int64_t& intValue, bool& isInt) {
+        bool negative = false;
+        if (punct("-")) {
+            negative = true;
+        } else {
+            punct("+");
+        }
+        Token const& t = _peek();
+        if (t.kind != Token::NUMBER) {
+            return false;
+        }
+        std::string text = (negative ? "-" : "") + t.text;
+        ++_pos;
+        char* end;
+        value = std::strtod(text.c_str(), &end);
+        if (*end != '\0') {
+            return false;
+        }
+        isInt = t.text.find_first_of(".eE") == std::string::npos;
+        if (isInt) {
+            errno = 0;
+            intValue = std::strtoll(text.c_str(), &end, 10);
+            isInt = (errno == 0);
+        }
+        return true;
+    }
+
+    bool comparison(std::string& op) {
+        static char const* const ops[] = {"=", "<>", "!=", "<", "<=", ">", ">="};
+        for (auto o : ops) {
+            if (punct(o)) {
+                op = o;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool peekNumber() const {
+        Token const& t = _peek();
+        return t.kind == Token::NUMBER || (t.kind == Token::PUNCT && (t.text == "-" || t.text == "+"));
+    }
+
+private:
+    Token const& _peek() const { return _tokens[_pos]; }
+
+    static bool _isReserved(std::string const& word) {
+        for (auto r : reserved) {
+            if (strcasecmp(word.c_str(), r) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Token> const _tokens;
+    size_t _pos {0};
+};
+
+} // anonymous namespace
+
+namespace lsst {
+namespace qserv {
+namespace wdb {
+
+namespace {
+
+struct Qualified {
+    std::vector<std::string> qualifier; ///< [db,] table or alias
+    std::string column;
+};
+
+ScanQuery::Ptr const none;
+
+bool parseColumn(Parser& p, Qualified& q) {
+    std::vector<std::string> parts;
+    bool star;
+    if (!p.dotted(parts, star) || star) {
+        return false;
+    }
+    q.column = parts.back();
+    parts.pop_back();
+    q.qualifier = parts;
+    return true;
+}
+
+} // anonymous namespace
+
+ScanQuery::Ptr ScanQuery::parse(std::string const& sql) {
+    Parser p(sql);
+    Ptr q(new ScanQuery());
+    std::vector<std::vector<std::string>> qualifiers;
+    if (!p.keyword("SELECT")) {
+        return none;
+    }
+    p.keyword("ALL");
+    do {
+        Select s;
+        if (!p.punct("*")) {
+            std::vector<std::string> parts;
+            bool star;
+            if (!p.dotted(parts, star)) {
+                return none;
+            }
+            if (!star) {
+                s.column = parts.back();
+                parts.pop_back();
+                s.name = s.column;
+                if (!p.alias(s.name)) {
+                    return none;
+                }
+            }
+            qualifiers.push_back(parts);
+        }
+        q->_selects.push_back(s);
+    } while (p.punct(","));
+
+    std::string alias;
+    if (!p.keyword("FROM") || !p.ident(q->_db) || !p.punct(".") || !p.ident(q->_table)
+        || !p.alias(alias)) {
+        return none;
+    }
+
+    if (p.keyword("WHERE")) {
+        int depth = 0;
+        do {
+            while (p.punct("(")) {
+                ++depth;
+            }
+            Term t;
+            Qualified c;
+            std::string op;
+            bool hiIsInt = true;
+            if (p.peekNumber()) {
+                // number op column
+                if (!p.number(t.lo, t.intLo, t.isInt) || !p.comparison(op) || !parseColumn(p, c)) {
+                    return none;
+                }
+                static std::string const ops[] = {"<", "<=", ">", ">="};
+                static std::string const flipped[] = {">", ">=", "<", "<="};
+                for (int i = 0; i < 4; ++i) {
+                    if (op == ops[i]) {
+                        op = flipped[i];
+                        break;
+                    }
+                }
+            } else {
+                if (!parseColumn(p, c)) {
+                    return none;
+                }
+                if (p.keyword("BETWEEN")) {
+                    op = "BETWEEN";
+                    if (!p.number(t.lo, t.intLo, t.isInt) || !p.keyword("AND")
+                        || !p.number(t.hi, t.intHi, hiIsInt)) {
+                        return none;
+                    }
+                } else if (!p.comparison(op) || !p.number(t.lo, t.intLo, t.isInt)) {
+                    return none;
+                }
+            }
+            t.isInt = t.isInt && hiIsInt;
+            t.op = op == "=" ? Term::EQ
+                : op == "<>" || op == "!=" ? Term::NE
+                : op == "<" ? Term::LT
+                : op == "<=" ? Term::LE
+                : op == ">" ? Term::GT
+                : op == ">=" ? Term::GE
+                : Term::BETWEEN;
+            t.column = c.column;
+            q->_terms.push_back(t);
+            qualifiers.push_back(c.qualifier);
+            // Only closes what was opened: AND binds the same on either side.
+            while (depth > 0 && p.punct(")")) {
+                --depth;
+            }
+        } while (p.keyword("AND"));
+        if (depth != 0) {
+            return none;
+        }
+    }
+    p.punct(";");
+    if (!p.atEnd()) {
+        return none;
+    }
+
+    // Columns can only be of the one table.
+    for (auto const& qual : qualifiers) {
+        if (qual.empty()) {
+            continue;
+        }
+        std::string const& table = qual.back();
+        // MySQL no longer knows an aliased table by its name.
+        bool const ok = qual.size() == 1
+            ? strcasecmp(table.c_str(), (alias.empty() ? q->_table : alias).c_str()) == 0
+            : (alias.empty() && strcasecmp(qual[0].c_str(), q->_db.c_str()) == 0
+               && strcasecmp(table.c_str(), q->_table.c_str()) == 0);
+        if (!ok) {
+            return none;
+        }
+    }
+    return q;
+}
+
+bool ScanQuery::bind(ScanLayout::Ptr const& layout) {
+    _columns.clear();
+    _names.clear();
+    for (auto const& s : _selects) {
+        if (s.column.empty()) {
+            for (unsigned int i = 0; i < layout->getColumns().size(); ++i) {
+                _columns.push_back(i);
+                _names.push_back(layout->getColumns()[i].name);
+            }
+            continue;
+        }
+        int const col = layout->findColumn(s.column);
+        if (col < 0) {
+            return false;
+        }
+        _columns.push_back(col);
+        _names.push_back(s.name);
+    }
+    for (auto& t : _terms) {
+        t.col = layout->findColumn(t.column);
+        if (t.col < 0) {
+            return false;
+        }
+        ScanLayout::Column const& c = layout->getColumns()[t.col];
+        if (c.type == ScanLayout::Column::CHAR) {
+            return false; // Collations
+        }
+        if (c.type == ScanLayout::Column::INT && c.length == 8 && (c.isUnsigned || !t.isInt)) {
+            return false; // Not exact as doubles
+        }
+        if (c.type != ScanLayout::Column::INT) {
+            t.isInt = false;
+        }
+    }
+    _layout = layout;
+    return true;
+}
+
+template <typename T>
+bool ScanQuery::_compare(Term::Op op, T v, T lo, T hi) {
+    switch (op) {
+    case Term::EQ: return v == lo;
+    case Term::NE: return v != lo;
+    case Term::LT: return v < lo;
+    case Term::LE: return v <= lo;
+    case Term::GT: return v > lo;
+    case Term::GE: return v >= lo;
+    case Term::BETWEEN: return lo <= v && v <= hi;
+    }
+    return false;
+}
+
+bool ScanQuery::matches(char const* record) const {
+    for (auto const& t : _terms) {
+        if (_layout->isNull(record, t.col)) {
+            return false;
+        }
+        bool match;
+        switch (_layout->getColumns()[t.col].type) {
+        case ScanLayout::Column::INT:
+            if (t.isInt) {
+                match = _compare(t.op, _layout->getInt64(record, t.col), t.intLo, t.intHi);
+            } else {
+                match = _compare(t.op, double(_layout->getInt64(record, t.col)), t.lo, t.hi);
+            }
+            break;
+        case ScanLayout::Column::FLOAT:
+            // MySQL compares FLOATs as the doubles they convert to.
+            match = _compare(t.op, double(_layout->getFloat(record, t.col)), t.lo, t.hi);
+            break;
+        case ScanLayout::Column::DOUBLE:
+            match = _compare(t.op, _layout->getDouble(record, t.col), t.lo, t.hi);
+            break;
+        default:
+            match = false;
+        }
+        if (!match) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}}} // namespace lsst::qserv::wdb
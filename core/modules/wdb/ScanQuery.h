@@ -0,0 +1,106 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_WDB_SCANQUERY_H
+#define LSST_QSERV_WDB_SCANQUERY_H
+
+// System headers
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Qserv headers
+#include "wdb/ScanLayout.h"
+
+namespace lsst {
+namespace qserv {
+namespace wdb {
+
+/// ScanQuery is a query simple enough to be answered by a SharedScan,
+/// selecting columns of the rows of one table that satisfy a conjunction of
+/// comparisons with numbers:
+///
+///   SELECT * | col [[AS] name], ... FROM db.table [[AS] alias]
+///     [WHERE col op number AND col BETWEEN number AND number ...]
+///
+/// where op is one of = <> != < <= > >=, columns may be qualified by the
+/// table name or alias, and comparisons may be parenthesized.
+class ScanQuery {
+public:
+    using Ptr = std::shared_ptr<ScanQuery>;
+
+    /// @return the query of sql, or nullptr if sql is not such a query
+    static Ptr parse(std::string const& sql);
+
+    std::string const& getDb() const { return _db; }
+    std::string const& getTable() const { return _table; }
+
+    /// Resolve the columns of the query in layout.
+    /// @return false if a column is missing, or is compared in a way this
+    /// class cannot do exactly as MySQL would (CHAR and UNSIGNED BIGINT
+    /// columns, BIGINT columns with non-integers).
+    bool bind(ScanLayout::Ptr const& layout);
+
+    /// @return the layout columns returned, once bound
+    std::vector<int> const& getColumns() const { return _columns; }
+
+    /// @return the names of the columns returned, as mysqld names them
+    std::vector<std::string> const& getNames() const { return _names; }
+
+    /// @return true if the record satisfies the WHERE clause, once bound
+    bool matches(char const* record) const;
+
+private:
+    struct Select {
+        std::string column; ///< Empty for *
+        std::string name;
+    };
+
+    struct Term {
+        enum Op { EQ, NE, LT, LE, GT, GE, BETWEEN };
+        std::string column;
+        Op op {EQ};
+        bool isInt {false}; ///< The bounds and the column are integers
+        int64_t intLo {0};
+        int64_t intHi {0}; ///< BETWEEN only
+        double lo {0};
+        double hi {0}; ///< BETWEEN only
+        int col {-1}; ///< In the layout, once bound
+    };
+
+    template <typename T> static bool _compare(Term::Op op, T v, T lo, T hi);
+
+    ScanQuery() {}
+
+    std::string _db;
+    std::string _table;
+    std::vector<Select> _selects;
+    std::vector<Term> _terms;
+    ScanLayout::Ptr _layout;
+    std::vector<int> _columns;
+    std::vector<std::string> _names;
+};
+
+}}} // namespace lsst::qserv::wdb
+
+#endif // LSST_QSERV_WDB_SCANQUERY_H
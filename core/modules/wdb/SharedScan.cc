@@ -0,0 +1,327 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "wdb/SharedScan.h"
+
+// System headers
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// LSST headers
+#include "lsst/log/Log.h"
+
+namespace {
+LOG_LOGGER _log = LOG_GET("lsst.qserv.wdb.SharedScan");
+}
+
+namespace lsst {
+namespace qserv {
+namespace wdb {
+
+SharedScan::SharedScan(std::string const& path, ScanLayout::Ptr const& layout, size_t batchRecords,
+                       std::chrono::milliseconds maxWait)
+    : _layout(layout), _batchRecords(std::max(batchRecords, size_t(1))),
+      _maxBuffered(2*_batchRecords), _maxWait(maxWait) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOGS(_log, LOG_LVL_WARN, "SharedScan cannot open " << path << ": " << std::strerror(errno));
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size % _layout->getRecordLength() != 0) {
+        LOGS(_log, LOG_LVL_WARN, "SharedScan " << path << " does not hold records of "
+             << _layout->getRecordLength() << " bytes");
+        close(fd);
+        return;
+    }
+    _size = st.st_size;
+    _recordCount = _size / _layout->getRecordLength();
+    if (_size > 0) {
+        // The pages are normally locked by memman already, which mapped
+        // the file for the scheduler.
+        void* data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            LOGS(_log, LOG_LVL_WARN, "SharedScan cannot map " << path << ": " << std::strerror(errno));
+            close(fd);
+            return;
+        }
+        madvise(data, _size, MADV_SEQUENTIAL);
+        _data = static_cast<char const*>(data);
+    }
+    close(fd); // The mapping keeps the file.
+    _valid = true;
+}
+
+SharedScan::~SharedScan() {
+    if (_data) {
+        munmap(const_cast<char*>(_data), _size);
+    }
+}
+
+bool SharedScan::run(ScanQuery const& query, RowFunc const& func) {
+    auto reader = std::make_shared<Reader>(query);
+    std::unique_lock<std::mutex> lock(_mtx);
+    ++_stats.queries;
+    if (_recordCount == 0) {
+        return true;
+    }
+    _joining.push_back(reader);
+    while (true) {
+        if (!reader->buffer.empty()) {
+            std::vector<char const*> records;
+            records.swap(reader->buffer);
+            _cv.notify_all(); // The driver may be waiting for room.
+            lock.unlock();
+            bool ok = _give(records, func);
+            lock.lock();
+            if (!ok) {
+                reader->stopped = true;
+                _cv.notify_all();
+                break;
+            }
+            continue;
+        }
+        if (reader->done) {
+            break;
+        }
+        if (reader->detached) {
+            lock.unlock();
+            bool ok = _readAlone(*reader, func);
+            lock.lock();
+            reader->stopped = !ok;
+            break;
+        }
+        if (_driving) {
+            _cv.wait(lock);
+            continue;
+        }
+        // The buffer of this query is empty: it has room for a batch.
+        _drive(lock);
+    }
+    // The batch in progress may still be matching records for the query.
+    _joining.erase(std::remove(_joining.begin(), _joining.end(), reader), _joining.end());
+    _readers.erase(std::remove(_readers.begin(), _readers.end(), reader), _readers.end());
+    _cv.wait(lock, [&reader]() { return !reader->inBatch; });
+    return !reader->stopped;
+}
+
+/// Read one batch for all readers, with lock held on entry and exit.
+void SharedScan::_drive(std::unique_lock<std::mutex>& lock) {
+    _driving = true;
+    for (auto const& r : _joining) {
+        r->recordsLeft = _recordCount;
+        _readers.push_back(r);
+    }
+    _joining.clear();
+    uint64_t const begin = _cursor;
+    uint64_t const end = std::min(begin + _batchRecords, _recordCount);
+    std::vector<Reader::Ptr> readers(_readers);
+    for (auto const& r : readers) {
+        r->inBatch = true;
+    }
+    lock.unlock();
+    std::vector<std::vector<char const*>> matches;
+    _match(begin, end, readers, matches);
+    lock.lock();
+    _cursor = end == _recordCount ? 0 : end;
+    ++_stats.batches;
+    _stats.records += end - begin;
+    // Wait a little for queries to take their records, then detach those
+    // still lagging behind, rather than stalling all the others.
+    auto const deadline = std::chrono::steady_clock::now() + _maxWait;
+    for (size_t j = 0; j < readers.size(); ++j) {
+        Reader& r = *readers[j];
+        bool const room = _cv.wait_until(lock, deadline, [this, &r, &matches, j]() {
+                return r.stopped || r.buffer.size() + matches[j].size() <= _maxBuffered;
+            });
+        if (r.stopped) {
+            // Left the scan.
+        } else if (!room) {
+            r.detached = true;
+            r.resumeAt = begin;
+            ++_stats.detached;
+            LOGS(_log, LOG_LVL_INFO, "SharedScan detached a query with "
+                 << r.buffer.size() << " records pending");
+        } else {
+            r.buffer.insert(r.buffer.end(), matches[j].begin(), matches[j].end());
+            r.recordsLeft -= std::min(r.recordsLeft, end - begin);
+            r.done = r.recordsLeft == 0;
+        }
+        r.inBatch = false;
+        _cv.notify_all();
+    }
+    _readers.erase(std::remove_if(_readers.begin(), _readers.end(), [](Reader::Ptr const& r) {
+                return r->stopped || r->detached || r->done;
+            }), _readers.end());
+    _driving = false;
+    // Some other query's thread may take over.
+    _cv.notify_all();
+}
+
+/// Find the records of [begin, end) matching each of readers.
+void SharedScan::_match(uint64_t begin, uint64_t end, std::vector<Reader::Ptr> const& readers,
+                        std::vector<std::vector<char const*>>& matches) {
+    size_t const length = _layout->getRecordLength();
+    if (end < _recordCount) {
+        // Start reading the next batch ahead, in case it is not resident.
+        size_t const page = sysconf(_SC_PAGESIZE);
+        size_t const next = (end*length) & ~(page - 1);
+        size_t const nextEnd = std::min(_recordCount, end + _batchRecords)*length;
+        madvise(const_cast<char*>(_data) + next, nextEnd - next, MADV_WILLNEED);
+    }
+    matches.resize(readers.size());
+    for (uint64_t i = begin; i < end; ++i) {
+        char const* record = _data + i*length;
+        if (_layout->isDeleted(record)) {
+            continue;
+        }
+        for (size_t j = 0; j < readers.size(); ++j) {
+            if (readers[j]->query.matches(record)) {
+                matches[j].push_back(record);
+            }
+        }
+    }
+}
+
+/// Hand records to func, which are mapped as long as the scan lives.
+/// @return false if func left the scan
+bool SharedScan::_give(std::vector<char const*> const& records, RowFunc const& func) {
+    try {
+        for (char const* record : records) {
+            if (!func(record)) {
+                return false;
+            }
+        }
+    } catch (std::exception const& e) {
+        LOGS(_log, LOG_LVL_ERROR, "SharedScan query failed: " << e.what());
+        return false;
+    }
+    return true;
+}
+
+/// Read the records reader has not seen yet, from the thread of its query.
+/// @return false if func left the scan
+bool SharedScan::_readAlone(Reader const& reader, RowFunc const& func) {
+    size_t const length = _layout->getRecordLength();
+    std::vector<char const*> records;
+    for (uint64_t n = 0; n < reader.recordsLeft;) {
+        uint64_t const begin = (reader.resumeAt + n) % _recordCount;
+        uint64_t const end = std::min(begin + std::min<uint64_t>(_batchRecords, reader.recordsLeft - n),
+                                      _recordCount);
+        records.clear();
+        for (uint64_t i = begin; i < end; ++i) {
+            char const* record = _data + i*length;
+            if (!_layout->isDeleted(record) && reader.query.matches(record)) {
+                records.push_back(record);
+            }
+        }
+        if (!_give(records, func)) {
+            return false;
+        }
+        n += end - begin;
+    }
+    return true;
+}
+
+SharedScan::Stats SharedScan::getStats() {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _stats;
+}
+
+SharedScan::Ptr SharedScanMgr::getScan(std::string const& db, std::string const& table,
+                                       ScanLayout::Ptr const& layout) {
+    std::string const path = _dataDir + "/" + db + "/" + table + ".MYD";
+    std::lock_guard<std::mutex> lock(_mtx);
+    auto& weak = _scans[path];
+    SharedScan::Ptr scan = weak.lock();
+    if (scan) {
+        // The table may have been reloaded with other columns since the
+        // scan started.
+        auto const& columns = scan->getLayout()->getColumns();
+        if (scan->getLayout()->getRecordLength() != layout->getRecordLength()
+            || columns.size() != layout->getColumns().size()) {
+            return nullptr;
+        }
+        return scan;
+    }
+    scan = std::make_shared<SharedScan>(path, layout, _batchRecords, _maxWait);
+    if (!scan->isValid()) {
+        _scans.erase(path);
+        return nullptr;
+    }
+    weak = scan;
+    // Forget the scans no query holds anymore.
+    for (auto i = _scans.begin(); i != _scans.end();) {
+        if (i->second.expired()) {
+            i = _scans.erase(i);
+        } else {
+            ++i;
+        }
+    }
+    return scan;
+}
+
+bool SharedScanMgr::findLayout(std::string const& user, std::string const& db,
+                               std::string const& table, ScanLayout::Ptr& layout) {
+    std::string const version = _getVersion(db, table);
+    if (version.empty()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(_mtx);
+    auto i = _layouts.find(user + "@" + db + "." + table);
+    if (i == _layouts.end() || i->second.version != version) {
+        return false;
+    }
+    layout = i->second.layout;
+    return true;
+}
+
+void SharedScanMgr::keepLayout(std::string const& user, std::string const& db,
+                               std::string const& table, ScanLayout::Ptr const& layout) {
+    std::string const version = _getVersion(db, table);
+    if (version.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mtx);
+    _layouts[user + "@" + db + "." + table] = KeptLayout{layout, version};
+}
+
+/// @return an identifier of the definition of db.table, which changes when
+/// the table is created again or altered, or an empty string if it has no
+/// definition file.
+std::string SharedScanMgr::_getVersion(std::string const& db, std::string const& table) const {
+    struct stat st;
+    if (stat((_dataDir + "/" + db + "/" + table + ".frm").c_str(), &st) != 0) {
+        return std::string();
+    }
+    return std::to_string(st.st_ino) + ":" + std::to_string(st.st_mtim.tv_sec) + "."
+        + std::to_string(st.st_mtim.tv_nsec);
+}
+
+}}} // namespace lsst::qserv::wdb
@@ -0,0 +1,187 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_WDB_SHAREDSCAN_H
+#define LSST_QSERV_WDB_SHAREDSCAN_H
+
+// System headers
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Qserv headers
+#include "wdb/ScanLayout.h"
+#include "wdb/ScanQuery.h"
+
+namespace lsst {
+namespace qserv {
+namespace wdb {
+
+/// SharedScan reads the records of a fixed format MyISAM data file, mapped
+/// in memory, for any number of ScanQueries at once: each record is decoded
+/// once and handed to every query it matches.
+///
+/// The scan is circular. A query joining a scan underway starts with the
+/// next batch of records and is done once the scan comes back to it, so
+/// that it has seen every record exactly once. The batches are read by the
+/// thread of one of its queries at a time, which only matches records and
+/// buffers them for each query; every query's own thread hands its records
+/// to its RowFunc. A query whose buffer stays full, e.g. as its results go
+/// to a slow czar, is detached from the scan and reads the rest of the file
+/// on its own, so that it does not hold up the other queries.
+class SharedScan {
+public:
+    using Ptr = std::shared_ptr<SharedScan>;
+
+    /// Called with each record matching a query, from the thread running
+    /// the query. Return false to leave the scan, e.g. on an error or when
+    /// the query was cancelled.
+    using RowFunc = std::function<bool(char const* record)>;
+
+    struct Stats {
+        uint64_t queries {0}; ///< Queries that ran on the scan
+        uint64_t batches {0}; ///< Batches of records read
+        uint64_t records {0}; ///< Records read, which cost as much as one query
+        uint64_t detached {0}; ///< Queries that finished reading on their own
+    };
+
+    /// Map the data file at path. See isValid().
+    /// @param batchRecords records read for all queries at a time
+    /// @param maxWait how long a batch waits for room in the buffer of a
+    ///                query before detaching it
+    SharedScan(std::string const& path, ScanLayout::Ptr const& layout, size_t batchRecords,
+               std::chrono::milliseconds maxWait=std::chrono::milliseconds(100));
+    ~SharedScan();
+
+    SharedScan(SharedScan const&) = delete;
+    SharedScan& operator=(SharedScan const&) = delete;
+
+    /// @return true if the file is mapped, and holds whole records
+    bool isValid() const { return _valid; }
+
+    ScanLayout::Ptr const& getLayout() const { return _layout; }
+
+    /// Give func each record matching query, bound to getLayout(), once.
+    /// Returns when the query has seen every record, or left the scan.
+    /// @return false if func left the scan
+    bool run(ScanQuery const& query, RowFunc const& func);
+
+    Stats getStats();
+
+private:
+    struct Reader {
+        using Ptr = std::shared_ptr<Reader>;
+        explicit Reader(ScanQuery const& query_) : query(query_) {}
+        ScanQuery const& query;
+        std::vector<char const*> buffer; ///< Matching records, for the query's thread
+        uint64_t recordsLeft {0}; ///< Before it has gone around the file
+        uint64_t resumeAt {0}; ///< First record to read once detached
+        bool inBatch {false}; ///< Being matched by the batch in progress
+        bool stopped {false}; ///< The RowFunc returned false
+        bool detached {false}; ///< Reading the records left on its own
+        bool done {false};
+    };
+
+    void _drive(std::unique_lock<std::mutex>& lock);
+    void _match(uint64_t begin, uint64_t end, std::vector<Reader::Ptr> const& readers,
+                std::vector<std::vector<char const*>>& matches);
+    bool _give(std::vector<char const*> const& records, RowFunc const& func);
+    bool _readAlone(Reader const& reader, RowFunc const& func);
+
+    ScanLayout::Ptr const _layout;
+    size_t const _batchRecords;
+    size_t const _maxBuffered; ///< Records in the buffer of a query
+    std::chrono::milliseconds const _maxWait;
+    bool _valid {false};
+    char const* _data {nullptr};
+    size_t _size {0};
+    uint64_t _recordCount {0};
+
+    std::mutex _mtx; ///< Protects the members below
+    std::condition_variable _cv; ///< Signalled when buffers change or the driver leaves
+    std::vector<Reader::Ptr> _readers; ///< Attached to the scan
+    std::vector<Reader::Ptr> _joining; ///< Starting with the next batch
+    uint64_t _cursor {0}; ///< Record starting the next batch
+    bool _driving {false}; ///< A thread is reading batches
+    Stats _stats;
+};
+
+/// SharedScanMgr finds the SharedScan of a chunk table, so that the queries
+/// on it running at the same time share a single pass over its records. A
+/// scan, and its mapping, are dropped once no query is using them. It also
+/// keeps the layouts looked up for the tables, so that each task does not
+/// have to query information_schema again.
+class SharedScanMgr {
+public:
+    using Ptr = std::shared_ptr<SharedScanMgr>;
+
+    /// @param dataDir the mysqld data directory, holding db/table.MYD files
+    /// @param batchRecords records read for all queries at a time
+    /// @param maxWait see SharedScan
+    explicit SharedScanMgr(std::string const& dataDir, size_t batchRecords=4096,
+                           std::chrono::milliseconds maxWait=std::chrono::milliseconds(100))
+        : _dataDir(dataDir), _batchRecords(batchRecords), _maxWait(maxWait) {}
+
+    SharedScanMgr(SharedScanMgr const&) = delete;
+    SharedScanMgr& operator=(SharedScanMgr const&) = delete;
+
+    /// @return the scan of db.table, whose records have layout, or nullptr
+    /// if its data file cannot be scanned.
+    SharedScan::Ptr getScan(std::string const& db, std::string const& table,
+                            ScanLayout::Ptr const& layout);
+
+    /// Find the layout kept for db.table as seen by user, which may be
+    /// nullptr for a table that cannot be scanned.
+    /// @return false if there is none, or the table was redefined since
+    bool findLayout(std::string const& user, std::string const& db, std::string const& table,
+                    ScanLayout::Ptr& layout);
+
+    /// Keep the layout of db.table as seen by user, for findLayout().
+    void keepLayout(std::string const& user, std::string const& db, std::string const& table,
+                    ScanLayout::Ptr const& layout);
+
+private:
+    struct KeptLayout {
+        ScanLayout::Ptr layout;
+        std::string version; ///< Of the table definition file
+    };
+
+    std::string _getVersion(std::string const& db, std::string const& table) const;
+
+    std::string const _dataDir;
+    size_t const _batchRecords;
+    std::chrono::milliseconds const _maxWait;
+    std::mutex _mtx; ///< Protects _scans and _layouts
+    std::map<std::string, std::weak_ptr<SharedScan>> _scans; ///< By file path
+    std::map<std::string, KeptLayout> _layouts; ///< By user and table
+};
+
+}}} // namespace lsst::qserv::wdb
+
+#endif // LSST_QSERV_WDB_SHAREDSCAN_H
@@ -98,4 +98,47 @@ BOOST_AUTO_TEST_CASE(TwoChunk) {
     // Now, these resources should be freed.
 }
 
+BOOST_AUTO_TEST_CASE(Cache) {
+    // Fake subchunk tables take 1 byte each.
+    std::shared_ptr<ChunkResourceMgr> crm(ChunkResourceMgr::newFakeMgr(3));
+    std::vector<int> sc1(1, 11);
+    std::vector<int> sc2(1, 12);
+    {
+        ChunkResource cr(crm->acquire(thedb, 1, tables, sc1));
+        ChunkResource shared(crm->acquire(thedb, 1, tables, sc1));
+    }
+    auto stats = crm->getCacheStats();
+    BOOST_CHECK_EQUAL(stats.misses, 2U);
+    BOOST_CHECK_EQUAL(stats.hits, 2U);
+    BOOST_CHECK_EQUAL(stats.bytes, 2U);
+    {
+        ChunkResource cr(crm->acquire(thedb, 1, tables, sc1));
+    }
+    stats = crm->getCacheStats();
+    BOOST_CHECK_EQUAL(stats.misses, 2U);
+    BOOST_CHECK_EQUAL(stats.hits, 4U);
+    BOOST_CHECK_EQUAL(stats.evictions, 0U);
+    {
+        ChunkResource cr(crm->acquire(thedb, 1, tables, sc2));
+    }
+    stats = crm->getCacheStats();
+    BOOST_CHECK_EQUAL(stats.misses, 4U);
+    BOOST_CHECK_EQUAL(stats.evictions, 1U);
+    BOOST_CHECK_EQUAL(stats.bytes, 3U);
+}
+
+BOOST_AUTO_TEST_CASE(NoCache) {
+    std::shared_ptr<ChunkResourceMgr> crm(ChunkResourceMgr::newFakeMgr());
+    {
+        ChunkResource cr(crm->acquire(thedb, 1, tables, subchunks));
+    }
+    {
+        ChunkResource cr(crm->acquire(thedb, 1, tables, subchunks));
+    }
+    auto stats = crm->getCacheStats();
+    BOOST_CHECK_EQUAL(stats.hits, 0U);
+    BOOST_CHECK_EQUAL(stats.evictions, 20U);
+    BOOST_CHECK_EQUAL(stats.bytes, 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,180 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ /**
+  * @brief Test ConnectionPool, with connections that are never connected
+  * so that no mysqld is needed.
+  */
+
+// System headers
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Qserv headers
+#include "mysql/MySqlConnection.h"
+#include "wdb/ConnectionPool.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE ConnectionPool
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+using lsst::qserv::mysql::MySqlConfig;
+using lsst::qserv::mysql::MySqlConnection;
+using lsst::qserv::wdb::ConnectionPool;
+
+namespace {
+
+/// Hands out unconnected connections and counts them.
+class FakePool : public ConnectionPool {
+public:
+    FakePool(size_t maxIdle, size_t maxOpen) : ConnectionPool(newConfig(), maxIdle, maxOpen) {}
+
+    static MySqlConfig newConfig() {
+        MySqlConfig config;
+        config.username = "qsmaster";
+        config.dbName = "LSST";
+        return config;
+    }
+
+    std::atomic<int> connects{0};
+    std::atomic<bool> alive{true}; ///< Answer of pings
+    std::atomic<bool> connectFails{false};
+
+protected:
+    ConnPtr _connect(MySqlConfig const& config) override {
+        if (connectFails) {
+            return nullptr;
+        }
+        ++connects;
+        return ConnPtr(new MySqlConnection(config));
+    }
+    bool _ping(MySqlConnection&) override { return alive; }
+    bool _resetSession(MySqlConnection&) override { return true; }
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(Suite)
+
+BOOST_AUTO_TEST_CASE(Reuse) {
+    FakePool pool(2, 0);
+    auto conn = pool.acquire("qsmaster", "");
+    BOOST_REQUIRE(conn != nullptr);
+    MySqlConnection* first = conn.get();
+    BOOST_CHECK_EQUAL(conn->getMySqlConfig().dbName, "LSST");
+    pool.release(std::move(conn), true);
+    BOOST_CHECK_EQUAL(pool.getIdleCount(), 1U);
+
+    // Same user and database, the idle connection is handed out again.
+    conn = pool.acquire("qsmaster", "LSST");
+    BOOST_CHECK(conn.get() == first);
+    BOOST_CHECK_EQUAL(pool.getHits(), 1U);
+    BOOST_CHECK_EQUAL(pool.getMisses(), 1U);
+
+    // Other database, a new connection.
+    auto other = pool.acquire("qsmaster", "Other");
+    BOOST_CHECK(other.get() != first);
+    BOOST_CHECK_EQUAL(other->getMySqlConfig().dbName, "Other");
+    BOOST_CHECK_EQUAL(pool.getMisses(), 2U);
+    BOOST_CHECK_EQUAL(pool.getOpenCount(), 2U);
+
+    // Unhealthy connections are closed.
+    pool.release(std::move(conn), false);
+    pool.release(std::move(other), true);
+    BOOST_CHECK_EQUAL(pool.getIdleCount(), 1U);
+    BOOST_CHECK_EQUAL(pool.getOpenCount(), 1U);
+    BOOST_CHECK_EQUAL(pool.connects, 2);
+}
+
+BOOST_AUTO_TEST_CASE(DeadConnection) {
+    FakePool pool(2, 0);
+    pool.release(pool.acquire("qsmaster", ""), true);
+    pool.alive = false;
+    auto conn = pool.acquire("qsmaster", "");
+    BOOST_CHECK(conn != nullptr);
+    BOOST_CHECK_EQUAL(pool.getHits(), 0U);
+    BOOST_CHECK_EQUAL(pool.getMisses(), 2U);
+    BOOST_CHECK_EQUAL(pool.getIdleCount(), 0U);
+    BOOST_CHECK_EQUAL(pool.getOpenCount(), 1U);
+    pool.release(std::move(conn), true);
+
+    // A failed connect does not count as open.
+    pool.connectFails = true;
+    BOOST_CHECK(pool.acquire("other", "") == nullptr);
+    BOOST_CHECK_EQUAL(pool.getOpenCount(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(IdleCap) {
+    FakePool pool(2, 0);
+    auto a = pool.acquire("a", "");
+    auto b = pool.acquire("b", "");
+    auto c = pool.acquire("c", "");
+    pool.release(std::move(a), true);
+    pool.release(std::move(b), true);
+    pool.release(std::move(c), true);
+    // The least recently used one, a, was closed.
+    BOOST_CHECK_EQUAL(pool.getIdleCount(), 2U);
+    BOOST_CHECK_EQUAL(pool.getOpenCount(), 2U);
+    pool.release(pool.acquire("a", ""), true);
+    BOOST_CHECK_EQUAL(pool.getHits(), 0U);
+    pool.release(pool.acquire("c", ""), true);
+    BOOST_CHECK_EQUAL(pool.getHits(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(OpenCap) {
+    FakePool pool(2, 2);
+    auto a = pool.acquire("a", "");
+    auto b = pool.acquire("b", "");
+    BOOST_CHECK_EQUAL(pool.getOpenCount(), 2U);
+
+    // At the cap, an optional connection is refused.
+    BOOST_CHECK(pool.acquire("c", "", false) == nullptr);
+
+    // An idle connection of another user is closed to make room.
+    pool.release(std::move(b), true);
+    auto c = pool.acquire("c", "", false);
+    BOOST_CHECK(c != nullptr);
+    BOOST_CHECK_EQUAL(pool.getIdleCount(), 0U);
+    BOOST_CHECK_EQUAL(pool.getOpenCount(), 2U);
+
+    // A required connection waits for one to be released.
+    std::atomic<bool> got{false};
+    std::thread waiter([&pool, &got]() {
+        auto d = pool.acquire("d", "");
+        got = (d != nullptr);
+        pool.release(std::move(d), true);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK(!got);
+    pool.release(std::move(a), false);
+    waiter.join();
+    BOOST_CHECK(got);
+    BOOST_CHECK_LE(pool.getOpenCount(), 2U);
+    pool.release(std::move(c), true);
+    BOOST_CHECK_EQUAL(pool.getOpenCount(), 2U);
+    BOOST_CHECK_EQUAL(pool.connects, 4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
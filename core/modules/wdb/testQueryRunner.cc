@@ -27,6 +27,11 @@
   * @author Daniel L. Wang, SLAC
   */
 
+// System headers
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
 // LSST headers
 #include "lsst/log/Log.h"
 
@@ -60,6 +65,26 @@ using lsst::qserv::wdb::ChunkResourceMgr;
 using lsst::qserv::wdb::QueryRunner;
 using lsst::qserv::wdb::QueryRunnerArg;
 
+/// Takes sendDelay to send each bucket, or throws.
+class SlowChannel : public SendChannel {
+public:
+    bool send(char const* buf, int bufLen) override { return true; }
+    bool sendError(std::string const& msg, int code) override { return true; }
+    bool sendFile(int fd, Size fSize) override { return true; }
+    bool sendStream(char const* buf, int bufLen, bool last) override {
+        if (fail) {
+            throw std::runtime_error("channel closed");
+        }
+        std::this_thread::sleep_for(sendDelay);
+        ++sends;
+        return true;
+    }
+
+    std::chrono::milliseconds sendDelay{0};
+    bool fail = false;
+    int sends = 0;
+};
+
 struct Fixture {
     std::shared_ptr<TaskMsg> newTaskMsg() {
         std::shared_ptr<TaskMsg> t = std::make_shared<TaskMsg>();
@@ -120,4 +145,37 @@ BOOST_AUTO_TEST_CASE(Output) {
     BOOST_CHECK_EQUAL(aa.task->msg->session(), result.session());
 }
 
+BOOST_AUTO_TEST_CASE(StageTimes) {
+    QueryRunnerArg aa(newArg());
+    auto sc = std::make_shared<SlowChannel>();
+    sc->sendDelay = std::chrono::milliseconds(50);
+    aa.task->sendChannel = sc;
+    QueryRunner::Ptr a{QueryRunner::newQueryRunner(aa)};
+    auto start = std::chrono::steady_clock::now();
+    BOOST_CHECK(a->runQuery());
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // A header and a message, sent on the send thread.
+    BOOST_CHECK_EQUAL(sc->sends, 2);
+    QueryRunner::StageTimes const& times = a->getStageTimes();
+    BOOST_CHECK_GE(times.send, 0.1);
+    BOOST_CHECK_GT(times.fill, 0);
+    BOOST_CHECK_GE(times.waitSend, 0);
+    BOOST_CHECK_GE(times.serialize, 0);
+    BOOST_CHECK_GE(times.checksum, 0);
+    BOOST_CHECK_LE(times.fill + times.waitSend, elapsed.count());
+    BOOST_CHECK_LE(times.serialize + times.checksum + times.send, elapsed.count());
+}
+
+BOOST_AUTO_TEST_CASE(SendFails) {
+    QueryRunnerArg aa(newArg());
+    auto sc = std::make_shared<SlowChannel>();
+    sc->fail = true;
+    aa.task->sendChannel = sc;
+    QueryRunner::Ptr a{QueryRunner::newQueryRunner(aa)};
+    // The error is reported, instead of leaving the send thread.
+    BOOST_CHECK(!a->runQuery());
+    BOOST_CHECK_EQUAL(sc->sends, 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,114 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// System headers
+#include <memory>
+#include <string>
+
+// Qserv headers
+#include "wbase/SendChannel.h"
+#include "wdb/ResultCache.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE ResultCache_1
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+using lsst::qserv::wbase::SendChannel;
+using lsst::qserv::wdb::ResultCache;
+
+struct Fixture {
+    /// @return an entry holding header and msg, as sent for one Task
+    ResultCache::Entry::Ptr record(ResultCache& cache, int chunkId,
+                                   std::string const& header, std::string const& msg) {
+        auto entry = cache.newEntry("LSST", chunkId);
+        entry->add(header.data(), header.size(), false);
+        entry->add(msg.data(), msg.size(), true);
+        return entry;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(Suite, Fixture)
+
+BOOST_AUTO_TEST_CASE(Replay) {
+    ResultCache cache(1000);
+    BOOST_CHECK(cache.insert("d1", record(cache, 1, "head", "result rows")));
+    BOOST_CHECK(cache.contains("d1"));
+    std::string out;
+    auto channel = SendChannel::newStringChannel(out);
+    BOOST_CHECK(cache.replay("d1", *channel));
+    BOOST_CHECK_EQUAL(out, "headresult rows");
+    BOOST_CHECK(!cache.replay("d2", *channel));
+    auto stats = cache.getStats();
+    BOOST_CHECK_EQUAL(stats.hits, 1U);
+    BOOST_CHECK_EQUAL(stats.misses, 1U);
+
+    // Requests are looked up with contains() first, as in Foreman.
+    BOOST_CHECK(!cache.contains("d2"));
+    BOOST_CHECK_EQUAL(cache.getStats().misses, 2U);
+    BOOST_CHECK(cache.contains("d1"));
+    BOOST_CHECK_EQUAL(cache.getStats().hits, 1U);
+    BOOST_CHECK_EQUAL(stats.bytes, 15U);
+
+    // Incomplete results are not kept.
+    auto entry = cache.newEntry("LSST", 1);
+    entry->add("head", 4, false);
+    BOOST_CHECK(!cache.insert("d3", entry));
+}
+
+BOOST_AUTO_TEST_CASE(Budget) {
+    ResultCache cache(400);
+    std::string msg(90, 'x');
+    BOOST_CHECK(cache.insert("d1", record(cache, 1, "h", msg)));
+    BOOST_CHECK(cache.insert("d2", record(cache, 2, "h", msg)));
+    BOOST_CHECK(cache.insert("d3", record(cache, 3, "h", msg)));
+    std::string out;
+    auto channel = SendChannel::newStringChannel(out);
+    BOOST_CHECK(cache.replay("d1", *channel)); // d2 is now least recently used
+    BOOST_CHECK(cache.insert("d4", record(cache, 4, "h", msg)));
+    BOOST_CHECK(cache.insert("d5", record(cache, 5, "h", msg)));
+    BOOST_CHECK(cache.contains("d1"));
+    BOOST_CHECK(!cache.contains("d2"));
+    BOOST_CHECK_EQUAL(cache.getStats().evictions, 1U);
+    BOOST_CHECK(cache.getStats().bytes <= 400U);
+
+    // Larger than a quarter of the cache
+    BOOST_CHECK(!cache.insert("big", record(cache, 6, "h", std::string(100, 'y'))));
+}
+
+BOOST_AUTO_TEST_CASE(Invalidate) {
+    ResultCache cache(1000);
+    BOOST_CHECK(cache.insert("d1", record(cache, 1, "h", "a")));
+    BOOST_CHECK(cache.insert("d2", record(cache, 2, "h", "b")));
+    auto recording = record(cache, 1, "h", "c");
+    cache.invalidate("LSST", 1);
+    BOOST_CHECK(!cache.contains("d1"));
+    BOOST_CHECK(cache.contains("d2"));
+    BOOST_CHECK_EQUAL(cache.getStats().invalidations, 1U);
+    // Recorded before the change, so possibly stale.
+    BOOST_CHECK(!cache.insert("d3", recording));
+    BOOST_CHECK(cache.insert("d3", record(cache, 1, "h", "c")));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
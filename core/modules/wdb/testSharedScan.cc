@@ -0,0 +1,297 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// System headers
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Qserv headers
+#include "wdb/ScanLayout.h"
+#include "wdb/ScanQuery.h"
+#include "wdb/SharedScan.h"
+
+// Boost unit test header
+#define BOOST_TEST_MODULE SharedScan_1
+#include "boost/test/included/unit_test.hpp"
+
+namespace test = boost::test_tools;
+
+using lsst::qserv::wdb::ColumnDesc;
+using lsst::qserv::wdb::ScanLayout;
+using lsst::qserv::wdb::ScanQuery;
+using lsst::qserv::wdb::SharedScan;
+using lsst::qserv::wdb::SharedScanMgr;
+
+struct Fixture {
+    Fixture() {
+        char dir[] = "/tmp/testSharedScanXXXXXX";
+        BOOST_REQUIRE(mkdtemp(dir));
+        dataDir = dir;
+        BOOST_REQUIRE(mkdir((dataDir + "/LSST").c_str(), 0700) == 0);
+        std::vector<ColumnDesc> columns(4);
+        columns[0].name = "objectId"; columns[0].dataType = "bigint";
+        columns[0].columnType = "bigint(20)";
+        columns[1].name = "ra"; columns[1].dataType = "double";
+        columns[1].columnType = "double"; columns[1].nullable = true;
+        columns[2].name = "flag"; columns[2].dataType = "tinyint";
+        columns[2].columnType = "tinyint(3) unsigned";
+        columns[3].name = "band"; columns[3].dataType = "char";
+        columns[3].columnType = "char(4)"; columns[3].nullable = true;
+        columns[3].octetLength = columns[3].charLength = 4;
+        layout = ScanLayout::build(columns);
+        BOOST_REQUIRE(layout);
+    }
+
+    ~Fixture() {
+        std::string cmd = "rm -rf " + dataDir;
+        std::system(cmd.c_str());
+    }
+
+    /// @return a record with the null flags byte, as MyISAM writes it
+    std::string record(int64_t id, double const* ra, unsigned char flag, char const* band) {
+        std::string r(layout->getRecordLength(), '\0');
+        r[0] = 1 | (ra ? 0 : 2) | (band ? 0 : 4);
+        for (int i = 0; i < 8; ++i) {
+            r[1 + i] = (uint64_t(id) >> (8*i)) & 0xff;
+        }
+        if (ra) {
+            std::memcpy(&r[9], ra, 8);
+        }
+        r[17] = flag;
+        std::memcpy(&r[18], band ? band : "    ", 4);
+        return r;
+    }
+
+    /// Write count records with objectId i and ra i/10 to LSST/Object_1.MYD
+    void writeTable(int count) {
+        std::string data;
+        for (int i = 0; i < count; ++i) {
+            double ra = i/10.0;
+            data += record(i, &ra, i % 256, "r   ");
+        }
+        FILE* f = std::fopen((dataDir + "/LSST/Object_1.MYD").c_str(), "w");
+        BOOST_REQUIRE(f);
+        std::fwrite(data.data(), 1, data.size(), f);
+        std::fclose(f);
+    }
+
+    std::string dataDir;
+    ScanLayout::Ptr layout;
+};
+
+BOOST_FIXTURE_TEST_SUITE(Suite, Fixture)
+
+BOOST_AUTO_TEST_CASE(Layout) {
+    BOOST_CHECK_EQUAL(layout->getRecordLength(), 1 + 8 + 8 + 1 + 4);
+    BOOST_CHECK_EQUAL(layout->findColumn("RA"), 1);
+    BOOST_CHECK_EQUAL(layout->getColumns()[2].sqlType, "TINYINT(3)");
+    double ra = 0.1;
+    std::string r = record(-3, &ra, 200, "ab  ");
+    std::string text;
+    BOOST_CHECK(!layout->isDeleted(r.data()));
+    BOOST_CHECK(!layout->isNull(r.data(), 1));
+    BOOST_CHECK_EQUAL(layout->getInt64(r.data(), 0), -3);
+    layout->formatText(r.data(), 1, text);
+    BOOST_CHECK_EQUAL(text, "0.1");
+    layout->formatText(r.data(), 2, text);
+    BOOST_CHECK_EQUAL(text, "200");
+    layout->formatText(r.data(), 3, text);
+    BOOST_CHECK_EQUAL(text, "ab");
+    r = record(1, nullptr, 0, nullptr);
+    BOOST_CHECK(layout->isNull(r.data(), 1));
+    BOOST_CHECK(layout->isNull(r.data(), 3));
+    r[0] = 0;
+    BOOST_CHECK(layout->isDeleted(r.data()));
+
+    std::vector<ColumnDesc> columns(1);
+    columns[0].name = "d"; columns[0].dataType = "decimal";
+    columns[0].columnType = "decimal(10,2)";
+    BOOST_CHECK(!ScanLayout::build(columns));
+}
+
+BOOST_AUTO_TEST_CASE(Parse) {
+    auto q = ScanQuery::parse("SELECT o.objectId, o.ra AS r FROM LSST.Object_1 AS o "
+                              "WHERE (o.ra BETWEEN 1 AND 2.5) AND 3 < o.objectId;");
+    BOOST_REQUIRE(q);
+    BOOST_CHECK_EQUAL(q->getDb(), "LSST");
+    BOOST_CHECK_EQUAL(q->getTable(), "Object_1");
+    BOOST_REQUIRE(q->bind(layout));
+    BOOST_CHECK_EQUAL(q->getNames().size(), 2U);
+    BOOST_CHECK_EQUAL(q->getNames()[1], "r");
+    double ra = 2.0;
+    BOOST_CHECK(q->matches(record(4, &ra, 0, nullptr).data()));
+    BOOST_CHECK(!q->matches(record(3, &ra, 0, nullptr).data()));
+    BOOST_CHECK(!q->matches(record(4, nullptr, 0, nullptr).data()));
+    ra = 2.6;
+    BOOST_CHECK(!q->matches(record(4, &ra, 0, nullptr).data()));
+
+    q = ScanQuery::parse("select * from LSST.Object_1");
+    BOOST_REQUIRE(q);
+    BOOST_REQUIRE(q->bind(layout));
+    BOOST_CHECK_EQUAL(q->getColumns().size(), 4U);
+
+    // Queries needing mysqld
+    char const* const others[] = {
+        "SELECT COUNT(*) FROM LSST.Object_1",
+        "SELECT ra FROM LSST.Object_1 WHERE ra > 1 OR ra < 0",
+        "SELECT ra FROM LSST.Object_1 LIMIT 10",
+        "SELECT ra FROM LSST.Object_1 ORDER BY ra",
+        "SELECT ra FROM Object_1",
+        "SELECT o.ra FROM LSST.Object_1 AS o, LSST.Source_1 AS s",
+        "SELECT s.ra FROM LSST.Object_1 AS o",
+        "SELECT ra FROM LSST.Object_1 WHERE band = 'r'",
+        "SELECT DISTINCT ra FROM LSST.Object_1",
+        "SELECT ra FROM LSST.Object_1 WHERE (ra > 1",
+        "SELECT ra FROM LSST.Object_1; DROP TABLE LSST.Object_1"
+    };
+    for (auto sql : others) {
+        BOOST_CHECK_MESSAGE(!ScanQuery::parse(sql), sql);
+    }
+    // Comparisons MySQL does otherwise
+    char const* const unbound[] = {
+        "SELECT ra FROM LSST.Object_1 WHERE band = 1",
+        "SELECT ra FROM LSST.Object_1 WHERE objectId < 1.5",
+        "SELECT decl FROM LSST.Object_1"
+    };
+    for (auto sql : unbound) {
+        q = ScanQuery::parse(sql);
+        BOOST_REQUIRE(q);
+        BOOST_CHECK_MESSAGE(!q->bind(layout), sql);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Scan) {
+    int const count = 1000;
+    writeTable(count);
+    SharedScanMgr mgr(dataDir, 64);
+    BOOST_CHECK(!mgr.getScan("LSST", "Object_2", layout));
+    auto scan = mgr.getScan("LSST", "Object_1", layout);
+    BOOST_REQUIRE(scan);
+    BOOST_CHECK(scan == mgr.getScan("LSST", "Object_1", layout));
+
+    auto q1 = ScanQuery::parse("SELECT objectId FROM LSST.Object_1 WHERE flag < 10");
+    auto q2 = ScanQuery::parse("SELECT objectId FROM LSST.Object_1 WHERE ra >= 50");
+    BOOST_REQUIRE(q1 && q1->bind(layout));
+    BOOST_REQUIRE(q2 && q2->bind(layout));
+    std::set<int64_t> ids1;
+    std::set<int64_t> ids2;
+    std::thread second;
+    // The second query joins while the first one is underway.
+    bool ok1 = scan->run(*q1, [&](char const* record) {
+            int64_t id = layout->getInt64(record, 0);
+            BOOST_CHECK(ids1.insert(id).second);
+            if (id == 256) {
+                second = std::thread([&]() {
+                        BOOST_CHECK(scan->run(*q2, [&](char const* record) {
+                                    BOOST_CHECK(ids2.insert(layout->getInt64(record, 0)).second);
+                                    return true;
+                                }));
+                    });
+                usleep(10000);
+            }
+            return true;
+        });
+    second.join();
+    BOOST_CHECK(ok1);
+    BOOST_CHECK_EQUAL(ids1.size(), 40U); // flag is objectId % 256
+    BOOST_CHECK_EQUAL(ids2.size(), 500U);
+    BOOST_CHECK_EQUAL(*ids2.begin(), 500);
+    auto stats = scan->getStats();
+    BOOST_CHECK_EQUAL(stats.queries, 2U);
+    BOOST_CHECK(stats.records < 2U*count);
+
+    // Leaving the scan early
+    int calls = 0;
+    BOOST_CHECK(!scan->run(*q2, [&](char const*) { return ++calls < 3; }));
+    BOOST_CHECK_EQUAL(calls, 3);
+}
+
+BOOST_AUTO_TEST_CASE(Detach) {
+    int const count = 1000;
+    writeTable(count);
+    SharedScanMgr mgr(dataDir, 64, std::chrono::milliseconds(20));
+    auto scan = mgr.getScan("LSST", "Object_1", layout);
+    BOOST_REQUIRE(scan);
+    auto q = ScanQuery::parse("SELECT objectId FROM LSST.Object_1");
+    BOOST_REQUIRE(q && q->bind(layout));
+
+    // The slow query, e.g. sending to a slow czar, blocks until the quick
+    // one is done, which it must not hold up.
+    std::set<int64_t> slowIds;
+    std::set<int64_t> quickIds;
+    std::atomic<bool> quickDone{false};
+    std::thread slow([&]() {
+            BOOST_CHECK(scan->run(*q, [&](char const* record) {
+                        BOOST_CHECK(slowIds.insert(layout->getInt64(record, 0)).second);
+                        while (slowIds.size() == 10 && !quickDone) {
+                            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                        }
+                        return true;
+                    }));
+        });
+    while (scan->getStats().queries == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    BOOST_CHECK(scan->run(*q, [&](char const* record) {
+                BOOST_CHECK(quickIds.insert(layout->getInt64(record, 0)).second);
+                return true;
+            }));
+    quickDone = true;
+    slow.join();
+    BOOST_CHECK_EQUAL(quickIds.size(), size_t(count));
+    BOOST_CHECK_EQUAL(slowIds.size(), size_t(count));
+    BOOST_CHECK_EQUAL(scan->getStats().detached, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(KeptLayout) {
+    SharedScanMgr mgr(dataDir);
+    ScanLayout::Ptr kept;
+    // Only kept for tables with a definition file.
+    mgr.keepLayout("qsmaster", "LSST", "Object_1", layout);
+    BOOST_CHECK(!mgr.findLayout("qsmaster", "LSST", "Object_1", kept));
+
+    std::string const frm = dataDir + "/LSST/Object_1.frm";
+    std::ofstream(frm) << "1";
+    mgr.keepLayout("qsmaster", "LSST", "Object_1", layout);
+    BOOST_CHECK(mgr.findLayout("qsmaster", "LSST", "Object_1", kept));
+    BOOST_CHECK(kept == layout);
+    BOOST_CHECK(!mgr.findLayout("other", "LSST", "Object_1", kept));
+
+    // Redefining the table drops its layout.
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::remove(frm.c_str());
+    std::ofstream(frm) << "2";
+    BOOST_CHECK(!mgr.findLayout("qsmaster", "LSST", "Object_1", kept));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
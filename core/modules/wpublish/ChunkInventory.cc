@@ -30,6 +30,8 @@
 #include <exception>
 #include <iostream>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 // Third-party headers
 #include "boost/regex.hpp"
@@ -69,8 +71,9 @@ inline std::string getTableNameDbListing(std::string const& instanceName) {
     return "qservw_" + instanceName + "." + "Dbs";
 }
 
+/// @return false if the list of databases could not be fetched
 template <class C>
-void fetchDbs(std::string const& instanceName,
+bool fetchDbs(std::string const& instanceName,
               SqlConnection& sc,
               C& dbs) {
 
@@ -82,12 +85,15 @@ void fetchDbs(std::string const& instanceName,
     std::string listq = "SELECT db FROM " + tableNameDbListing;
     LOGS(_log, LOG_LVL_DEBUG, "Launching query: " << listq);
     std::shared_ptr<SqlResultIter> resultP = sc.getQueryIter(listq);
-    assert(resultP.get());
+    if (!resultP) {
+        LOGS(_log, LOG_LVL_ERROR, "ChunkInventory can't get list of publishable dbs.");
+        return false;
+    }
     if (resultP->getErrorObject().isSet()) {
         SqlErrorObject& seo = resultP->getErrorObject();
         LOGS(_log, LOG_LVL_ERROR, "ChunkInventory can't get list of publishable dbs.");
         LOGS(_log, LOG_LVL_ERROR, seo.printErrMsg());
-        return;
+        return false;
     }
     bool nothing = true;
     for(; !resultP->done(); ++(*resultP)) {
@@ -97,6 +103,7 @@ void fetchDbs(std::string const& instanceName,
     if (nothing) {
         LOGS(_log, LOG_LVL_WARN, "TEST: No databases found to export: " << listq);
     }
+    return true;
 }
 
 /// Functor to be called per-table name
@@ -149,15 +156,50 @@ struct addDbItem {
     ChunkInventory::StringSet& _stringSet;
 };
 
-/// Functor to load db
+/// Fill signatures with the names and modification times of the chunk
+/// tables of dbName. Without access to information_schema, only names are known.
+/// @return false if the modification times could not be queried
+bool fetchSignatures(SqlConnection& sc, std::string const& dbName,
+                     ChunkInventory::ChunkMap const& chunkMap,
+                     std::map<int, std::string>& signatures) {
+    std::map<std::string, std::string> updateTimes;
+    std::string query = "SELECT TABLE_NAME, UPDATE_TIME FROM information_schema.TABLES "
+                        "WHERE TABLE_SCHEMA = '" + dbName + "'";
+    std::shared_ptr<SqlResultIter> resultP = sc.getQueryIter(query);
+    bool ok = resultP && !resultP->getErrorObject().isSet();
+    if (ok) {
+        for(; !resultP->done(); ++(*resultP)) {
+            auto const& row = **resultP;
+            if (row.size() >= 2) {
+                updateTimes[row[0]] = row[1];
+            }
+        }
+    } else {
+        LOGS(_log, LOG_LVL_ERROR, "ChunkInventory can't get table update times for db=" << dbName);
+    }
+    for (auto const& chunk : chunkMap) {
+        std::string& sig = signatures[chunk.first];
+        for (auto const& table : chunk.second) { // StringSet, so sorted
+            std::string tableName = table + "_" + std::to_string(chunk.first);
+            sig += tableName + "@" + updateTimes[tableName] + ";";
+        }
+    }
+    return ok;
+}
+
+/// Functor to load db. Clears ok if any query fails.
 class doDb {
 public:
     doDb(SqlConnection& conn,
          boost::regex& regex,
-         ChunkInventory::ExistMap& existMap)
+         ChunkInventory::ExistMap& existMap,
+         bool& ok,
+         ChunkInventory::SignatureMap* signatures=nullptr)
         : _conn(conn),
           _regex(regex),
-          _existMap(existMap)
+          _existMap(existMap),
+          _ok(ok),
+          _signatures(signatures)
         {}
 
     void operator()(std::string const& dbName) {
@@ -166,8 +208,10 @@ public:
         SqlErrorObject sqlErrorObject;
         bool ok = _conn.listTables(tables,  sqlErrorObject, "", dbName);
         if (!ok) {
-            LOGS(_log, LOG_LVL_ERROR, "SQL error: " << sqlErrorObject.errMsg());
-            assert(ok);
+            LOGS(_log, LOG_LVL_ERROR, "SQL error listing tables of db=" << dbName
+                 << ": " << sqlErrorObject.errMsg());
+            _ok = false;
+            return;
         }
         ChunkInventory::ChunkMap& chunkMap = _existMap[dbName];
         chunkMap.clear(); // Clear out stale entries to avoid mixing.
@@ -194,11 +238,17 @@ public:
         }
         //std::for_each(chunkMap.begin(), chunkMap.end(), printChunk(std::cout));
         // TODO: Sanity check: do all tables have the same chunks represented?
+        if (_signatures
+            && !fetchSignatures(_conn, dbName, chunkMap, (*_signatures)[dbName])) {
+            _ok = false;
+        }
         }
 private:
     SqlConnection& _conn;
     boost::regex& _regex;
     ChunkInventory::ExistMap& _existMap;
+    bool& _ok;
+    ChunkInventory::SignatureMap* _signatures;
 };
 
 class Validator : public lsst::qserv::ResourceUnit::Checker {
@@ -228,6 +278,7 @@ ChunkInventory::ChunkInventory(std::string const& name,
 
 bool ChunkInventory::has(std::string const& db, int chunk,
                          std::string table) const {
+    std::lock_guard<std::mutex> lock(_mtx);
     ExistMap::const_iterator di = _existMap.find(db);
     if (di == _existMap.end()) { return false; }
 
@@ -248,6 +299,7 @@ std::shared_ptr<ResourceUnit::Checker> ChunkInventory::newValidator() {
 }
 
 void ChunkInventory::dbgPrint(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(_mtx);
     os << "ChunkInventory(";
     ExistMap::const_iterator i,e;
     bool firstDb = true;
@@ -276,13 +328,72 @@ void ChunkInventory::dbgPrint(std::ostream& os) {
 }
 
 void ChunkInventory::_init(SqlConnection& sc) {
+    // At startup, whatever could be loaded is better than nothing.
+    if (!_load(sc, _existMap, _signatures)) {
+        LOGS(_log, LOG_LVL_ERROR, "ChunkInventory initial load incomplete");
+    }
+}
+
+bool ChunkInventory::refresh(SqlConnection& sc) {
+    ExistMap existMap;
+    SignatureMap signatures;
+    if (!_load(sc, existMap, signatures)) {
+        // A partial inventory would reject valid requests and report changes
+        // that did not happen, so keep the previous one.
+        LOGS(_log, LOG_LVL_WARN, "ChunkInventory refresh failed, keeping previous inventory");
+        return false;
+    }
+    std::vector<std::pair<std::string, int>> changed;
+    ChangeFunc changeFunc;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        // Chunks of a that are missing from b, or, if compare, differ in b.
+        auto diff = [&changed](SignatureMap const& a, SignatureMap const& b, bool compare) {
+            for (auto const& db : a) {
+                auto bDb = b.find(db.first);
+                for (auto const& chunk : db.second) {
+                    if (bDb == b.end()) {
+                        changed.emplace_back(db.first, chunk.first);
+                        continue;
+                    }
+                    auto bChunk = bDb->second.find(chunk.first);
+                    if (bChunk == bDb->second.end() || (compare && bChunk->second != chunk.second)) {
+                        changed.emplace_back(db.first, chunk.first);
+                    }
+                }
+            }
+        };
+        diff(signatures, _signatures, true);
+        diff(_signatures, signatures, false);
+        _existMap.swap(existMap);
+        _signatures.swap(signatures);
+        changeFunc = _changeFunc;
+    }
+    for (auto const& dbChunk : changed) {
+        LOGS(_log, LOG_LVL_DEBUG, "ChunkInventory change in db=" << dbChunk.first
+             << " chunk=" << dbChunk.second);
+        if (changeFunc) {
+            changeFunc(dbChunk.first, dbChunk.second);
+        }
+    }
+    return true;
+}
+
+void ChunkInventory::setChangeFunc(ChangeFunc const& func) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _changeFunc = func;
+}
+
+bool ChunkInventory::_load(SqlConnection& sc, ExistMap& existMap, SignatureMap& signatures) {
     std::string chunkedForm("(\\w+)_(\\d+)");
     boost::regex regex(chunkedForm);
     // Check metadata for databases to track
 
     std::deque<std::string> dbs;
 
-    fetchDbs(_name, sc, dbs);
+    if (!fetchDbs(_name, sc, dbs)) {
+        return false;
+    }
     // If we want to merge in the fs-level files/dirs, we will need the
     // export path (from getenv(XRDLCLROOT))
     // std::string exportRoot("/tmp/testExport");
@@ -290,7 +401,9 @@ void ChunkInventory::_init(SqlConnection& sc) {
     // get chunkList
     // SHOW TABLES IN db;
     std::deque<std::string> chunks;
-    std::for_each(dbs.begin(), dbs.end(), doDb(sc, regex, _existMap));
+    bool ok = true;
+    std::for_each(dbs.begin(), dbs.end(), doDb(sc, regex, existMap, ok, &signatures));
+    return ok;
 }
 
 void ChunkInventory::_fillDbChunks(ChunkInventory::StringSet& s) {
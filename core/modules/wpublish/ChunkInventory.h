@@ -30,8 +30,10 @@
 
 // System headers
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
@@ -62,6 +64,11 @@ public:
     typedef std::map<std::string, ChunkMap> ExistMap;
     typedef std::shared_ptr<ChunkInventory> Ptr;
     typedef std::shared_ptr<ChunkInventory const> CPtr;
+    /// Called with the db and chunk of tables that changed
+    typedef std::function<void(std::string const&, int)> ChangeFunc;
+    /// Per db, per chunk: description of the chunk tables and their
+    /// modification times, compared between loads.
+    typedef std::map<std::string, std::map<int, std::string>> SignatureMap;
 
     ChunkInventory(std::string const& name);
     ChunkInventory(std::string const& name, std::shared_ptr<sql::SqlConnection> sc);
@@ -81,11 +88,26 @@ public:
 
     void dbgPrint(std::ostream& os);
 
+    /// Reload the inventory, and call the change function for every chunk
+    /// whose tables were created, dropped or modified since the last load.
+    /// Modifications are seen through information_schema.TABLES.UPDATE_TIME.
+    /// If any query fails, the previous inventory is kept.
+    /// @return false if the inventory could not be reloaded
+    bool refresh(sql::SqlConnection& sc);
+
+    /// Set the function called by refresh() for each changed chunk.
+    void setChangeFunc(ChangeFunc const& func);
+
 private:
     void _init(sql::SqlConnection& sc);
+    /// @return false if any query failed, leaving existMap and signatures partial
+    bool _load(sql::SqlConnection& sc, ExistMap& existMap, SignatureMap& signatures);
     void _fillDbChunks(ChunkInventory::StringSet& s);
 
+    mutable std::mutex _mtx; ///< Protects _existMap, _signatures and _changeFunc
     ExistMap _existMap;
+    SignatureMap _signatures;
+    ChangeFunc _changeFunc;
     std::string _name;
 };
 
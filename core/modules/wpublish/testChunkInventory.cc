@@ -22,6 +22,11 @@
  */
 /// Test ChunkInventory
 
+// System headers
+#include <map>
+#include <set>
+#include <utility>
+
 // Third-party headers
 
 // Qserv headers
@@ -63,7 +68,7 @@ struct ChunkSql : public MockSql {
                             SqlErrorObject& errObj,
                             std::string const& prefixed,
                             std::string const& dbName) {
-        if (dbName == "LSST") {
+        if (dbName == "LSST" && !_failListTables) {
             v.insert(v.begin(), _tablesBegin, _tablesEnd);
             return true;
         } else {
@@ -74,12 +79,15 @@ struct ChunkSql : public MockSql {
         return std::string("LSST");
     }
     virtual std::shared_ptr<SqlResultIter> getQueryIter(std::string const& query) {
-        if (startswith(query, "SELECT db FROM")) {
+        if (startswith(query, "SELECT db FROM") && !_failDbs) {
             std::shared_ptr<SqlIter> it;
             it = std::make_shared<SqlIter>(_selectDbTuples.begin(),
                                            _selectDbTuples.end());
             return it;
         }
+        if (startswith(query, "SELECT TABLE_NAME, UPDATE_TIME") && !_updateTimes.empty()) {
+            return std::make_shared<SqlIter>(_updateTimes.begin(), _updateTimes.end());
+        }
         return std::shared_ptr<SqlIter>();
     }
 
@@ -89,6 +97,9 @@ struct ChunkSql : public MockSql {
     typedef MockSql::Iter<TupleVectorIter> SqlIter;
 
     TupleVector _selectDbTuples;
+    TupleVector _updateTimes; ///< (table, update time) pairs
+    bool _failDbs = false; ///< Fail the query listing the databases
+    bool _failListTables = false;
     char const* const* _tablesBegin;
     char const* const* _tablesEnd;
 };
@@ -124,4 +135,61 @@ BOOST_AUTO_TEST_CASE(MissingDummy) {
     BOOST_CHECK(!ci.has("LSST", 123));
 
 }
+BOOST_AUTO_TEST_CASE(Refresh) {
+    std::shared_ptr<ChunkSql> cs = std::make_shared<ChunkSql>(tables, tables+tablesSize);
+    cs->_updateTimes = {{"Object_31415", "2016-05-01 10:00:00"},
+                        {"Object_1234567890", "2016-05-01 10:00:00"}};
+    ChunkInventory ci("test", cs);
+    std::set<std::pair<std::string, int>> changed;
+    ci.setChangeFunc([&changed](std::string const& db, int chunk) {
+        changed.insert(std::make_pair(db, chunk));
+    });
+    ci.refresh(*cs);
+    BOOST_CHECK(changed.empty());
+
+    // A modified table
+    cs->_updateTimes[0][1] = "2016-05-02 08:00:00";
+    ci.refresh(*cs);
+    BOOST_CHECK_EQUAL(changed.size(), 1U);
+    BOOST_CHECK(changed.count(std::make_pair(std::string("LSST"), 31415)) == 1);
+
+    // Dropped tables
+    changed.clear();
+    cs->_tablesBegin = tables + 2;
+    ci.refresh(*cs);
+    BOOST_CHECK_EQUAL(changed.size(), 1U);
+    BOOST_CHECK(changed.count(std::make_pair(std::string("LSST"), 31415)) == 1);
+    BOOST_CHECK(!ci.has("LSST", 31415));
+}
+
+BOOST_AUTO_TEST_CASE(RefreshFailure) {
+    std::shared_ptr<ChunkSql> cs = std::make_shared<ChunkSql>(tables, tables+tablesSize);
+    cs->_updateTimes = {{"Object_31415", "2016-05-01 10:00:00"},
+                        {"Object_1234567890", "2016-05-01 10:00:00"}};
+    ChunkInventory ci("test", cs);
+    std::set<std::pair<std::string, int>> changed;
+    ci.setChangeFunc([&changed](std::string const& db, int chunk) {
+        changed.insert(std::make_pair(db, chunk));
+    });
+
+    // Failed queries keep the previous inventory and report no changes.
+    cs->_failDbs = true;
+    BOOST_CHECK(!ci.refresh(*cs));
+    cs->_failDbs = false;
+    cs->_failListTables = true;
+    BOOST_CHECK(!ci.refresh(*cs));
+    cs->_failListTables = false;
+    auto updateTimes = cs->_updateTimes;
+    cs->_updateTimes.clear(); // The update time query fails
+    BOOST_CHECK(!ci.refresh(*cs));
+    BOOST_CHECK(changed.empty());
+    BOOST_CHECK(ci.has("LSST", 31415));
+    BOOST_CHECK(ci.has("LSST", 1234567890));
+
+    // Once the queries work again, so does the refresh.
+    cs->_updateTimes = updateTimes;
+    BOOST_CHECK(ci.refresh(*cs));
+    BOOST_CHECK(changed.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -74,7 +74,7 @@ BlendScheduler::BlendScheduler(std::string const& name,
                                std::shared_ptr<GroupScheduler> const& group,
                                std::vector<std::shared_ptr<ScanScheduler>> const& scanSchedulers)
     : SchedulerBase{name, 0, 0, 0}, _schedMaxThreads{schedMaxThreads},
-      _group{group}, _scanFast{scanSchedulers.at(0)} {
+      _group{group}, _scanFast{scanSchedulers.at(0)}, _scanSchedulers{scanSchedulers} {
     dbgBlendScheduler = this;
     // If these are not defined, there is no point in continuing.
     assert(_group);
@@ -94,12 +94,27 @@ BlendScheduler::BlendScheduler(std::string const& name,
 
 BlendScheduler::~BlendScheduler() {
     /// Cleanup pointers.
+    if (_sendBudget != nullptr) {
+        _sendBudget->setRoomFunc(nullptr);
+    }
     std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
-    for (auto const& sched : _schedulers) {
-        auto const& scanSched = std::dynamic_pointer_cast<ScanScheduler>(sched);
-        if (scanSched != nullptr) {
-            scanSched->setBlendScheduler(nullptr);
-        }
+    for (auto const& scanSched : _scanSchedulers) {
+        scanSched->setBlendScheduler(nullptr);
+    }
+}
+
+
+/// Hold back Tasks while sendBudget is full, and look again when it has room.
+void BlendScheduler::setSendBudget(wbase::SendBudget::Ptr const& sendBudget) {
+    {
+        std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
+        _sendBudget = sendBudget;
+    }
+    if (sendBudget != nullptr) {
+        sendBudget->setRoomFunc([this]() {
+                _infoChanged = true;
+                _wakeOne();
+            });
     }
 }
 
@@ -127,7 +142,6 @@ void BlendScheduler::queCmd(util::Command::Ptr const& cmd) {
     }
     LOGS(_log, LOG_LVL_DEBUG, "BlendScheduler::queCmd " << task->getIdStr());
 
-    std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
     // Check for scan tables
     SchedulerBase* s = nullptr;
     auto const& scanTables = task->getScanInfo().infoTables;
@@ -142,13 +156,10 @@ void BlendScheduler::queCmd(util::Command::Ptr const& cmd) {
             LOGS(_log, LOG_LVL_DEBUG, ss.str());
         }
 
-        for (auto const& sched : _schedulers) {
-            ScanScheduler *scan = dynamic_cast<ScanScheduler*>(sched.get());
-            if (scan != nullptr) {
-                if (scan->isRatingInRange(scanPriority)) {
-                    s = scan;
-                    break;
-                }
+        for (auto const& scan : _scanSchedulers) {
+            if (scan->isRatingInRange(scanPriority)) {
+                s = scan.get();
+                break;
             }
         }
         if (s == nullptr) {
@@ -169,7 +180,7 @@ void BlendScheduler::queCmd(util::Command::Ptr const& cmd) {
     LOGS(_log, LOG_LVL_DEBUG, "Blend queCmd " << task->getIdStr());
     s->queCmd(task);
     _infoChanged = true;
-    notify(true);
+    _wakeOne();
 }
 
 void BlendScheduler::commandStart(util::Command::Ptr const& cmd) {
@@ -195,7 +206,7 @@ void BlendScheduler::commandFinish(util::Command::Ptr const& cmd) {
         LOGS(_log, LOG_LVL_WARN, "BlendScheduler::commandFinish cmd failed conversion");
         return;
     }
-    wcontrol::Scheduler* s = lookup(t);
+    wcontrol::Scheduler* s = _release(t);
 
     if (s != nullptr) {
         s->commandFinish(t);
@@ -206,8 +217,7 @@ void BlendScheduler::commandFinish(util::Command::Ptr const& cmd) {
     _infoChanged = true;
 
     // TODO: DM-4943 Add check to only call notify if resources were actually freed by commandFinish()
-    notify(true);
-
+    _wakeOne();
 }
 
 /// @return ptr to scheduler that is tracking p
@@ -222,6 +232,41 @@ wcontrol::Scheduler* BlendScheduler::lookup(wbase::Task::Ptr p) {
 }
 
 
+/// Stop tracking task, which has finished.
+/// @return ptr to the scheduler that was tracking task.
+SchedulerBase* BlendScheduler::_release(wbase::Task::Ptr const& task) {
+    std::lock_guard<std::mutex> guard(_mapMutex);
+    auto i = _map.find(task.get());
+    if (i == _map.end()) {
+        return nullptr;
+    }
+    SchedulerBase* sched = i->second;
+    _map.erase(i);
+    return sched;
+}
+
+
+void BlendScheduler::notifyReady() {
+    _infoChanged = true;
+    _wakeOne();
+}
+
+
+/// Wake one of the threads waiting in getCmd(), if there are any. The thread
+/// asks the schedulers for a Task again and, if it gets one, wakes the next.
+/// Locking _mx ensures that a thread that looked for a Task before the change
+/// being signalled is already waiting.
+void BlendScheduler::_wakeOne() {
+    {
+        std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
+        if (_idleThreads == 0) {
+            return;
+        }
+    }
+    notify(false);
+}
+
+
 bool BlendScheduler::ready() {
     std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
     return _ready();
@@ -231,7 +276,6 @@ bool BlendScheduler::ready() {
 /// Returns true when any sub-scheduler has a command ready.
 /// Precondition util::CommandQueue::_mx must be locked when this is called.
 bool BlendScheduler::_ready() {
-    std::ostringstream os;
     bool ready = false;
 
     if (_flagReorderScans) {
@@ -239,46 +283,80 @@ bool BlendScheduler::_ready() {
         _sortScanSchedulers();
     }
 
+    if (_sendBudget != nullptr && _sendBudget->isFull()) {
+        if (_infoChanged.exchange(false)) {
+            LOGS(_log, LOG_LVL_DEBUG, getName() << "_ready() send budget full, queued="
+                 << _sendBudget->getQueuedBytes());
+        }
+        return false;
+    }
+
     // Get the total number of threads schedulers want reserved
     int availableThreads = calcAvailableTheads();
-    bool changed = _infoChanged.exchange(false);
-    for (auto sched : _schedulers) {
+    // Only build the log message when something changed, this is called often.
+    bool changed = _infoChanged.exchange(false) && LOG_CHECK_LVL(_log, LOG_LVL_DEBUG);
+    std::string info;
+    for (auto const& sched : _schedulers) {
         availableThreads = sched->applyAvailableThreads(availableThreads);
         ready = sched->ready();
-        if (changed && LOG_CHECK_LVL(_log, LOG_LVL_DEBUG)) {
+        if (changed) {
+            std::ostringstream os;
             os << sched->getName() << "(r=" << ready << " sz=" << sched->getSize()
                << " fl=" << sched-> getInFlight() << " avail=" << availableThreads << ") ";
+            info += os.str();
         }
         if (ready) break;
     }
     if (changed) {
-        LOGS(_log, LOG_LVL_DEBUG, getName() << "_ready() " << os.str());
+        LOGS(_log, LOG_LVL_DEBUG, getName() << "_ready() " << info);
     }
     return ready;
 }
 
 util::Command::Ptr BlendScheduler::getCmd(bool wait) {
     std::unique_lock<std::mutex> lock(util::CommandQueue::_mx);
-    if (wait) {
-        util::CommandQueue::_cv.wait(lock, [this](){return _ready();});
+    // Asking the schedulers for a command directly, rather than checking
+    // _ready() first, keeps the time _mx is held per Task down.
+    util::Command::Ptr cmd = _getCmd();
+    while (wait && cmd == nullptr) {
+        ++_idleThreads;
+        util::CommandQueue::_cv.wait(lock);
+        --_idleThreads;
+        cmd = _getCmd();
+    }
+    if (cmd != nullptr) {
+        _infoChanged = true;
+        // Pass the wakeup on, there may be more Tasks ready to run.
+        if (_idleThreads > 0) {
+            notify(false);
+        }
     }
+    // returning nullptr is acceptable.
+    return cmd;
+}
 
-    // Try to get a command from the schedulers
+/// @return a command from the highest priority scheduler that has one ready, or nullptr.
+/// Precondition util::CommandQueue::_mx must be locked when this is called.
+util::Command::Ptr BlendScheduler::_getCmd() {
     util::Command::Ptr cmd;
+    if (_flagReorderScans) {
+        _flagReorderScans = false;
+        _sortScanSchedulers();
+    }
+    if (_sendBudget != nullptr && _sendBudget->isFull()) {
+        return cmd;
+    }
     int availableThreads = calcAvailableTheads();
-    for(auto sched : _schedulers) {
+    for (auto const& sched : _schedulers) {
         availableThreads = sched->applyAvailableThreads(availableThreads);
         cmd = sched->getCmd(false); // no wait
         if (cmd != nullptr) {
             LOGS(_log, LOG_LVL_DEBUG, "Blend getCmd() using cmd from " << sched->getName());
-            wbase::Task::Ptr task = std::dynamic_pointer_cast<wbase::Task>(cmd);
             break;
         }
         // adjMax = _getAdjustedMaxThreads(adjMax, sched->getInFlight()); // DM-4943 possible alternate method
         LOGS(_log, LOG_LVL_DEBUG, "Blend getCmd() nothing from " << sched->getName() << " avail=" << availableThreads);
     }
-    if (cmd != nullptr) _infoChanged = true;
-    // returning nullptr is acceptable.
     return cmd;
 }
 
@@ -306,11 +384,31 @@ int BlendScheduler::calcAvailableTheads() {
     return available;
 }
 
-/// Returns the number of Tasks queued in all sub-schedulers.
-std::size_t BlendScheduler::getSize() const {
+/// @return the number of connections a starting Task may run its fragments
+/// on: its own, plus one per pool thread that is neither running a Task nor
+/// reserved for a sub-scheduler. Idle threads are only lent while no Task
+/// is waiting for one. The extra connections are not counted as inFlight, so
+/// Tasks starting together may share the same idle threads.
+int BlendScheduler::getTaskParallelism() {
     std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
-    std::size_t sz = 0;
+    if (_sendBudget != nullptr && _sendBudget->isFull()) {
+        return 1;
+    }
+    int idle = _schedMaxThreads;
     for (auto sched : _schedulers) {
+        if (sched->getSize() > 0) {
+            return 1;
+        }
+        int inFlight = sched->getInFlight();
+        idle -= inFlight + std::max(0, sched->desiredThreadReserve() - inFlight);
+    }
+    return 1 + std::max(0, idle);
+}
+
+/// Returns the number of Tasks queued in all sub-schedulers.
+std::size_t BlendScheduler::getSize() const {
+    std::size_t sz = _group->getSize();
+    for (auto const& sched : _scanSchedulers) {
         sz += sched->getSize();
     }
     return sz;
@@ -318,9 +416,8 @@ std::size_t BlendScheduler::getSize() const {
 
 /// Returns the number of Tasks inFlight.
 int BlendScheduler::getInFlight() const {
-    std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
-    int inFlight = 0;
-    for (auto sched : _schedulers) {
+    int inFlight = _group->getInFlight();
+    for (auto const& sched : _scanSchedulers) {
         inFlight += sched->getInFlight();
     }
     return inFlight;
@@ -24,9 +24,10 @@
 #define LSST_QSERV_WSCHED_BLENDSCHEDULER_H
 
 // System headers
-#include <map>
+#include <unordered_map>
 
 // Qserv headers
+#include "wbase/SendBudget.h"
 #include "wsched/SchedulerBase.h"
 
 // Forward declarations
@@ -74,6 +75,16 @@ namespace wsched {
 /// Secondly, the ScanScheduler schedulers are only allowed to advance to a new chunk
 /// if resources are available to read the chunk into memory, or if the sub-scheduler
 /// has no Tasks inFlight.
+///
+/// Lastly, no Task is started while the worker's SendBudget is full, as the
+/// results of new Tasks would only add to the data waiting for czars.
+///
+/// Each sub-scheduler guards its queue with its own mutex. The BlendScheduler
+/// mutex is only held while pool threads wait for, and decide on, the next
+/// Task, so that the thread reservations above are computed consistently.
+/// Queuing and finishing Tasks do not hold it. Instead of waking every idle
+/// pool thread, an event wakes one, and a thread that takes a Task wakes the
+/// next one so that it can look for more work.
 class BlendScheduler : public wsched::SchedulerBase {
 public:
     using Ptr = std::shared_ptr<BlendScheduler>;
@@ -98,28 +109,39 @@ public:
     int getInFlight() const override;
     bool ready() override;
     int applyAvailableThreads(int tempMax) override { return tempMax;} //< does nothing
+    int getTaskParallelism() override;
 
     void setFlagReorderScans() { _flagReorderScans = true; }
+    /// Wake a thread to look for a Task, when a sub-scheduler became ready
+    /// other than by queuing or finishing a Task.
+    void notifyReady();
+    void setSendBudget(wbase::SendBudget::Ptr const& sendBudget);
     wcontrol::Scheduler* lookup(wbase::Task::Ptr p);
     int calcAvailableTheads();
 
 private:
     int _getAdjustedMaxThreads(int oldAdjMax, int inFlight);
     bool _ready();
+    util::Command::Ptr _getCmd();
     void _sortScanSchedulers();
+    void _wakeOne();
+    SchedulerBase* _release(wbase::Task::Ptr const& task);
 
     int _schedMaxThreads; //< maximum number of threads that can run.
 
     // Sub-schedulers.
     std::shared_ptr<GroupScheduler> _group;
     std::shared_ptr<ScanScheduler> _scanFast;
-    std::vector<SchedulerBase::Ptr> _schedulers;
+    std::vector<std::shared_ptr<ScanScheduler>> _scanSchedulers; //< Constant after construction.
+    std::vector<SchedulerBase::Ptr> _schedulers; //< In priority order, protected by _mx.
+    int _idleThreads{0}; //< Number of threads waiting in getCmd(), protected by _mx.
     bool _lastCmdFromScan{false};
-    std::map<wbase::Task*, SchedulerBase*> _map;
+    std::unordered_map<wbase::Task*, SchedulerBase*> _map; //< Tasks queued or inFlight.
     std::mutex _mapMutex;
 
     std::atomic<bool> _flagReorderScans{false};
     std::atomic<bool> _infoChanged{true}; //< Used to limit debug logging.
+    wbase::SendBudget::Ptr _sendBudget; //< Queued result bytes, may be nullptr.
 };
 
 }}} // namespace lsst::qserv::wsched
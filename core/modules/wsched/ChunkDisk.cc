@@ -28,6 +28,7 @@
 #include <ctime>
 #include <errno.h>
 #include <exception>
+#include <set>
 #include <sstream>
 
 // LSST headers
@@ -87,17 +88,51 @@ wbase::Task::Ptr ChunkDisk::MinHeap::pop() {
     return task;
 }
 
+wbase::Task::Ptr ChunkDisk::MinHeap::findFirst(TaskFilter const& filter) {
+    wbase::Task::Ptr first;
+    for (auto const& task : _tasks) {
+        if ((first == nullptr || compareFunc(first, task)) && filter(task)) {
+            first = task;
+        }
+    }
+    return first;
+}
+
+void ChunkDisk::MinHeap::remove(wbase::Task::Ptr const& task) {
+    if (!_tasks.empty() && _tasks.front() == task) {
+        pop();
+        return;
+    }
+    auto iter = std::find(_tasks.begin(), _tasks.end(), task);
+    if (iter != _tasks.end()) {
+        _tasks.erase(iter);
+        heapify();
+    }
+}
+
+
+ChunkDisk::~ChunkDisk() {
+    std::unique_lock<std::mutex> lock(_queueMutex);
+    _lockCv.wait(lock, [this](){ return _locksOutstanding == 0; });
+    if (_lockTask != nullptr && _lockDone && _lockHandle != memman::MemMan::HandleType::INVALID) {
+        _memMan->unlock(_lockHandle);
+    }
+}
+
 
 void ChunkDisk::enqueue(wbase::Task::Ptr const& a) {
     std::lock_guard<std::mutex> lock(_queueMutex);
     int chunkId = a->getChunkId();
-    time(&a->entryTime);
+    a->entryTime = _clock();
     /// Compute entry time to reduce spurious valgrind errors
     ::ctime_r(&a->entryTime, a->timestr);
 
     const char* state = "";
     // To keep from getting stuck  on this chunkId, put new requests for this chunkId on pending.
     if (chunkId <= _lastChunk) {
+        if (_pendingTasks.empty() || a->entryTime < _pendingOldest) {
+            _pendingOldest = a->entryTime;
+        }
         _pendingTasks.push(a);
         state = "PENDING";
     } else { // Ok to be part of scan. chunk not yet started
@@ -131,14 +166,185 @@ bool ChunkDisk::nextTaskDifferentChunkId() {
 
 
 /// Return true if this disk is ready to provide a Task from its queue.
-bool ChunkDisk::ready(bool useFlexibleLock) {
+bool ChunkDisk::ready(bool useFlexibleLock, TaskFilter const& filter) {
+    std::lock_guard<std::mutex> lock(_queueMutex);
+    return _ready(useFlexibleLock, filter) != nullptr;
+}
+
+void ChunkDisk::setMaxWait(int maxWaitSec) {
+    std::lock_guard<std::mutex> lock(_queueMutex);
+    _maxWaitSec = maxWaitSec;
+}
+
+void ChunkDisk::setClock(Clock const& clock) {
     std::lock_guard<std::mutex> lock(_queueMutex);
-    return _ready(useFlexibleLock);
+    _clock = clock;
+}
+
+void ChunkDisk::setMemLocker(MemLocker::Ptr const& memLocker, std::function<void()> const& lockedFunc) {
+    std::lock_guard<std::mutex> lock(_queueMutex);
+    _memLocker = memLocker;
+    _lockedFunc = lockedFunc;
+}
+
+bool ChunkDisk::lockPending() const {
+    std::lock_guard<std::mutex> lock(_queueMutex);
+    return _lockTask != nullptr;
+}
+
+void ChunkDisk::setPrefetch(int prefetchChunks) {
+    std::lock_guard<std::mutex> lock(_queueMutex);
+    _prefetchChunks = prefetchChunks;
 }
 
 /// Precondition: _queueMutex must be locked
-/// Return true if this disk is ready to provide a Task from its queue.
-bool ChunkDisk::_ready(bool useFlexibleLock) {
+/// Prefetch the tables of the _prefetchChunks chunks the scan reaches after
+/// chunkId, those left in this pass first, so that they are read from disk
+/// while the Tasks on chunkId run.
+void ChunkDisk::_prefetchAfter(int chunkId) {
+    if (_prefetchChunks <= 0 || chunkId == _lastPrefetch) {
+        return;
+    }
+    _lastPrefetch = chunkId;
+    std::set<int> thisPass;
+    std::set<int> nextPass;
+    for (auto const& task : _activeTasks._tasks) {
+        if (task->getChunkId() > chunkId) thisPass.insert(task->getChunkId());
+    }
+    for (auto const& task : _pendingTasks._tasks) {
+        if (task->getChunkId() != chunkId) nextPass.insert(task->getChunkId());
+    }
+    std::vector<int> chunkIds(thisPass.begin(), thisPass.end());
+    for (int id : nextPass) {
+        if (thisPass.count(id) == 0) chunkIds.push_back(id);
+    }
+    if (chunkIds.size() > static_cast<std::size_t>(_prefetchChunks)) {
+        chunkIds.resize(_prefetchChunks);
+    }
+
+    for (int id : chunkIds) {
+        std::vector<memman::TableInfo> tables;
+        std::set<std::string> names;
+        auto addTables = [id, &tables, &names](MinHeap const& heap) {
+            for (auto const& task : heap._tasks) {
+                if (task->getChunkId() != id) continue;
+                for (auto const& tbl : task->getScanInfo().infoTables) {
+                    std::string name = tbl.db + "." + tbl.table;
+                    if (names.insert(name).second) {
+                        tables.emplace_back(name);
+                    }
+                }
+            }
+        };
+        addTables(_activeTasks);
+        addTables(_pendingTasks);
+        LOGS(_log, LOG_LVL_DEBUG, "ChunkDisk prefetch chunkId=" << id << " tables=" << tables.size());
+        if (_memLocker != nullptr) {
+            _memLocker->prefetch(tables, id);
+        } else {
+            _memMan->prefetch(tables, id);
+        }
+    }
+}
+
+/// Precondition: _queueMutex must be locked
+/// Ask _memLocker to lock tables for task, which is then pending memory.
+void ChunkDisk::_lockInBackground(wbase::Task::Ptr const& task,
+                                  std::vector<memman::TableInfo> const& tables) {
+    _lockTask = task;
+    _lockDone = false;
+    ++_locksOutstanding;
+    // The chunk is promised to task, as in _ready(), so Tasks arriving for it
+    // or lower chunks in the meantime go on pending.
+    _grantChunk(task->getChunkId());
+    LOGS(_log, LOG_LVL_DEBUG, "ChunkDisk pending memory " << task->getIdStr());
+    _memLocker->lock(tables, task->getChunkId(), [this](memman::MemMan::Handle handle, int err) {
+            _lockFinished(handle, err);
+        });
+}
+
+/// Called on a MemLocker thread when the lock requested by _lockInBackground() completes.
+/// The result is used by the next call to _ready(), even if the lock failed.
+void ChunkDisk::_lockFinished(memman::MemMan::Handle handle, int err) {
+    std::function<void()> lockedFunc;
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        _lockHandle = handle;
+        _lockErrno = err;
+        _lockDone = true;
+        lockedFunc = _lockedFunc;
+    }
+    if (lockedFunc) {
+        lockedFunc();
+    }
+    std::lock_guard<std::mutex> lock(_queueMutex);
+    --_locksOutstanding;
+    _lockCv.notify_all();
+}
+
+/// Precondition: _queueMutex must be locked
+/// Move the Tasks of chunks with a Task pending for longer than _maxWaitSec
+/// to _activeTasks, where their lower chunkIds put them first. They all run
+/// together, so the Tasks of those chunks still share their scans.
+void ChunkDisk::_promoteWaiting() {
+    if (_maxWaitSec <= 0 || _pendingTasks.empty()) {
+        return;
+    }
+    time_t now = _clock();
+    if (now - _pendingOldest <= _maxWaitSec) {
+        return;
+    }
+    std::vector<int> chunkIds;
+    for (auto const& task : _pendingTasks._tasks) {
+        if (now - task->entryTime > _maxWaitSec) {
+            chunkIds.push_back(task->getChunkId());
+        }
+    }
+    if (chunkIds.empty()) {
+        return;
+    }
+    auto promoted = std::partition(_pendingTasks._tasks.begin(), _pendingTasks._tasks.end(),
+                                   [&chunkIds](wbase::Task::Ptr const& task) {
+            return std::find(chunkIds.begin(), chunkIds.end(), task->getChunkId()) == chunkIds.end();
+        });
+    LOGS(_log, LOG_LVL_INFO, "ChunkDisk promoting " << (_pendingTasks._tasks.end() - promoted)
+         << " Tasks pending for more than " << _maxWaitSec << "s");
+    for (auto iter = promoted; iter != _pendingTasks._tasks.end(); ++iter) {
+        _activeTasks.push(*iter);
+    }
+    _pendingTasks._tasks.erase(promoted, _pendingTasks._tasks.end());
+    _pendingTasks.heapify();
+    _pendingOldest = now;
+    for (auto const& task : _pendingTasks._tasks) {
+        _pendingOldest = std::min(_pendingOldest, task->entryTime);
+    }
+}
+
+/// Precondition: _queueMutex must be locked
+/// Once a chunk has been granted, everything equal and below must go on pending.
+/// Otherwise there's a risk of a Task with lower or same chunkId getting in front
+/// of the one granted and needing the resources it has been promised. A Task the
+/// filter picked on a higher chunk than the top of _activeTasks does not move the
+/// scan past the top though, as the chunks from the top on are still to be scanned.
+void ChunkDisk::_grantChunk(int chunkId) {
+    if (!_activeTasks.empty() && chunkId > _activeTasks.top()->getChunkId()) {
+        _lastChunk = _activeTasks.top()->getChunkId() - 1;
+    } else {
+        _lastChunk = chunkId;
+    }
+}
+
+/// Precondition: _queueMutex must be locked
+/// @return the Task this disk is ready to provide from its queue, nullptr if none.
+/// That is the first Task in the scan passing filter, or the first one if no
+/// Task does.
+wbase::Task::Ptr ChunkDisk::_ready(bool useFlexibleLock, TaskFilter const& filter) {
+    _promoteWaiting();
+    // The Task that was given memory goes next until getTask() takes it, even
+    // if it is no longer the top or the filter choice.
+    if (_readyTask != nullptr) {
+        return _readyTask;
+    }
     // If the current queue is empty and the pending is not,
     // Switch to the pending queue.
     if (_activeTasks.empty() && !_pendingTasks.empty()) {
@@ -146,31 +352,57 @@ bool ChunkDisk::_ready(bool useFlexibleLock) {
         LOGS(_log, LOG_LVL_DEBUG, "ChunkDisk active-pending swap");
     }
     // If _pendingTasks was empty too, nothing to do.
-    if(_activeTasks.empty()) { return false; }
+    if(_activeTasks.empty()) { return nullptr; }
 
     wbase::Task::Ptr task = _activeTasks.top();
+    if (filter && !filter(task)) {
+        auto other = _activeTasks.findFirst(filter);
+        if (other != nullptr) {
+            task = other;
+        }
+    }
+    if (_lockTask != nullptr) {
+        // The Task memory is being locked for goes next.
+        if (!_lockDone) {
+            return nullptr;
+        }
+        task = _lockTask;
+    }
     // Try to get memHandle for the task if doesn't have one.
     if (!task->hasMemHandle()) {
-        memman::TableInfo::LockType lckOptTbl = memman::TableInfo::LockType::MUSTLOCK;
-        memman::TableInfo::LockType lckOptIdx = memman::TableInfo::LockType::NOLOCK;
-        if (useFlexibleLock) lckOptTbl = memman::TableInfo::LockType::FLEXIBLE;
-        auto scanInfo = task-> getScanInfo();
         auto chunkId = task->getChunkId();
-        std::vector<memman::TableInfo> tblVect;
-        for (auto const& tbl : scanInfo.infoTables) {
-            memman::TableInfo ti(tbl.db + "." + tbl.table, lckOptTbl, lckOptIdx);
-            LOGS(_log,LOG_LVL_DEBUG, "chunkId=" << chunkId << " ti=" << ti.tableName
-                                     << " lock=" << (int)ti.theData);
-            tblVect.push_back(ti);
+        memman::MemMan::Handle handle;
+        int lockErrno;
+        if (_lockTask != nullptr) {
+            handle = _lockHandle;
+            lockErrno = _lockErrno;
+            _lockTask = nullptr;
+        } else {
+            memman::TableInfo::LockType lckOptTbl = memman::TableInfo::LockType::MUSTLOCK;
+            memman::TableInfo::LockType lckOptIdx = memman::TableInfo::LockType::NOLOCK;
+            if (useFlexibleLock) lckOptTbl = memman::TableInfo::LockType::FLEXIBLE;
+            auto scanInfo = task-> getScanInfo();
+            std::vector<memman::TableInfo> tblVect;
+            for (auto const& tbl : scanInfo.infoTables) {
+                memman::TableInfo ti(tbl.db + "." + tbl.table, lckOptTbl, lckOptIdx);
+                LOGS(_log,LOG_LVL_DEBUG, "chunkId=" << chunkId << " ti=" << ti.tableName
+                                         << " lock=" << (int)ti.theData);
+                tblVect.push_back(ti);
+            }
+            if (_memLocker != nullptr) {
+                _lockInBackground(task, tblVect);
+                return nullptr;
+            }
+            // If tblVect is empty, we should get the empty handle
+            handle = _memMan->lock(tblVect, chunkId);
+            lockErrno = errno;
         }
-        // If tblVect is empty, we should get the empty handle
-        memman::MemMan::Handle handle = _memMan->lock(tblVect, chunkId);
         LOGS(_log,LOG_LVL_DEBUG, "handle=" << handle);
         if (handle == 0) {
-            switch (errno) {
+            switch (lockErrno) {
             case ENOMEM:
                 setResourceStarved(true);
-                return false;
+                return nullptr;
             case ENOENT:
                 LOGS(_log, LOG_LVL_ERROR, "_memMgr->lock errno=ENOENT chunk not found " << task->getIdStr());
                 // Not sure if this is the best course of action, but it should just need one
@@ -182,29 +414,32 @@ bool ChunkDisk::_ready(bool useFlexibleLock) {
                 LOGS(_log, LOG_LVL_ERROR, "_memMgr->lock file system error " << task->getIdStr());
                 // Any error reading the file system is probably fatal for the worker.
                 throw std::bad_exception();
-                return false;
+                return nullptr;
             }
         }
         task->setMemHandle(handle);
+        _readyTask = task;
         setResourceStarved(false);
-        // Once the chunk has been granted, everything equal and below must go on pending.
-        // Otherwise there's a risk of a Task with lower or same chunkId getting in front
-        // of this one and needing the resources this Task has been promised.
-        _lastChunk = chunkId;
+        _grantChunk(chunkId);
+        _prefetchAfter(chunkId);
     }
-    return true;
+    return task;
 }
 
 /// Return a Task that is ready to run, if available.
-wbase::Task::Ptr ChunkDisk::getTask(bool useFlexibleLock) {
+wbase::Task::Ptr ChunkDisk::getTask(bool useFlexibleLock, TaskFilter const& filter) {
     LOGS(_log, LOG_LVL_DEBUG, "ChunkDisk::getTask start");
     std::lock_guard<std::mutex> lock(_queueMutex);
-    if (!_ready(useFlexibleLock)) {
+    auto task = _ready(useFlexibleLock, filter);
+    if (task == nullptr) {
         LOGS(_log, LOG_LVL_DEBUG, "ChunkDisk denying task");
         return nullptr;
     }
     // Check the chunkId.
-    auto task = _activeTasks.pop();
+    _activeTasks.remove(task);
+    if (task == _readyTask) {
+        _readyTask = nullptr;
+    }
     int chunkId = task->getChunkId();
     LOGS(_log, LOG_LVL_DEBUG, "ChunkDisk getTask: current=" << _lastChunk
          << " candidate=" << chunkId << " " << task->getIdStr());
@@ -32,6 +32,9 @@
 
 // System headers
 #include <algorithm>
+#include <condition_variable>
+#include <ctime>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <vector>
@@ -40,6 +43,7 @@
 #include "memman/MemMan.h"
 #include "proto/worker.pb.h"
 #include "wbase/Task.h"
+#include "wsched/MemLocker.h"
 
 
 namespace lsst {
@@ -50,18 +54,41 @@ namespace wsched {
 /// TODO: DM-4943 Maybe merge this class into ScanScheduler.
 class ChunkDisk {
 public:
+    /// Returns false for Tasks that should give way to the others, if any.
+    using TaskFilter = std::function<bool(wbase::Task::Ptr const&)>;
 
     ChunkDisk(memman::MemMan::Ptr const& memMan) : _memMan{memMan} {}
     ChunkDisk(ChunkDisk const&) = delete;
     ChunkDisk& operator=(ChunkDisk const&) = delete;
+    ~ChunkDisk();
 
     // Queue management
     void enqueue(wbase::Task::Ptr const& a);
-    wbase::Task::Ptr getTask(bool useFlexibleLock);
+    wbase::Task::Ptr getTask(bool useFlexibleLock, TaskFilter const& filter=nullptr);
     bool empty() const;
-    bool ready(bool useFlexibleLock);
+    bool ready(bool useFlexibleLock, TaskFilter const& filter=nullptr);
     std::size_t getSize() const;
 
+    /// Tasks deferred to the next scan for more than maxWaitSec seconds are
+    /// brought into the current one, with the other Tasks on their chunk.
+    /// 0 disables this.
+    void setMaxWait(int maxWaitSec);
+
+    /// Use clock for the entry times of Tasks and their waits instead of time().
+    using Clock = std::function<time_t()>;
+    void setClock(Clock const& clock);
+
+    /// Lock memory for Tasks with memLocker instead of in ready() and getTask().
+    /// While the lock is obtained, the Task is pending memory and no Task is
+    /// ready. lockedFunc is called, without locks held, when a lock completes.
+    void setMemLocker(MemLocker::Ptr const& memLocker, std::function<void()> const& lockedFunc);
+    /// @return true while memory is being locked for a Task.
+    bool lockPending() const;
+
+    /// Once memory for a chunk is locked, prefetch the tables of the next
+    /// prefetchChunks chunks of the scan. 0 disables this.
+    void setPrefetch(int prefetchChunks);
+
     void setResourceStarved(bool starved);
     bool nextTaskDifferentChunkId();
 
@@ -85,13 +112,21 @@ public:
         void heapify() {
             std::make_heap(_tasks.begin(), _tasks.end(), compareFunc);
         }
+        /// @return the first Task in heap order passing filter, nullptr if none
+        wbase::Task::Ptr findFirst(TaskFilter const& filter);
+        void remove(wbase::Task::Ptr const& task);
 
         std::vector<wbase::Task::Ptr> _tasks;
     };
 
 private:
     bool _empty() const;
-    bool _ready(bool useFlexibleLock);
+    wbase::Task::Ptr _ready(bool useFlexibleLock, TaskFilter const& filter);
+    void _promoteWaiting();
+    void _grantChunk(int chunkId);
+    void _lockInBackground(wbase::Task::Ptr const& task, std::vector<memman::TableInfo> const& tables);
+    void _lockFinished(memman::MemMan::Handle handle, int err);
+    void _prefetchAfter(int chunkId);
 
     mutable std::mutex _queueMutex;
     MinHeap _activeTasks;
@@ -100,6 +135,23 @@ private:
     memman::MemMan::Ptr _memMan;
     mutable std::mutex _inflightMutex;
     bool _resourceStarved{false};
+    int _maxWaitSec{0}; ///< Of Tasks on _pendingTasks, 0 for no limit
+    time_t _pendingOldest{0}; ///< Oldest entryTime on _pendingTasks, if any
+    Clock _clock{[]() { return time(nullptr); }};
+
+    // Background locking, protected by _queueMutex.
+    MemLocker::Ptr _memLocker; ///< nullptr to lock in ready() and getTask()
+    std::function<void()> _lockedFunc;
+    wbase::Task::Ptr _lockTask; ///< Task memory is being locked for, if any
+    bool _lockDone{false}; ///< The lock for _lockTask completed
+    memman::MemMan::Handle _lockHandle{memman::MemMan::HandleType::INVALID};
+    int _lockErrno{0};
+    int _locksOutstanding{0}; ///< Requests that have not finished calling back
+    wbase::Task::Ptr _readyTask; ///< Task given memory by _ready(), until getTask()
+    std::condition_variable _lockCv; ///< Signalled when _locksOutstanding drops
+
+    int _prefetchChunks{0}; ///< Number of chunks to prefetch, protected by _queueMutex
+    int _lastPrefetch{-100}; ///< Chunk the last prefetch followed
 };
 
 }}} // namespace
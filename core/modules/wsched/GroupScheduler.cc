@@ -33,7 +33,9 @@
 #include "wsched/GroupScheduler.h"
 
 // System headers
+#include <cstdint>
 #include <iostream>
+#include <limits>
 #include <mutex>
 #include <sstream>
 
@@ -46,6 +48,12 @@
 
 namespace {
 LOG_LOGGER _log = LOG_GET("lsst.qserv.wsched.GroupScheduler");
+
+/// @return the key of the groups task may join in GroupScheduler::_openGroups.
+/// Not having a chunk id is considered an id.
+int64_t groupKey(lsst::qserv::wbase::Task const& task) {
+    return task.msg->has_chunkid() ? task.msg->chunkid() : std::numeric_limits<int64_t>::min();
+}
 }
 
 namespace lsst {
@@ -59,7 +67,8 @@ GroupQueue::GroupQueue(int maxAccepted, wbase::Task::Ptr const& task) : _maxAcce
     if (_hasChunkId) {
         _chunkId = task->msg->chunkid();
     }
-    assert(queTask(task));
+    bool queued = queTask(task); // Not inside assert(), which NDEBUG drops.
+    assert(queued);
 }
 
 /// Return true if this GroupQueue accepts this task.
@@ -102,22 +111,25 @@ void GroupScheduler::queCmd(util::Command::Ptr const& cmd) {
         LOGS(_log, LOG_LVL_WARN, getName() << " queCmd could not be converted to Task or was nullptr");
         return;
     }
-    std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
-    // Start at the front of the queue looking for a group to accept the task.
-    bool queued = false;
-    for(auto iter = _queue.begin(), end = _queue.end(); iter != end && !queued; ++iter) {
-        GroupQueue::Ptr group = *iter;
-        if (group->queTask(t)) {
-            queued = true;
+    {
+        std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
+        _taskQueued(*t);
+        int64_t const key = groupKey(*t);
+        auto iter = _openGroups.find(key);
+        if (iter == _openGroups.end()) {
+            // No group of the chunk accepts tasks, need to make a new group.
+            auto group = std::make_shared<GroupQueue>(_maxGroupSize, t);
+            _queue.push_back(group);
+            iter = _openGroups.emplace(key, group).first;
+        } else {
+            iter->second->queTask(t);
         }
+        if (iter->second->isFull()) {
+            _openGroups.erase(iter);
+        }
+        util::CommandQueue::_cv.notify_one();
     }
-    if (!queued) {
-        // Wasn't inserted into an existing group, need to make a new group.
-        auto group = std::make_shared<GroupQueue>(_maxGroupSize, t);
-        _queue.push_back(group);
-    }
-    LOGS(_log, LOG_LVL_WARN, getName() << " queCmd " << t->getIdStr());
-    util::CommandQueue::_cv.notify_all();
+    LOGS(_log, LOG_LVL_DEBUG, getName() << " queCmd " << t->getIdStr());
 }
 
 /// Return a Task from the front of the queue. If no message is available, wait until one is.
@@ -130,8 +142,14 @@ util::Command::Ptr GroupScheduler::getCmd(bool wait)  {
     }
     auto group = _queue.front();
     auto cmd = group->getTask();
+    _taskDequeued(*cmd);
     if (group->isEmpty()) {
         _queue.pop_front();
+        // A group leaving the queue no longer accepts tasks.
+        auto iter = _openGroups.find(groupKey(*std::static_pointer_cast<wbase::Task>(cmd)));
+        if (iter != _openGroups.end() && iter->second == group) {
+            _openGroups.erase(iter);
+        }
     }
     ++_inFlight; // Considered inFlight as soon as it's off the queue.
     return cmd;
@@ -23,6 +23,10 @@
 #ifndef LSST_QSERV_WSCHED_GROUPSCHEDULER_H
 #define LSST_QSERV_WSCHED_GROUPSCHEDULER_H
 
+// System headers
+#include <cstdint>
+#include <unordered_map>
+
 // Qserv headers
 #include "util/EventThread.h"
 #include "wsched/SchedulerBase.h"
@@ -42,6 +46,8 @@ public:
     wbase::Task::Ptr getTask();
     wbase::Task::Ptr peekTask();
     bool isEmpty() { return _tasks.empty(); }
+    /// @return true once the group has accepted as many tasks as it may
+    bool isFull() const { return _accepted >= _maxAccepted; }
 
 protected:
     bool _hasChunkId{false};
@@ -54,6 +60,8 @@ protected:
 /// GroupScheduler -- A scheduler that is a cross between FIFO and shared scan.
 /// Tasks are ordered as they come in, except that queries for the
 /// same chunks are grouped together.
+/// Only the newest group of a chunk can still accept tasks, and it is
+/// indexed by chunk id, so that queuing and dequeuing take constant time.
 class GroupScheduler : public SchedulerBase {
 public:
     typedef std::shared_ptr<GroupScheduler> Ptr;
@@ -78,6 +86,8 @@ private:
     bool _ready();
 
     std::deque<GroupQueue::Ptr> _queue;
+    /// Groups in _queue that are not full, by chunk id.
+    std::unordered_map<int64_t, GroupQueue::Ptr> _openGroups;
     int _maxGroupSize{1};
 };
 
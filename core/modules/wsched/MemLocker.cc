@@ -0,0 +1,83 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Class header
+#include "wsched/MemLocker.h"
+
+// System headers
+#include <errno.h>
+
+// LSST headers
+#include "lsst/log/Log.h"
+
+namespace {
+LOG_LOGGER _log = LOG_GET("lsst.qserv.wsched.MemLocker");
+}
+
+namespace lsst {
+namespace qserv {
+namespace wsched {
+
+MemLocker::MemLocker(memman::MemMan::Ptr const& memMan, unsigned int threadCount)
+    : _memMan{memMan}, _queue{std::make_shared<util::CommandQueue>()} {
+    _pool = util::ThreadPool::newThreadPool(threadCount, _queue);
+    LOGS(_log, LOG_LVL_DEBUG, "MemLocker threads=" << threadCount);
+}
+
+
+MemLocker::~MemLocker() {
+    // The requests to end the threads are queued behind the lock requests.
+    _pool->endAll();
+    _pool->waitForResize(0);
+}
+
+
+void MemLocker::lock(std::vector<memman::TableInfo> const& tables, int chunkId, DoneFunc const& done) {
+    auto memMan = _memMan;
+    auto cmd = std::make_shared<util::Command>([memMan, tables, chunkId, done](util::CmdData*) {
+            memman::MemMan::Handle handle = memMan->lock(tables, chunkId);
+            int err = (handle == memman::MemMan::HandleType::INVALID) ? errno : 0;
+            LOGS(_log, LOG_LVL_DEBUG, "MemLocker chunkId=" << chunkId << " handle=" << handle
+                 << " errno=" << err);
+            done(handle, err);
+        });
+    _queue->queCmd(cmd);
+}
+
+
+void MemLocker::prefetch(std::vector<memman::TableInfo> const& tables, int chunkId) {
+    auto memMan = _memMan;
+    auto cmd = std::make_shared<util::Command>([memMan, tables, chunkId](util::CmdData*) {
+            uint64_t bytes = memMan->prefetch(tables, chunkId);
+            auto stats = memMan->getStatistics();
+            LOGS(_log, LOG_LVL_INFO, "MemLocker prefetch chunkId=" << chunkId << " bytes=" << bytes
+                 << " total files=" << stats.numPrefetch << " hits=" << stats.numPrefHits
+                 << " bytes=" << stats.bytesPrefetch << " wasted=" << stats.bytesPrefWaste
+                 << " resident bytes=" << stats.bytesResident << " hits=" << stats.numResHits
+                 << " misses=" << stats.numResMisses << " evicts=" << stats.numResEvicts
+                 << " saved=" << stats.bytesResSaved);
+        });
+    _queue->queCmd(cmd);
+}
+
+}}} // namespace lsst::qserv::wsched
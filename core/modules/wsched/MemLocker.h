@@ -0,0 +1,71 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef LSST_QSERV_WSCHED_MEMLOCKER_H
+#define LSST_QSERV_WSCHED_MEMLOCKER_H
+
+// System headers
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Qserv headers
+#include "memman/MemMan.h"
+#include "util/EventThread.h"
+
+namespace lsst {
+namespace qserv {
+namespace wsched {
+
+/// MemLocker obtains MemMan locks on a pool of background threads.
+/// MemManReal reads whole chunk files into memory while locking them, which
+/// can take seconds, and schedulers must not wait for that while holding
+/// their mutexes.
+class MemLocker {
+public:
+    using Ptr = std::shared_ptr<MemLocker>;
+    /// Called on a locker thread with the handle returned by MemMan::lock()
+    /// and the errno it set, 0 if it succeeded.
+    using DoneFunc = std::function<void(memman::MemMan::Handle handle, int err)>;
+
+    MemLocker(memman::MemMan::Ptr const& memMan, unsigned int threadCount);
+    MemLocker(MemLocker const&) = delete;
+    MemLocker& operator=(MemLocker const&) = delete;
+    /// Waits for locks already requested to complete.
+    ~MemLocker();
+
+    /// Queue a request for MemMan::lock(tables, chunkId). done is called
+    /// when it completes.
+    void lock(std::vector<memman::TableInfo> const& tables, int chunkId, DoneFunc const& done);
+
+    /// Queue a request for MemMan::prefetch(tables, chunkId).
+    void prefetch(std::vector<memman::TableInfo> const& tables, int chunkId);
+
+private:
+    memman::MemMan::Ptr _memMan;
+    util::CommandQueue::Ptr _queue;
+    util::ThreadPool::Ptr _pool;
+};
+
+}}} // namespace lsst::qserv::wsched
+
+#endif // LSST_QSERV_WSCHED_MEMLOCKER_H
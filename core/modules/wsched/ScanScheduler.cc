@@ -33,6 +33,7 @@
 #include "wsched/ScanScheduler.h"
 
 // System headers
+#include <algorithm>
 #include <cstddef>
 #include <iostream>
 #include <mutex>
@@ -84,6 +85,10 @@ void ScanScheduler::commandFinish(util::Command::Ptr const& cmd) {
     }
     std::lock_guard<std::mutex> guard(util::CommandQueue::_mx);
     --_inFlight;
+    auto query = _queries.find(t->getQueryId());
+    if (query != _queries.end() && --query->second.inFlight <= 0 && query->second.queued <= 0) {
+        _queries.erase(query);
+    }
 
     if (_memManHandleToUnlock != memman::MemMan::HandleType::INVALID) {
         _memMan->unlock(_memManHandleToUnlock);
@@ -121,8 +126,13 @@ bool ScanScheduler::_ready() {
         return false;
     }
     bool useFlexibleLock = (_inFlight < 1);
-    auto rdy = _disk->ready(useFlexibleLock); // Only returns true if MemMan grants resources.
-    if (_memManHandleToUnlock != memman::MemMan::HandleType::INVALID) {
+    // Only returns true if MemMan grants resources.
+    auto rdy = _disk->ready(useFlexibleLock, [this](wbase::Task::Ptr const& task) {
+            return _underShare(task);
+        });
+    // Keep the files of the last Task locked until the lock for the next
+    // Task is settled, as they are likely to be needed again.
+    if (_memManHandleToUnlock != memman::MemMan::HandleType::INVALID && !_disk->lockPending()) {
         _memMan->unlock(_memManHandleToUnlock);
         _memManHandleToUnlock = memman::MemMan::HandleType::INVALID;
     }
@@ -143,13 +153,82 @@ util::Command::Ptr ScanScheduler::getCmd(bool wait)  {
         return nullptr;
     }
     bool useFlexibleLock = (_inFlight < 1);
-    auto task = _disk->getTask(useFlexibleLock);
-    ++_inFlight; // in flight as soon as it is off the queue.
-    _infoChanged = true;
+    auto task = _disk->getTask(useFlexibleLock, [this](wbase::Task::Ptr const& task) {
+            return _underShare(task);
+        });
+    if (task != nullptr) {
+        ++_inFlight; // in flight as soon as it is off the queue.
+        _infoChanged = true;
+        QueryTasks& query = _queries[task->getQueryId()];
+        --query.queued;
+        ++query.inFlight;
+        _taskDequeued(*task);
+    }
     return task;
 }
 
 
+/// Precondition: _mx is locked
+/// @return true if the query of task has fewer Tasks in flight than its share.
+bool ScanScheduler::_underShare(wbase::Task::Ptr const& task) {
+    if (_querySharePercent >= 100) {
+        return true;
+    }
+    int const share = std::max(1, maxInFlight()*_querySharePercent/100);
+    auto query = _queries.find(task->getQueryId());
+    return query == _queries.end() || query->second.inFlight < share;
+}
+
+
+void ScanScheduler::setQueryShare(int sharePercent) {
+    std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
+    _querySharePercent = sharePercent;
+}
+
+
+void ScanScheduler::setMaxWait(int maxWaitSec) {
+    _disk->setMaxWait(maxWaitSec);
+}
+
+
+void ScanScheduler::setClock(std::function<time_t()> const& clock) {
+    _disk->setClock(clock);
+}
+
+
+void ScanScheduler::setMemLocker(std::shared_ptr<MemLocker> const& memLocker) {
+    _disk->setMemLocker(memLocker, [this]() { _memLocked(); });
+}
+
+
+void ScanScheduler::setPrefetch(int prefetchChunks) {
+    _disk->setPrefetch(prefetchChunks);
+}
+
+
+/// Called on a MemLocker thread when memory was locked for a Task,
+/// which may be ready to run now.
+void ScanScheduler::_memLocked() {
+    BlendScheduler* blend;
+    {
+        std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
+        _infoChanged = true;
+        blend = _blendScheduler;
+    }
+    util::CommandQueue::_cv.notify_one();
+    if (blend != nullptr) {
+        blend->notifyReady();
+    }
+}
+
+
+ScanScheduler::QueryTasks ScanScheduler::getQueryTasks(qmeta::QueryId queryId) const {
+    std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
+    auto query = _queries.find(queryId);
+    return query == _queries.end() ? QueryTasks() : query->second;
+}
+
+
 void ScanScheduler::queCmd(util::Command::Ptr const& cmd) {
     wbase::Task::Ptr t = std::dynamic_pointer_cast<wbase::Task>(cmd);
     if (t == nullptr) {
@@ -158,9 +237,11 @@ void ScanScheduler::queCmd(util::Command::Ptr const& cmd) {
     }
     std::lock_guard<std::mutex> lock(util::CommandQueue::_mx);
     LOGS(_log, LOG_LVL_DEBUG, getName() << " queCmd " << t->getIdStr());
+    _taskQueued(*t);
+    ++_queries[t->getQueryId()].queued;
     _disk->enqueue(t);
     _infoChanged = true;
-    util::CommandQueue::_cv.notify_all();
+    util::CommandQueue::_cv.notify_one();
 }
 
 }}} // namespace lsst::qserv::wsched
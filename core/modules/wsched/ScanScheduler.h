@@ -24,8 +24,11 @@
 #define LSST_QSERV_WSCHED_SCANSCHEDULER_H
 
 // System headers
-#include<atomic>
+#include <atomic>
+#include <ctime>
+#include <functional>
 #include <mutex>
+#include <unordered_map>
 
 // Qserv headers
 #include "memman/MemMan.h"
@@ -37,6 +40,7 @@ namespace qserv {
 namespace wsched {
     class BlendScheduler;
     class ChunkDisk;
+    class MemLocker;
 }}} // End of forward declarations
 
 
@@ -54,6 +58,11 @@ namespace wsched {
 //  wrapping back to the lowest chunk at the end.
 ///
 /// It only advances to the next chunk if system resources are available.
+///
+/// So that one large query does not hold back the others, a query may only
+/// have a share of the threads of the scheduler in flight while Tasks of
+/// other queries are waiting, and Tasks deferred to the next pass over the
+/// chunks for too long are brought into the current one (see ChunkDisk).
 class ScanScheduler : public SchedulerBase {
 public:
     typedef std::shared_ptr<ScanScheduler> Ptr;
@@ -74,14 +83,39 @@ public:
     void commandFinish(util::Command::Ptr const& cmd) override;
     bool isRatingInRange(int rating) { return _minRating <= rating && rating <= _maxRating; }
 
+    /// Let a query have at most sharePercent of maxInFlight() Tasks in
+    /// flight, at least one, unless no other query has Tasks waiting.
+    void setQueryShare(int sharePercent);
+    /// See ChunkDisk::setMaxWait()
+    void setMaxWait(int maxWaitSec);
+    /// See ChunkDisk::setClock()
+    void setClock(std::function<time_t()> const& clock);
+    /// Lock memory for Tasks on memLocker's threads, see ChunkDisk::setMemLocker()
+    void setMemLocker(std::shared_ptr<MemLocker> const& memLocker);
+    /// See ChunkDisk::setPrefetch()
+    void setPrefetch(int prefetchChunks);
+
+    /// Tasks of one query
+    struct QueryTasks {
+        int inFlight{0};
+        int queued{0};
+    };
+    /// @return the Tasks of queryId in this scheduler
+    QueryTasks getQueryTasks(qmeta::QueryId queryId) const;
+
     // SchedulerBase overrides
     bool ready() override;
     std::size_t getSize() const override ;
 
 private:
     bool _ready();
+    bool _underShare(wbase::Task::Ptr const& task);
+    void _memLocked();
     std::shared_ptr<ChunkDisk> _disk; //< Constrains access to files.
 
+    std::unordered_map<qmeta::QueryId, QueryTasks> _queries; ///< Queries with Tasks here
+    int _querySharePercent{100};
+
     memman::MemMan::Ptr _memMan; //< Limits queries when resources not available.
     memman::MemMan::Handle _memManHandleToUnlock{memman::MemMan::HandleType::INVALID};
 
@@ -24,6 +24,7 @@
 #include "wsched/SchedulerBase.h"
 
 // System headers
+#include <chrono>
 
 // LSST headers
 #include "lsst/log/Log.h"
@@ -65,4 +66,21 @@ void SchedulerBase::setPriorityDefault() {
 }
 
 
+/// Note the time task is queued at.
+void SchedulerBase::_taskQueued(wbase::Task& task) {
+    task.queuedTime = std::chrono::steady_clock::now();
+}
+
+
+/// Record how long task waited in the queue, logging the histogram of
+/// waits every so often.
+void SchedulerBase::_taskDequeued(wbase::Task& task) {
+    std::chrono::duration<double> wait = std::chrono::steady_clock::now() - task.queuedTime;
+    _waitHist.addEntry(wait.count());
+    if (_waitHist.getTotalCount() % 1000 == 0) {
+        LOGS(_log, LOG_LVL_INFO, _waitHist.getString());
+    }
+}
+
+
 }}} // namespace lsst::qserv::wsched
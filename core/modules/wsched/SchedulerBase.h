@@ -28,6 +28,7 @@
 // System headers
 
 // Qserv headers
+#include "util/Histogram.h"
 #include "wcontrol/Foreman.h"
 
 
@@ -48,7 +49,8 @@ public:
     SchedulerBase(std::string const& name, int maxThreads, int maxReserve, int priority) :
         _name{name}, _maxReserve{maxReserve}, _maxReserveDefault{maxReserve},
         _maxThreads{maxThreads}, _maxThreadsAdj{maxThreads},
-        _priority{priority}, _priorityDefault{priority}, _priorityNext{priority} {}
+        _priority{priority}, _priorityDefault{priority}, _priorityNext{priority},
+        _waitHist{name + " queue wait sec", {0.01, 0.1, 1, 10, 60, 300, 1800}} {}
     virtual ~SchedulerBase() {}
     SchedulerBase(SchedulerBase const&) = delete;
     SchedulerBase& operator=(SchedulerBase const&) = delete;
@@ -92,7 +94,13 @@ public:
     /// Return maximum number of Tasks this scheduler can have inFlight.
     virtual int maxInFlight() { return std::min(_maxThreads, _maxThreadsAdj); }
 
+    /// @return the time Tasks spent queued in this scheduler
+    util::Histogram const& getWaitHistogram() const { return _waitHist; }
+
 protected:
+    void _taskQueued(wbase::Task& task);
+    void _taskDequeued(wbase::Task& task);
+
     std::string const _name{}; //< Name of this scheduler.
     int _maxReserve{1};    //< Number of threads this scheduler would like to have reserved for its use.
     int _maxReserveDefault{1};
@@ -105,6 +113,8 @@ protected:
     int _priorityNext; ///< Priority to use starting with the next chunk.
 
     std::atomic<int> _inFlight{0}; //< Number of Tasks running.
+
+    util::Histogram _waitHist; ///< Seconds Tasks were queued
 };
 
 }}} // namespace lsst::qserv::wsched
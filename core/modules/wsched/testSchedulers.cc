@@ -27,6 +27,13 @@
   * @author Daniel L. Wang, SLAC
   */
 
+// System headers
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 // Third-party headers
 
 // Qserv headers
@@ -38,6 +45,7 @@
 #include "wsched/BlendScheduler.h"
 #include "wsched/FifoScheduler.h"
 #include "wsched/GroupScheduler.h"
+#include "wsched/MemLocker.h"
 #include "wsched/ScanScheduler.h"
 
 // Boost unit test header
@@ -223,6 +231,52 @@ BOOST_AUTO_TEST_CASE(GroupMaxThread) {
     BOOST_CHECK(gs.ready() == false);
 }
 
+BOOST_AUTO_TEST_CASE(GroupFill) {
+    // Queue Tasks over a few chunks, then drain them, checking that every
+    // group but the last of a chunk is full. testSchedulersBench times this
+    // for many more Tasks.
+    int const maxGroupSize = 10;
+    int const chunks = 5;
+    int const taskCount = 205;
+    wsched::GroupScheduler gs{"GroupSchedFill", 1, 0, maxGroupSize, 0};
+    for (int i = 0; i < taskCount; ++i) {
+        gs.queCmd(makeTask(newTaskMsgSimple(i % chunks)));
+    }
+    int const groupsPerChunk = (taskCount/chunks + maxGroupSize - 1)/maxGroupSize;
+    BOOST_CHECK_EQUAL(gs.getSize(), static_cast<std::size_t>(chunks*groupsPerChunk));
+
+    int count = 0;
+    int groupChunk = -1;
+    int groupLength = 0;
+    for (auto cmd = gs.getCmd(false); cmd != nullptr; cmd = gs.getCmd(false)) {
+        auto task = std::static_pointer_cast<Task>(cmd);
+        if (task->msg->chunkid() != groupChunk) {
+            if (groupChunk >= 0 && count <= chunks*(groupsPerChunk - 1)*maxGroupSize) {
+                BOOST_CHECK_EQUAL(groupLength, maxGroupSize);
+            }
+            groupChunk = task->msg->chunkid();
+            groupLength = 0;
+        }
+        ++groupLength;
+        ++count;
+        gs.commandFinish(cmd);
+    }
+    BOOST_CHECK_EQUAL(count, taskCount);
+    BOOST_CHECK(gs.empty());
+
+    // Once its group is gone, a chunk starts a new one at the back.
+    auto a1 = queMsgWithChunkId(gs, 1);
+    auto b1 = queMsgWithChunkId(gs, 2);
+    auto cmd = gs.getCmd(false);
+    BOOST_CHECK(cmd.get() == a1.get());
+    gs.commandFinish(cmd);
+    auto a2 = queMsgWithChunkId(gs, 1);
+    cmd = gs.getCmd(false);
+    BOOST_CHECK(cmd.get() == b1.get());
+    gs.commandFinish(cmd);
+    BOOST_CHECK(gs.getCmd(false).get() == a2.get());
+}
+
 BOOST_AUTO_TEST_CASE(DiskMinHeap) {
     wsched::ChunkDisk::MinHeap minHeap{};
 
@@ -328,6 +382,133 @@ BOOST_AUTO_TEST_CASE(ChunkDiskMemManNoneTest) {
 }
 
 
+BOOST_AUTO_TEST_CASE(ChunkDiskMemLocker) {
+    // Memory is locked on a MemLocker thread, the Task waits for it meanwhile.
+    auto memMan = std::make_shared<lsst::qserv::memman::MemManNone>(1, false);
+    auto memLocker = std::make_shared<wsched::MemLocker>(memMan, 1);
+    wsched::ChunkDisk cDisk(memMan);
+    std::mutex mtx;
+    std::condition_variable cv;
+    int lockedCount = 0;
+    cDisk.setMemLocker(memLocker, [&mtx, &cv, &lockedCount]() {
+            std::lock_guard<std::mutex> lock(mtx);
+            ++lockedCount;
+            cv.notify_all();
+        });
+    auto waitLocked = [&mtx, &cv, &lockedCount](int count) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&lockedCount, count]() { return lockedCount >= count; });
+    };
+
+    Task::Ptr a47 = makeTask(newTaskMsgScan(47, 0));
+    cDisk.enqueue(a47);
+    BOOST_CHECK(cDisk.ready(true) == false);
+    BOOST_CHECK(cDisk.lockPending() == true);
+    waitLocked(1);
+    BOOST_CHECK(cDisk.ready(true) == true);
+    BOOST_CHECK(cDisk.lockPending() == false);
+    auto aa47 = cDisk.getTask(true);
+    BOOST_CHECK(aa47.get() == a47.get());
+    BOOST_CHECK(aa47->hasMemHandle());
+
+    // MemManNone refuses locks that are not flexible. The failure is seen
+    // once, and the lock is requested again the next time.
+    Task::Ptr a48 = makeTask(newTaskMsgScan(48, 0));
+    cDisk.enqueue(a48);
+    BOOST_CHECK(cDisk.ready(false) == false);
+    waitLocked(2);
+    BOOST_CHECK(cDisk.ready(false) == false);
+    BOOST_CHECK(cDisk.lockPending() == false);
+    BOOST_CHECK(cDisk.ready(true) == false);
+    waitLocked(3);
+    auto aa48 = cDisk.getTask(true);
+    BOOST_CHECK(aa48.get() == a48.get());
+    BOOST_CHECK(cDisk.empty() == true);
+
+    // A ScanScheduler thread waiting for a Task is woken when its memory is locked.
+    wsched::ScanScheduler sched{"ScanSchedL", 2, 1, 0, memMan, 0, 100};
+    sched.setMemLocker(memLocker);
+    Task::Ptr a50 = makeTask(newTaskMsgScan(50, 0));
+    sched.queCmd(a50);
+    auto aa50 = sched.getCmd(true);
+    BOOST_CHECK(aa50.get() == a50.get());
+    sched.commandFinish(aa50);
+}
+
+
+BOOST_AUTO_TEST_CASE(ScanMemLockerShare) {
+    // The Task memory was locked for in the background is the one handed out,
+    // even if the query share filter prefers another Task once it is locked.
+    auto memMan = std::make_shared<lsst::qserv::memman::MemManNone>(1, true);
+    auto memLocker = std::make_shared<wsched::MemLocker>(memMan, 1);
+    wsched::ScanScheduler sched{"ScanSchedLShare", 2, 1, 0, memMan, 0, 100};
+    sched.setMemLocker(memLocker);
+    sched.setQueryShare(50);
+    auto newQueryTask = [this](int queryId, int chunkId) {
+        auto msg = newTaskMsgScan(chunkId, 0);
+        msg->set_queryid(queryId);
+        return makeTask(msg);
+    };
+    Task::Ptr big10 = newQueryTask(1, 10);
+    Task::Ptr big11 = newQueryTask(1, 11);
+    sched.queCmd(big10);
+    sched.queCmd(big11);
+    auto cmd10 = sched.getCmd(true);
+    BOOST_CHECK(cmd10.get() == big10.get());
+    // No other query waits, so memory is locked for big11 though query 1 is at
+    // its share. A Task of another query arrives meanwhile.
+    BOOST_CHECK(sched.getCmd(false) == nullptr);
+    BOOST_CHECK_EQUAL(sched.getInFlight(), 1);
+    Task::Ptr small = newQueryTask(2, 20);
+    sched.queCmd(small);
+    auto cmd11 = sched.getCmd(true);
+    BOOST_CHECK(cmd11.get() == big11.get());
+    BOOST_CHECK_EQUAL(sched.getInFlight(), 2);
+    sched.commandFinish(cmd10);
+    sched.commandFinish(cmd11);
+    BOOST_CHECK_EQUAL(sched.getInFlight(), 0);
+    auto cmd20 = sched.getCmd(true);
+    BOOST_CHECK(cmd20.get() == small.get());
+    sched.commandFinish(cmd20);
+    BOOST_CHECK_EQUAL(sched.getInFlight(), 0);
+    BOOST_CHECK_EQUAL(sched.getSize(), 0U);
+}
+
+
+BOOST_AUTO_TEST_CASE(ChunkDiskPrefetch) {
+    // Records the chunks prefetched.
+    struct MemManPrefetch : public lsst::qserv::memman::MemManNone {
+        MemManPrefetch() : MemManNone(1, false) {}
+        uint64_t prefetch(std::vector<lsst::qserv::memman::TableInfo> const& tables, int chunk) override {
+            BOOST_CHECK_EQUAL(tables.size(), 1U);
+            chunks.push_back(chunk);
+            return 0;
+        }
+        std::vector<int> chunks;
+    };
+    auto memMan = std::make_shared<MemManPrefetch>();
+    wsched::ChunkDisk cDisk(memMan);
+    cDisk.setPrefetch(2);
+    std::vector<Task::Ptr> tasks;
+    for (int chunkId : {10, 11, 11, 12, 13}) {
+        tasks.push_back(makeTask(newTaskMsgScan(chunkId, 0)));
+        cDisk.enqueue(tasks.back());
+    }
+    // Locking chunk 10 prefetches the next two.
+    BOOST_CHECK(cDisk.getTask(true).get() == tasks[0].get());
+    BOOST_CHECK((memMan->chunks == std::vector<int>{11, 12}));
+    // Chunk 11 is only followed once.
+    BOOST_CHECK_EQUAL(cDisk.getTask(true)->getChunkId(), 11);
+    BOOST_CHECK_EQUAL(cDisk.getTask(true)->getChunkId(), 11);
+    BOOST_CHECK((memMan->chunks == std::vector<int>{11, 12, 12, 13}));
+    // Chunks of the next pass follow the last ones of this pass.
+    Task::Ptr a5 = makeTask(newTaskMsgScan(5, 0));
+    cDisk.enqueue(a5);
+    BOOST_CHECK(cDisk.getTask(true).get() == tasks[3].get());
+    BOOST_CHECK((memMan->chunks == std::vector<int>{11, 12, 12, 13, 13, 5}));
+}
+
+
 BOOST_AUTO_TEST_CASE(ScanScheduleTest) {
     auto memMan = std::make_shared<lsst::qserv::memman::MemManNone>(1, false);
     wsched::ScanScheduler sched{"ScanSchedA", 2, 1, 0, memMan, 0, 100};
@@ -388,6 +569,110 @@ BOOST_AUTO_TEST_CASE(ScanScheduleTest) {
 }
 
 
+BOOST_AUTO_TEST_CASE(ScanQueryShare) {
+    // A query may use half of the 4 threads while another one has Tasks waiting.
+    auto memMan = std::make_shared<lsst::qserv::memman::MemManNone>(1, false);
+    wsched::ScanScheduler sched{"ScanSchedShare", 4, 1, 0, memMan, 0, 100};
+    sched.setQueryShare(50);
+    auto newQueryTask = [this](int queryId, int chunkId) {
+        auto msg = newTaskMsg(chunkId);
+        msg->set_queryid(queryId);
+        return makeTask(msg);
+    };
+    std::vector<Task::Ptr> big;
+    for (int chunkId = 10; chunkId < 14; ++chunkId) {
+        big.push_back(newQueryTask(1, chunkId));
+        sched.queCmd(big.back());
+    }
+    Task::Ptr small = newQueryTask(2, 20);
+    sched.queCmd(small);
+    BOOST_CHECK_EQUAL(sched.getQueryTasks(1).queued, 4);
+
+    BOOST_CHECK(sched.getCmd(false).get() == big[0].get());
+    BOOST_CHECK(sched.getCmd(false).get() == big[1].get());
+    // Query 1 is at its share, the Task of query 2 goes first.
+    BOOST_CHECK(sched.getCmd(false).get() == small.get());
+    // No other query is waiting anymore.
+    BOOST_CHECK(sched.getCmd(false).get() == big[2].get());
+    BOOST_CHECK_EQUAL(sched.getQueryTasks(1).inFlight, 3);
+    BOOST_CHECK_EQUAL(sched.getQueryTasks(1).queued, 1);
+    sched.commandFinish(small);
+    BOOST_CHECK_EQUAL(sched.getQueryTasks(2).inFlight, 0);
+    BOOST_CHECK_EQUAL(sched.getWaitHistogram().getTotalCount(), 4U);
+}
+
+
+BOOST_AUTO_TEST_CASE(ScanShareKeepsTop) {
+    // A Task the query share filter picks on a higher chunk does not move the
+    // scan past the lower chunks still queued; a Task arriving for one of them
+    // joins the current pass.
+    auto memMan = std::make_shared<lsst::qserv::memman::MemManNone>(1, false);
+    wsched::ScanScheduler sched{"ScanSchedTop", 4, 1, 0, memMan, 0, 100};
+    sched.setQueryShare(50);
+    auto newQueryTask = [this](int queryId, int chunkId) {
+        auto msg = newTaskMsg(chunkId);
+        msg->set_queryid(queryId);
+        return makeTask(msg);
+    };
+    std::vector<Task::Ptr> big;
+    for (int chunkId = 10; chunkId < 14; ++chunkId) {
+        big.push_back(newQueryTask(1, chunkId));
+        sched.queCmd(big.back());
+    }
+    Task::Ptr small = newQueryTask(2, 20);
+    sched.queCmd(small);
+    BOOST_CHECK(sched.getCmd(false).get() == big[0].get());
+    BOOST_CHECK(sched.getCmd(false).get() == big[1].get());
+    auto cmd = sched.getCmd(false);
+    BOOST_CHECK(cmd.get() == small.get());
+    sched.commandFinish(cmd);
+
+    Task::Ptr late12 = newQueryTask(1, 12);
+    sched.queCmd(late12);
+    auto cmdA = sched.getCmd(false);
+    auto cmdB = sched.getCmd(false);
+    BOOST_CHECK(cmdA.get() == big[2].get() || cmdA.get() == late12.get());
+    BOOST_CHECK(cmdB.get() == big[2].get() || cmdB.get() == late12.get());
+    BOOST_CHECK(cmdA.get() != cmdB.get());
+}
+
+
+BOOST_AUTO_TEST_CASE(ScanAging) {
+    // A Task deferred to the next pass over the chunks is brought into the
+    // current one once it has waited too long.
+    auto memMan = std::make_shared<lsst::qserv::memman::MemManNone>(1, false);
+    wsched::ScanScheduler sched{"ScanSchedAging", 1, 1, 0, memMan, 0, 100};
+    sched.setMaxWait(1);
+    time_t now = time(nullptr);
+    sched.setClock([&now]() { return now; });
+    Task::Ptr a50 = makeTask(newTaskMsg(50));
+    sched.queCmd(a50);
+    auto cmd = sched.getCmd(false);
+    BOOST_CHECK(cmd.get() == a50.get());
+    Task::Ptr a5 = makeTask(newTaskMsg(5)); // goes on pending
+    Task::Ptr b5 = makeTask(newTaskMsg(5));
+    sched.queCmd(a5);
+    Task::Ptr a60 = makeTask(newTaskMsg(60));
+    sched.queCmd(a60);
+    sched.commandFinish(cmd);
+    cmd = sched.getCmd(false);
+    BOOST_CHECK(cmd.get() == a60.get());
+    sched.commandFinish(cmd);
+    Task::Ptr a70 = makeTask(newTaskMsg(70));
+    sched.queCmd(a70);
+    sched.queCmd(b5);
+    now += 2;
+    // Both Tasks on chunk 5 come before a70, together.
+    cmd = sched.getCmd(false);
+    BOOST_CHECK(cmd.get() == a5.get() || cmd.get() == b5.get());
+    sched.commandFinish(cmd);
+    cmd = sched.getCmd(false);
+    BOOST_CHECK(cmd.get() == a5.get() || cmd.get() == b5.get());
+    sched.commandFinish(cmd);
+    BOOST_CHECK(sched.getCmd(false).get() == a70.get());
+}
+
+
 BOOST_AUTO_TEST_CASE(BlendScheduleTest) {
     // Test that space is appropriately reserved for each scheduler as Tasks are started and finished.
     // In this case, memMan->lock(..) always returns true (really HandleType::ISEMPTY).
@@ -412,12 +697,15 @@ BOOST_AUTO_TEST_CASE(BlendScheduleTest) {
 
     BOOST_CHECK(blend->ready() == false);
     BOOST_CHECK(blend->calcAvailableTheads() == 5);
+    // Idle threads can be lent to a Task while nothing is queued.
+    BOOST_CHECK_EQUAL(blend->getTaskParallelism(), 6);
 
     // Put one message on each scheduler except ScanFast, which gets 2.
     Task::Ptr g1 = makeTask(newTaskMsgSimple(40));
     blend->queCmd(g1);
     BOOST_CHECK(group->getSize() == 1);
     BOOST_CHECK(blend->ready() == true);
+    BOOST_CHECK_EQUAL(blend->getTaskParallelism(), 1);
 
     auto taskMsg = newTaskMsgScan(27, lsst::qserv::proto::ScanInfo::Rating::FAST);
     Task::Ptr sF1 = makeTask(taskMsg);
@@ -466,6 +754,7 @@ BOOST_AUTO_TEST_CASE(BlendScheduleTest) {
     BOOST_CHECK(blend->calcAvailableTheads() == 0);
     BOOST_CHECK(blend->getSize() == 0);
     BOOST_CHECK(blend->ready() == false);
+    BOOST_CHECK_EQUAL(blend->getTaskParallelism(), 1);
 
     // All threads should now be in use or reserved, should be able to start one
     // Task for each scheduler but second Task should remain on queue.
@@ -658,10 +947,100 @@ BOOST_AUTO_TEST_CASE(BlendScheduleTest) {
         groupTasks.push_back(task);
     }
     // Finish all the groupTasks, groupTasks[1] is already finished.
-    for (int j=1; j<7; ++j) blend->commandFinish(groupTasks[j]);
+    for (int j=0; j<7; ++j) {
+        if (j != 1) blend->commandFinish(groupTasks[j]);
+    }
     BOOST_CHECK(blend->getInFlight() == 0);
     BOOST_CHECK(blend->ready() == false);
 }
 
+BOOST_AUTO_TEST_CASE(BlendSendBudget) {
+    // No Task should start while result data waiting for czars fills the send budget.
+    int const fastest = lsst::qserv::proto::ScanInfo::Rating::FASTEST;
+    int const fast    = lsst::qserv::proto::ScanInfo::Rating::FAST;
+    int maxThreads = 9;
+    auto memMan = std::make_shared<lsst::qserv::memman::MemManNone>(1, true);
+    auto group = std::make_shared<wsched::GroupScheduler>("GroupSched", maxThreads, 2, 3, 1);
+    auto scanFast = std::make_shared<wsched::ScanScheduler>(
+        "ScanFast", maxThreads, 2, 2, memMan, fastest, fast);
+    std::vector<wsched::ScanScheduler::Ptr> scanSchedulers{scanFast};
+    auto blend = std::make_shared<wsched::BlendScheduler>("blendSched", maxThreads, group, scanSchedulers);
+    auto budget = std::make_shared<lsst::qserv::wbase::SendBudget>(1000);
+    blend->setSendBudget(budget);
+
+    budget->acquire(600, [](){ return false; });
+    Task::Ptr g1 = makeTask(newTaskMsgSimple(40));
+    blend->queCmd(g1);
+    BOOST_CHECK(blend->ready() == true);
+    budget->acquire(400, [](){ return false; });
+    BOOST_CHECK(budget->isFull());
+    BOOST_CHECK(blend->ready() == false);
+    BOOST_CHECK(blend->getCmd(false) == nullptr);
+    BOOST_CHECK_EQUAL(blend->getTaskParallelism(), 1);
+
+    // A full budget only lets exempt senders through.
+    budget->acquire(100, [](){ return true; });
+    BOOST_CHECK_EQUAL(budget->getQueuedBytes(), 1100U);
+
+    budget->release(500);
+    BOOST_CHECK(!budget->isFull());
+    BOOST_CHECK(blend->ready() == true);
+    auto og1 = blend->getCmd(false);
+    BOOST_CHECK(og1.get() == g1.get());
+    blend->commandFinish(og1);
+}
+
+BOOST_AUTO_TEST_CASE(BlendDispatchAll) {
+    // Run trivial interactive Tasks through a BlendScheduler from a small pool,
+    // as in EventThread::handleCmds(), and check that all of them are dispatched
+    // and accounted for. testSchedulersBench times this for larger pools.
+    int const fastest = lsst::qserv::proto::ScanInfo::Rating::FASTEST;
+    int const fast    = lsst::qserv::proto::ScanInfo::Rating::FAST;
+    int const taskCount = 1000;
+    int const threadCount = 4;
+    int maxThreads = std::max(threadCount, wsched::BlendScheduler::getMinPoolSize());
+    auto memMan = std::make_shared<lsst::qserv::memman::MemManNone>(1, true);
+    auto group = std::make_shared<wsched::GroupScheduler>("GroupSched", maxThreads, 2, 3, 1);
+    auto scanFast = std::make_shared<wsched::ScanScheduler>(
+        "ScanFast", maxThreads, 2, 2, memMan, fastest, fast);
+    std::vector<wsched::ScanScheduler::Ptr> scanSchedulers{scanFast};
+    auto blend = std::make_shared<wsched::BlendScheduler>("blendSched", maxThreads, group, scanSchedulers);
+
+    std::atomic<int> done{0};
+    auto runPoolThread = [&blend]() {
+        for (bool loop = true; loop;) {
+            auto cmd = blend->getCmd(true);
+            if (cmd == nullptr) continue;
+            auto task = std::static_pointer_cast<Task>(cmd);
+            blend->commandStart(cmd);
+            cmd->action(nullptr);
+            blend->commandFinish(cmd);
+            loop = (task->msg->db() != "stop");
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int j = 0; j < threadCount; ++j) {
+        pool.emplace_back(runPoolThread);
+    }
+    for (int j = 0; j < taskCount; ++j) {
+        auto task = makeTask(newTaskMsgSimple(j % 100));
+        task->setFunc([&done](lsst::qserv::util::CmdData*) { ++done; });
+        blend->queCmd(task);
+    }
+    while (done < taskCount) {
+        std::this_thread::yield();
+    }
+    for (int j = 0; j < threadCount; ++j) {
+        auto stopMsg = newTaskMsgSimple(j);
+        stopMsg->set_db("stop");
+        blend->queCmd(makeTask(stopMsg));
+    }
+    for (auto& thrd : pool) {
+        thrd.join();
+    }
+    BOOST_CHECK_EQUAL(done, taskCount);
+    BOOST_CHECK_EQUAL(blend->getSize(), 0U);
+    BOOST_CHECK_EQUAL(blend->getInFlight(), 0);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
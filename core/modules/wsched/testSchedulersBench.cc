@@ -0,0 +1,181 @@
+// -*- LSST-C++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2016 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+/**
+  * @file
+  *
+  * @brief Benchmark for dispatching Tasks through the worker schedulers.
+  *
+  * Queues many interactive Tasks over few chunks in a GroupScheduler and
+  * drains them, reporting the queCmd and getCmd rates. Then runs trivial
+  * interactive Tasks through a BlendScheduler from pools of several sizes,
+  * as the Foreman pool threads do, and reports the number of Tasks
+  * dispatched per second. Checks that every Task ran and that the schedulers
+  * are empty at the end. Timings are not meaningful as a unit test.
+  *
+  * Usage: testSchedulersBench [groupTasks [blendTasks]]
+  */
+
+// System headers
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Qserv headers
+#include "memman/MemManNone.h"
+#include "proto/ScanTableInfo.h"
+#include "proto/worker.pb.h"
+#include "wbase/Task.h"
+#include "wsched/BlendScheduler.h"
+#include "wsched/GroupScheduler.h"
+#include "wsched/ScanScheduler.h"
+
+namespace {
+
+namespace wsched = lsst::qserv::wsched;
+
+using lsst::qserv::proto::TaskMsg;
+using lsst::qserv::wbase::SendChannel;
+using lsst::qserv::wbase::Task;
+
+Task::Ptr makeTask(int chunkId, char const* db) {
+    auto taskMsg = std::make_shared<TaskMsg>();
+    taskMsg->set_session(123456);
+    taskMsg->set_chunkid(chunkId);
+    taskMsg->set_db(db);
+    return std::make_shared<Task>(taskMsg, std::shared_ptr<SendChannel>());
+}
+
+/// Queue taskCount Tasks over chunks chunks in a GroupScheduler, then drain
+/// it. @return true if every Task was returned and the scheduler left empty.
+bool groupQueueDrain(int chunks, int taskCount) {
+    int const maxGroupSize = 10;
+    wsched::GroupScheduler gs{"GroupSchedBench", 1, 0, maxGroupSize, 0};
+    std::vector<Task::Ptr> tasks;
+    tasks.reserve(taskCount);
+    for (int i = 0; i < taskCount; ++i) {
+        tasks.push_back(makeTask(i % chunks, "moose"));
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (auto const& t : tasks) {
+        gs.queCmd(t);
+    }
+    std::chrono::duration<double> queTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    int count = 0;
+    for (auto cmd = gs.getCmd(false); cmd != nullptr; cmd = gs.getCmd(false)) {
+        ++count;
+        gs.commandFinish(cmd);
+    }
+    std::chrono::duration<double> getTime = std::chrono::steady_clock::now() - start;
+    std::cout << "GroupScheduler " << taskCount << " tasks on " << chunks << " chunks: queCmd "
+              << taskCount/queTime.count() << "/s, getCmd " << taskCount/getTime.count() << "/s"
+              << std::endl;
+    bool ok = count == taskCount && gs.empty();
+    if (!ok) {
+        std::cout << "ERROR: got " << count << " of " << taskCount << " Tasks" << std::endl;
+    }
+    return ok;
+}
+
+/// Dispatch taskCount Tasks through a BlendScheduler from threadCount pool
+/// threads. @return true if every Task ran and the scheduler was left empty.
+bool blendDispatch(int threadCount, int taskCount) {
+    int const fastest = lsst::qserv::proto::ScanInfo::Rating::FASTEST;
+    int const fast    = lsst::qserv::proto::ScanInfo::Rating::FAST;
+    int maxThreads = std::max(threadCount, wsched::BlendScheduler::getMinPoolSize());
+    auto memMan = std::make_shared<lsst::qserv::memman::MemManNone>(1, true);
+    auto group = std::make_shared<wsched::GroupScheduler>("GroupSched", maxThreads, 2, 3, 1);
+    auto scanFast = std::make_shared<wsched::ScanScheduler>(
+        "ScanFast", maxThreads, 2, 2, memMan, fastest, fast);
+    std::vector<wsched::ScanScheduler::Ptr> scanSchedulers{scanFast};
+    auto blend = std::make_shared<wsched::BlendScheduler>("blendSched", maxThreads, group, scanSchedulers);
+
+    std::atomic<int> done{0};
+    std::vector<Task::Ptr> tasks;
+    tasks.reserve(taskCount);
+    for (int j = 0; j < taskCount; ++j) {
+        auto task = makeTask(j % 100, "moose");
+        task->setFunc([&done](lsst::qserv::util::CmdData*) { ++done; });
+        tasks.push_back(task);
+    }
+
+    // Each pool thread leaves after running one of these, as in EventThread::handleCmds().
+    auto runPoolThread = [&blend]() {
+        for (bool loop = true; loop;) {
+            auto cmd = blend->getCmd(true);
+            if (cmd == nullptr) continue;
+            auto task = std::static_pointer_cast<Task>(cmd);
+            blend->commandStart(cmd);
+            cmd->action(nullptr);
+            blend->commandFinish(cmd);
+            loop = (task->msg->db() != "stop");
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int j = 0; j < threadCount; ++j) {
+        pool.emplace_back(runPoolThread);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto const& task : tasks) {
+        blend->queCmd(task);
+    }
+    while (done < taskCount) {
+        std::this_thread::yield();
+    }
+    std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - start;
+    for (int j = 0; j < threadCount; ++j) {
+        blend->queCmd(makeTask(j, "stop"));
+    }
+    for (auto& thrd : pool) {
+        thrd.join();
+    }
+    std::cout << "BlendScheduler " << threadCount << " threads: "
+              << taskCount/runTime.count() << " dispatches/s" << std::endl;
+    bool ok = done == taskCount && blend->getSize() == 0 && blend->getInFlight() == 0;
+    if (!ok) {
+        std::cout << "ERROR: ran " << done << " of " << taskCount << " Tasks, "
+                  << blend->getSize() << " queued and "
+                  << blend->getInFlight() << " in flight" << std::endl;
+    }
+    return ok;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    int groupTasks = argc > 1 ? std::atoi(argv[1]) : 50000;
+    int blendTasks = argc > 2 ? std::atoi(argv[2]) : 20000;
+    int status = 0;
+    if (!groupQueueDrain(500, groupTasks)) status = 1;
+    for (int threadCount : {1, 4, 16, 48}) {
+        if (!blendDispatch(threadCount, blendTasks)) status = 1;
+    }
+    return status;
+}
@@ -44,13 +44,14 @@ namespace lsst {
 namespace qserv {
 namespace xrdsvc {
 
-/// SimpleBuffer is a really simple buffer for transferring data packets to
-/// XrdSsi
-class SimpleBuffer : public XrdSsiStream::Buffer, boost::noncopyable {
+/// PooledStreamBuffer lends the memory of a PooledBuffer to XrdSsi, which
+/// reads the data in place. The bytes stay counted in the worker SendBudget
+/// until XrdSsi recycles the buffer.
+class PooledStreamBuffer : public XrdSsiStream::Buffer, boost::noncopyable {
 public:
-    SimpleBuffer(std::string const& input) {
-        data = new char[input.size()];
-        memcpy(data, input.data(), input.size());
+    PooledStreamBuffer(util::PooledBuffer::Ptr buf, wbase::SendBudget::Ptr const& budget)
+        : _buf(std::move(buf)), _budget(budget) {
+        data = _buf->data();
         next = 0;
     }
 
@@ -63,9 +64,15 @@ public:
     // char  *data; //!> -> Buffer containing the data
     // Buffer *next; //!> For chaining by buffer receiver
 
-    virtual ~SimpleBuffer() {
-        delete[] data;
+    virtual ~PooledStreamBuffer() { // _buf goes back to the pool
+        if (_budget) {
+            _budget->release(_buf->size());
+        }
     }
+
+private:
+    util::PooledBuffer::Ptr _buf;
+    wbase::SendBudget::Ptr _budget;
 };
 
 ////////////////////////////////////////////////////////////////////////
@@ -73,9 +80,9 @@ public:
 ////////////////////////////////////////////////////////////////////////
 
 /// Constructor
-ChannelStream::ChannelStream()
+ChannelStream::ChannelStream(uint64_t maxQueuedBytes, wbase::SendBudget::Ptr const& budget)
     : XrdSsiStream(isActive),
-      _closed(false) {}
+      _closed(false), _maxQueuedBytes(maxQueuedBytes), _budget(budget) {}
 
 /// Destructor
 ChannelStream::~ChannelStream() {
@@ -86,21 +93,52 @@ ChannelStream::~ChannelStream() {
 #endif
 }
 
-/// Push in a data packet
-void
+/// Push in a data packet, copying it
+bool
 ChannelStream::append(char const* buf, int bufLen, bool last) {
+    return append(util::PooledBuffer::copyOf(buf, bufLen), last);
+}
+
+/// Push in a data packet, taking over its buffer
+bool
+ChannelStream::append(util::PooledBuffer::Ptr buf, bool last) {
+    if (_cancelled) {
+        return false;
+    }
     if (_closed) {
         throw Bug("ChannelStream::append: Stream closed, append(...,last=true) already received");
     }
-    LOGS(_log, LOG_LVL_DEBUG, "last=" << last << " " << util::prettyCharBuf(buf, bufLen, 10));
+    size_t const size = buf->size();
+    LOGS(_log, LOG_LVL_DEBUG, "last=" << last << " "
+         << util::prettyCharBuf(buf->data(), size, 10));
+    if (_maxQueuedBytes != 0) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!_msgs.empty() && _queuedBytes + size > _maxQueuedBytes) {
+            LOGS(_log, LOG_LVL_DEBUG, "Stream full, queued=" << _queuedBytes << ", waiting");
+            _hasSpaceCondition.wait(lock, [this, size]() {
+                    return _cancelled || _msgs.empty() || _queuedBytes + size <= _maxQueuedBytes; });
+        }
+    }
+    if (_budget) {
+        _budget->acquire(size, [this]() { return _cancelled || _queuedBytes == 0; });
+    }
     {
         std::unique_lock<std::mutex> lock(_mutex);
+        if (_cancelled) {
+            lock.unlock();
+            if (_budget) {
+                _budget->release(size);
+            }
+            return false;
+        }
         LOGS(_log, LOG_LVL_DEBUG, "Trying to append message (flowing)");
 
-        _msgs.push_back(std::string(buf, bufLen));
+        _msgs.push_back(std::move(buf));
+        _queuedBytes += size;
         _closed = last; // if last is true, then we are closed.
         _hasDataCondition.notify_one();
     }
+    return true;
 }
 
 /// Pull out a data packet as a Buffer object (called by XrdSsi code)
@@ -119,12 +157,36 @@ ChannelStream::GetBuff(XrdSsiErrInfo &eInfo, int &dlen, bool &last) {
         eInfo.Set("Not an active stream", EOPNOTSUPP);
         return 0;
     }
-    SimpleBuffer* sb = new SimpleBuffer(_msgs.front());
-    dlen = _msgs.front().size();
+    dlen = _msgs.front()->size();
+    PooledStreamBuffer* sb = new PooledStreamBuffer(std::move(_msgs.front()), _budget);
     _msgs.pop_front();
+    _queuedBytes -= dlen;
     last = _closed && _msgs.empty();
+    _hasSpaceCondition.notify_all();
+    if (_budget && _msgs.empty()) {
+        _budget->wake(); // A sender waiting on the budget is now exempt.
+    }
     LOGS(_log, LOG_LVL_DEBUG, "returning buffer (" << dlen << ", " << (last ? "(last)" : "(more)") << ")");
     return sb;
 }
 
+void
+ChannelStream::cancel() {
+    uint64_t dropped;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _cancelled = true;
+        _closed = true;
+        dropped = _queuedBytes;
+        _msgs.clear();
+        _queuedBytes = 0;
+    }
+    LOGS(_log, LOG_LVL_DEBUG, "Stream cancelled, dropped " << dropped << " bytes");
+    _hasDataCondition.notify_all();
+    _hasSpaceCondition.notify_all();
+    if (_budget) {
+        _budget->release(dropped); // Also wakes senders waiting on the budget.
+    }
+}
+
 }}} // lsst::qserv::xrdsvc
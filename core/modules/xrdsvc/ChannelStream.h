@@ -24,39 +24,66 @@
 #define LSST_QSERV_XRDSVC_CHANNELSTREAM_H
 
 // System headers
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <deque>
 #include <mutex>
-#include <string>
 
 // Third-party headers
 #include "XrdSsi/XrdSsiErrInfo.hh" // required by XrdSsiStream
 #include "XrdSsi/XrdSsiStream.hh"
 
+// Qserv headers
+#include "util/BufferPool.h"
+#include "wbase/SendBudget.h"
+
 namespace lsst {
 namespace qserv {
 namespace xrdsvc {
 /// ChannelStream is an implementation of an XrdSsiStream that accepts
 /// SendChannel streamed data.
+///
+/// The queue is bounded: append() blocks while the stream holds
+/// maxQueuedBytes or more, and while the worker-wide SendBudget is full.
+/// A message is always accepted when the stream's queue is empty, so a
+/// single message larger than the caps still goes through.
 class ChannelStream : public XrdSsiStream {
 public:
-    ChannelStream();
+    /// @param maxQueuedBytes cap on the bytes queued in this stream, 0 for none
+    /// @param budget worker-wide cap on queued bytes, may be nullptr
+    ChannelStream(uint64_t maxQueuedBytes=0, wbase::SendBudget::Ptr const& budget=nullptr);
     virtual ~ChannelStream();
 
-    /// Push in a data packet
-    void append(char const* buf, int bufLen, bool last);
+    /// Push in a data packet, copying it
+    /// @return false if the stream was cancelled
+    bool append(char const* buf, int bufLen, bool last);
+
+    /// Push in a data packet, taking over its buffer. The buffer is handed to
+    /// XrdSsi as is and goes back to its pool when XrdSsi recycles it.
+    /// @return false if the stream was cancelled
+    bool append(util::PooledBuffer::Ptr buf, bool last);
 
     /// Pull out a data packet as a Buffer object (called by XrdSsi code)
     virtual Buffer *GetBuff(XrdSsiErrInfo &eInfo, int &dlen, bool &last);
 
+    /// Drop queued data, close the stream, and release blocked append() calls.
+    /// Called once the client no longer reads the stream.
+    void cancel();
+
     bool closed() const { return _closed; }
+    uint64_t getQueuedBytes() const { return _queuedBytes; }
 
 private:
     bool _closed; ///< Closed to new append() calls?
-    // Can keep a deque of (buf, bufsize) to reduce copying, if needed.
-    std::deque<std::string> _msgs; ///< Message queue
+    std::atomic<bool> _cancelled{false};
+    uint64_t const _maxQueuedBytes;
+    wbase::SendBudget::Ptr const _budget;
+    std::atomic<uint64_t> _queuedBytes{0}; ///< Bytes in _msgs
+    std::deque<util::PooledBuffer::Ptr> _msgs; ///< Message queue
     std::mutex _mutex; ///< _msgs protection
     std::condition_variable _hasDataCondition; ///< _msgs condition
+    std::condition_variable _hasSpaceCondition; ///< _queuedBytes condition
 };
 
 }}} // namespace lsst::qserv::xrdsvc
@@ -26,6 +26,8 @@
 
 // System headers
 #include <cassert>
+#include <chrono>
+#include <exception>
 #include <iostream>
 #include <string>
 #include <stdlib.h>
@@ -43,13 +45,16 @@
 #include "memman/MemManNone.h"
 #include "sql/SqlConnection.h"
 #include "wbase/Base.h"
+#include "wbase/SendBudget.h"
 #include "wconfig/Config.h"
 #include "wconfig/ConfigError.h"
 #include "wcontrol/Foreman.h"
+#include "wdb/ResultCache.h"
 #include "wpublish/ChunkInventory.h"
 #include "wsched/BlendScheduler.h"
 #include "wsched/FifoScheduler.h"
 #include "wsched/GroupScheduler.h"
+#include "wsched/MemLocker.h"
 #include "wsched/ScanScheduler.h"
 #include "xrdsvc/SsiSession.h"
 #include "xrdsvc/XrdName.h"
@@ -150,20 +155,68 @@ SsiService::SsiService(XrdSsiLogger* log) {
                  "SchedFast", maxThread, maxReserveFast, priorityFast, memMan, fastest, fast)
     };
 
-    _foreman = wcontrol::Foreman::newForeman(
-        std::make_shared<wsched::BlendScheduler>("BlendSched", maxThread, group, scanSchedulers),
-        poolSize);
+    // Keep large queries from holding back the others in the scans.
+    auto queryShare = config.getInt("QSW_SCAN_QUERY_SHARE", 100);
+    auto maxWaitSec = config.getInt("QSW_SCAN_MAX_WAIT_SEC", 0);
+    LOGS(_log, LOG_LVL_DEBUG, "cfg scan queryShare=" << queryShare << "% maxWaitSec=" << maxWaitSec);
+    for (auto const& sched : scanSchedulers) {
+        sched->setQueryShare(queryShare);
+        sched->setMaxWait(maxWaitSec);
+    }
+
+    // Read chunk tables into memory without holding up the schedulers.
+    auto lockThreads = config.getInt("QSW_MEMMAN_LOCK_THREADS", 2);
+    auto prefetchChunks = config.getInt("QSW_MEMMAN_PREFETCH_CHUNKS", 1);
+    LOGS(_log, LOG_LVL_DEBUG, "cfg memMan lockThreads=" << lockThreads
+         << " prefetchChunks=" << prefetchChunks);
+    if (cfgMemMan == "MemManReal" && lockThreads > 0) {
+        auto memLocker = std::make_shared<wsched::MemLocker>(memMan, lockThreads);
+        for (auto const& sched : scanSchedulers) {
+            sched->setMemLocker(memLocker);
+        }
+    }
+    for (auto const& sched : scanSchedulers) {
+        sched->setPrefetch(prefetchChunks);
+    }
+
+    // Caps on result bytes waiting for czars to read them
+    _streamMaxBytes = config.getInt("QSW_STREAM_MAX_MB", 16)*1000000ULL;
+    _sendBudget = std::make_shared<wbase::SendBudget>(config.getInt("QSW_SEND_MAX_MB", 1000)*1000000ULL);
+    LOGS(_log, LOG_LVL_DEBUG, "cfg streamMaxBytes=" << _streamMaxBytes
+         << " sendMaxBytes=" << _sendBudget->getMaxBytes());
+
+    auto blend = std::make_shared<wsched::BlendScheduler>("BlendSched", maxThread, group, scanSchedulers);
+    blend->setSendBudget(_sendBudget);
+    _foreman = wcontrol::Foreman::newForeman(blend, poolSize);
+
+    // Cached results are only valid as long as their chunk tables are unchanged.
+    auto resultCache = _foreman->getResultCache();
+    if (resultCache) {
+        _chunkInventory->setChangeFunc([resultCache](std::string const& db, int chunk) {
+                resultCache->invalidate(db, chunk);
+            });
+        _startInventoryRefresh(config.getInt("QSW_INVENTORY_REFRESH_SEC", 60));
+    }
 }
 
 SsiService::~SsiService() {
     LOGS(_log, LOG_LVL_DEBUG, "SsiService dying.");
+    if (_refreshThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(_refreshMtx);
+            _stopRefresh = true;
+        }
+        _refreshCv.notify_all();
+        _refreshThread.join();
+    }
 }
 
 void SsiService::Provision(XrdSsiService::Resource* r,
                            unsigned short timeOut,
                            bool userConn) { // Step 2
     LOGS(_log, LOG_LVL_DEBUG, "Got provision call where rName is: " << r->rName);
-    XrdSsiSession* session = new SsiSession(r->rName, _chunkInventory->newValidator(), _foreman);
+    XrdSsiSession* session = new SsiSession(r->rName, _chunkInventory->newValidator(), _foreman,
+                                            _streamMaxBytes, _sendBudget);
     r->ProvisionDone(session); // Step 3: trigger client-side ProvisionDone()
 }
 
@@ -178,6 +231,32 @@ void SsiService::_initInventory() {
     LOGS(_log, LOG_LVL_DEBUG, os.str());
 }
 
+/// Reload the chunk inventory every 'seconds' seconds, so that changed chunk
+/// tables are noticed.
+void SsiService::_startInventoryRefresh(int seconds) {
+    if (seconds <= 0) {
+        LOGS(_log, LOG_LVL_WARN, "Chunk inventory refresh disabled, cached results "
+             "are kept whatever happens to their tables");
+        return;
+    }
+    _refreshThread = std::thread([this, seconds]() {
+        std::unique_lock<std::mutex> lock(_refreshMtx);
+        while (!_refreshCv.wait_for(lock, std::chrono::seconds(seconds),
+                                    [this]() { return _stopRefresh; })) {
+            lock.unlock();
+            try {
+                auto conn = makeSqlConnection();
+                if (conn) {
+                    _chunkInventory->refresh(*conn);
+                }
+            } catch (std::exception const& e) {
+                LOGS(_log, LOG_LVL_ERROR, "Chunk inventory refresh failed: " << e.what());
+            }
+            lock.lock();
+        }
+    });
+}
+
 void SsiService::_setupResultPath() {
     wbase::updateResultPath();
     wbase::clearResultPath();
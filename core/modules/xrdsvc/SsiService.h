@@ -25,7 +25,11 @@
 #define LSST_QSERV_XRDSVC_SSISERVICE_H
 
 // System headers
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 // Third-party headers
 #include "XrdSsi/XrdSsiService.hh"
@@ -35,6 +39,9 @@ class XrdSsiLogger;
 
 namespace lsst {
 namespace qserv {
+namespace wbase {
+  class SendBudget;
+}
 namespace wcontrol {
   class Foreman;
 }
@@ -64,12 +71,21 @@ public:
 
 private:
     void _initInventory();
+    void _startInventoryRefresh(int seconds);
     void _configure();
     void _setupResultPath();
     bool _setupScratchDb();
 
     std::shared_ptr<wpublish::ChunkInventory> _chunkInventory;
     std::shared_ptr<wcontrol::Foreman> _foreman;
+    std::shared_ptr<wbase::SendBudget> _sendBudget; ///< Caps queued result bytes
+    uint64_t _streamMaxBytes{0}; ///< Caps queued result bytes per stream
+
+    /// Reloads _chunkInventory periodically, invalidating cached results
+    std::thread _refreshThread;
+    std::mutex _refreshMtx;
+    std::condition_variable _refreshCv;
+    bool _stopRefresh{false}; ///< protected by _refreshMtx
 
 }; // class SsiService
 
@@ -40,6 +40,7 @@
 #include "global/ResourceUnit.h"
 #include "proto/worker.pb.h"
 #include "util/Timer.h"
+#include "wbase/MultiChunkChannel.h"
 #include "wbase/SendChannel.h"
 #include "xrdsvc/SsiSession_ReplyChannel.h"
 
@@ -72,6 +73,10 @@ void SsiSession::ProcessRequest(XrdSsiRequest* req, unsigned short timeout) {
     LOGS(_log, LOG_LVL_DEBUG, "GetRequest took " << t.getElapsed() << " seconds");
 
     auto replyChannel = std::make_shared<ReplyChannel>(*this);
+    {
+        std::lock_guard<std::mutex> lock(_tasksMutex);
+        _replyChannel = replyChannel;
+    }
 
     auto errorFunc = [this, &req, &replyChannel](std::string const& errStr) {
         replyChannel->sendError(errStr, EINVAL);
@@ -120,10 +125,41 @@ void SsiSession::ProcessRequest(XrdSsiRequest* req, unsigned short timeout) {
     }
 
     // Once BindRequest has been called, we don't want to send errors back to xrootd
-    // if the task has been cancelled. Also, task needs to exist before binding
+    // if the task has been cancelled. Also, tasks need to exist before binding
     // to avoid any chance of missing the cancel call.
-    auto task = std::make_shared<wbase::Task>(taskMsg, replyChannel);
-    _addTask(task);
+    std::vector<wbase::Task::Ptr> tasks;
+    std::vector<int> unownedChunks;
+    std::shared_ptr<wbase::MultiChunkChannel> multiChunkChannel;
+    if (taskMsg->chunkblock_size() == 0) {
+        tasks.push_back(std::make_shared<wbase::Task>(taskMsg, replyChannel));
+    } else {
+        // One Task per chunk, all sending through the request's stream.
+        multiChunkChannel = std::make_shared<wbase::MultiChunkChannel>(
+            replyChannel, taskMsg->chunkblock_size() + 1);
+        proto::TaskMsg chunkBase(*taskMsg);
+        chunkBase.clear_chunkblock();
+        chunkBase.clear_fragment();
+        for (auto const& block : taskMsg->chunkblock()) {
+            ResourceUnit chunkRu;
+            chunkRu.setAsDbChunk(ru.db(), block.chunkid());
+            if (!(*_validator)(chunkRu)) {
+                LOGS(_log, LOG_LVL_WARN, "unowned chunk in multi-chunk query:" << chunkRu.path());
+                unownedChunks.push_back(block.chunkid());
+                continue;
+            }
+            auto chunkMsg = std::make_shared<proto::TaskMsg>(chunkBase);
+            chunkMsg->set_chunkid(block.chunkid());
+            chunkMsg->mutable_fragment()->CopyFrom(block.fragment());
+            tasks.push_back(std::make_shared<wbase::Task>(
+                chunkMsg, multiChunkChannel->newChunkChannel(block.chunkid())));
+        }
+        taskMsg->clear_chunkblock();
+        tasks.insert(tasks.begin(), std::make_shared<wbase::Task>(
+            taskMsg, multiChunkChannel->newChunkChannel(taskMsg->chunkid())));
+    }
+    for (auto const& task : tasks) {
+        _addTask(task);
+    }
     t.start();
     BindRequest(req, this); // Step 5
     t.stop();
@@ -133,11 +169,17 @@ void SsiSession::ProcessRequest(XrdSsiRequest* req, unsigned short timeout) {
     // reference to this SsiSession inside the reply channel for the task,
     // and after the call to BindRequest.
     ReleaseRequestBuffer();
+    for (int chunkId : unownedChunks) {
+        multiChunkChannel->sendUnowned(chunkId);
+    }
     t.start();
-    _processor->processTask(task); // Queues task to be run later.
+    for (auto const& task : tasks) {
+        _processor->processTask(task); // Queues task to be run later.
+    }
     t.stop();
     LOGS(_log, LOG_LVL_DEBUG, "BindRequest took " << t.getElapsed() << " seconds");
-    LOGS(_log, LOG_LVL_DEBUG, "Enqueued TaskMsg for " << ru << " in " << t.getElapsed() << " seconds");
+    LOGS(_log, LOG_LVL_DEBUG, "Enqueued " << tasks.size() << " TaskMsg for " << ru
+         << " in " << t.getElapsed() << " seconds");
 }
 
 /// Called by XrdSsi to free resources.
@@ -151,6 +193,10 @@ void SsiSession::RequestFinished(XrdSsiRequest* req, XrdSsiRespInfo const& rinfo
             for (auto task: _tasks) {
                 task->cancel();
             }
+            // Release senders blocked on a full stream.
+            if (_replyChannel) {
+                _replyChannel->cancelStream();
+            }
         }
     }
     // No buffers allocated, so don't need to free.
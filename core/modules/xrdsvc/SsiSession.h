@@ -25,6 +25,7 @@
 
 // System headers
 #include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <vector>
 
@@ -34,6 +35,7 @@
 
 // Local headers
 #include "global/ResourceUnit.h"
+#include "wbase/SendBudget.h"
 #include "wbase/Task.h"
 
 // Forward declarations
@@ -59,9 +61,14 @@ public:
     typedef std::shared_ptr<ResourceUnit::Checker> ValidatorPtr;
 
     /// Construct a new session (called by SsiService)
-    SsiSession(char const* sname, ValidatorPtr validator, std::shared_ptr<wbase::MsgProcessor> processor)
+    /// @param streamMaxBytes cap on the result bytes queued in the session's
+    /// stream, 0 for none
+    /// @param sendBudget worker-wide cap on queued result bytes, may be nullptr
+    SsiSession(char const* sname, ValidatorPtr validator, std::shared_ptr<wbase::MsgProcessor> processor,
+               uint64_t streamMaxBytes=0, wbase::SendBudget::Ptr const& sendBudget=nullptr)
         : XrdSsiSession{strdup(sname), 0}, XrdSsiResponder{this, nullptr},
-          _validator{validator}, _processor{processor} {}
+          _validator{validator}, _processor{processor},
+          _streamMaxBytes{streamMaxBytes}, _sendBudget{sendBudget} {}
 
     virtual ~SsiSession();
 
@@ -78,10 +85,13 @@ private:
 
     ValidatorPtr _validator; ///< validates request against what's available
     std::shared_ptr<wbase::MsgProcessor> _processor; ///< actual msg processor
+    uint64_t const _streamMaxBytes; ///< Cap on bytes queued in the result stream
+    wbase::SendBudget::Ptr const _sendBudget; ///< Worker-wide cap on queued bytes
 
     /// List of Tasks.
     std::mutex _tasksMutex; ///< protects _tasks.
     std::vector<wbase::Task::Ptr> _tasks;
+    std::shared_ptr<ReplyChannel> _replyChannel; ///< protected by _tasksMutex
     std::atomic<bool> _cancelled{false}; ///< true if the session has been cancelled.
 
     friend class SsiProcessor; // Allow access for cancellation
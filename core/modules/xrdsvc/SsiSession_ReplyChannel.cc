@@ -87,20 +87,42 @@ SsiSession::ReplyChannel::sendStream(char const* buf, int bufLen, bool last) {
     // Initialize streaming object if not initialized.
     LOGS(_log, LOG_LVL_DEBUG, "sendStream, checking stream " << (void *) _stream
          << " len=" << bufLen << " last=" << last);
-    if (!_stream) {
-        _initStream();
-    } else if (_stream->closed()) {
-        return false;
-    }
-    _stream->append(buf, bufLen, last);
-    return true;
+    ChannelStream* stream = _prepareStream();
+    return stream && stream->append(buf, bufLen, last);
+}
+
+bool
+SsiSession::ReplyChannel::sendStream(util::PooledBuffer::Ptr buf, bool last) {
+    LOGS(_log, LOG_LVL_DEBUG, "sendStream, checking stream " << (void *) _stream
+         << " len=" << buf->size() << " last=" << last);
+    ChannelStream* stream = _prepareStream();
+    return stream && stream->append(std::move(buf), last);
 }
 
 void
-SsiSession::ReplyChannel::_initStream() {
+SsiSession::ReplyChannel::cancelStream() {
+    std::lock_guard<std::mutex> lock(_streamMtx);
+    _cancelled = true;
+    if (_stream) {
+        _stream->cancel();
+    }
+}
+
+/// Initialize the streaming object if not initialized.
+/// @return the stream, or nullptr if it was already closed or cancelled.
+ChannelStream*
+SsiSession::ReplyChannel::_prepareStream() {
+    std::lock_guard<std::mutex> lock(_streamMtx);
+    if (_cancelled) {
+        return nullptr;
+    }
+    if (_stream) {
+        return _stream->closed() ? nullptr : _stream;
+    }
     //_stream.reset(new Stream);
-    _stream = new ChannelStream();
+    _stream = new ChannelStream(_ssiSession._streamMaxBytes, _ssiSession._sendBudget);
     _ssiSession.SetResponse(_stream);
+    return _stream;
 }
 
 }}} // lsst::qserv::xrdsvc
@@ -23,6 +23,9 @@
 #ifndef LSST_QSERV_XRDSVC_SSISESSION_REPLYCHANNEL_H
 #define LSST_QSERV_XRDSVC_SSISESSION_REPLYCHANNEL_H
 
+// System headers
+#include <mutex>
+
 // Third-party headers
 #include "XrdSsi/XrdSsiResponder.hh"
 
@@ -51,12 +54,18 @@ public:
     virtual bool sendError(std::string const& msg, int code);
     virtual bool sendFile(int fd, Size fSize);
     virtual bool sendStream(char const* buf, int bufLen, bool last);
+    virtual bool sendStream(util::PooledBuffer::Ptr buf, bool last);
+
+    /// Drop data queued for sending, and make further sendStream calls fail.
+    void cancelStream();
 
 private:
-    void _initStream();
+    ChannelStream* _prepareStream();
 
     SsiSession& _ssiSession;
+    std::mutex _streamMtx; ///< Protects _stream and _cancelled
     ChannelStream* _stream;
+    bool _cancelled{false};
 };
 
 }}} // namespace lsst::qserv::xrdsvc